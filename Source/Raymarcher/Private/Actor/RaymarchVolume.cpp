@@ -6,12 +6,20 @@
 #include "Actor/RaymarchVolume.h"
 
 #include "GenericPlatform/GenericPlatformTime.h"
+#include "RenderGraphUtils.h"
 #include "RenderTargetVolumeMipped.h"
+#include "Rendering/AdaptiveStepping.h"
 #include "Rendering/RaymarchMaterialParameters.h"
+#include "Rendering/LightingRenderCache.h"
 #include "Rendering/LightingShaderUtils.h"
+#include "Rendering/LightingShaders.h"
+#include "Rendering/LightingShadersExperimental.h"
+#include "Rendering/OctreeShaders.h"
+#include "Rendering/ReducedResolutionRaymarch.h"
 #include "TextureUtilities.h"
 #include "UObject/SavePackage.h"
 #include "Util/RaymarchUtils.h"
+#include "Util/UtilityShaders.h"
 #include "VolumeAsset/Loaders/MHDLoader.h"
 #include "VolumeAsset/VolumeAsset.h"
 
@@ -137,6 +145,9 @@ void ARaymarchVolume::PostRegisterAllComponents()
 		OctreeRaymarchMaterial->SetScalarParameterValue(RaymarchParams::OctreeMip, OctreeVolumeMip);
 	}
 
+	SetMaterialAdaptiveStepParameters();
+	SetMaterialProjectionMode();
+
 	if (StaticMeshComponent)
 	{
 		if (LitRaymarchMaterial && SelectRaymarchMaterial == ERaymarchMaterial::Lit)
@@ -147,9 +158,12 @@ void ARaymarchVolume::PostRegisterAllComponents()
 		{
 			StaticMeshComponent->SetMaterial(0, IntensityRaymarchMaterial);
 		}
-		else if (OctreeRaymarchMaterial && SelectRaymarchMaterial == ERaymarchMaterial::Octree)
+		else if (OctreeRaymarchMaterial && (SelectRaymarchMaterial == ERaymarchMaterial::Octree ||
+											  SelectRaymarchMaterial == ERaymarchMaterial::OctreeSkipping ||
+											  SelectRaymarchMaterial == ERaymarchMaterial::Projection))
 		{
-			StaticMeshComponent->SetMaterial(0, OctreeRaymarchMaterial);
+			// Also sets the octree material mode.
+			SwitchRenderer(SelectRaymarchMaterial);
 		}
 	}
 
@@ -173,6 +187,18 @@ void ARaymarchVolume::OnConstruction(const FTransform& Transform)
 	}
 }
 
+void ARaymarchVolume::PostLoad()
+{
+	Super::PostLoad();
+
+	// Volumes saved before LightVolumeFormat existed could only switch between G8 and R32F.
+	if (bLightVolume32Bit_DEPRECATED)
+	{
+		LightVolumeFormat = ELightVolumeFormat::R32F;
+		bLightVolume32Bit_DEPRECATED = false;
+	}
+}
+
 #if WITH_EDITOR
 
 void ARaymarchVolume::OnVolumeAssetChangedTF(UCurveLinearColor* Curve)
@@ -207,7 +233,7 @@ void ARaymarchVolume::OnImageInfoChangedInEditor()
 	SetMaterialWindowingParameters();
 
 	static double LastTimeReset = 0.0f;
-	if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+	if (UsesLightVolume())
 	{
 		// Don't wait for recompute for next frame.
 
@@ -242,7 +268,7 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 
 	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, LightsArray))
 	{
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		if (UsesLightVolume())
 		{
 			bRequestedRecompute = true;
 		}
@@ -251,7 +277,7 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 
 	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, ClippingPlane))
 	{
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		if (UsesLightVolume())
 		{
 			bRequestedRecompute = true;
 		}
@@ -264,7 +290,7 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 		PropertyName == GET_MEMBER_NAME_CHECKED(FWindowingParameters, HighCutoff) ||
 		PropertyName == GET_MEMBER_NAME_CHECKED(FWindowingParameters, LowCutoff))
 	{
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		if (UsesLightVolume())
 		{
 			bRequestedRecompute = true;
 		}
@@ -273,17 +299,44 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 	}
 
 	if (PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, LightVolumeHalfResolution) ||
-		PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, bLightVolume32Bit))
+		PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, LightVolumeFormat))
 	{
 		InitializeRaymarchResources(RaymarchResources.DataVolumeTextureRef);
 		SetMaterialVolumeParameters();
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		if (UsesLightVolume())
 		{
 			bRequestedRecompute = true;
 		}
 		return;
 	}
 
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, bMultiResolutionLightVolume))
+	{
+		if (!bMultiResolutionLightVolume)
+		{
+			FreeCoarseLightVolumes();
+		}
+		if (UsesLightVolume())
+		{
+			bRequestedRecompute = true;
+		}
+		return;
+	}
+
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, bAsyncCompute))
+	{
+		CancelAsyncCompute();
+		if (UsesLightVolume())
+		{
+			bRequestedRecompute = true;
+		}
+		if (UsesOctree())
+		{
+			bRequestedOctreeRebuild = true;
+		}
+		return;
+	}
+
 	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, RaymarchingSteps))
 	{
 		if (RaymarchResources.bIsInitialized)
@@ -295,173 +348,1164 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 		return;
 	}
 
-	if (PropertyName == GET_ENUMERATOR_NAME_CHECKED(ARaymarchVolume, SelectRaymarchMaterial))
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, RaymarchQuality))
+	{
+		SetMaterialAdaptiveStepParameters();
+		return;
+	}
+
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, RaymarchProjection))
+	{
+		SetRaymarchProjection(RaymarchProjection);
+		return;
+	}
+
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, bPreIntegratedTF))
+	{
+		SetLitMaterialTransferFunction();
+		return;
+	}
+
+	if (PropertyName == GET_ENUMERATOR_NAME_CHECKED(ARaymarchVolume, SelectRaymarchMaterial) ||
+		PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, RaymarchStepping))
+	{
+		SwitchRenderer(SelectRaymarchMaterial);
+		if (UsesLightVolume())
+		{
+			bRequestedRecompute = true;
+		}
+		if (UsesOctree())
+		{
+			bRequestedOctreeRebuild = true;
+		}
+	}
+
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, OctreeVolumeMip))
+	{
+		if (RaymarchResources.bIsInitialized)
+		{
+			OctreeRaymarchMaterial->SetScalarParameterValue(RaymarchParams::OctreeMip, OctreeVolumeMip);
+		}
+	}
+}
+
+bool ARaymarchVolume::ShouldTickIfViewportsOnly() const
+{
+	return true;
+}
+
+#endif	  // #if WITH_EDITOR
+
+void ARaymarchVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopReducedResolutionRaymarch();
+	Super::EndPlay(EndPlayReason);
+}
+
+void ARaymarchVolume::Destroyed()
+{
+	StopReducedResolutionRaymarch();
+	Super::Destroyed();
+}
+
+void ARaymarchVolume::BeginDestroy()
+{
+	// Volumes of editor worlds get neither EndPlay nor Destroyed when the world goes away.
+	if (bDrawnAtReducedResolution)
+	{
+		FReducedResolutionRaymarchExtension::RemoveVolume(this);
+		bDrawnAtReducedResolution = false;
+	}
+	Super::BeginDestroy();
+}
+
+// Called every frame
+void ARaymarchVolume::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Uncomment to see logs of potentially weird ticking behavior in-editor when dragging sliders in VolumeInfo.
+	//
+	// 	static int TickFrame = 0;
+	//
+	// 	FString Log = "Tick :\nInitialized = " + FString::FromInt(RaymarchResources.bIsInitialized) +
+	// 				  "\nRecompute = " + FString::FromInt(bRequestedRecompute) + "\nDeltaTime = " +
+	// FString::SanitizeFloat(DeltaTime)
+	// +
+	// 				  "\nTick number = " + FString::FromInt(TickFrame++);
+	//
+	// 	GEngine->AddOnScreenDebugMessage(0, 0, FColor::Yellow, Log);
+
+	if (!RaymarchResources.bIsInitialized || !RootComponent->IsVisible())
+	{
+		// If not initialized, return.
+		// #TODO? we could also stop ticks altogether when not initialized.
+		StopReducedResolutionRaymarch();
+		return;
+	}
+
+	// Volume transform changed or clipping plane moved.
+	const bool bWorldParametersChanged = WorldParameters != GetWorldParameters();
+	if (bWorldParametersChanged)
+	{
+		UpdateWorldParameters();
+		SetMaterialClippingParameters();
+	}
+
+	if (bAsyncCompute)
+	{
+		TickAsyncComputeOctree();
+	}
+	else if (bRequestedOctreeRebuild && UsesOctree())
+	{
+		URaymarchUtils::GenerateOctree(RaymarchResources);
+		// We rebuild the octree. Set to false to prevent additional unwanted rebuild.
+		bRequestedOctreeRebuild = false;
+	}
+
+	TickLightVolume(bWorldParametersChanged);
+
+	// After the lights, so that the history accumulated at reduced resolution gets thrown away in the frame the light volume
+	// changes.
+	UpdateReducedResolutionRaymarch();
+}
+
+void ARaymarchVolume::TickLightVolume(bool bWorldParametersChanged)
+{
+	// Only check if we need to update lights if we're using a Lit raymarch material.
+	// (No point in recalculating a light volume that's not currently being used anyways).
+	if (!UsesLightVolume())
+	{
+		return;
+	}
+
+	// For testing light calculation shader speed - comment out when not testing! (otherwise lights get recalculated every tick
+	// for no reason).
+	// 		ResetAllLights();
+	// 		return;
+
+	if (bMultiResolutionLightVolume)
+	{
+		TickMultiResolutionLightVolume(bWorldParametersChanged);
+		return;
+	}
+
+	if (bAsyncCompute)
+	{
+		TickAsyncComputeLightVolume(bWorldParametersChanged);
+		return;
+	}
+
+	if (LightPropagationScheduler.IsActive() && !bTimeSlicedLightPropagation)
+	{
+		// Time slicing got switched off during a recompute - finish it at once instead.
+		CancelTimeSlicedLightPropagation();
+		bRequestedRecompute = true;
+	}
+
+	// A time-sliced recompute in flight checks itself whether the world parameters change affects it.
+	if (bWorldParametersChanged && !bRequestedRecompute && !LightPropagationScheduler.IsActive())
+	{
+		UpdateLightsForWorldParametersChange();
+	}
+
+	if (bTimeSlicedLightPropagation && (bRequestedRecompute || LightPropagationScheduler.IsActive()))
+	{
+		TickTimeSlicedLightPropagation();
+	}
+	else if (bRequestedRecompute)
+	{
+		// If we're requesting recompute or parameters changed,
+		ResetAllLights();
+	}
+	else
+	{
+		// Check each individual light if it needs an update.
+		TArray<ARaymarchLight*> LightsToUpdate;
+		for (ARaymarchLight* Light : LightsArray)
+		{
+			if (!Light)
+			{
+				continue;
+			}
+			if (!LightParametersMap.Contains(Light))
+			{
+				LightParametersMap.Add(Light, Light->GetCurrentParameters());
+				LightsToUpdate.Add(Light);
+			}
+			else if (Light->GetCurrentParameters() != LightParametersMap[Light])
+			{
+				LightsToUpdate.Add(Light);
+			}
+		}
+
+		// More than half lights need update -> full reset is quicker
+		if ((LightsToUpdate.Num() > 1) && LightsToUpdate.Num() >= (LightsArray.Num() / 2))
+		{
+			if (bTimeSlicedLightPropagation)
+			{
+				bRequestedRecompute = true;
+				TickTimeSlicedLightPropagation();
+			}
+			else
+			{
+				ResetAllLights();
+			}
+		}
+		else
+		{
+			// Only update the lights that need it.
+			for (ARaymarchLight* UpdatedLight : LightsToUpdate)
+			{
+				UpdateSingleLight(UpdatedLight);
+				LightParametersMap[UpdatedLight] = UpdatedLight->GetCurrentParameters();
+			}
+		}
+	}
+}
+
+void ARaymarchVolume::ResetAllLights()
+{
+	if (!RaymarchResources.bIsInitialized)
+	{
+		return;
+	}
+
+	if (bMultiResolutionLightVolume)
+	{
+		ResetAllLightsMultiResolution();
+		return;
+	}
+
+	if (bAsyncCompute)
+	{
+		// Recomputing into the displayed light volume would get overwritten by a recompute in flight - queue a new one instead.
+		bRequestedRecompute = true;
+		return;
+	}
+
+	// Recomputing at once makes a time-sliced recompute in flight pointless.
+	CancelTimeSlicedLightPropagation();
+
+	// Clear Light volume to zero.
+	UVolumeTextureToolkit::ClearVolumeTexture(RaymarchResources.LightVolumeRenderTarget, 0);
+	RaymarchHistoryVersion++;
+
+	// Add all lights.
+	bool bResetWasSuccessful = true;
+	TMap<ARaymarchLight*, FLightSnapshotState> OldLightSnapshots = MoveTemp(LightSnapshots);
+	LightSnapshots.Reset();
+	TArray<FDirLightParameters> BatchedLightParameters;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (!Light)
+		{
+			continue;
+		}
+		bool bLightAddWasSuccessful = false;
+
+		// Snapshots can only be captured from a single light's buffers.
+		FLightPropagationSnapshots CaptureSnapshots;
+		if (bDirtyRegionLightRecompute)
+		{
+			CaptureSnapshots = PlanSnapshotCapture(Light->GetCurrentParameters(), WorldParameters, GetLightVolumeDimensions());
+		}
+		const bool bCapturesSnapshots = CaptureSnapshots.Axes[0].IsValid() || CaptureSnapshots.Axes[1].IsValid();
+
+		if (bBatchedLightPropagation && !bCapturesSnapshots)
+		{
+			// Added together with the other batched lights below.
+			BatchedLightParameters.Add(Light->GetCurrentParameters());
+		}
+		else if (bCapturesSnapshots)
+		{
+			// Capture snapshots a few slices before the clipping plane, so that moving it doesn't need to recompute this light.
+			FLightSnapshotState SnapshotState = OldLightSnapshots.FindRef(Light);
+			if (!SnapshotState.Buffers)
+			{
+				SnapshotState.Buffers = MakeShared<FLightSnapshotBuffers, ESPMode::ThreadSafe>();
+			}
+			SnapshotState.Snapshots = CaptureSnapshots;
+			URaymarchUtils::AddDirLightWithSnapshotsToSingleVolume(RaymarchResources, Light->GetCurrentParameters(), WorldParameters,
+				SnapshotState.Snapshots, SnapshotState.Buffers, bResetWasSuccessful);
+			LightSnapshots.Add(Light, SnapshotState);
+		}
+		else
+		{
+			URaymarchUtils::AddDirLightToSingleVolume(
+				RaymarchResources, Light->GetCurrentParameters(), true, WorldParameters, bResetWasSuccessful,
+				LightPropagationEngine == ELightPropagationEngine::SingleDispatch);
+		}
+
+		if (!bResetWasSuccessful)
+		{
+			FString log = "Error. Could not add/remove light " + Light->GetName() + " in volume " + GetName() + " .";
+			UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log);
+			return;
+		}
+		LightParametersMap.Add(Light, Light->GetCurrentParameters());
+	}
+
+	if (BatchedLightParameters.Num() > 0)
+	{
+		URaymarchUtils::AddDirLightsToSingleVolume(
+			RaymarchResources, BatchedLightParameters, true, WorldParameters, bResetWasSuccessful);
+		if (!bResetWasSuccessful)
+		{
+			UE_LOG(LogRaymarchVolume, Error, TEXT("Error. Could not add batched lights in volume %s."), *GetName());
+			return;
+		}
+	}
+
+	// False-out request recompute flag when we succeeded in resetting lights.
+	bRequestedRecompute = false;
+	LightVolumeWorldParameters = WorldParameters;
+}
+
+void ARaymarchVolume::UpdateLightsForWorldParametersChange()
+{
+	switch (ClassifyWorldParametersChange(LightVolumeWorldParameters, WorldParameters))
+	{
+		case ELightVolumeInvalidation::None:
+			// Translated or scaled uniformly - every light still has the same local direction.
+			LightRecomputesAvoided++;
+			return;
+		case ELightVolumeInvalidation::Clipping:
+			// Only the clipping plane moved (relative to the volume) - re-propagate the slices it affects if that's cheaper.
+			if (!bDirtyRegionLightRecompute || !UpdateLightsForClippingChange())
+			{
+				bRequestedRecompute = true;
+			}
+			return;
+		case ELightVolumeInvalidation::Full:
+			bRequestedRecompute = true;
+			return;
+		default:
+			break;
+	}
+
+	// Rotated or scaled non-uniformly - change every light from the local direction it was propagated with to the new one.
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (!Light || !LightParametersMap.Contains(Light))
+		{
+			continue;
+		}
+		const FDirLightParameters PropagatedParameters = GetLightParametersForTransform(
+			LightParametersMap[Light], LightVolumeWorldParameters.VolumeTransform, WorldParameters.VolumeTransform);
+		if (PropagatedParameters.LightDirection.Equals(Light->GetCurrentParameters().LightDirection, UE_KINDA_SMALL_NUMBER) &&
+			PropagatedParameters.LightIntensity == Light->GetCurrentParameters().LightIntensity)
+		{
+			// E.g. rotating around the light direction.
+			continue;
+		}
+		UpdateSingleLight(Light);
+		LightParametersMap[Light] = Light->GetCurrentParameters();
+		IncrementalLightUpdates++;
+	}
+	LightVolumeWorldParameters = WorldParameters;
+	LightRecomputesAvoided++;
+}
+
+bool ARaymarchVolume::UpdateLightsForClippingChange()
+{
+	struct FLightClippingChange
+	{
+		ARaymarchLight* Light;
+		FDirLightParameters PropagatedParameters;
+		FClippingChangePlan Plan;
+	};
+
+	// Plan all lights first - if re-propagating is more work than recomputing everything, leave the light volume alone.
+	TArray<FLightClippingChange> Changes;
+	int64 Cost = 0;
+	int64 FullCost = 0;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (!Light || !LightParametersMap.Contains(Light))
+		{
+			continue;
+		}
+		FLightClippingChange& Change = Changes.AddDefaulted_GetRef();
+		Change.Light = Light;
+		Change.PropagatedParameters = GetLightParametersForTransform(
+			LightParametersMap[Light], LightVolumeWorldParameters.VolumeTransform, WorldParameters.VolumeTransform);
+		Change.Plan = PlanClippingChange(Change.PropagatedParameters, LightVolumeWorldParameters, WorldParameters,
+			GetLightVolumeDimensions(), LightSnapshots.FindOrAdd(Light).Snapshots);
+		Cost += Change.Plan.GetCost();
+		FullCost += Change.Plan.GetFullCost();
+	}
+	if (Cost >= FullCost)
+	{
+		return false;
+	}
+
+	RaymarchHistoryVersion++;
+	for (const FLightClippingChange& Change : Changes)
+	{
+		FLightSnapshotState& SnapshotState = LightSnapshots[Change.Light];
+		if (!SnapshotState.Buffers)
+		{
+			SnapshotState.Buffers = MakeShared<FLightSnapshotBuffers, ESPMode::ThreadSafe>();
+		}
+
+		bool bLightChangeWasSuccessful = false;
+		URaymarchUtils::ChangeClippingInSingleVolume(RaymarchResources, Change.PropagatedParameters, LightVolumeWorldParameters,
+			WorldParameters, Change.Plan, SnapshotState.Buffers, bLightChangeWasSuccessful);
+		if (!bLightChangeWasSuccessful)
+		{
+			FString log = "Error. Could not change clipping of light " + Change.Light->GetName() + " in volume " + GetName() + " .";
+			UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log);
+			return false;
+		}
+		SnapshotState.Snapshots = Change.Plan.NewSnapshots;
+		DirtyRegionLightUpdates++;
+	}
+	LightVolumeWorldParameters = WorldParameters;
+	LightRecomputesAvoided++;
+	return true;
+}
+
+void ARaymarchVolume::TickTimeSlicedLightPropagation()
+{
+	if (!RaymarchResources.TFTextureRef || !RaymarchResources.TFTextureRef->GetResource())
+	{
+		return;
+	}
+
+	TArray<ARaymarchLight*> Lights;
+	TArray<FDirLightParameters> LightParameters;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (Light)
+		{
+			Lights.Add(Light);
+			LightParameters.Add(Light->GetCurrentParameters());
+		}
+	}
+
+	const bool bInFlight = LightPropagationScheduler.IsActive();
+	if (bRequestedRecompute || !bInFlight || LightPropagationScheduler.IsOutdated(LightParameters, WorldParameters))
+	{
+		if (!EnsurePendingLightVolume())
+		{
+			UE_LOG(LogRaymarchVolume, Error, TEXT("Could not create the pending light volume of %s, recomputing lights at once."),
+				*GetName());
+			ResetAllLights();
+			return;
+		}
+		if (bInFlight)
+		{
+			LightPropagationRestarts++;
+		}
+
+		// Whatever the cancelled recompute left in the pending light volume gets cleared before the chunks of the new one.
+		UVolumeTextureToolkit::ClearVolumeTexture(RaymarchResources.PendingLightVolumeRenderTarget, 0);
+		const bool bHasBatchBuffers = RaymarchResources.XYZBatchReadWriteBuffers[0].UAVs[0] &&
+									  RaymarchResources.XYZBatchReadWriteBuffers[1].UAVs[0] &&
+									  RaymarchResources.XYZBatchReadWriteBuffers[2].UAVs[0];
+		LightPropagationScheduler.Start(
+			LightParameters, WorldParameters, GetLightVolumeDimensions(), bBatchedLightPropagation && bHasBatchBuffers);
+		ScheduledLights = MoveTemp(Lights);
+		bRequestedRecompute = false;
+	}
+
+	// Propagate into the pending light volume, the displayed one stays untouched.
+	FBasicRaymarchRenderingResources PendingResources = RaymarchResources;
+	PendingResources.LightVolumeRenderTarget = RaymarchResources.PendingLightVolumeRenderTarget;
+	PendingResources.LightVolumeUAVRef = RaymarchResources.PendingLightVolumeUAVRef;
+	LightPropagationScheduler.ExecuteChunks(PendingResources, LightPropagationScheduler.PlanFrame(LightPropagationBudgetMs));
+
+	LightPropagationQueueDepth = LightPropagationScheduler.GetQueueDepth();
+	LightPropagationNanosecondsPerVoxel = static_cast<float>(LightPropagationScheduler.GetNanosecondsPerVoxel());
+	if (LightPropagationScheduler.IsComplete())
+	{
+		FinishTimeSlicedLightPropagation();
+	}
+}
+
+void ARaymarchVolume::FinishTimeSlicedLightPropagation()
+{
+	// The chunks are enqueued before the material parameters change, so the first frame showing the new volume sees it complete.
+	Swap(RaymarchResources.LightVolumeRenderTarget, RaymarchResources.PendingLightVolumeRenderTarget);
+	Swap(RaymarchResources.LightVolumeUAVRef, RaymarchResources.PendingLightVolumeUAVRef);
+	SetMaterialVolumeParameters();
+
+	const TArray<FDirLightParameters>& LightParameters = LightPropagationScheduler.GetLights();
+	LightParametersMap.Reset();
+	for (int32 i = 0; i < ScheduledLights.Num(); i++)
+	{
+		LightParametersMap.Add(ScheduledLights[i], LightParameters[i]);
+	}
+	LightVolumeWorldParameters = LightPropagationScheduler.GetWorldParameters();
+	// Time-sliced recomputes don't capture clipping snapshots.
+	LightSnapshots.Reset();
+
+	LightPropagationLatencyMs = static_cast<float>(LightPropagationScheduler.GetSecondsSinceStart() * 1000.0);
+	LightPropagationLatencyFrames = LightPropagationScheduler.GetFramesPlanned();
+	CancelTimeSlicedLightPropagation();
+}
+
+void ARaymarchVolume::CancelTimeSlicedLightPropagation()
+{
+	LightPropagationScheduler.Cancel();
+	ScheduledLights.Reset();
+	LightPropagationQueueDepth = 0;
+}
+
+bool ARaymarchVolume::EnsurePendingLightVolume()
+{
+	if (RaymarchResources.PendingLightVolumeRenderTarget && RaymarchResources.PendingLightVolumeUAVRef)
+	{
+		return true;
+	}
+	const UTextureRenderTargetVolume* LightVolume = RaymarchResources.LightVolumeRenderTarget;
+	if (!LightVolume)
+	{
+		return false;
+	}
+
+	// Same as the displayed light volume, so that the two can be swapped.
+	RaymarchResources.PendingLightVolumeRenderTarget =
+		NewObject<UTextureRenderTargetVolume>(this, "Pending Light Volume Render Target");
+	RaymarchResources.PendingLightVolumeRenderTarget->bCanCreateUAV = true;
+	RaymarchResources.PendingLightVolumeRenderTarget->bHDR = LightVolume->bHDR;
+	RaymarchResources.PendingLightVolumeRenderTarget->Init(
+		LightVolume->SizeX, LightVolume->SizeY, LightVolume->SizeZ, LightVolume->OverrideFormat);
+
+	// Flush rendering commands so that the texture is definitely initialized with resources and we can create a UAV ref.
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	(
+		[&](FRHICommandListImmediate& RHICmdList)
+		{
+			UTextureRenderTargetVolume* PendingLightVolume = RaymarchResources.PendingLightVolumeRenderTarget;
+			if (!PendingLightVolume->GetResource() || !PendingLightVolume->GetResource()->TextureRHI)
+			{
+				return;
+			}
+			RaymarchResources.PendingLightVolumeUAVRef = RHICreateUnorderedAccessView(PendingLightVolume->GetResource()->TextureRHI);
+			INC_DWORD_STAT(STAT_RaymarcherLightingRHICreations);
+		});
+	FlushRenderingCommands();
+	return RaymarchResources.PendingLightVolumeUAVRef.IsValid();
+}
+
+FIntVector ARaymarchVolume::GetLightVolumeDimensions() const
+{
+	const UTextureRenderTargetVolume* LightVolume = RaymarchResources.LightVolumeRenderTarget;
+	return LightVolume ? FIntVector(LightVolume->SizeX, LightVolume->SizeY, LightVolume->SizeZ) : FIntVector(0, 0, 0);
+}
+
+bool ARaymarchVolume::PollAsyncCompute(FAsyncComputeWork& Work)
+{
+	if (*Work.SubmittedFlag)
+	{
+		return true;
+	}
+
+	// The scene renderer normally picks the work up a frame or two behind the game thread. Anything longer means no scene is
+	// being rendered (e.g. the editor viewport is hidden), which would keep the work queued forever.
+	constexpr int32 FramesBeforeFlush = 3;
+	if (++Work.FramesWaited > FramesBeforeFlush)
+	{
+		FRaymarchSceneViewExtension::Flush();
+		Work.FramesWaited = 0;
+		AsyncComputeFlushes++;
+	}
+	return false;
+}
+
+void ARaymarchVolume::TickAsyncComputeLightVolume(bool bWorldParametersChanged)
+{
+	// Async compute recomputes replace the time-sliced ones.
+	CancelTimeSlicedLightPropagation();
+
+	if (AsyncComputeLightVolume.SubmittedFlag)
+	{
+		if (!PollAsyncCompute(AsyncComputeLightVolume))
+		{
+			return;
+		}
+
+		// The recompute is in a graph submitted before the materials of the next frame, so the first frame showing the new volume
+		// sees it complete.
+		Swap(RaymarchResources.LightVolumeRenderTarget, RaymarchResources.PendingLightVolumeRenderTarget);
+		Swap(RaymarchResources.LightVolumeUAVRef, RaymarchResources.PendingLightVolumeUAVRef);
+		SetMaterialVolumeParameters();
+
+		LightParametersMap.Reset();
+		for (int32 i = 0; i < AsyncComputeLights.Num(); i++)
+		{
+			LightParametersMap.Add(AsyncComputeLights[i], AsyncComputeLightParameters[i]);
+		}
+		LightVolumeWorldParameters = AsyncComputeWorldParameters;
+		// Async compute recomputes don't capture clipping snapshots.
+		LightSnapshots.Reset();
+		AsyncComputeLightVolume = FAsyncComputeWork();
+	}
+
+	// Compare against what the displayed light volume was computed with - the world parameters may have changed several times
+	// while a recompute was in flight.
+	bool bRecompute = bRequestedRecompute;
+	if (ClassifyWorldParametersChange(LightVolumeWorldParameters, WorldParameters) != ELightVolumeInvalidation::None)
+	{
+		bRecompute = true;
+	}
+	else if (bWorldParametersChanged)
+	{
+		LightRecomputesAvoided++;
+	}
+
+	TArray<ARaymarchLight*> Lights;
+	TArray<FDirLightParameters> LightParameters;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (!Light)
+		{
+			continue;
+		}
+		Lights.Add(Light);
+		LightParameters.Add(Light->GetCurrentParameters());
+		const FDirLightParameters* LastParameters = LightParametersMap.Find(Light);
+		bRecompute |= !LastParameters || *LastParameters != LightParameters.Last();
+	}
+	// Catches removed lights.
+	bRecompute |= Lights.Num() != LightParametersMap.Num();
+
+	if (!bRecompute || !RaymarchResources.TFTextureRef || !RaymarchResources.TFTextureRef->GetResource())
+	{
+		return;
+	}
+	if (!EnsurePendingLightVolume())
+	{
+		UE_LOG(
+			LogRaymarchVolume, Error, TEXT("Could not create the pending light volume of %s, can't recompute lights."), *GetName());
+		bRequestedRecompute = false;
+		return;
+	}
+
+	FBasicRaymarchRenderingResources PendingResources = RaymarchResources;
+	PendingResources.LightVolumeRenderTarget = RaymarchResources.PendingLightVolumeRenderTarget;
+	PendingResources.LightVolumeUAVRef = RaymarchResources.PendingLightVolumeUAVRef;
+	const bool bBatched = bBatchedLightPropagation && RaymarchResources.XYZBatchReadWriteBuffers[0].UAVs[0] &&
+						  RaymarchResources.XYZBatchReadWriteBuffers[1].UAVs[0] &&
+						  RaymarchResources.XYZBatchReadWriteBuffers[2].UAVs[0];
+	const bool bSingleDispatch = LightPropagationEngine == ELightPropagationEngine::SingleDispatch;
+
+	AsyncComputeLightVolume.SubmittedFlag = FRaymarchSceneViewExtension::Enqueue(
+		[PendingResources, LightParameters, WorldParameters = WorldParameters, bBatched, bSingleDispatch](
+			FRDGBuilder& GraphBuilder)
+		{
+			// Clearing on the async compute queue as well, so that the whole recompute overlaps with the graphics pipe.
+			FRDGTextureRef LightVolume = RegisterExternalTexture(
+				GraphBuilder, PendingResources.LightVolumeRenderTarget->GetResource()->TextureRHI, TEXT("Light Volume"));
+			AddClearVolumeTexturePass(GraphBuilder, GraphBuilder.CreateUAV(LightVolume), 0, GetRaymarchComputePassFlags());
+
+			if (bBatched)
+			{
+				AddDirLightsToSingleLightVolume_RenderThread(GraphBuilder, PendingResources, LightParameters, true, WorldParameters);
+				return;
+			}
+			for (const FDirLightParameters& Light : LightParameters)
+			{
+				if (bSingleDispatch)
+				{
+					AddDirLightToSingleLightVolume_GPUSync_RenderThread(
+						GraphBuilder, PendingResources, Light, true, WorldParameters);
+				}
+				else
+				{
+					AddDirLightToSingleLightVolume_RenderThread(GraphBuilder, PendingResources, Light, true, WorldParameters);
+				}
+			}
+		});
+
+	AsyncComputeLights = MoveTemp(Lights);
+	AsyncComputeLightParameters = MoveTemp(LightParameters);
+	AsyncComputeWorldParameters = WorldParameters;
+	AsyncComputeLightRecomputes++;
+	bRequestedRecompute = false;
+}
+
+void ARaymarchVolume::TickAsyncComputeOctree()
+{
+	if (AsyncComputeOctree.SubmittedFlag)
+	{
+		if (!PollAsyncCompute(AsyncComputeOctree))
+		{
+			return;
+		}
+		Swap(RaymarchResources.OctreeVolumeRenderTarget, RaymarchResources.PendingOctreeVolumeRenderTarget);
+		Swap(RaymarchResources.OctreeUAVRef, RaymarchResources.PendingOctreeUAVRef);
+		SetMaterialVolumeParameters();
+		AsyncComputeOctree = FAsyncComputeWork();
+	}
+
+	if (!bRequestedOctreeRebuild || !UsesOctree())
+	{
+		return;
+	}
+	// We rebuild the octree. Set to false to prevent additional unwanted rebuild.
+	bRequestedOctreeRebuild = false;
+
+	if (!EnsurePendingOctree())
+	{
+		UE_LOG(LogRaymarchVolume, Error, TEXT("Could not create the pending octree of %s, generating it at once."), *GetName());
+		URaymarchUtils::GenerateOctree(RaymarchResources);
+		return;
+	}
+
+	FBasicRaymarchRenderingResources PendingResources = RaymarchResources;
+	PendingResources.OctreeVolumeRenderTarget = RaymarchResources.PendingOctreeVolumeRenderTarget;
+	PendingResources.OctreeUAVRef = RaymarchResources.PendingOctreeUAVRef;
+	AsyncComputeOctree.SubmittedFlag = FRaymarchSceneViewExtension::Enqueue(
+		[PendingResources](FRDGBuilder& GraphBuilder) { GenerateOctreeForVolume_RenderThread(GraphBuilder, PendingResources); });
+}
+
+bool ARaymarchVolume::EnsurePendingOctree()
+{
+	if (RaymarchResources.PendingOctreeVolumeRenderTarget && RaymarchResources.PendingOctreeUAVRef)
+	{
+		return true;
+	}
+	const URenderTargetVolumeMipped* Octree = RaymarchResources.OctreeVolumeRenderTarget;
+	if (!Octree)
+	{
+		return false;
+	}
+
+	// Same as the displayed octree, so that the two can be swapped.
+	RaymarchResources.PendingOctreeVolumeRenderTarget = NewObject<URenderTargetVolumeMipped>(this, "Pending Octree Render Target");
+	RaymarchResources.PendingOctreeVolumeRenderTarget->bCanCreateUAV = true;
+	RaymarchResources.PendingOctreeVolumeRenderTarget->bHDR = false;
+	RaymarchResources.PendingOctreeVolumeRenderTarget->Init(
+		Octree->SizeX, Octree->SizeY, Octree->SizeZ, Octree->GetNumMips(), OCTREE_PIXEL_FORMAT);
+
+	// Flush rendering commands so that the texture is definitely initialized with resources and we can create a UAV ref.
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	(
+		[&](FRHICommandListImmediate& RHICmdList)
+		{
+			URenderTargetVolumeMipped* PendingOctree = RaymarchResources.PendingOctreeVolumeRenderTarget;
+			if (!PendingOctree->GetResource() || !PendingOctree->GetResource()->TextureRHI)
+			{
+				return;
+			}
+			RaymarchResources.PendingOctreeUAVRef = RHICreateUnorderedAccessView(PendingOctree->GetResource()->TextureRHI);
+		});
+	FlushRenderingCommands();
+	return RaymarchResources.PendingOctreeUAVRef.IsValid();
+}
+
+void ARaymarchVolume::CancelAsyncCompute()
+{
+	if (AsyncComputeLightVolume.SubmittedFlag || AsyncComputeOctree.SubmittedFlag)
+	{
+		// The queued work renders into the pending light volume and octree - get it rendered before they can go away.
+		FRaymarchSceneViewExtension::Flush();
+		FlushRenderingCommands();
+	}
+
+	// Whatever got dropped still needs to get done.
+	bRequestedRecompute |= AsyncComputeLightVolume.SubmittedFlag.IsValid();
+	bRequestedOctreeRebuild |= AsyncComputeOctree.SubmittedFlag.IsValid();
+	AsyncComputeLightVolume = FAsyncComputeWork();
+	AsyncComputeOctree = FAsyncComputeWork();
+	AsyncComputeLights.Reset();
+	AsyncComputeLightParameters.Reset();
+}
+
+void ARaymarchVolume::TickMultiResolutionLightVolume(bool bWorldParametersChanged)
+{
+	// Time-sliced recomputes only render into the full resolution light volume.
+	CancelTimeSlicedLightPropagation();
+
+	if (bWorldParametersChanged && !bRequestedRecompute)
+	{
+		// Translated or scaled uniformly - every light still has the same local direction. Anything else recomputes the lights
+		// at their coarse levels, which is what makes the multi-resolution light volume cheap to interact with.
+		if (ClassifyWorldParametersChange(LightVolumeWorldParameters, WorldParameters) == ELightVolumeInvalidation::None)
+		{
+			LightRecomputesAvoided++;
+		}
+		else
+		{
+			bRequestedRecompute = true;
+		}
+	}
+	if (bRequestedRecompute)
+	{
+		ResetAllLightsMultiResolution();
+		return;
+	}
+
+	// Changed lights go to the level picked for them.
+	TArray<FLightVolumeLODChange> Changes;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		if (!Light)
+		{
+			continue;
+		}
+		FLightVolumeLODChange Change;
+		Change.Light = Light;
+		Change.bAdd = true;
+		Change.AddedParameters = Light->GetCurrentParameters();
+		Change.AddedLevel = SelectLightVolumeLODForLight(Light);
+		if (LightParametersMap.Contains(Light) && LightVolumeLODs.Contains(Light))
+		{
+			if (Light->GetCurrentParameters() == LightParametersMap[Light])
+			{
+				continue;
+			}
+			// The old light was propagated with the transform the light volume was last updated with.
+			Change.bRemove = true;
+			Change.RemovedParameters = GetLightParametersForTransform(
+				LightParametersMap[Light], LightVolumeWorldParameters.VolumeTransform, WorldParameters.VolumeTransform);
+			Change.RemovedLevel = LightVolumeLODs[Light];
+		}
+		Changes.Add(Change);
+	}
+	if (Changes.Num() > 0)
+	{
+		LightVolumeIdleFrames = 0;
+		ApplyLightVolumeLODChanges(Changes);
+		return;
+	}
+
+	// Refine one light per frame once the scene is idle.
+	if (++LightVolumeIdleFrames < LightVolumeRefinementIdleFrames)
+	{
+		return;
+	}
+	TArray<ARaymarchLight*> Lights;
+	TArray<int32> Levels;
+	TArray<float> Contributions;
+	for (ARaymarchLight* Light : LightsArray)
+	{
+		const int32* Level = Light ? LightVolumeLODs.Find(Light) : nullptr;
+		if (Level && LightParametersMap.Contains(Light))
+		{
+			Lights.Add(Light);
+			Levels.Add(*Level);
+			Contributions.Add(GetRelativeLightContribution(Light));
+		}
+	}
+	const int32 Refined = PickLightVolumeLODRefinement(Levels, Contributions);
+	if (Refined == INDEX_NONE)
+	{
+		return;
+	}
+	FLightVolumeLODChange Refinement;
+	Refinement.Light = Lights[Refined];
+	Refinement.bRemove = true;
+	Refinement.RemovedParameters = GetLightParametersForTransform(LightParametersMap[Refinement.Light],
+		LightVolumeWorldParameters.VolumeTransform, WorldParameters.VolumeTransform);
+	Refinement.RemovedLevel = Levels[Refined];
+	Refinement.bAdd = true;
+	Refinement.AddedParameters = Refinement.Light->GetCurrentParameters();
+	Refinement.AddedLevel = Levels[Refined] - 1;
+	if (ApplyLightVolumeLODChanges(MakeArrayView(&Refinement, 1)))
+	{
+		LightVolumeRefinements++;
+	}
+}
+
+void ARaymarchVolume::ResetAllLightsMultiResolution()
+{
+	if (!RaymarchResources.bIsInitialized)
+	{
+		return;
+	}
+	CancelTimeSlicedLightPropagation();
+
+	// Snapshots would only hold the lights propagated at full resolution.
+	LightSnapshots.Reset();
+	LightParametersMap.Reset();
+	LightVolumeLODs.Reset();
+
+	// Clear all levels, the coarse ones aren't upsampled into the full resolution one afterwards.
+	UVolumeTextureToolkit::ClearVolumeTexture(RaymarchResources.LightVolumeRenderTarget, 0);
+	RaymarchHistoryVersion++;
+	for (const FBasicRaymarchRenderingResources& Coarse : CoarseLightVolumeResources)
 	{
-		SwitchRenderer(SelectRaymarchMaterial);
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
-		{
-			bRequestedRecompute = true;
-		}
-		if (SelectRaymarchMaterial == ERaymarchMaterial::Octree)
+		if (Coarse.bIsInitialized)
 		{
-			bRequestedOctreeRebuild = true;
+			UVolumeTextureToolkit::ClearVolumeTexture(Coarse.LightVolumeRenderTarget, 0);
 		}
 	}
 
-	if (PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, OctreeVolumeMip))
+	TArray<FLightVolumeLODChange> Changes;
+	for (ARaymarchLight* Light : LightsArray)
 	{
-		if (RaymarchResources.bIsInitialized)
+		if (Light)
 		{
-			OctreeRaymarchMaterial->SetScalarParameterValue(RaymarchParams::OctreeMip, OctreeVolumeMip);
+			FLightVolumeLODChange& Change = Changes.AddDefaulted_GetRef();
+			Change.Light = Light;
+			Change.bAdd = true;
+			Change.AddedParameters = Light->GetCurrentParameters();
+			Change.AddedLevel = SelectLightVolumeLODForLight(Light);
 		}
 	}
-}
+	if (!ApplyLightVolumeLODChanges(Changes, false))
+	{
+		return;
+	}
 
-bool ARaymarchVolume::ShouldTickIfViewportsOnly() const
-{
-	return true;
+	// False-out request recompute flag when we succeeded in resetting lights.
+	bRequestedRecompute = false;
+	LightVolumeWorldParameters = WorldParameters;
+	LightVolumeIdleFrames = 0;
 }
 
-#endif	  // #if WITH_EDITOR
-
-// Called every frame
-void ARaymarchVolume::Tick(float DeltaTime)
+bool ARaymarchVolume::ApplyLightVolumeLODChanges(TArrayView<const FLightVolumeLODChange> Changes, bool bUpsampled /*= true*/)
 {
-	Super::Tick(DeltaTime);
-
-	// Uncomment to see logs of potentially weird ticking behavior in-editor when dragging sliders in VolumeInfo.
-	//
-	// 	static int TickFrame = 0;
-	//
-	// 	FString Log = "Tick :\nInitialized = " + FString::FromInt(RaymarchResources.bIsInitialized) +
-	// 				  "\nRecompute = " + FString::FromInt(bRequestedRecompute) + "\nDeltaTime = " +
-	// FString::SanitizeFloat(DeltaTime)
-	// +
-	// 				  "\nTick number = " + FString::FromInt(TickFrame++);
-	//
-	// 	GEngine->AddOnScreenDebugMessage(0, 0, FColor::Yellow, Log);
-
-	if (!RaymarchResources.bIsInitialized || !RootComponent->IsVisible())
+	RaymarchHistoryVersion++;
+	bool bTouchedLevels[LightVolumeLODCount] = {};
+	for (const FLightVolumeLODChange& Change : Changes)
 	{
-		// If not initialized, return.
-		// #TODO? we could also stop ticks altogether when not initialized.
-		return;
+		bTouchedLevels[Change.RemovedLevel] |= Change.bRemove;
+		bTouchedLevels[Change.AddedLevel] |= Change.bAdd;
 	}
-
-	// Volume transform changed or clipping plane moved -> need full recompute.
-	if (WorldParameters != GetWorldParameters())
+	for (int32 Level = 1; Level < LightVolumeLODCount; Level++)
 	{
-		bRequestedRecompute = true;
-		UpdateWorldParameters();
-		SetMaterialClippingParameters();
+		if (bTouchedLevels[Level] && !EnsureCoarseLightVolume(Level))
+		{
+			UE_LOG(LogRaymarchVolume, Error, TEXT("Could not create the light volume of LOD %d of %s."), Level, *GetName());
+			return false;
+		}
 	}
 
-	if (bRequestedOctreeRebuild && SelectRaymarchMaterial == ERaymarchMaterial::Octree)
+	// Take the coarse levels out of the full resolution light volume while they change. Everything gets enqueued on the render
+	// thread in order, so the materials never see a light volume in between.
+	auto UpsampleTouchedLevels = [&](float Weight)
 	{
-		URaymarchUtils::GenerateOctree(RaymarchResources);
-		// We rebuild the octree. Set to false to prevent additional unwanted rebuild.
-		bRequestedOctreeRebuild = false;
+		bool bSuccess = true;
+		for (int32 Level = 1; Level < LightVolumeLODCount && bSuccess; Level++)
+		{
+			if (bTouchedLevels[Level])
+			{
+				URaymarchUtils::AddUpsampledLightVolume(
+					RaymarchResources, CoarseLightVolumeResources[Level - 1].LightVolumeRenderTarget, Weight, bSuccess);
+			}
+		}
+		return bSuccess;
+	};
+	if (bUpsampled && !UpsampleTouchedLevels(-1.0f))
+	{
+		UE_LOG(LogRaymarchVolume, Error, TEXT("Could not upsample the coarse light volumes of %s."), *GetName());
+		return false;
 	}
 
-	// Only check if we need to update lights if we're using Lit raymarch material.
-	// (No point in recalculating a light volume that's not currently being used anyways).
-	if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+	const bool bSingleDispatch = LightPropagationEngine == ELightPropagationEngine::SingleDispatch;
+	bool bSuccess = true;
+	for (const FLightVolumeLODChange& Change : Changes)
 	{
-		// For testing light calculation shader speed - comment out when not testing! (otherwise lights get recalculated every tick
-		// for no reason).
-		// 		ResetAllLights();
-		// 		return;
-
-		if (bRequestedRecompute)
+		if (Change.bRemove && Change.bAdd && Change.RemovedLevel == Change.AddedLevel)
 		{
-			// If we're requesting recompute or parameters changed,
-			ResetAllLights();
+			FBasicRaymarchRenderingResources Resources = GetLightVolumeLODResources(Change.AddedLevel);
+			URaymarchUtils::ChangeDirLightInSingleVolume(
+				Resources, Change.RemovedParameters, Change.AddedParameters, WorldParameters, bSuccess);
 		}
 		else
 		{
-			// Check each individual light if it needs an update.
-			TArray<ARaymarchLight*> LightsToUpdate;
-			for (ARaymarchLight* Light : LightsArray)
-			{
-				if (!Light)
-				{
-					continue;
-				}
-				if (!LightParametersMap.Contains(Light))
-				{
-					LightParametersMap.Add(Light, Light->GetCurrentParameters());
-					LightsToUpdate.Add(Light);
-				}
-				else if (Light->GetCurrentParameters() != LightParametersMap[Light])
-				{
-					LightsToUpdate.Add(Light);
-				}
-			}
-
-			// More than half lights need update -> full reset is quicker
-			if ((LightsToUpdate.Num() > 1) && LightsToUpdate.Num() >= (LightsArray.Num() / 2))
+			if (Change.bRemove)
 			{
-				ResetAllLights();
+				URaymarchUtils::AddDirLightToSingleVolume(GetLightVolumeLODResources(Change.RemovedLevel), Change.RemovedParameters,
+					false, WorldParameters, bSuccess, bSingleDispatch);
 			}
-			else
+			if (Change.bAdd && bSuccess)
 			{
-				// Only update the lights that need it.
-				for (ARaymarchLight* UpdatedLight : LightsToUpdate)
-				{
-					UpdateSingleLight(UpdatedLight);
-					LightParametersMap[UpdatedLight] = UpdatedLight->GetCurrentParameters();
-				}
+				URaymarchUtils::AddDirLightToSingleVolume(GetLightVolumeLODResources(Change.AddedLevel), Change.AddedParameters,
+					true, WorldParameters, bSuccess, bSingleDispatch);
 			}
 		}
+		if (!bSuccess)
+		{
+			FString log = "Error. Could not change light " + Change.Light->GetName() + " in volume " + GetName() + " .";
+			UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log);
+			break;
+		}
+
+		LightParametersMap.Add(Change.Light, Change.AddedParameters);
+		LightVolumeLODs.Add(Change.Light, Change.AddedLevel);
+		if (Change.AddedLevel > 0)
+		{
+			CoarseLightPropagations++;
+		}
 	}
-}
 
-void ARaymarchVolume::ResetAllLights()
-{
-	if (!RaymarchResources.bIsInitialized)
+	// Put the coarse levels back even after a failure, so that the full resolution light volume keeps the lights it had.
+	if (!UpsampleTouchedLevels(1.0f))
 	{
-		return;
+		UE_LOG(LogRaymarchVolume, Error, TEXT("Could not upsample the coarse light volumes of %s."), *GetName());
+		return false;
 	}
+	return bSuccess;
+}
 
-	// Clear Light volume to zero.
-	UVolumeTextureToolkit::ClearVolumeTexture(RaymarchResources.LightVolumeRenderTarget, 0);
+int32 ARaymarchVolume::SelectLightVolumeLODForLight(const ARaymarchLight* Light) const
+{
+	FLightVolumeLODSettings Settings;
+	Settings.ContributionThreshold = LightVolumeLODContributionThreshold;
+	Settings.CameraDistanceThreshold = LightVolumeLODCameraDistance;
+
+	// Distance of the closest view rendered last frame, in multiples of the volume's diagonal.
+	float CameraDistance = 0.0f;
+	const FBox Bounds = GetComponentsBoundingBox(true);
+	const double Diagonal = Bounds.GetSize().Size();
+	if (LightVolumeLODPolicy == ELightVolumeLODPolicy::CameraDistance && GetWorld() && Diagonal > 0.0 &&
+		GetWorld()->ViewLocationsRenderedLastFrame.Num() > 0)
+	{
+		double ClosestDistance = UE_BIG_NUMBER;
+		for (const FVector& ViewLocation : GetWorld()->ViewLocationsRenderedLastFrame)
+		{
+			ClosestDistance = FMath::Min(ClosestDistance, FMath::Sqrt(Bounds.ComputeSquaredDistanceToPoint(ViewLocation)));
+		}
+		CameraDistance = static_cast<float>(ClosestDistance / Diagonal);
+	}
+	return SelectLightVolumeLOD(LightVolumeLODPolicy, Settings, GetRelativeLightContribution(Light), CameraDistance);
+}
 
-	// Add all lights.
-	bool bResetWasSuccessful = true;
-	for (ARaymarchLight* Light : LightsArray)
+float ARaymarchVolume::GetRelativeLightContribution(const ARaymarchLight* Light) const
+{
+	float MaxIntensity = 0.0f;
+	for (const ARaymarchLight* OtherLight : LightsArray)
 	{
-		if (!Light)
+		if (OtherLight)
 		{
-			continue;
+			MaxIntensity = FMath::Max(MaxIntensity, OtherLight->GetCurrentParameters().LightIntensity);
 		}
-		bool bLightAddWasSuccessful = false;
+	}
+	return MaxIntensity > 0.0f ? Light->GetCurrentParameters().LightIntensity / MaxIntensity : 1.0f;
+}
 
-		URaymarchUtils::AddDirLightToSingleVolume(
-			RaymarchResources, Light->GetCurrentParameters(), true, WorldParameters, bResetWasSuccessful, bFastShader);
+FBasicRaymarchRenderingResources ARaymarchVolume::GetLightVolumeLODResources(int32 Level) const
+{
+	FBasicRaymarchRenderingResources Resources = RaymarchResources;
+	if (Level == 0)
+	{
+		return Resources;
+	}
 
-		if (!bResetWasSuccessful)
+	const FBasicRaymarchRenderingResources& Coarse = CoarseLightVolumeResources[Level - 1];
+	Resources.LightVolumeRenderTarget = Coarse.LightVolumeRenderTarget;
+	Resources.LightVolumeUAVRef = nullptr;
+	Resources.PendingLightVolumeRenderTarget = nullptr;
+	Resources.PendingLightVolumeUAVRef = nullptr;
+	for (int32 i = 0; i < 3; i++)
+	{
+		Resources.XYZReadWriteBuffers[i] = Coarse.XYZReadWriteBuffers[i];
+		// Lights are never batched into the coarse levels.
+		Resources.XYZBatchReadWriteBuffers[i] = OneAxisReadWriteBufferResources();
+	}
+	Resources.RenderCacheId = Coarse.RenderCacheId;
+	return Resources;
+}
+
+bool ARaymarchVolume::EnsureCoarseLightVolume(int32 Level)
+{
+	FBasicRaymarchRenderingResources& Coarse = CoarseLightVolumeResources[Level - 1];
+	if (Coarse.bIsInitialized)
+	{
+		return true;
+	}
+	const UTextureRenderTargetVolume* LightVolume = RaymarchResources.LightVolumeRenderTarget;
+	if (!LightVolume)
+	{
+		return false;
+	}
+
+	// Same format as the full resolution light volume.
+	const FIntVector Dimensions = GetLightVolumeLODDimensions(GetLightVolumeDimensions(), Level);
+	Coarse.LightVolumeRenderTarget =
+		NewObject<UTextureRenderTargetVolume>(this, *FString::Printf(TEXT("Light Volume LOD %d Render Target"), Level));
+	Coarse.LightVolumeRenderTarget->bCanCreateUAV = true;
+	Coarse.LightVolumeRenderTarget->bHDR = LightVolume->bHDR;
+	Coarse.LightVolumeRenderTarget->Init(Dimensions.X, Dimensions.Y, Dimensions.Z, LightVolume->OverrideFormat);
+
+	// Flush rendering commands so that the texture is definitely initialized with resources.
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	(
+		[&](FRHICommandListImmediate& RHICmdList)
 		{
-			FString log = "Error. Could not add/remove light " + Light->GetName() + " in volume " + GetName() + " .";
-			UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log, 3);
-			return;
-		}
+			if (!Coarse.LightVolumeRenderTarget->GetResource() || !Coarse.LightVolumeRenderTarget->GetResource()->TextureRHI)
+			{
+				return;
+			}
+			const EPixelFormat PixelFormat = LightVolume->OverrideFormat;
+			URaymarchUtils::CreateBufferTextures(
+				FIntPoint(Dimensions.Y, Dimensions.Z), PixelFormat, Coarse.XYZReadWriteBuffers[0]);
+			URaymarchUtils::CreateBufferTextures(
+				FIntPoint(Dimensions.X, Dimensions.Z), PixelFormat, Coarse.XYZReadWriteBuffers[1]);
+			URaymarchUtils::CreateBufferTextures(
+				FIntPoint(Dimensions.X, Dimensions.Y), PixelFormat, Coarse.XYZReadWriteBuffers[2]);
+			Coarse.RenderCacheId = FLightingRenderCache::AllocateResourcesId();
+			Coarse.bIsInitialized = true;
+		});
+	FlushRenderingCommands();
+	if (Coarse.bIsInitialized)
+	{
+		UVolumeTextureToolkit::ClearVolumeTexture(Coarse.LightVolumeRenderTarget, 0);
 	}
+	return Coarse.bIsInitialized;
+}
 
-	// False-out request recompute flag when we succeeded in resetting lights.
-	bRequestedRecompute = false;
+void ARaymarchVolume::FreeCoarseLightVolumes()
+{
+	LightVolumeLODs.Reset();
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	(
+		[&](FRHICommandListImmediate& RHICmdList)
+		{
+			for (FBasicRaymarchRenderingResources& Coarse : CoarseLightVolumeResources)
+			{
+				FLightingRenderCache::Get().Invalidate(Coarse.RenderCacheId);
+				Coarse.RenderCacheId = 0;
+				if (Coarse.LightVolumeRenderTarget)
+				{
+					Coarse.LightVolumeRenderTarget->MarkAsGarbage();
+					Coarse.LightVolumeRenderTarget = nullptr;
+				}
+				for (OneAxisReadWriteBufferResources& Buffer : Coarse.XYZReadWriteBuffers)
+				{
+					URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(Buffer);
+				}
+				Coarse.bIsInitialized = false;
+			}
+		});
+	FlushRenderingCommands();
 }
 
 void ARaymarchVolume::UpdateSingleLight(ARaymarchLight* UpdatedLight)
 {
 	bool bLightAddWasSuccessful = false;
 
-	URaymarchUtils::ChangeDirLightInSingleVolume(RaymarchResources, LightParametersMap[UpdatedLight],
-		UpdatedLight->GetCurrentParameters(), WorldParameters, bLightAddWasSuccessful);
+	// The light's snapshots hold the old light.
+	if (FLightSnapshotState* SnapshotState = LightSnapshots.Find(UpdatedLight))
+	{
+		SnapshotState->Snapshots.Invalidate();
+	}
+
+	// The old light was propagated with the transform the light volume was last updated with, which can differ from the current
+	// one by a translation or uniform scale.
+	const FDirLightParameters PropagatedParameters = GetLightParametersForTransform(
+		LightParametersMap[UpdatedLight], LightVolumeWorldParameters.VolumeTransform, WorldParameters.VolumeTransform);
+	URaymarchUtils::ChangeDirLightInSingleVolume(RaymarchResources, PropagatedParameters, UpdatedLight->GetCurrentParameters(),
+		WorldParameters, bLightAddWasSuccessful);
+	RaymarchHistoryVersion++;
 
 	if (!bLightAddWasSuccessful)
 	{
 		FString log = "Error. Could not change light " + UpdatedLight->GetName() + " in volume " + GetName() + " .";
-		UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log, 3);
+		UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log);
 	}
 }
 
@@ -519,6 +1563,7 @@ bool ARaymarchVolume::SetVolumeAsset(UVolumeAsset* InVolumeAsset)
 		// Create default black-to-white texture if the VolumeAsset doesn't have one.
 		URaymarchUtils::MakeDefaultTFTexture(RaymarchResources.TFTextureRef);
 	}
+	CreatePreIntegratedTFTexture(InVolumeAsset->TransferFuncCurve);
 
 	VolumeAsset = InVolumeAsset;
 	OldVolumeAsset = InVolumeAsset;
@@ -532,10 +1577,7 @@ bool ARaymarchVolume::SetVolumeAsset(UVolumeAsset* InVolumeAsset)
 	}
 
 	// Set TF Texture in the lit material (after resource init, so FlushRenderingCommands has been called).
-	if (LitRaymarchMaterial)
-	{
-		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, RaymarchResources.TFTextureRef);
-	}
+	SetLitMaterialTransferFunction();
 
 	if (OctreeRaymarchMaterial)
 	{
@@ -566,13 +1608,17 @@ void ARaymarchVolume::SetTFCurve(UCurveLinearColor* InTFCurve)
 	{
 		CurrentTFCurve = InTFCurve;
 		URaymarchUtils::ColorCurveToTexture(CurrentTFCurve, RaymarchResources.TFTextureRef);
+		CreatePreIntegratedTFTexture(CurrentTFCurve);
+		RaymarchHistoryVersion++;
 		// #TODO flushing rendering commands can lead to hitches, maybe figure out a better way to make sure TF is created in time
 		// for the texture parameter to be set.
 		// e.g. render-thread promise and game-thread future?
 		FlushRenderingCommands();
 		// Set TF Texture to the lit and octree material.
-		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, RaymarchResources.TFTextureRef);
+		SetLitMaterialTransferFunction();
 		OctreeRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, RaymarchResources.TFTextureRef);
+		// The visible range depends on the TF.
+		SetMaterialWindowingParameters();
 		bRequestedRecompute = true;
 	}
 }
@@ -704,6 +1750,13 @@ void ARaymarchVolume::SetMaterialWindowingParameters()
 		OctreeRaymarchMaterial->SetVectorParameterValue(
 			RaymarchParams::WindowingParams, RaymarchResources.WindowingParameters.ToLinearColor());
 	}
+	// The octree material has no parameter for the visible range, it reads it from the primitive data.
+	const FVector2f VisibleRange = GetCurrentOctreeVisibleRange();
+	if (StaticMeshComponent)
+	{
+		StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::OctreeVisibleRange, VisibleRange.X);
+		StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::OctreeVisibleRange + 1, VisibleRange.Y);
+	}
 }
 
 void ARaymarchVolume::SetMaterialClippingParameters()
@@ -795,11 +1848,144 @@ void ARaymarchVolume::SwitchRenderer(ERaymarchMaterial InSelectRaymarchMaterial)
 			StaticMeshComponent->SetMaterial(0, IntensityRaymarchMaterial);
 			break;
 		case ERaymarchMaterial::Octree:
+			SetOctreeMaterialMode(EOctreeMaterialMode::OctreeMip);
+			StaticMeshComponent->SetMaterial(0, OctreeRaymarchMaterial);
+			break;
+		case ERaymarchMaterial::OctreeSkipping:
+			SetOctreeMaterialMode(
+				RaymarchStepping == ERaymarchStepping::Adaptive ? EOctreeMaterialMode::Adaptive : EOctreeMaterialMode::Skipping);
 			StaticMeshComponent->SetMaterial(0, OctreeRaymarchMaterial);
 			break;
+		case ERaymarchMaterial::Projection:
+			SetOctreeMaterialMode(EOctreeMaterialMode::Projection);
+			StaticMeshComponent->SetMaterial(0, OctreeRaymarchMaterial);
+			break;
+	}
+}
+
+bool ARaymarchVolume::UsesLightVolume() const
+{
+	return SelectRaymarchMaterial == ERaymarchMaterial::Lit;
+}
+
+bool ARaymarchVolume::UsesReducedResolution() const
+{
+	return (RaymarchResolution != ERaymarchResolution::Full || bTemporalAccumulation) &&
+		   (SelectRaymarchMaterial == ERaymarchMaterial::Lit || SelectRaymarchMaterial == ERaymarchMaterial::OctreeSkipping);
+}
+
+void ARaymarchVolume::UpdateReducedResolutionRaymarch()
+{
+	UWorld* World = GetWorld();
+	if (!UsesReducedResolution() || !World || !World->Scene || !RaymarchResources.DataVolumeTextureRef ||
+		!RaymarchResources.TFTextureRef)
+	{
+		StopReducedResolutionRaymarch();
+		return;
+	}
+
+	// Sent every tick, the light volume can get swapped for the pending one anytime.
+	FReducedResolutionRaymarchState State;
+	State.Scene = World->Scene;
+	State.VolumeTransform = WorldParameters.VolumeTransform;
+	State.LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+	State.WindowingParameters = RaymarchResources.WindowingParameters;
+	State.StepCount = RaymarchingSteps;
+	State.Resolution = RaymarchResolution;
+	State.UpsampleParameters.bRefineEdges = bRefineRaymarchEdges;
+	State.bTemporalAccumulation = bTemporalAccumulation;
+	State.TemporalParameters.StepFrames = TemporalStepFrames;
+	State.HistoryVersion = RaymarchHistoryVersion;
+	UTexture* LightVolume = UsesLightVolume() ? RaymarchResources.LightVolumeRenderTarget : nullptr;
+	FReducedResolutionRaymarchExtension::SetVolume(
+		this, State, RaymarchResources.DataVolumeTextureRef, RaymarchResources.TFTextureRef, LightVolume);
+
+	if (!bDrawnAtReducedResolution)
+	{
+		// Only the mesh drawing the volume gets hidden, the cube border stays.
+		StaticMeshComponent->SetVisibility(false);
+		bDrawnAtReducedResolution = true;
+	}
+}
+
+void ARaymarchVolume::StopReducedResolutionRaymarch()
+{
+	if (!bDrawnAtReducedResolution)
+	{
+		return;
+	}
+	FReducedResolutionRaymarchExtension::RemoveVolume(this);
+	if (StaticMeshComponent)
+	{
+		// Stays hidden if the whole volume got hidden meanwhile.
+		StaticMeshComponent->SetVisibility(RootComponent->IsVisible());
+	}
+	bDrawnAtReducedResolution = false;
+}
+
+bool ARaymarchVolume::UsesOctree() const
+{
+	return SelectRaymarchMaterial == ERaymarchMaterial::Octree || SelectRaymarchMaterial == ERaymarchMaterial::OctreeSkipping ||
+		   (SelectRaymarchMaterial == ERaymarchMaterial::Projection && RaymarchProjection != ERaymarchProjection::Average);
+}
+
+void ARaymarchVolume::SetMaterialAdaptiveStepParameters()
+{
+	if (!StaticMeshComponent)
+	{
+		return;
+	}
+	// The octree material's Steps stay RaymarchingSteps, adaptive stepping takes its step count from the primitive data.
+	const FAdaptiveStepParameters Parameters = GetAdaptiveStepParameters(RaymarchQuality);
+	StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::AdaptiveStepParams, Parameters.StepCount);
+	StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::AdaptiveStepParams + 1, Parameters.MaxStepScale);
+	StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::AdaptiveStepParams + 2, Parameters.Tolerance);
+}
+
+FVector2f ARaymarchVolume::GetCurrentOctreeVisibleRange() const
+{
+	return GetOctreeVisibleRange(URaymarchUtils::SampleColorCurve(CurrentTFCurve), RaymarchResources.WindowingParameters);
+}
+
+void ARaymarchVolume::SetOctreeMaterialMode(EOctreeMaterialMode Mode)
+{
+	if (StaticMeshComponent)
+	{
+		StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::OctreeMaterialMode, static_cast<float>(Mode));
+	}
+}
+
+void ARaymarchVolume::SetMaterialProjectionMode()
+{
+	if (StaticMeshComponent)
+	{
+		StaticMeshComponent->SetCustomPrimitiveDataFloat(
+			RaymarchPrimitiveData::ProjectionMode, static_cast<float>(RaymarchProjection));
+	}
+}
+
+void ARaymarchVolume::SetLitMaterialTransferFunction()
+{
+	if (!LitRaymarchMaterial)
+	{
+		return;
+	}
+	// The lit material has no parameter for the table, it takes it in place of the TF texture.
+	UTexture2D* TransferFunction =
+		bPreIntegratedTF ? RaymarchResources.PreIntegratedTFTextureRef : RaymarchResources.TFTextureRef;
+	LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, TransferFunction);
+	if (StaticMeshComponent)
+	{
+		StaticMeshComponent->SetCustomPrimitiveDataFloat(RaymarchPrimitiveData::PreIntegratedTF, bPreIntegratedTF ? 1.0f : 0.0f);
 	}
 }
 
+void ARaymarchVolume::CreatePreIntegratedTFTexture(UCurveLinearColor* Curve)
+{
+	URaymarchUtils::TransferFunctionToPreIntegratedTexture(
+		URaymarchUtils::SampleColorCurve(Curve), RaymarchResources.PreIntegratedTFTextureRef);
+}
+
 void ARaymarchVolume::SetRaymarchSteps(float InRaymarchingSteps)
 {
 	RaymarchingSteps = InRaymarchingSteps;
@@ -817,6 +2003,42 @@ void ARaymarchVolume::SetRaymarchSteps(float InRaymarchingSteps)
 	{
 		OctreeRaymarchMaterial->SetScalarParameterValue(RaymarchParams::Steps, RaymarchingSteps);
 	}
+
+}
+
+void ARaymarchVolume::SetRaymarchQuality(float InRaymarchQuality)
+{
+	RaymarchQuality = FMath::Clamp(InRaymarchQuality, 0.0f, 1.0f);
+	SetMaterialAdaptiveStepParameters();
+}
+
+void ARaymarchVolume::SetPreIntegratedTF(bool bInPreIntegratedTF)
+{
+	bPreIntegratedTF = bInPreIntegratedTF;
+	SetLitMaterialTransferFunction();
+}
+
+void ARaymarchVolume::SetRaymarchProjection(ERaymarchProjection InRaymarchProjection)
+{
+	RaymarchProjection = InRaymarchProjection;
+	SetMaterialProjectionMode();
+	// The average projection doesn't skip, switching away from it needs the octree.
+	if (UsesOctree())
+	{
+		bRequestedOctreeRebuild = true;
+	}
+}
+
+void ARaymarchVolume::SetRaymarchResolution(ERaymarchResolution InRaymarchResolution)
+{
+	// Picked up by the next tick.
+	RaymarchResolution = InRaymarchResolution;
+}
+
+void ARaymarchVolume::SetTemporalAccumulation(bool bInTemporalAccumulation)
+{
+	// Picked up by the next tick.
+	bTemporalAccumulation = bInTemporalAccumulation;
 }
 
 void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
@@ -855,11 +2077,7 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 		Z = FMath::DivideAndRoundUp(Z, 2);
 	}
 
-	EPixelFormat PixelFormat = PF_G8;
-	if (bLightVolume32Bit)
-	{
-		PixelFormat = PF_R32_FLOAT;
-	}
+	const EPixelFormat PixelFormat = GetLightVolumePixelFormat(LightVolumeFormat);
 
 	// Call the actual rendering code on RenderThread.
 	FIntPoint XBufferSize = FIntPoint(Y, Z);
@@ -868,14 +2086,15 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 
 	RaymarchResources.LightVolumeRenderTarget = NewObject<UTextureRenderTargetVolume>(this, "Light Volume Render Target");
 	RaymarchResources.LightVolumeRenderTarget->bCanCreateUAV = true;
-	RaymarchResources.LightVolumeRenderTarget->bHDR = bLightVolume32Bit;
+	RaymarchResources.LightVolumeRenderTarget->bHDR = LightVolumeFormat != ELightVolumeFormat::G8;
 	RaymarchResources.LightVolumeRenderTarget->Init(X, Y, Z, PixelFormat);
 
 	RaymarchResources.OctreeVolumeRenderTarget = NewObject<URenderTargetVolumeMipped>(this, "Octree Render Target");
 	RaymarchResources.OctreeVolumeRenderTarget->bCanCreateUAV = true;
 	RaymarchResources.OctreeVolumeRenderTarget->bHDR = false;
-	RaymarchResources.OctreeVolumeRenderTarget->Init(FMath::RoundUpToPowerOfTwo(Volume->GetSizeX()),
-		FMath::RoundUpToPowerOfTwo(Volume->GetSizeY()), FMath::RoundUpToPowerOfTwo(Volume->GetSizeZ()), 4, PF_G16);
+	const FIntVector OctreeSize = GetOctreeDimensions(FIntVector(Volume->GetSizeX(), Volume->GetSizeY(), Volume->GetSizeZ()));
+	RaymarchResources.OctreeVolumeRenderTarget->Init(
+		OctreeSize.X, OctreeSize.Y, OctreeSize.Z, GetOctreeMipCount(OctreeSize), OCTREE_PIXEL_FORMAT);
 
 	// Flush rendering commands so that all textures are definitely initialized with resources and we can create a UAV ref.
 	FlushRenderingCommands();
@@ -885,12 +2104,19 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 		[&](FRHICommandListImmediate& RHICmdList)
 		{
 			RaymarchResources.DataVolumeTextureRef = Volume;
+			RaymarchResources.RenderCacheId = FLightingRenderCache::AllocateResourcesId();
 
 			// Make buffers fully colored if we need to support colored lights.
 			URaymarchUtils::CreateBufferTextures(XBufferSize, PixelFormat, RaymarchResources.XYZReadWriteBuffers[0]);
 			URaymarchUtils::CreateBufferTextures(YBufferSize, PixelFormat, RaymarchResources.XYZReadWriteBuffers[1]);
 			URaymarchUtils::CreateBufferTextures(ZBufferSize, PixelFormat, RaymarchResources.XYZReadWriteBuffers[2]);
 
+			// RGBA buffers for propagating 4 lights at once, with the same precision as the single light buffers.
+			const EPixelFormat BatchPixelFormat = GetBatchedLightBufferPixelFormat(LightVolumeFormat);
+			URaymarchUtils::CreateBufferTextures(XBufferSize, BatchPixelFormat, RaymarchResources.XYZBatchReadWriteBuffers[0], 2);
+			URaymarchUtils::CreateBufferTextures(YBufferSize, BatchPixelFormat, RaymarchResources.XYZBatchReadWriteBuffers[1], 2);
+			URaymarchUtils::CreateBufferTextures(ZBufferSize, BatchPixelFormat, RaymarchResources.XYZBatchReadWriteBuffers[2], 2);
+
 			if (!RaymarchResources.LightVolumeRenderTarget || !RaymarchResources.LightVolumeRenderTarget->GetResource() ||
 				!RaymarchResources.LightVolumeRenderTarget->GetResource()->TextureRHI)
 			{
@@ -900,6 +2126,7 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 
 			RaymarchResources.LightVolumeUAVRef =
 				RHICreateUnorderedAccessView(RaymarchResources.LightVolumeRenderTarget->GetResource()->TextureRHI);
+			INC_DWORD_STAT(STAT_RaymarcherLightingRHICreations);
 
 			if (!RaymarchResources.OctreeVolumeRenderTarget || !RaymarchResources.OctreeVolumeRenderTarget->GetResource() ||
 				!RaymarchResources.OctreeVolumeRenderTarget->GetResource()->TextureRHI)
@@ -922,27 +2149,52 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 
 void ARaymarchVolume::FreeRaymarchResources()
 {
+	CancelTimeSlicedLightPropagation();
+	CancelAsyncCompute();
+	FreeCoarseLightVolumes();
+	StopReducedResolutionRaymarch();
+
 	ENQUEUE_RENDER_COMMAND(CaptureCommand)
 	(
 		[&](FRHICommandListImmediate& RHICmdList)
 		{
 			RaymarchResources.DataVolumeTextureRef = nullptr;
+			FLightingRenderCache::Get().Invalidate(RaymarchResources.RenderCacheId);
+			RaymarchResources.RenderCacheId = 0;
 			if (RaymarchResources.LightVolumeRenderTarget)
 			{
 				RaymarchResources.LightVolumeRenderTarget->MarkAsGarbage();
 				RaymarchResources.LightVolumeRenderTarget = nullptr;
 			}
 
+			if (RaymarchResources.PendingLightVolumeRenderTarget)
+			{
+				RaymarchResources.PendingLightVolumeRenderTarget->MarkAsGarbage();
+				RaymarchResources.PendingLightVolumeRenderTarget = nullptr;
+			}
+			RaymarchResources.PendingLightVolumeUAVRef.SafeRelease();
+
 			if (RaymarchResources.OctreeVolumeRenderTarget)
 			{
 				RaymarchResources.OctreeVolumeRenderTarget->MarkAsGarbage();
 				RaymarchResources.OctreeVolumeRenderTarget = nullptr;
 			}
 
+			if (RaymarchResources.PendingOctreeVolumeRenderTarget)
+			{
+				RaymarchResources.PendingOctreeVolumeRenderTarget->MarkAsGarbage();
+				RaymarchResources.PendingOctreeVolumeRenderTarget = nullptr;
+			}
+			RaymarchResources.PendingOctreeUAVRef.SafeRelease();
+
 			for (OneAxisReadWriteBufferResources& Buffer : RaymarchResources.XYZReadWriteBuffers)
 			{
 				URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(Buffer);
 			}
+			for (OneAxisReadWriteBufferResources& Buffer : RaymarchResources.XYZBatchReadWriteBuffers)
+			{
+				URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(Buffer);
+			}
 
 			RaymarchResources.bIsInitialized = false;
 		});
@@ -5,6 +5,9 @@
 
 #include "Raymarcher.h"
 
+#include "Rendering/RaymarchAsyncCompute.h"
+#include "Rendering/ReducedResolutionRaymarch.h"
+
 #define LOCTEXT_NAMESPACE "FRaymarcherModule"
 
 void FRaymarcherModule::StartupModule()
@@ -22,6 +25,8 @@ void FRaymarcherModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FRaymarchSceneViewExtension::Shutdown();
+	FReducedResolutionRaymarchExtension::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
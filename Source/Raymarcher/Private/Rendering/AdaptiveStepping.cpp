@@ -0,0 +1,256 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/AdaptiveStepping.h"
+
+// Same as in RaymarcherCommon.usf.
+#define VOLUME_DENSITY 100.0f
+
+namespace
+{
+// Same as ADAPTIVE_STEP_OCTREE_LEVEL in WindowedRaymarchMaterials.usf.
+constexpr int32 AdaptiveStepOctreeLevel = 3;
+
+// Equivalent of AccumulateLightEnergy() in RaymarcherCommon.usf.
+void AccumulateLightEnergy(FLinearColor& LightEnergy, const FLinearColor& Sample)
+{
+	const float Weight = Sample.A * (1.0f - LightEnergy.A);
+	LightEnergy.R += Sample.R * Weight;
+	LightEnergy.G += Sample.G * Weight;
+	LightEnergy.B += Sample.B * Weight;
+	LightEnergy.A += Weight;
+}
+
+// Early termination of the raymarch materials - returns true once further samples would barely change the color.
+bool IsSaturated(FLinearColor& LightEnergy)
+{
+	if (LightEnergy.A > 0.95f)
+	{
+		LightEnergy.A = 1.0f;
+		return true;
+	}
+	return false;
+}
+}	 // namespace
+
+FAdaptiveStepParameters GetAdaptiveStepParameters(float Quality)
+{
+	const float Alpha = FMath::Clamp(Quality, 0.0f, 1.0f);
+	FAdaptiveStepParameters Parameters;
+	Parameters.StepCount = FMath::Lerp(100.0f, 300.0f, Alpha);
+	Parameters.MaxStepScale = FMath::Lerp(8.0f, 2.0f, Alpha);
+	Parameters.Tolerance = FMath::Lerp(0.2f, 0.02f, Alpha);
+	return Parameters;
+}
+
+float GetAdaptiveStepScale(const FVector3f& NodeAlphas, float SampleAlpha, const FAdaptiveStepParameters& Parameters)
+{
+	const float Variation = FMath::Max(NodeAlphas.GetMax() - NodeAlphas.GetMin(), SampleAlpha);
+	return FMath::Clamp(Parameters.Tolerance / FMath::Max(Variation, 1e-4f), 1.0f, FMath::Max(Parameters.MaxStepScale, 1.0f));
+}
+
+double FRaymarchCPUStats::GetSamplesPerRay() const
+{
+	return Rays > 0 ? static_cast<double>(Samples) / Rays : 0.0;
+}
+
+FLinearColor RaymarchFixedStep_CPU(const FRaymarchCPUResources& Resources, const FVector3f& Entry, const FVector3f& Direction,
+	float Thickness, float StepCount, FRaymarchCPUStats& Stats)
+{
+	const float FloatActualSteps = StepCount * Thickness;
+	const int32 MaxSteps = FMath::FloorToInt32(FloatActualSteps);
+	const float FinalStep = FMath::Frac(FloatActualSteps);
+	const FVector3f StepVector = Direction / StepCount;
+	const float StepSizeWorld = VOLUME_DENSITY / StepCount;
+	Stats.Rays++;
+
+	FLinearColor LightEnergy = FLinearColor::Transparent;
+	for (int32 Step = 1; Step <= MaxSteps; Step++)
+	{
+		AccumulateLightEnergy(
+			LightEnergy, SampleWindowedVolumeStep_CPU(Resources, FVector(Entry + StepVector * Step), StepSizeWorld));
+		Stats.Samples++;
+		if (IsSaturated(LightEnergy))
+		{
+			return LightEnergy;
+		}
+	}
+
+	if (FinalStep > 0.0f)
+	{
+		AccumulateLightEnergy(LightEnergy,
+			SampleWindowedVolumeStep_CPU(Resources, FVector(Entry + StepVector * FloatActualSteps), StepSizeWorld * FinalStep));
+		Stats.Samples++;
+	}
+	return LightEnergy;
+}
+
+FLinearColor RaymarchAdaptiveStep_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips,
+	const FVector2f& VisibleRange, const FVector3f& Entry, const FVector3f& Direction, float Thickness,
+	const FAdaptiveStepParameters& Parameters, FRaymarchCPUStats& Stats)
+{
+	if (Mips.IsEmpty())
+	{
+		return RaymarchFixedStep_CPU(Resources, Entry, Direction, Thickness, Parameters.StepCount, Stats);
+	}
+
+	const float FloatActualSteps = Parameters.StepCount * Thickness;
+	const FVector3f StepVector = Direction / Parameters.StepCount;
+	const float StepSizeWorld = VOLUME_DENSITY / Parameters.StepCount;
+	Stats.Rays++;
+
+	const FVector3f VoxelSize(Resources.DataDimensions);
+	const FVector3f VoxelEntry = Entry * VoxelSize;
+	const FVector3f VoxelStep = StepVector * VoxelSize;
+	const int32 Level = FMath::Min(AdaptiveStepOctreeLevel, Mips.Num() - 1);
+	const FOctreeMipCPU& Mip = Mips[Level];
+	const FIntVector& OctreeSize = Mips[0].Dimensions;
+
+	FLinearColor LightEnergy = FLinearColor::Transparent;
+	// Position along the ray in shortest steps. Every iteration advances it by at least one step.
+	float Step = 1.0f;
+	while (Step <= FloatActualSteps)
+	{
+		const FVector3f VoxelPos = VoxelEntry + VoxelStep * Step;
+		const FIntVector Node(FMath::Clamp(FMath::FloorToInt32(VoxelPos.X), 0, OctreeSize.X - 1) >> Level,
+			FMath::Clamp(FMath::FloorToInt32(VoxelPos.Y), 0, OctreeSize.Y - 1) >> Level,
+			FMath::Clamp(FMath::FloorToInt32(VoxelPos.Z), 0, OctreeSize.Z - 1) >> Level);
+		const int64 NodeIndex = Mip.GetIndex(Node.X, Node.Y, Node.Z);
+		Stats.NodeVisits++;
+
+		// Equivalent of GetOctreeNodeSampleBounds and GetOctreeNodeExitStep.
+		const FVector3f NodeMin = FVector3f(Node.X << Level, Node.Y << Level, Node.Z << Level) + 0.5f;
+		const FVector3f NodeMax = FVector3f((Node.X + 1) << Level, (Node.Y + 1) << Level, (Node.Z + 1) << Level) - 0.5f;
+		const bool bInsideNode = VoxelPos.X >= NodeMin.X && VoxelPos.Y >= NodeMin.Y && VoxelPos.Z >= NodeMin.Z &&
+								 VoxelPos.X <= NodeMax.X && VoxelPos.Y <= NodeMax.Y && VoxelPos.Z <= NodeMax.Z;
+		float ExitStep = 1e20f;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			if (FMath::Abs(VoxelStep[Axis]) > 1e-6f)
+			{
+				const float ExitPlane = VoxelStep[Axis] > 0.0f ? NodeMax[Axis] : NodeMin[Axis];
+				ExitStep = FMath::Min(ExitStep, (ExitPlane - VoxelEntry[Axis]) / VoxelStep[Axis]);
+			}
+		}
+
+		const float NodeMaxValue = Mip.Max[NodeIndex];
+		const float NodeMinValue = Mip.Min[NodeIndex];
+		if (bInsideNode && (NodeMaxValue < VisibleRange.X || NodeMinValue > VisibleRange.Y))
+		{
+			// Nothing in the node can be visible - continue with the first step past it.
+			Step = FMath::Max(Step + 1.0f, FMath::FloorToFloat(ExitStep) + 1.0f);
+			continue;
+		}
+
+		FLinearColor Sample = SampleWindowedVolumeStep_CPU(Resources, FVector(Entry + StepVector * Step), 1.0f);
+		Stats.Samples++;
+		float Scale = 1.0f;
+		if (bInsideNode)
+		{
+			const FVector3f NodeAlphas(SampleWindowedTransferFunction_CPU(Resources, NodeMinValue, 1.0f).A,
+				SampleWindowedTransferFunction_CPU(Resources, (NodeMinValue + NodeMaxValue) / 2.0f, 1.0f).A,
+				SampleWindowedTransferFunction_CPU(Resources, NodeMaxValue, 1.0f).A);
+			Scale = GetAdaptiveStepScale(NodeAlphas, Sample.A, Parameters);
+			// Stay in the node the opacity variation is known for.
+			Scale = FMath::Min(Scale, FMath::Max(FMath::FloorToFloat(ExitStep) + 1.0f - Step, 1.0f));
+		}
+		// Don't step past the end of the ray.
+		Scale = FMath::Min(Scale, FloatActualSteps + 1.0f - Step);
+
+		Sample.A = 1.0f - FMath::Pow(1.0f - Sample.A, StepSizeWorld * Scale);
+		AccumulateLightEnergy(LightEnergy, Sample);
+		if (IsSaturated(LightEnergy))
+		{
+			return LightEnergy;
+		}
+		Step += Scale;
+	}
+
+	// The part of the ray after the last full step, like the final step of a fixed step raymarch.
+	const float FinalStep = FloatActualSteps + 1.0f - Step;
+	if (FinalStep > 0.0f)
+	{
+		AccumulateLightEnergy(LightEnergy,
+			SampleWindowedVolumeStep_CPU(Resources, FVector(Entry + StepVector * FloatActualSteps), StepSizeWorld * FinalStep));
+		Stats.Samples++;
+	}
+	return LightEnergy;
+}
+
+double FAdaptiveStepComparisonCPU::GetSampleFraction() const
+{
+	return Fixed.Samples > 0 ? static_cast<double>(Adaptive.Samples) / Fixed.Samples : 1.0;
+}
+
+FString FAdaptiveStepComparisonCPU::ToString() const
+{
+	return FString::Printf(TEXT("%lld rays, %.1f adaptive vs %.1f fixed samples per ray (%.1f %%), mean error %.4f, max error %.4f"),
+		Fixed.Rays, Adaptive.GetSamplesPerRay(), Fixed.GetSamplesPerRay(), GetSampleFraction() * 100.0, MeanError, MaxError);
+}
+
+FAdaptiveStepComparisonCPU CompareAdaptiveStepRaymarch_CPU(const FRaymarchCPUResources& Resources,
+	const TArray<FOctreeMipCPU>& Mips, const FVector2f& VisibleRange, const FVector3f& ViewDirection, int32 Resolution,
+	float FixedStepCount, const FAdaptiveStepParameters& Parameters)
+{
+	FAdaptiveStepComparisonCPU Comparison;
+	const FVector3f Direction = ViewDirection.GetSafeNormal();
+	FVector3f AxisU, AxisV;
+	Direction.FindBestAxisVectors(AxisU, AxisV);
+
+	// The image covers the unit cube seen from any direction.
+	const float Extent = FMath::Sqrt(3.0f);
+	const FVector3f Center(0.5f);
+	double ErrorSum = 0.0;
+	int64 Pixels = 0;
+	for (int32 Y = 0; Y < Resolution; Y++)
+	{
+		for (int32 X = 0; X < Resolution; X++)
+		{
+			const FVector3f Origin = Center + AxisU * (((X + 0.5f) / Resolution - 0.5f) * Extent) +
+									 AxisV * (((Y + 0.5f) / Resolution - 0.5f) * Extent) - Direction * Extent;
+
+			// Where the ray enters and leaves the unit cube.
+			float Enter = 0.0f;
+			float Exit = UE_BIG_NUMBER;
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				if (FMath::Abs(Direction[Axis]) < 1e-6f)
+				{
+					Exit = (Origin[Axis] < 0.0f || Origin[Axis] > 1.0f) ? -1.0f : Exit;
+					continue;
+				}
+				float Near = -Origin[Axis] / Direction[Axis];
+				float Far = (1.0f - Origin[Axis]) / Direction[Axis];
+				if (Near > Far)
+				{
+					Swap(Near, Far);
+				}
+				Enter = FMath::Max(Enter, Near);
+				Exit = FMath::Min(Exit, Far);
+			}
+			if (Exit <= Enter)
+			{
+				continue;
+			}
+
+			const FVector3f Entry = Origin + Direction * Enter;
+			const float Thickness = Exit - Enter;
+			const FLinearColor Fixed =
+				RaymarchFixedStep_CPU(Resources, Entry, Direction, Thickness, FixedStepCount, Comparison.Fixed);
+			const FLinearColor Adaptive = RaymarchAdaptiveStep_CPU(
+				Resources, Mips, VisibleRange, Entry, Direction, Thickness, Parameters, Comparison.Adaptive);
+
+			const float Error = FMath::Max(FMath::Max(FMath::Abs(Fixed.R - Adaptive.R), FMath::Abs(Fixed.G - Adaptive.G)),
+				FMath::Max(FMath::Abs(Fixed.B - Adaptive.B), FMath::Abs(Fixed.A - Adaptive.A)));
+			ErrorSum += Error;
+			Comparison.MaxError = FMath::Max(Comparison.MaxError, static_cast<double>(Error));
+			Pixels++;
+		}
+	}
+	Comparison.MeanError = Pixels > 0 ? ErrorSum / Pixels : 0.0;
+	return Comparison;
+}
+
+#undef VOLUME_DENSITY
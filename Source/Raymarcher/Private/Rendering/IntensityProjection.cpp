@@ -0,0 +1,214 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/IntensityProjection.h"
+
+#include "Async/ParallelFor.h"
+
+namespace
+{
+// Same constants as in OctreeCommon.usf.
+constexpr int32 LeafLevelLimit = 1;
+constexpr int32 TopLevelLimit = 6;
+
+// Equivalent of CanOctreeNodeChangeProjection() in WindowedRaymarchMaterials.usf.
+bool CanOctreeNodeChangeProjection(float NodeMax, float NodeMin, ERaymarchProjection Projection, float Value)
+{
+	switch (Projection)
+	{
+		case ERaymarchProjection::Maximum:
+			return NodeMax > Value;
+		case ERaymarchProjection::Minimum:
+			return NodeMin < Value;
+		default:
+			return true;
+	}
+}
+}	 // namespace
+
+double FProjectionCPUStats::GetSampleFraction() const
+{
+	return FullSamples > 0 ? static_cast<double>(Samples) / FullSamples : 1.0;
+}
+
+FString FProjectionCPUStats::ToString() const
+{
+	return FString::Printf(TEXT("%lld rays, %.1f %% of %lld samples taken, %lld node visits in %.2f ms"), Rays,
+		GetSampleFraction() * 100.0, FullSamples, NodeVisits, Seconds * 1000.0);
+}
+
+bool ProjectRay_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips, ERaymarchProjection Projection,
+	const FVector3f& Entry, const FVector3f& Direction, float Thickness, float StepCount, float& OutValue,
+	FProjectionCPUStats& Stats)
+{
+	const float FloatActualSteps = StepCount * Thickness;
+	const int32 MaxSteps = FMath::FloorToInt32(FloatActualSteps);
+	const float FinalStep = FMath::Frac(FloatActualSteps);
+	const FVector3f StepVector = Direction / StepCount;
+	Stats.Rays++;
+	Stats.FullSamples += MaxSteps + (FinalStep > 0.0f ? 1 : 0);
+
+	// Data values at which the projection shows as black and white.
+	const float WindowLow = Resources.WindowingParameters.Center - Resources.WindowingParameters.Width / 2.0f;
+	const float WindowHigh = WindowLow + Resources.WindowingParameters.Width;
+
+	// Maximum or minimum so far, and the step length weighted sum of the values for the average.
+	float Value = Projection == ERaymarchProjection::Minimum ? 1e20f : -1e20f;
+	double ValueSum = 0.0;
+	double WeightSum = 0.0;
+	// Adds the sample at Step to the projection, returns true once further samples can't change what's displayed.
+	auto AddSample = [&](float Step, float Weight)
+	{
+		const float DataValue = SampleDataVolume_CPU(Resources, FVector(Entry + StepVector * Step));
+		Stats.Samples++;
+		Value = Projection == ERaymarchProjection::Minimum ? FMath::Min(Value, DataValue) : FMath::Max(Value, DataValue);
+		ValueSum += DataValue * Weight;
+		WeightSum += Weight;
+		return (Projection == ERaymarchProjection::Maximum && Value >= WindowHigh) ||
+			   (Projection == ERaymarchProjection::Minimum && Value <= WindowLow);
+	};
+
+	const bool bSkipping = Projection != ERaymarchProjection::Average && !Mips.IsEmpty();
+	const FVector3f VoxelSize(Resources.DataDimensions);
+	const FVector3f VoxelEntry = Entry * VoxelSize;
+	const FVector3f VoxelStep = StepVector * VoxelSize;
+	const int32 LeafLevel = bSkipping ? FMath::Min(LeafLevelLimit, Mips.Num() - 1) : 0;
+	const int32 TopLevel = bSkipping ? FMath::Min(TopLevelLimit, Mips.Num() - 1) : 0;
+
+	const int32 MaxIterations = (MaxSteps + 1) * (TopLevel - LeafLevel + 1) + TopLevel;
+	int32 Level = TopLevel;
+	int32 Step = 1;
+	bool bSaturated = false;
+	for (int32 Iteration = 0; Iteration < MaxIterations && Step <= MaxSteps; Iteration++)
+	{
+		if (bSkipping)
+		{
+			const FVector3f VoxelPos = VoxelEntry + VoxelStep * Step;
+			const FIntVector& OctreeSize = Mips[0].Dimensions;
+			const FIntVector Node(FMath::Clamp(FMath::FloorToInt32(VoxelPos.X), 0, OctreeSize.X - 1) >> Level,
+				FMath::Clamp(FMath::FloorToInt32(VoxelPos.Y), 0, OctreeSize.Y - 1) >> Level,
+				FMath::Clamp(FMath::FloorToInt32(VoxelPos.Z), 0, OctreeSize.Z - 1) >> Level);
+			const FOctreeMipCPU& Mip = Mips[Level];
+			const int64 NodeIndex = Mip.GetIndex(Node.X, Node.Y, Node.Z);
+			Stats.NodeVisits++;
+
+			// Equivalent of GetOctreeNodeSampleBounds and GetOctreeNodeExitStep.
+			if (!CanOctreeNodeChangeProjection(Mip.Max[NodeIndex], Mip.Min[NodeIndex], Projection, Value))
+			{
+				const FVector3f NodeMin = FVector3f(Node.X << Level, Node.Y << Level, Node.Z << Level) + 0.5f;
+				const FVector3f NodeMax = FVector3f((Node.X + 1) << Level, (Node.Y + 1) << Level, (Node.Z + 1) << Level) - 0.5f;
+				if (VoxelPos.X >= NodeMin.X && VoxelPos.Y >= NodeMin.Y && VoxelPos.Z >= NodeMin.Z && VoxelPos.X <= NodeMax.X &&
+					VoxelPos.Y <= NodeMax.Y && VoxelPos.Z <= NodeMax.Z)
+				{
+					float ExitStep = 1e20f;
+					for (int32 Axis = 0; Axis < 3; Axis++)
+					{
+						if (FMath::Abs(VoxelStep[Axis]) > 1e-6f)
+						{
+							const float ExitPlane = VoxelStep[Axis] > 0.0f ? NodeMax[Axis] : NodeMin[Axis];
+							ExitStep = FMath::Min(ExitStep, (ExitPlane - VoxelEntry[Axis]) / VoxelStep[Axis]);
+						}
+					}
+					Step = FMath::Max(Step + 1, FMath::FloorToInt32(FMath::Min(ExitStep, static_cast<float>(MaxSteps))) + 1);
+					Level = FMath::Min(Level + 1, TopLevel);
+					continue;
+				}
+			}
+			if (Level > LeafLevel)
+			{
+				Level--;
+				continue;
+			}
+		}
+
+		bSaturated = AddSample(Step, 1.0f);
+		Step++;
+		if (bSaturated)
+		{
+			break;
+		}
+	}
+
+	if (!bSaturated && FinalStep > 0.0f)
+	{
+		AddSample(FloatActualSteps, FinalStep);
+	}
+
+	if (WeightSum <= 0.0)
+	{
+		return false;
+	}
+	OutValue = Projection == ERaymarchProjection::Average ? static_cast<float>(ValueSum / WeightSum) : Value;
+	return true;
+}
+
+void RenderProjection_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips,
+	ERaymarchProjection Projection, const FVector3f& ViewDirection, int32 Resolution, float StepCount, TArray<float>& OutImage,
+	FProjectionCPUStats& Stats)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const FVector3f Direction = ViewDirection.GetSafeNormal();
+	FVector3f AxisU, AxisV;
+	Direction.FindBestAxisVectors(AxisU, AxisV);
+
+	// The image covers the unit cube seen from any direction.
+	const float Extent = FMath::Sqrt(3.0f);
+	const FVector3f Center(0.5f);
+	OutImage.SetNumZeroed(Resolution * Resolution);
+	TArray<FProjectionCPUStats> RowStats;
+	RowStats.SetNum(Resolution);
+	ParallelFor(Resolution,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Resolution; X++)
+			{
+				const FVector3f Origin = Center + AxisU * (((X + 0.5f) / Resolution - 0.5f) * Extent) +
+										 AxisV * (((Y + 0.5f) / Resolution - 0.5f) * Extent) - Direction * Extent;
+
+				// Where the ray enters and leaves the unit cube.
+				float Enter = 0.0f;
+				float Exit = UE_BIG_NUMBER;
+				for (int32 Axis = 0; Axis < 3; Axis++)
+				{
+					if (FMath::Abs(Direction[Axis]) < 1e-6f)
+					{
+						Exit = (Origin[Axis] < 0.0f || Origin[Axis] > 1.0f) ? -1.0f : Exit;
+						continue;
+					}
+					float Near = -Origin[Axis] / Direction[Axis];
+					float Far = (1.0f - Origin[Axis]) / Direction[Axis];
+					if (Near > Far)
+					{
+						Swap(Near, Far);
+					}
+					Enter = FMath::Max(Enter, Near);
+					Exit = FMath::Min(Exit, Far);
+				}
+				if (Exit <= Enter)
+				{
+					continue;
+				}
+
+				const FVector3f Entry = Origin + Direction * Enter;
+				float Value;
+				if (ProjectRay_CPU(Resources, Mips, Projection, Entry, Direction, Exit - Enter, StepCount, Value, RowStats[Y]))
+				{
+					// Equivalent of GetTransferFuncPosition() in WindowedSampling.usf.
+					const FWindowingParameters& Window = Resources.WindowingParameters;
+					OutImage[X + Y * Resolution] =
+						FMath::Clamp((Value - Window.Center + Window.Width / 2.0f) / Window.Width, 0.0f, 1.0f);
+				}
+			}
+		});
+
+	for (const FProjectionCPUStats& Row : RowStats)
+	{
+		Stats.Rays += Row.Rays;
+		Stats.Samples += Row.Samples;
+		Stats.FullSamples += Row.FullSamples;
+		Stats.NodeVisits += Row.NodeVisits;
+	}
+	Stats.Seconds += FPlatformTime::Seconds() - StartTime;
+}
@@ -0,0 +1,286 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/LightPropagationScheduler.h"
+
+#include "DynamicRHI.h"
+#include "RHI.h"
+#include "Rendering/LightingShaders.h"
+#include "RenderingThread.h"
+
+void FLightPropagationGPUTimer::Begin(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+	if (!GSupportsTimestampRenderQueries)
+	{
+		return;
+	}
+	CurrentBegin = RHICreateRenderQuery(RQT_AbsoluteTime);
+	RHICmdList.EndRenderQuery(CurrentBegin);
+}
+
+void FLightPropagationGPUTimer::End(FRHICommandListImmediate& RHICmdList, int64 Voxels)
+{
+	check(IsInRenderingThread());
+	if (!CurrentBegin)
+	{
+		return;
+	}
+	FPendingQuery& Query = PendingQueries.AddDefaulted_GetRef();
+	Query.Begin = MoveTemp(CurrentBegin);
+	Query.End = RHICreateRenderQuery(RQT_AbsoluteTime);
+	Query.Voxels = Voxels;
+	RHICmdList.EndRenderQuery(Query.End);
+}
+
+void FLightPropagationGPUTimer::Poll()
+{
+	check(IsInRenderingThread());
+	// Queries finish in order, so stop at the first one the GPU isn't done with.
+	int32 FinishedQueries = 0;
+	for (; FinishedQueries < PendingQueries.Num(); FinishedQueries++)
+	{
+		const FPendingQuery& Query = PendingQueries[FinishedQueries];
+		uint64 BeginMicroseconds = 0;
+		uint64 EndMicroseconds = 0;
+		if (!RHIGetRenderQueryResult(Query.Begin, BeginMicroseconds, false) ||
+			!RHIGetRenderQueryResult(Query.End, EndMicroseconds, false))
+		{
+			break;
+		}
+		if (EndMicroseconds > BeginMicroseconds)
+		{
+			Measurements.Enqueue(MakeTuple(Query.Voxels, (EndMicroseconds - BeginMicroseconds) / 1000.0));
+		}
+	}
+	PendingQueries.RemoveAt(0, FinishedQueries);
+}
+
+FLightPropagationScheduler::FLightPropagationScheduler() : GPUTimer(MakeShared<FLightPropagationGPUTimer, ESPMode::ThreadSafe>())
+{
+}
+
+void FLightPropagationScheduler::Start(TArrayView<const FDirLightParameters> InLights,
+	const FRaymarchWorldParameters& InWorldParameters, const FIntVector& LightVolumeDimensions, bool bBatched)
+{
+	Lights = TArray<FDirLightParameters>(InLights);
+	WorldParameters = InWorldParameters;
+	Propagations.Reset();
+
+	TArray<TArray<int32>> Batches;
+	if (bBatched)
+	{
+		Batches = GroupLightsIntoBatches(Lights, WorldParameters.VolumeTransform);
+	}
+	else
+	{
+		for (int32 LightIndex = 0; LightIndex < Lights.Num(); LightIndex++)
+		{
+			if (!Lights[LightIndex].LightDirection.IsZero())
+			{
+				Batches.Add({LightIndex});
+			}
+		}
+	}
+
+	for (const TArray<int32>& Batch : Batches)
+	{
+		FScheduledLightPropagation& Propagation = Propagations.AddDefaulted_GetRef();
+		TArray<FMajorAxes, TInlineAllocator<MaxBatchedLights>> LocalMajorAxes;
+		for (const int32 LightIndex : Batch)
+		{
+			FDirLightParameters LocalLightParams;
+			GetLocalLightParamsAndAxes(
+				Lights[LightIndex], WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes.AddDefaulted_GetRef());
+			Propagation.Lights.Add(Lights[LightIndex]);
+		}
+
+		// Same axes as the propagation itself goes along - all lights of a batch share the faces of the first one.
+		for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+		{
+			bool bAnyLightHasWeight = false;
+			for (const FMajorAxes& Axes : LocalMajorAxes)
+			{
+				bAnyLightHasWeight |= Axes.FaceWeight[AxisIndex].second != 0;
+			}
+			if (!bAnyLightHasWeight)
+			{
+				break;
+			}
+			const FIntVector TransposedDimensions = GetTransposedDimensions(LocalMajorAxes[0], LightVolumeDimensions, AxisIndex);
+			Propagation.AxisSteps[AxisIndex] = TransposedDimensions.Z;
+			Propagation.SliceVoxels[AxisIndex] = static_cast<int64>(TransposedDimensions.X) * TransposedDimensions.Y;
+		}
+	}
+
+	CurrentPropagation = 0;
+	CurrentAxis = 0;
+	CurrentStep = 0;
+	SkipFinishedSweeps();
+
+	bActive = true;
+	FramesPlanned = 0;
+	StartSeconds = FPlatformTime::Seconds();
+}
+
+void FLightPropagationScheduler::Cancel()
+{
+	bActive = false;
+	Propagations.Reset();
+	Lights.Reset();
+}
+
+bool FLightPropagationScheduler::IsComplete() const
+{
+	return CurrentPropagation >= Propagations.Num();
+}
+
+bool FLightPropagationScheduler::IsOutdated(
+	TArrayView<const FDirLightParameters> InLights, const FRaymarchWorldParameters& InWorldParameters) const
+{
+	if (InLights.Num() != Lights.Num())
+	{
+		return true;
+	}
+	for (int32 i = 0; i < Lights.Num(); i++)
+	{
+		if (InLights[i] != Lights[i])
+		{
+			return true;
+		}
+	}
+	// Moving the volume without changing local light directions or clipping leaves the propagation valid.
+	return ClassifyWorldParametersChange(WorldParameters, InWorldParameters) != ELightVolumeInvalidation::None;
+}
+
+TArray<FLightPropagationChunk> FLightPropagationScheduler::PlanFrame(float BudgetMs)
+{
+	TPair<int64, double> Measurement;
+	while (GPUTimer->Measurements.Dequeue(Measurement))
+	{
+		AddGPUTimeMeasurement(Measurement.Key, Measurement.Value);
+	}
+
+	TArray<FLightPropagationChunk> Chunks;
+	if (!bActive)
+	{
+		return Chunks;
+	}
+	FramesPlanned++;
+
+	double BudgetVoxels = FMath::Max(BudgetMs, 0.0f) * 1.0e6 / NanosecondsPerVoxel;
+	while (!IsComplete())
+	{
+		const FScheduledLightPropagation& Propagation = Propagations[CurrentPropagation];
+		const int64 SliceVoxels = Propagation.SliceVoxels[CurrentAxis];
+		const int32 RemainingSteps = Propagation.AxisSteps[CurrentAxis] - CurrentStep;
+		int32 Steps = static_cast<int32>(FMath::Min<double>(RemainingSteps, FMath::FloorToDouble(BudgetVoxels / SliceVoxels)));
+		if (Steps <= 0)
+		{
+			if (Chunks.Num() > 0)
+			{
+				break;
+			}
+			Steps = 1;
+		}
+
+		FLightPropagationChunk& Chunk = Chunks.AddDefaulted_GetRef();
+		Chunk.PropagationIndex = CurrentPropagation;
+		Chunk.Range.AxisIndex = CurrentAxis;
+		Chunk.Range.FirstStep = CurrentStep;
+		Chunk.Range.NumSteps = Steps;
+		Chunk.Voxels = Steps * SliceVoxels;
+
+		BudgetVoxels -= Chunk.Voxels;
+		CurrentStep += Steps;
+		SkipFinishedSweeps();
+	}
+	return Chunks;
+}
+
+void FLightPropagationScheduler::ExecuteChunks(
+	const FBasicRaymarchRenderingResources& Resources, const TArray<FLightPropagationChunk>& Chunks)
+{
+	if (Chunks.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<TPair<TArray<FDirLightParameters>, FLightPropagationRange>> Work;
+	int64 Voxels = 0;
+	for (const FLightPropagationChunk& Chunk : Chunks)
+	{
+		Work.Emplace(Propagations[Chunk.PropagationIndex].Lights, Chunk.Range);
+		Voxels += Chunk.Voxels;
+	}
+
+	ENQUEUE_RENDER_COMMAND(LightPropagationChunks)
+	([Resources, Work = MoveTemp(Work), WorldParameters = WorldParameters, Timer = GPUTimer, Voxels](
+		 FRHICommandListImmediate& RHICmdList) {
+		Timer->Poll();
+		Timer->Begin(RHICmdList);
+		// A single graph for all chunks, so that the barriers between them get merged.
+		FRDGBuilder GraphBuilder(RHICmdList);
+		for (const TPair<TArray<FDirLightParameters>, FLightPropagationRange>& Chunk : Work)
+		{
+			AddDirLightsToSingleLightVolume_RenderThread(GraphBuilder, Resources, Chunk.Key, true, WorldParameters, Chunk.Value);
+		}
+		GraphBuilder.Execute();
+		Timer->End(RHICmdList, Voxels);
+	});
+}
+
+void FLightPropagationScheduler::AddGPUTimeMeasurement(int64 Voxels, double Milliseconds)
+{
+	if (Voxels <= 0 || Milliseconds <= 0.0)
+	{
+		return;
+	}
+	const double Measured = Milliseconds * 1.0e6 / Voxels;
+	// The first measurement replaces the default guess, later ones get smoothed so that a single slow frame doesn't halve the
+	// amount of work done in the next one.
+	NanosecondsPerVoxel = bHasMeasurement ? FMath::Lerp(NanosecondsPerVoxel, Measured, 0.25) : Measured;
+	bHasMeasurement = true;
+}
+
+int32 FLightPropagationScheduler::GetQueueDepth() const
+{
+	if (!bActive)
+	{
+		return 0;
+	}
+	int32 Sweeps = 0;
+	for (int32 PropagationIndex = CurrentPropagation; PropagationIndex < Propagations.Num(); PropagationIndex++)
+	{
+		for (int32 AxisIndex = PropagationIndex == CurrentPropagation ? CurrentAxis : 0; AxisIndex < 2; AxisIndex++)
+		{
+			Sweeps += Propagations[PropagationIndex].AxisSteps[AxisIndex] > 0 ? 1 : 0;
+		}
+	}
+	return Sweeps;
+}
+
+double FLightPropagationScheduler::GetSecondsSinceStart() const
+{
+	return bActive ? FPlatformTime::Seconds() - StartSeconds : 0.0;
+}
+
+void FLightPropagationScheduler::SkipFinishedSweeps()
+{
+	while (CurrentPropagation < Propagations.Num())
+	{
+		const FScheduledLightPropagation& Propagation = Propagations[CurrentPropagation];
+		if (CurrentAxis < 2 && CurrentStep < Propagation.AxisSteps[CurrentAxis])
+		{
+			return;
+		}
+		CurrentStep = 0;
+		if (++CurrentAxis >= 2)
+		{
+			CurrentAxis = 0;
+			CurrentPropagation++;
+		}
+	}
+}
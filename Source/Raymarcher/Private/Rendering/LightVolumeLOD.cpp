@@ -0,0 +1,49 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/LightVolumeLOD.h"
+
+FIntVector GetLightVolumeLODDimensions(const FIntVector& FullDimensions, int32 Level)
+{
+	const int32 Divisor = 1 << Level;
+	return FIntVector(FMath::DivideAndRoundUp(FullDimensions.X, Divisor), FMath::DivideAndRoundUp(FullDimensions.Y, Divisor),
+		FMath::DivideAndRoundUp(FullDimensions.Z, Divisor));
+}
+
+int32 SelectLightVolumeLOD(
+	ELightVolumeLODPolicy Policy, const FLightVolumeLODSettings& Settings, float RelativeContribution, float CameraDistance)
+{
+	int32 Level = 0;
+	if (Policy == ELightVolumeLODPolicy::Contribution)
+	{
+		const float Threshold = FMath::Clamp(Settings.ContributionThreshold, 0.0f, 1.0f);
+		Level = RelativeContribution >= Threshold ? 0 : (RelativeContribution >= Threshold * Threshold ? 1 : 2);
+	}
+	else
+	{
+		const float Threshold = FMath::Max(Settings.CameraDistanceThreshold, 0.0f);
+		Level = CameraDistance < Threshold ? 0 : (CameraDistance < 2.0f * Threshold ? 1 : 2);
+	}
+	return FMath::Min(Level, LightVolumeLODCount - 1);
+}
+
+int32 PickLightVolumeLODRefinement(TArrayView<const int32> Levels, TArrayView<const float> Contributions)
+{
+	check(Levels.Num() == Contributions.Num());
+	int32 Picked = INDEX_NONE;
+	for (int32 i = 0; i < Levels.Num(); i++)
+	{
+		if (Levels[i] == 0)
+		{
+			continue;
+		}
+		if (Picked == INDEX_NONE || Levels[i] > Levels[Picked] ||
+			(Levels[i] == Levels[Picked] && Contributions[i] > Contributions[Picked]))
+		{
+			Picked = i;
+		}
+	}
+	return Picked;
+}
@@ -0,0 +1,899 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/LightingCPU.h"
+
+#include "Async/ParallelFor.h"
+#include "Math/Float16.h"
+#include "Rendering/LightingShaderUtils.h"
+
+// Same constants as in RaymarcherCommon.usf.
+#define ONE_OVER_SQRT_3 0.57735026919f
+#define VOLUME_DENSITY 100.0f
+
+namespace
+{
+/// Per-light, per-axis parameters of a propagation - what the shaders get as uniforms plus the two ping-pong buffers.
+struct FLightPass
+{
+	FVector2D PrevPixelOffset;
+	FVector UVWOffset;
+	float StepSize = 0.0f;
+
+	/// Light outside of the read buffer (the border color of the read buffer sampler).
+	float LightAlpha = 0.0f;
+
+	TArray<float> ReadBuffer;
+	TArray<float> WriteBuffer;
+};
+
+/// Everything that stays constant during the propagation along one axis.
+struct FAxisPropagation
+{
+	const FRaymarchCPUResources* Resources;
+	FClippingPlaneParameters LocalClippingParameters;
+	FIntVector TransposedDimensions;
+	uint8 Axis;
+
+	/// Equivalent of mul(int3(PixelLoc.x, PixelLoc.y, Loop), PermutationMatrix) in the shaders.
+	FIntVector GetVolumePosition(int32 X, int32 Y, int32 Loop) const
+	{
+		switch (Axis)
+		{
+			case 0:
+				return FIntVector(Loop, X, Y);
+			case 1:
+				return FIntVector(X, Loop, Y);
+			default:
+				return FIntVector(X, Y, Loop);
+		}
+	}
+};
+
+// Equivalent of GetLightAlpha, GetUVOffset and GetStepSizeAndUVWOffset + the normalization done in LightingShaders.cpp.
+void SetupLightPass(FLightPass& Pass, const FDirLightParameters& LocalLightParams, const FMajorAxes& MajorAxes, unsigned AxisIndex,
+	const FIntVector& TransposedDimensions, const FRaymarchWorldParameters& WorldParameters)
+{
+	const FCubeFace Face = MajorAxes.FaceWeight[AxisIndex].first;
+	Pass.LightAlpha = GetLightAlpha(LocalLightParams, MajorAxes, AxisIndex);
+	Pass.PrevPixelOffset = GetUVOffset(Face, -LocalLightParams.LightDirection, TransposedDimensions);
+	GetStepSizeAndUVWOffset(
+		Face, -LocalLightParams.LightDirection, TransposedDimensions, WorldParameters, Pass.StepSize, Pass.UVWOffset);
+
+	// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct, but consistent!)
+	const int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
+	Pass.UVWOffset.Normalize();
+	Pass.UVWOffset *= 1.0f / LowestVoxelCount;
+
+	// Equivalent of Clear2DTexture_RenderThread on both buffers.
+	const int32 BufferSize = TransposedDimensions.X * TransposedDimensions.Y;
+	Pass.ReadBuffer.Init(Pass.LightAlpha, BufferSize);
+	Pass.WriteBuffer.Init(Pass.LightAlpha, BufferSize);
+}
+
+// Bilinear sampling of a read buffer with a border color, like the sampler from GetBufferSamplerRef(). LoadPixel returns the
+// buffer's pixel at an index.
+// (The GPU border color is quantized to 8 bits, the CPU uses the exact light alpha.)
+template <typename LoadPixelType>
+float SampleBuffer(const FIntVector& Size, const FVector2D& UV, float BorderValue, LoadPixelType LoadPixel)
+{
+	const float X = UV.X * Size.X - 0.5f;
+	const float Y = UV.Y * Size.Y - 0.5f;
+	const int32 X0 = FMath::FloorToInt32(X);
+	const int32 Y0 = FMath::FloorToInt32(Y);
+	const float FracX = X - X0;
+	const float FracY = Y - Y0;
+
+	auto Fetch = [&](int32 FetchX, int32 FetchY)
+	{
+		if (FetchX < 0 || FetchY < 0 || FetchX >= Size.X || FetchY >= Size.Y)
+		{
+			return BorderValue;
+		}
+		return LoadPixel(FetchX + FetchY * Size.X);
+	};
+
+	const float Top = FMath::Lerp(Fetch(X0, Y0), Fetch(X0 + 1, Y0), FracX);
+	const float Bottom = FMath::Lerp(Fetch(X0, Y0 + 1), Fetch(X0 + 1, Y0 + 1), FracX);
+	return FMath::Lerp(Top, Bottom, FracY);
+}
+
+float SampleReadBuffer(const FLightPass& Pass, const FIntVector& Size, const FVector2D& UV)
+{
+	return SampleBuffer(Size, UV, Pass.LightAlpha, [&Pass](int32 Index) { return Pass.ReadBuffer[Index]; });
+}
+
+// Trilinear sampling of a volume. Fetch returns the voxel at X, Y, Z, which can be outside of the volume.
+template <typename FetchType>
+float SampleTrilinear(const FIntVector& Size, const FVector& UVW, FetchType Fetch)
+{
+	const FVector TexelPos = UVW * FVector(Size) - 0.5;
+	const FIntVector Pos0(FMath::FloorToInt32(TexelPos.X), FMath::FloorToInt32(TexelPos.Y), FMath::FloorToInt32(TexelPos.Z));
+	const FVector Frac = TexelPos - FVector(Pos0);
+
+	float Planes[2];
+	for (int32 i = 0; i < 2; i++)
+	{
+		const int32 Z = Pos0.Z + i;
+		const float Top = FMath::Lerp(Fetch(Pos0.X, Pos0.Y, Z), Fetch(Pos0.X + 1, Pos0.Y, Z), static_cast<float>(Frac.X));
+		const float Bottom =
+			FMath::Lerp(Fetch(Pos0.X, Pos0.Y + 1, Z), Fetch(Pos0.X + 1, Pos0.Y + 1, Z), static_cast<float>(Frac.X));
+		Planes[i] = FMath::Lerp(Top, Bottom, static_cast<float>(Frac.Y));
+	}
+	return FMath::Lerp(Planes[0], Planes[1], static_cast<float>(Frac.Z));
+}
+
+// Trilinear sampling of the data volume with a border value, like the sampler in SetRaymarchResources().
+float SampleVolume(const FRaymarchCPUResources& Resources, const FVector& UVW, float BorderValue)
+{
+	const FIntVector& Size = Resources.DataDimensions;
+	return SampleTrilinear(Size, UVW,
+		[&](int32 X, int32 Y, int32 Z)
+		{
+			if (X < 0 || Y < 0 || Z < 0 || X >= Size.X || Y >= Size.Y || Z >= Size.Z)
+			{
+				return BorderValue;
+			}
+			return Resources.DataVolume[X + (Y + static_cast<int64>(Z) * Size.Y) * Size.X];
+		});
+}
+
+// Data value sampled outside of the volume - the zero point of the windowing (see SetRaymarchResources()).
+float GetBorderDataValue(const FRaymarchCPUResources& Resources)
+{
+	return Resources.WindowingParameters.Center - 0.5f * Resources.WindowingParameters.Width;
+}
+
+// The two transfer function texels bilinear sampling with clamping blends at the position a data value is windowed to. Returns
+// false if windowing cuts the value off.
+bool GetTransferFunctionTexels(const FRaymarchCPUResources& Resources, float DataValue, int32& OutIndex0, int32& OutIndex1,
+	float& OutWeight1)
+{
+	const FWindowingParameters& Windowing = Resources.WindowingParameters;
+	const float TFPos = (DataValue - Windowing.Center + (Windowing.Width / 2.0f)) / Windowing.Width;
+	if ((TFPos < 0.0f && Windowing.LowCutoff) || (TFPos > 1.0f && Windowing.HighCutoff))
+	{
+		return false;
+	}
+
+	const int32 TFSize = Resources.TransferFunction.Num();
+	const float TexelPos = FMath::Clamp(TFPos * TFSize - 0.5f, 0.0f, static_cast<float>(TFSize - 1));
+	OutIndex0 = FMath::FloorToInt32(TexelPos);
+	OutIndex1 = FMath::Min(OutIndex0 + 1, TFSize - 1);
+	OutWeight1 = TexelPos - OutIndex0;
+	return true;
+}
+
+// Equivalent of SampleWindowedVolumeStep(...).a in WindowedSampling.usf.
+float SampleWindowedVolumeStepAlpha(const FRaymarchCPUResources& Resources, const FVector& UVW, float StepSize)
+{
+	const float DataValue = SampleVolume(Resources, UVW, GetBorderDataValue(Resources));
+	int32 Index0, Index1;
+	float Weight1;
+	if (!GetTransferFunctionTexels(Resources, DataValue, Index0, Index1, Weight1))
+	{
+		return 0.0f;
+	}
+	float Alpha = FMath::Lerp(Resources.TransferFunction[Index0].A, Resources.TransferFunction[Index1].A, Weight1);
+
+	Alpha = FMath::Clamp(Alpha, 0.0f, 1.0f);
+	return 1.0f - FMath::Pow(1.0f - Alpha, StepSize);
+}
+
+// Weight of a voxel by an approximation of the part of it that's not cut away by the clipping plane (see the shaders).
+float GetClippingAlphaWeight(
+	const FClippingPlaneParameters& Clipping, const FIntVector& LightVolumeDimensions, const FVector& SampleUVW)
+{
+	const float DistanceToCuttingPlane = FVector::DotProduct(SampleUVW - Clipping.Center, Clipping.Direction);
+	const FVector CuttingPlaneIntersectPoint = SampleUVW + Clipping.Direction * DistanceToCuttingPlane;
+	const FVector VoxelCuttingPlaneOffset = (SampleUVW - CuttingPlaneIntersectPoint) * FVector(LightVolumeDimensions);
+	const float VoxelDistance = VoxelCuttingPlaneOffset.Size();
+	return FMath::Clamp(0.5f + (ONE_OVER_SQRT_3 * VoxelDistance * FMath::Sign(DistanceToCuttingPlane)), 0.0f, 1.0f);
+}
+
+bool IsInsideVolume(const FVector& SampleUVW)
+{
+	return SampleUVW.GetMin() >= 0.0 && SampleUVW.GetMax() <= 1.0;
+}
+
+// Returns the UV the light reaching pixel X, Y of a slice gets read from in the previous slice's buffer.
+FVector2D GetPreviousUV(const FAxisPropagation& Propagation, const FLightPass& Pass, int32 X, int32 Y)
+{
+	const FIntVector& Size = Propagation.TransposedDimensions;
+	return FVector2D((X + 0.5) / Size.X, (Y + 0.5) / Size.Y) + Pass.PrevPixelOffset;
+}
+
+// Returns the clipping weighted opacity occluding the light of a pass on its way to a voxel.
+// bRequireInsideVolume mirrors the extra check AddDirLightShader does before sampling (ChangeDirLightShader doesn't have it).
+float GetOccludingSample(
+	const FAxisPropagation& Propagation, const FLightPass& Pass, const FVector& VoxelUVW, bool bRequireInsideVolume)
+{
+	const FVector SampleUVW = VoxelUVW + Pass.UVWOffset;
+	const float AlphaWeight = GetClippingAlphaWeight(
+		Propagation.LocalClippingParameters, Propagation.Resources->LightVolumeDimensions, SampleUVW);
+
+	float CurrentSample = 0.0f;
+	if (AlphaWeight > 0.0f && (IsInsideVolume(SampleUVW) || !bRequireInsideVolume))
+	{
+		CurrentSample = SampleWindowedVolumeStepAlpha(*Propagation.Resources, SampleUVW, Pass.StepSize * VOLUME_DENSITY);
+		CurrentSample *= AlphaWeight;
+	}
+	return CurrentSample;
+}
+
+// Propagates the light of one pass through one voxel. Returns the light alpha that reaches the voxel.
+float PropagateVoxel(
+	const FAxisPropagation& Propagation, FLightPass& Pass, int32 X, int32 Y, const FVector& VoxelUVW, bool bRequireInsideVolume)
+{
+	const FIntVector& Size = Propagation.TransposedDimensions;
+	const float PreviousLightAlpha = SampleReadBuffer(Pass, Size, GetPreviousUV(Propagation, Pass, X, Y));
+	const float CurrentSample = GetOccludingSample(Propagation, Pass, VoxelUVW, bRequireInsideVolume);
+
+	const float CurrentLightAlpha = PreviousLightAlpha * (1 - CurrentSample);
+	Pass.WriteBuffer[X + Y * Size.X] = QuantizeLightValue(CurrentLightAlpha, Propagation.Resources->LightVolumeFormat);
+	return CurrentLightAlpha;
+}
+
+// Runs the slice loop along one axis for one or more lights (adding/removing, more than one if batched) or two lights (bChange,
+// Passes = {Removed, Added}). If CaptureBuffer is provided, the light propagated in CaptureSlice gets copied into it.
+void PropagateAlongAxis(FRaymarchCPUResources& Resources, const FAxisPropagation& Propagation, TArrayView<FLightPass> Passes,
+	bool bChange, int Start, int Stop, int AxisDirection, int32 AddedSign, FLightPropagationCPUStats& Stats,
+	TArray<float>* CaptureBuffer = nullptr, int CaptureSlice = INDEX_NONE)
+{
+	const FIntVector& Size = Propagation.TransposedDimensions;
+	const FIntVector& LightDims = Resources.LightVolumeDimensions;
+
+	for (int Loop = Start; Loop != Stop; Loop += AxisDirection)
+	{
+		const double SliceStart = FPlatformTime::Seconds();
+
+		// Every voxel of a slice only reads the previous slice, so rows can be processed independently.
+		ParallelFor(Size.Y,
+			[&](int32 Y)
+			{
+				for (int32 X = 0; X < Size.X; X++)
+				{
+					const FIntVector Pos = Propagation.GetVolumePosition(X, Y, Loop);
+					const FVector VoxelUVW = (FVector(Pos) + 0.5) / FVector(LightDims);
+					float& LightVoxel =
+						Resources.LightVolume[Pos.X + (Pos.Y + static_cast<int64>(Pos.Z) * LightDims.Y) * LightDims.X];
+
+					if (bChange)
+					{
+						const float RemovedAlpha = PropagateVoxel(Propagation, Passes[0], X, Y, VoxelUVW, false);
+						const float AddedAlpha = PropagateVoxel(Propagation, Passes[1], X, Y, VoxelUVW, false);
+						// Ignore changes smaller than 0.001 to avoid writes with almost no effect.
+						if (FMath::Abs(AddedAlpha - RemovedAlpha) > 1e-3f)
+						{
+							LightVoxel = QuantizeLightValue(LightVoxel + AddedAlpha - RemovedAlpha, Resources.LightVolumeFormat);
+						}
+					}
+					else
+					{
+						// Batched lights are summed up and written once, like BatchedComputeShader does.
+						float AddedLightAlpha = 0.0f;
+						for (FLightPass& Pass : Passes)
+						{
+							const float CurrentLightAlpha = PropagateVoxel(Propagation, Pass, X, Y, VoxelUVW, true);
+							if (FMath::Abs(CurrentLightAlpha) > 1e-3f)
+							{
+								AddedLightAlpha += CurrentLightAlpha;
+							}
+						}
+						if (AddedLightAlpha != 0.0f)
+						{
+							LightVoxel = QuantizeLightValue(LightVoxel + AddedLightAlpha * AddedSign, Resources.LightVolumeFormat);
+						}
+					}
+				}
+			});
+
+		// Ping-pong - this slice's write buffer is the next slice's read buffer.
+		for (FLightPass& Pass : Passes)
+		{
+			Swap(Pass.ReadBuffer, Pass.WriteBuffer);
+		}
+		if (CaptureBuffer && Loop == CaptureSlice)
+		{
+			*CaptureBuffer = Passes.Last().ReadBuffer;
+		}
+
+		const double SliceSeconds = FPlatformTime::Seconds() - SliceStart;
+		Stats.MaxSliceSeconds = FMath::Max(Stats.MaxSliceSeconds, SliceSeconds);
+		Stats.SlicesProcessed++;
+		Stats.VoxelsProcessed += static_cast<int64>(Size.X) * Size.Y;
+	}
+}
+
+// Tracks the group shared memory accesses of the threads between two barriers of the single dispatch propagation. Accesses of
+// the same element by different threads between two barriers, at least one of them a write, are data races on the GPU.
+class FGroupSharedAccessTracker
+{
+public:
+	explicit FGroupSharedAccessTracker(int32 NumElements)
+	{
+		Writers.Init(INDEX_NONE, NumElements);
+		Readers.Init(INDEX_NONE, NumElements);
+	}
+
+	void Read(int32 Index, int32 Thread)
+	{
+		Hazards += Writers[Index] != INDEX_NONE && Writers[Index] != Thread;
+		Readers[Index] = Readers[Index] == INDEX_NONE || Readers[Index] == Thread ? Thread : MultipleThreads;
+	}
+
+	void Write(int32 Index, int32 Thread)
+	{
+		Hazards += (Writers[Index] != INDEX_NONE && Writers[Index] != Thread) ||
+				   (Readers[Index] != INDEX_NONE && Readers[Index] != Thread);
+		Writers[Index] = Thread;
+	}
+
+	/// GroupMemoryBarrierWithGroupSync() - all accesses before it are visible to everything after it.
+	void Barrier()
+	{
+		Writers.Init(INDEX_NONE, Writers.Num());
+		Readers.Init(INDEX_NONE, Readers.Num());
+		Barriers++;
+	}
+
+	int32 Barriers = 0;
+	int32 Hazards = 0;
+
+private:
+	static constexpr int32 MultipleThreads = -2;
+
+	TArray<int32> Writers;
+	TArray<int32> Readers;
+};
+
+// Runs the slice loop along one axis like AddDirLightShader_GPUSync.usf does - a single thread group walking all slices,
+// reading and writing the light buffers in group shared memory and synchronizing with a barrier after each slice. The threads
+// run one after another (in reverse order, so that a missing barrier changes the result), and every shared memory access goes
+// through Tracker.
+void PropagateAlongAxisInSingleDispatch(FRaymarchCPUResources& Resources, const FAxisPropagation& Propagation,
+	const FLightPass& Pass, int Start, int Stop, int AxisDirection, int32 AddedSign, FGroupSharedAccessTracker& Tracker)
+{
+	const FIntVector& Size = Propagation.TransposedDimensions;
+	const FIntVector& LightDims = Resources.LightVolumeDimensions;
+	const int32 SlicePixels = Size.X * Size.Y;
+	TArray<float> LightBuffers;
+	LightBuffers.SetNumZeroed(2 * GPUSyncMaxSlicePixels);
+
+	const int32 FirstReadOffset = (Start % 2) * GPUSyncMaxSlicePixels;
+	for (int32 Thread = GPUSyncNumThreads - 1; Thread >= 0; Thread--)
+	{
+		for (int32 Pixel = Thread; Pixel < SlicePixels; Pixel += GPUSyncNumThreads)
+		{
+			Tracker.Write(FirstReadOffset + Pixel, Thread);
+			LightBuffers[FirstReadOffset + Pixel] = Pass.LightAlpha;
+		}
+	}
+	Tracker.Barrier();
+
+	for (int Loop = Start; Loop != Stop; Loop += AxisDirection)
+	{
+		const int32 ReadOffset = (Loop % 2) * GPUSyncMaxSlicePixels;
+		const int32 WriteOffset = GPUSyncMaxSlicePixels - ReadOffset;
+
+		for (int32 Thread = GPUSyncNumThreads - 1; Thread >= 0; Thread--)
+		{
+			for (int32 Pixel = Thread; Pixel < SlicePixels; Pixel += GPUSyncNumThreads)
+			{
+				const int32 X = Pixel % Size.X;
+				const int32 Y = Pixel / Size.X;
+				const FIntVector Pos = Propagation.GetVolumePosition(X, Y, Loop);
+				const FVector VoxelUVW = (FVector(Pos) + 0.5) / FVector(LightDims);
+
+				const float PreviousLightAlpha = SampleBuffer(Size, GetPreviousUV(Propagation, Pass, X, Y), Pass.LightAlpha,
+					[&](int32 Index)
+					{
+						Tracker.Read(ReadOffset + Index, Thread);
+						return LightBuffers[ReadOffset + Index];
+					});
+				const float CurrentSample = GetOccludingSample(Propagation, Pass, VoxelUVW, true);
+				const float CurrentLightAlpha = PreviousLightAlpha * (1 - CurrentSample);
+
+				Tracker.Write(WriteOffset + Pixel, Thread);
+				LightBuffers[WriteOffset + Pixel] = CurrentLightAlpha;
+
+				// Ignore changes smaller than 0.001 to avoid writes with almost no effect.
+				if (FMath::Abs(CurrentLightAlpha) > 1e-3f)
+				{
+					float& LightVoxel =
+						Resources.LightVolume[Pos.X + (Pos.Y + static_cast<int64>(Pos.Z) * LightDims.Y) * LightDims.X];
+					LightVoxel = QuantizeLightValue(LightVoxel + CurrentLightAlpha * AddedSign, Resources.LightVolumeFormat);
+				}
+			}
+		}
+		Tracker.Barrier();
+	}
+}
+
+bool AreResourcesValid(const FRaymarchCPUResources& Resources)
+{
+	const FIntVector& DataDims = Resources.DataDimensions;
+	const FIntVector& LightDims = Resources.LightVolumeDimensions;
+	return Resources.DataVolume.Num() == static_cast<int64>(DataDims.X) * DataDims.Y * DataDims.Z &&
+		   Resources.LightVolume.Num() == static_cast<int64>(LightDims.X) * LightDims.Y * LightDims.Z &&
+		   Resources.LightVolume.Num() > 0 && Resources.TransferFunction.Num() > 0;
+}
+}	 // namespace
+
+float QuantizeLightValue(float Value, ELightVolumeFormat Format)
+{
+	switch (Format)
+	{
+		case ELightVolumeFormat::G8:
+			return FMath::RoundToFloat(FMath::Clamp(Value, 0.0f, 1.0f) * 255.0f) / 255.0f;
+		case ELightVolumeFormat::R16F:
+			return FFloat16(Value).GetFloat();
+		default:
+			return Value;
+	}
+}
+
+FLinearColor SampleWindowedTransferFunction_CPU(const FRaymarchCPUResources& Resources, float DataValue, float StepSize)
+{
+	int32 Index0, Index1;
+	float Weight1;
+	if (!GetTransferFunctionTexels(Resources, DataValue, Index0, Index1, Weight1))
+	{
+		return FLinearColor::Transparent;
+	}
+	FLinearColor Color = FMath::Lerp(Resources.TransferFunction[Index0], Resources.TransferFunction[Index1], Weight1);
+	Color.A = 1.0f - FMath::Pow(1.0f - FMath::Clamp(Color.A, 0.0f, 1.0f), StepSize);
+	return Color;
+}
+
+FLinearColor SampleWindowedVolumeStep_CPU(const FRaymarchCPUResources& Resources, const FVector& UVW, float StepSize)
+{
+	return SampleWindowedTransferFunction_CPU(Resources, SampleVolume(Resources, UVW, GetBorderDataValue(Resources)), StepSize);
+}
+
+float SampleDataVolume_CPU(const FRaymarchCPUResources& Resources, const FVector& UVW)
+{
+	const FIntVector& Size = Resources.DataDimensions;
+	return SampleTrilinear(Size, UVW,
+		[&](int32 X, int32 Y, int32 Z)
+		{
+			X = FMath::Clamp(X, 0, Size.X - 1);
+			Y = FMath::Clamp(Y, 0, Size.Y - 1);
+			Z = FMath::Clamp(Z, 0, Size.Z - 1);
+			return Resources.DataVolume[X + (Y + static_cast<int64>(Z) * Size.Y) * Size.X];
+		});
+}
+
+void FRaymarchCPUResources::InitLightVolume(FIntVector Dimensions)
+{
+	LightVolumeDimensions = Dimensions;
+	LightVolume.Init(0.0f, static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z);
+}
+
+double FLightPropagationCPUStats::GetVoxelsPerSecond() const
+{
+	return Seconds > 0.0 ? VoxelsProcessed / Seconds : 0.0;
+}
+
+double FLightPropagationCPUStats::GetAverageSliceSeconds() const
+{
+	return SlicesProcessed > 0 ? Seconds / SlicesProcessed : 0.0;
+}
+
+void FLightPropagationCPUStats::Accumulate(const FLightPropagationCPUStats& Other)
+{
+	VoxelsProcessed += Other.VoxelsProcessed;
+	SlicesProcessed += Other.SlicesProcessed;
+	Seconds += Other.Seconds;
+	MaxSliceSeconds = FMath::Max(MaxSliceSeconds, Other.MaxSliceSeconds);
+}
+
+FString FLightPropagationCPUStats::ToString() const
+{
+	return FString::Printf(TEXT("%.1f Mvoxels/s, %d slices, %.3f ms per slice (max %.3f ms), %.1f ms total"),
+		GetVoxelsPerSecond() / 1.0e6, SlicesProcessed, GetAverageSliceSeconds() * 1000.0, MaxSliceSeconds * 1000.0,
+		Seconds * 1000.0);
+}
+
+void AddDirLightToSingleLightVolume_CPU(FRaymarchCPUResources& Resources, const FDirLightParameters LightParameters,
+	const bool Added, const FRaymarchWorldParameters WorldParameters, FLightPropagationCPUStats* OutStats /*= nullptr*/,
+	FLightSnapshotsCPU* Snapshots /*= nullptr*/)
+{
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0) || !ensure(AreResourcesValid(Resources)))
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FLightPropagationCPUStats Stats;
+
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+
+	FAxisPropagation Propagation;
+	Propagation.Resources = &Resources;
+	Propagation.LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		// Break if the axis weight == 0
+		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		{
+			break;
+		}
+		Propagation.TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, Resources.LightVolumeDimensions, i);
+		Propagation.Axis = (uint8) LocalMajorAxes.FaceWeight[i].first / 2;
+
+		FLightPass Pass;
+		SetupLightPass(Pass, LocalLightParams, LocalMajorAxes, i, Propagation.TransposedDimensions, WorldParameters);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, Propagation.TransposedDimensions.Z);
+		TArray<float>* CaptureBuffer =
+			Snapshots ? &Snapshots->Buffers[i][Snapshots->Snapshots.Axes[i].BufferIndex] : nullptr;
+		const int CaptureSlice = Snapshots ? Snapshots->Snapshots.Axes[i].Slice : INDEX_NONE;
+		PropagateAlongAxis(Resources, Propagation, MakeArrayView(&Pass, 1), false, Start, Stop, AxisDirection, Added ? 1 : -1,
+			Stats, CaptureBuffer, CaptureSlice);
+	}
+
+	if (OutStats)
+	{
+		Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+		OutStats->Accumulate(Stats);
+	}
+}
+
+void AddDirLightToSingleLightVolume_GPUSync_CPU(FRaymarchCPUResources& Resources, const FDirLightParameters LightParameters,
+	const bool Added, const FRaymarchWorldParameters WorldParameters, FGPUSyncScheduleCPUStats* OutStats /*= nullptr*/)
+{
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0) || !ensure(AreResourcesValid(Resources)))
+	{
+		return;
+	}
+
+	FGPUSyncScheduleCPUStats Stats;
+	FGroupSharedAccessTracker Tracker(2 * GPUSyncMaxSlicePixels);
+
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+
+	FAxisPropagation Propagation;
+	Propagation.Resources = &Resources;
+	Propagation.LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		// Break if the axis weight == 0
+		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		{
+			break;
+		}
+		Propagation.TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, Resources.LightVolumeDimensions, i);
+		Propagation.Axis = (uint8) LocalMajorAxes.FaceWeight[i].first / 2;
+
+		FLightPass Pass;
+		SetupLightPass(Pass, LocalLightParams, LocalMajorAxes, i, Propagation.TransposedDimensions, WorldParameters);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, Propagation.TransposedDimensions.Z);
+		if (!CanPropagateInSingleDispatch(Propagation.TransposedDimensions))
+		{
+			// Same fallback as the GPU version - a dispatch per slice.
+			FLightPropagationCPUStats PerSliceStats;
+			PropagateAlongAxis(Resources, Propagation, MakeArrayView(&Pass, 1), false, Start, Stop, AxisDirection,
+				Added ? 1 : -1, PerSliceStats);
+			Stats.PerSliceAxes++;
+			continue;
+		}
+
+		PropagateAlongAxisInSingleDispatch(
+			Resources, Propagation, Pass, Start, Stop, AxisDirection, Added ? 1 : -1, Tracker);
+		Stats.SingleDispatchAxes++;
+	}
+
+	if (OutStats)
+	{
+		OutStats->SingleDispatchAxes += Stats.SingleDispatchAxes;
+		OutStats->PerSliceAxes += Stats.PerSliceAxes;
+		OutStats->Barriers += Tracker.Barriers;
+		OutStats->Hazards += Tracker.Hazards;
+	}
+}
+
+void AddUpsampledLightVolume_CPU(FRaymarchCPUResources& Resources, const FRaymarchCPUResources& CoarseResources, float Weight)
+{
+	const FIntVector& Size = Resources.LightVolumeDimensions;
+	const FIntVector& CoarseSize = CoarseResources.LightVolumeDimensions;
+	if (!ensure(Resources.LightVolume.Num() == static_cast<int64>(Size.X) * Size.Y * Size.Z &&
+				CoarseResources.LightVolume.Num() == static_cast<int64>(CoarseSize.X) * CoarseSize.Y * CoarseSize.Z &&
+				CoarseResources.LightVolume.Num() > 0))
+	{
+		return;
+	}
+
+	ParallelFor(Size.Z,
+		[&](int32 Z)
+		{
+			for (int32 Y = 0; Y < Size.Y; Y++)
+			{
+				for (int32 X = 0; X < Size.X; X++)
+				{
+					// Same as the clamping sampler of UpsampleLightVolumeShader.usf.
+					const FVector UVW = (FVector(X, Y, Z) + 0.5) / FVector(Size);
+					const float Upsampled = SampleTrilinear(CoarseSize, UVW,
+						[&](int32 FetchX, int32 FetchY, int32 FetchZ)
+						{
+							FetchX = FMath::Clamp(FetchX, 0, CoarseSize.X - 1);
+							FetchY = FMath::Clamp(FetchY, 0, CoarseSize.Y - 1);
+							FetchZ = FMath::Clamp(FetchZ, 0, CoarseSize.Z - 1);
+							const int64 Index = FetchX + (FetchY + static_cast<int64>(FetchZ) * CoarseSize.Y) * CoarseSize.X;
+							return CoarseResources.LightVolume[Index];
+						});
+					float& LightVoxel = Resources.LightVolume[X + (Y + static_cast<int64>(Z) * Size.Y) * Size.X];
+					LightVoxel = QuantizeLightValue(LightVoxel + Weight * Upsampled, Resources.LightVolumeFormat);
+				}
+			}
+		});
+}
+
+void AddDirLightsToSingleLightVolume_CPU(FRaymarchCPUResources& Resources, TArrayView<const FDirLightParameters> LightParameters,
+	const bool Added, const FRaymarchWorldParameters WorldParameters, FLightPropagationCPUStats* OutStats /*= nullptr*/)
+{
+	if (!ensure(AreResourcesValid(Resources)))
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FLightPropagationCPUStats Stats;
+
+	FAxisPropagation Propagation;
+	Propagation.Resources = &Resources;
+	Propagation.LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+
+	for (const TArray<int32>& Batch : GroupLightsIntoBatches(LightParameters, WorldParameters.VolumeTransform))
+	{
+		FDirLightParameters LocalLightParams[MaxBatchedLights];
+		FMajorAxes LocalMajorAxes[MaxBatchedLights];
+		for (int32 i = 0; i < Batch.Num(); i++)
+		{
+			GetLocalLightParamsAndAxes(
+				LightParameters[Batch[i]], WorldParameters.VolumeTransform, LocalLightParams[i], LocalMajorAxes[i]);
+		}
+		// All lights share the faces, so the axes of the first one decide the dimensions and loop direction.
+		const FMajorAxes& BatchAxes = LocalMajorAxes[0];
+
+		for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+		{
+			// Break if the axis weight == 0 for all lights.
+			bool bAnyLightHasWeight = false;
+			for (int32 i = 0; i < Batch.Num(); i++)
+			{
+				bAnyLightHasWeight |= LocalMajorAxes[i].FaceWeight[AxisIndex].second != 0;
+			}
+			if (!bAnyLightHasWeight)
+			{
+				break;
+			}
+			Propagation.TransposedDimensions = GetTransposedDimensions(BatchAxes, Resources.LightVolumeDimensions, AxisIndex);
+			Propagation.Axis = (uint8) BatchAxes.FaceWeight[AxisIndex].first / 2;
+
+			TArray<FLightPass, TInlineAllocator<MaxBatchedLights>> Passes;
+			Passes.SetNum(Batch.Num());
+			for (int32 i = 0; i < Batch.Num(); i++)
+			{
+				SetupLightPass(
+					Passes[i], LocalLightParams[i], LocalMajorAxes[i], AxisIndex, Propagation.TransposedDimensions, WorldParameters);
+			}
+
+			int Start, Stop, AxisDirection;
+			GetLoopStartStopIndexes(Start, Stop, AxisDirection, BatchAxes, AxisIndex, Propagation.TransposedDimensions.Z);
+			PropagateAlongAxis(
+				Resources, Propagation, MakeArrayView(Passes), false, Start, Stop, AxisDirection, Added ? 1 : -1, Stats);
+		}
+	}
+
+	if (OutStats)
+	{
+		Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+		OutStats->Accumulate(Stats);
+	}
+}
+
+void ChangeDirLightInSingleLightVolume_CPU(FRaymarchCPUResources& Resources, const FDirLightParameters RemovedLightParameters,
+	const FDirLightParameters AddedLightParameters, const FRaymarchWorldParameters WorldParameters,
+	FLightPropagationCPUStats* OutStats /*= nullptr*/)
+{
+	// Can't have directional light without direction...
+	if (AddedLightParameters.LightDirection == FVector(0.0, 0.0, 0.0) ||
+		RemovedLightParameters.LightDirection == FVector(0.0, 0.0, 0.0) || !ensure(AreResourcesValid(Resources)))
+	{
+		return;
+	}
+
+	FDirLightParameters RemovedLocalLightParams, AddedLocalLightParams;
+	FMajorAxes RemovedLocalMajorAxes, AddedLocalMajorAxes;
+	GetLocalLightParamsAndAxes(
+		RemovedLightParameters, WorldParameters.VolumeTransform, RemovedLocalLightParams, RemovedLocalMajorAxes);
+	GetLocalLightParamsAndAxes(AddedLightParameters, WorldParameters.VolumeTransform, AddedLocalLightParams, AddedLocalMajorAxes);
+
+	// If lights have different major axes, do a separate removal and addition.
+	if (RemovedLocalMajorAxes.FaceWeight[0].first != AddedLocalMajorAxes.FaceWeight[0].first ||
+		RemovedLocalMajorAxes.FaceWeight[1].first != AddedLocalMajorAxes.FaceWeight[1].first)
+	{
+		AddDirLightToSingleLightVolume_CPU(Resources, RemovedLightParameters, false, WorldParameters, OutStats);
+		AddDirLightToSingleLightVolume_CPU(Resources, AddedLightParameters, true, WorldParameters, OutStats);
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FLightPropagationCPUStats Stats;
+
+	FAxisPropagation Propagation;
+	Propagation.Resources = &Resources;
+	Propagation.LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+
+	for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+	{
+		// The GPU version propagates zero light along an axis with zero weight for both lights, which never writes anything.
+		if (RemovedLocalMajorAxes.FaceWeight[AxisIndex].second == 0 && AddedLocalMajorAxes.FaceWeight[AxisIndex].second == 0)
+		{
+			continue;
+		}
+		Propagation.TransposedDimensions =
+			GetTransposedDimensions(RemovedLocalMajorAxes, Resources.LightVolumeDimensions, AxisIndex);
+		Propagation.Axis = (uint8) RemovedLocalMajorAxes.FaceWeight[AxisIndex].first / 2;
+
+		FLightPass Passes[2];
+		SetupLightPass(Passes[0], RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex, Propagation.TransposedDimensions,
+			WorldParameters);
+		SetupLightPass(
+			Passes[1], AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex, Propagation.TransposedDimensions, WorldParameters);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(
+			Start, Stop, AxisDirection, RemovedLocalMajorAxes, AxisIndex, Propagation.TransposedDimensions.Z);
+		PropagateAlongAxis(Resources, Propagation, MakeArrayView(Passes), true, Start, Stop, AxisDirection, 1, Stats);
+	}
+
+	if (OutStats)
+	{
+		Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+		OutStats->Accumulate(Stats);
+	}
+}
+
+void ChangeClippingInSingleLightVolume_CPU(FRaymarchCPUResources& Resources, const FDirLightParameters LightParameters,
+	const FRaymarchWorldParameters OldWorldParameters, const FRaymarchWorldParameters NewWorldParameters,
+	const FClippingChangePlan& Plan, FLightSnapshotsCPU& Snapshots, FLightPropagationCPUStats* OutStats /*= nullptr*/)
+{
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0) || !ensure(AreResourcesValid(Resources)))
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FLightPropagationCPUStats Stats;
+
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, NewWorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+
+	FAxisPropagation Propagation;
+	Propagation.Resources = &Resources;
+	Propagation.LocalClippingParameters = GetLocalClippingParameters(NewWorldParameters);
+	const FClippingPlaneParameters RemovedClippingParameters = GetLocalClippingParameters(OldWorldParameters);
+	const FIntVector& LightDims = Resources.LightVolumeDimensions;
+
+	for (int32 AxisIndex = 0; AxisIndex < Plan.AxisCount; AxisIndex++)
+	{
+		const FClippingChangeAxisPlan& AxisPlan = Plan.Axes[AxisIndex];
+		if (!AxisPlan.IsDirty())
+		{
+			continue;
+		}
+		Propagation.TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, LightDims, AxisIndex);
+		Propagation.Axis = (uint8) LocalMajorAxes.FaceWeight[AxisIndex].first / 2;
+		const FIntVector& Size = Propagation.TransposedDimensions;
+
+		// Passes[0] is the light with the removed clipping, Passes[1] with the added one. Both resume from the same snapshot.
+		FLightPass Passes[2];
+		for (FLightPass& Pass : Passes)
+		{
+			SetupLightPass(Pass, LocalLightParams, LocalMajorAxes, AxisIndex, Size, NewWorldParameters);
+			if (AxisPlan.ResumeSlice != AxisPlan.Start)
+			{
+				Pass.ReadBuffer = Snapshots.Buffers[AxisIndex][AxisPlan.ResumeBufferIndex];
+			}
+		}
+
+		for (int Loop = AxisPlan.ResumeSlice; Loop != AxisPlan.Stop; Loop += AxisPlan.AxisDirection)
+		{
+			const double SliceStart = FPlatformTime::Seconds();
+			const bool bDirty = (Loop - AxisPlan.FirstDirtySlice) * AxisPlan.AxisDirection >= 0;
+
+			ParallelFor(Size.Y,
+				[&](int32 Y)
+				{
+					for (int32 X = 0; X < Size.X; X++)
+					{
+						const FIntVector Pos = Propagation.GetVolumePosition(X, Y, Loop);
+						const FVector SampleUVW = (FVector(Pos) + 0.5) / FVector(LightDims) + Passes[1].UVWOffset;
+						const FVector2D PreviousUV = FVector2D((X + 0.5) / Size.X, (Y + 0.5) / Size.Y) + Passes[1].PrevPixelOffset;
+						const int32 BufferIndex = X + Y * Size.X;
+
+						const float AddedAlphaWeight =
+							GetClippingAlphaWeight(Propagation.LocalClippingParameters, LightDims, SampleUVW);
+						float AddedLightAlpha = SampleReadBuffer(Passes[1], Size, PreviousUV);
+						if (!bDirty)
+						{
+							float Sample = 0.0f;
+							if (AddedAlphaWeight > 0.0f && IsInsideVolume(SampleUVW))
+							{
+								Sample = SampleWindowedVolumeStepAlpha(Resources, SampleUVW, Passes[1].StepSize * VOLUME_DENSITY);
+							}
+							AddedLightAlpha *= 1 - Sample * AddedAlphaWeight;
+							Passes[0].WriteBuffer[BufferIndex] = QuantizeLightValue(AddedLightAlpha, Resources.LightVolumeFormat);
+							Passes[1].WriteBuffer[BufferIndex] = Passes[0].WriteBuffer[BufferIndex];
+							continue;
+						}
+
+						const float RemovedAlphaWeight = GetClippingAlphaWeight(RemovedClippingParameters, LightDims, SampleUVW);
+						float RemovedLightAlpha = SampleReadBuffer(Passes[0], Size, PreviousUV);
+
+						// Sample the volume only once for both lights.
+						float Sample = 0.0f;
+						if (FMath::Max(AddedAlphaWeight, RemovedAlphaWeight) > 0.0f && IsInsideVolume(SampleUVW))
+						{
+							Sample = SampleWindowedVolumeStepAlpha(Resources, SampleUVW, Passes[1].StepSize * VOLUME_DENSITY);
+						}
+						AddedLightAlpha *= 1 - Sample * AddedAlphaWeight;
+						RemovedLightAlpha *= 1 - Sample * RemovedAlphaWeight;
+						Passes[0].WriteBuffer[BufferIndex] = QuantizeLightValue(RemovedLightAlpha, Resources.LightVolumeFormat);
+						Passes[1].WriteBuffer[BufferIndex] = QuantizeLightValue(AddedLightAlpha, Resources.LightVolumeFormat);
+
+						// Undo exactly what adding the removed light wrote, then write what adding the new one would.
+						const float Change = (FMath::Abs(AddedLightAlpha) > 1e-3f ? AddedLightAlpha : 0.0f) -
+											 (FMath::Abs(RemovedLightAlpha) > 1e-3f ? RemovedLightAlpha : 0.0f);
+						if (Change != 0.0f)
+						{
+							float& LightVoxel =
+								Resources.LightVolume[Pos.X + (Pos.Y + static_cast<int64>(Pos.Z) * LightDims.Y) * LightDims.X];
+							LightVoxel = QuantizeLightValue(LightVoxel + Change, Resources.LightVolumeFormat);
+						}
+					}
+				});
+
+			for (FLightPass& Pass : Passes)
+			{
+				Swap(Pass.ReadBuffer, Pass.WriteBuffer);
+			}
+			if (Loop == AxisPlan.CaptureSlice)
+			{
+				Snapshots.Buffers[AxisIndex][AxisPlan.CaptureBufferIndex] = Passes[1].ReadBuffer;
+			}
+
+			const double SliceSeconds = FPlatformTime::Seconds() - SliceStart;
+			Stats.MaxSliceSeconds = FMath::Max(Stats.MaxSliceSeconds, SliceSeconds);
+			Stats.SlicesProcessed++;
+			Stats.VoxelsProcessed += static_cast<int64>(Size.X) * Size.Y;
+		}
+	}
+	Snapshots.Snapshots = Plan.NewSnapshots;
+
+	if (OutStats)
+	{
+		Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+		OutStats->Accumulate(Stats);
+	}
+}
+
+#undef ONE_OVER_SQRT_3
+#undef VOLUME_DENSITY
@@ -0,0 +1,95 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/LightingRenderCache.h"
+
+#include "HAL/ThreadSafeCounter.h"
+#include "RHI.h"
+#include "RenderingThread.h"
+
+DEFINE_STAT(STAT_RaymarcherLightingRHICreations);
+
+FLightingRenderCache& FLightingRenderCache::Get()
+{
+	check(IsInRenderingThread());
+	static FLightingRenderCache Cache;
+	return Cache;
+}
+
+uint32 FLightingRenderCache::AllocateResourcesId()
+{
+	static FThreadSafeCounter LastResourcesId;
+	const uint32 ResourcesId = static_cast<uint32>(LastResourcesId.Increment());
+	// Skip 0 after wrapping around.
+	return ResourcesId != 0 ? ResourcesId : static_cast<uint32>(LastResourcesId.Increment());
+}
+
+FSamplerStateRHIRef FLightingRenderCache::GetBufferSampler(uint32 ResourcesId, uint32 BorderColorInt)
+{
+	return GetSampler(
+		ResourcesId, FSamplerStateInitializerRHI(SF_Bilinear, AM_Border, AM_Border, AM_Border, 0, 0, 0, 1, BorderColorInt));
+}
+
+FSamplerStateRHIRef FLightingRenderCache::GetVolumeSampler(uint32 ResourcesId, uint32 BorderColorInt)
+{
+	return GetSampler(
+		ResourcesId, FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
+}
+
+FLightAxisConstants FLightingRenderCache::GetAxisConstants(uint32 ResourcesId, const FDirLightParameters& LocalLightParams,
+	const FMajorAxes& LocalMajorAxes, const unsigned AxisIndex, const FIntVector& TransposedDimensions)
+{
+	check(IsInRenderingThread());
+	if (ResourcesId == 0)
+	{
+		return GetLightAxisConstants(LocalLightParams, LocalMajorAxes, AxisIndex, TransposedDimensions);
+	}
+
+	// The major axes follow from the light direction, so they don't need to be a part of the key.
+	const FAxisConstantsKey Key{LocalLightParams.LightDirection, TransposedDimensions, AxisIndex};
+	TMap<FAxisConstantsKey, FLightAxisConstants>& AxisConstants = Entries.FindOrAdd(ResourcesId).AxisConstants;
+	if (const FLightAxisConstants* Constants = AxisConstants.Find(Key))
+	{
+		return *Constants;
+	}
+	if (AxisConstants.Num() >= MaxEntriesPerCache)
+	{
+		AxisConstants.Reset();
+	}
+	return AxisConstants.Add(Key, GetLightAxisConstants(LocalLightParams, LocalMajorAxes, AxisIndex, TransposedDimensions));
+}
+
+void FLightingRenderCache::Invalidate(uint32 ResourcesId)
+{
+	check(IsInRenderingThread());
+	Entries.Remove(ResourcesId);
+}
+
+FSamplerStateRHIRef FLightingRenderCache::GetSampler(uint32 ResourcesId, const FSamplerStateInitializerRHI& Initializer)
+{
+	check(IsInRenderingThread());
+	TMap<FSamplerStateInitializerRHI, FSamplerStateRHIRef>* Samplers =
+		ResourcesId != 0 ? &Entries.FindOrAdd(ResourcesId).Samplers : nullptr;
+	if (Samplers)
+	{
+		if (const FSamplerStateRHIRef* Sampler = Samplers->Find(Initializer))
+		{
+			return *Sampler;
+		}
+		if (Samplers->Num() >= MaxEntriesPerCache)
+		{
+			Samplers->Reset();
+		}
+	}
+
+	FSamplerStateRHIRef Sampler = RHICreateSamplerState(Initializer);
+	INC_DWORD_STAT(STAT_RaymarcherLightingRHICreations);
+	NumCreatedSamplers++;
+	if (Samplers)
+	{
+		Samplers->Add(Initializer, Sampler);
+	}
+	return Sampler;
+}
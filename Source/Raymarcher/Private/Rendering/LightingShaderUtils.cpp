@@ -1,5 +1,7 @@
 #include "Rendering/LightingShaderUtils.h"
 
+#include "Rendering/LightingRenderCache.h"
+
 FString GetDirectionName(FCubeFace Face)
 {
 	switch (Face)
@@ -46,17 +48,23 @@ FMajorAxes FMajorAxes::GetMajorAxes(FVector LightPos)
 }
 
 FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FRHITexture3D* VolumeRef, const unsigned index)
+{
+	return GetTransposedDimensions(
+		Axes, FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeY(), VolumeRef->GetSizeZ()), index);
+}
+
+FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FIntVector& VolumeDimensions, const unsigned index)
 {
 	FCubeFace face = Axes.FaceWeight[index].first;
 	unsigned axis = (uint8) face / 2;
 	switch (axis)
 	{
 		case 0:	   // going along X -> Volume Y = x, volume Z = y
-			return FIntVector(VolumeRef->GetSizeY(), VolumeRef->GetSizeZ(), VolumeRef->GetSizeX());
+			return FIntVector(VolumeDimensions.Y, VolumeDimensions.Z, VolumeDimensions.X);
 		case 1:	   // going along Y -> Volume X = x, volume Z = y
-			return FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeZ(), VolumeRef->GetSizeY());
+			return FIntVector(VolumeDimensions.X, VolumeDimensions.Z, VolumeDimensions.Y);
 		case 2:	   // going along Z -> Volume X = x, volume Y = y
-			return FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeY(), VolumeRef->GetSizeZ());
+			return FIntVector(VolumeDimensions.X, VolumeDimensions.Y, VolumeDimensions.Z);
 		default:
 			check(false);
 			return FIntVector(0, 0, 0);
@@ -77,6 +85,14 @@ OneAxisReadWriteBufferResources& GetBuffers(
 	return InParams.XYZReadWriteBuffers[FaceAxis];
 }
 
+OneAxisReadWriteBufferResources& GetBatchBuffers(
+	const FMajorAxes& Axes, const unsigned index, FBasicRaymarchRenderingResources& InParams)
+{
+	FCubeFace Face = Axes.FaceWeight[index].first;
+	unsigned FaceAxis = (uint8) Face / 2;
+	return InParams.XYZBatchReadWriteBuffers[FaceAxis];
+}
+
 
 ///  Returns the UV offset to the previous layer. This is the position in the previous layer that is in the direction of the light.
 FVector2D GetUVOffset(FCubeFace Axis, FVector LightPosition, FIntVector TransposedDimensions)
@@ -190,6 +206,7 @@ void GetLocalLightParamsAndAxes(const FDirLightParameters& LightParameters, cons
 FSamplerStateRHIRef GetBufferSamplerRef(uint32 BorderColorInt)
 {
 	// Return a sampler for RW buffers - bordered by specified color.
+	INC_DWORD_STAT(STAT_RaymarcherLightingRHICreations);
 	return RHICreateSamplerState(
 		FSamplerStateInitializerRHI(SF_Bilinear, AM_Border, AM_Border, AM_Border, 0, 0, 0, 1, BorderColorInt));
 }
@@ -202,6 +219,11 @@ uint32 GetBorderColorIntSingle(FDirLightParameters LightParams, FMajorAxes Major
 	return LightColor.ToFColor(true).ToPackedARGB();
 }
 
+uint32 GetBorderColorIntBatched(const FLinearColor& LightAlphas)
+{
+	return LightAlphas.ToFColor(true).ToPackedARGB();
+}
+
 FClippingPlaneParameters GetLocalClippingParameters(const FRaymarchWorldParameters WorldParameters)
 {
 	FClippingPlaneParameters RetVal;
@@ -219,6 +241,78 @@ FClippingPlaneParameters GetLocalClippingParameters(const FRaymarchWorldParamete
 	return RetVal;
 }
 
+// Tolerance for comparing local directions, rotations and scale ratios when classifying world parameter changes.
+static constexpr double WorldParametersChangeTolerance = 1e-4;
+
+// True if the local clipping plane doesn't clip away any corner of the (0-1) unit cube.
+static bool ClipsNothing(const FClippingPlaneParameters& LocalClippingParameters)
+{
+	for (int32 Corner = 0; Corner < 8; Corner++)
+	{
+		const FVector Position(Corner & 1, (Corner >> 1) & 1, (Corner >> 2) & 1);
+		if (FVector::DotProduct(Position - LocalClippingParameters.Center, LocalClippingParameters.Direction) <= 0.0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// True if both clipping planes clip the same voxels of the light volume.
+static bool HaveSameLocalClipping(const FClippingPlaneParameters& OldClipping, const FClippingPlaneParameters& NewClipping)
+{
+	// Moving the plane within itself or anywhere outside of the volume doesn't change which voxels get clipped.
+	const bool bSamePlane = OldClipping.Direction.Equals(NewClipping.Direction, WorldParametersChangeTolerance) &&
+							FMath::IsNearlyEqual(FVector::DotProduct(OldClipping.Center, OldClipping.Direction),
+								FVector::DotProduct(NewClipping.Center, NewClipping.Direction), WorldParametersChangeTolerance);
+	return bSamePlane || (ClipsNothing(OldClipping) && ClipsNothing(NewClipping));
+}
+
+// True if all light directions are the same in local space of both transforms.
+static bool HaveSameLocalLightDirections(const FTransform& OldTransform, const FTransform& NewTransform)
+{
+	// Local light directions are the normalized inverse-transformed world directions. They stay the same if the rotation does and
+	// the scale only changes by a positive uniform factor.
+	if (!OldTransform.GetRotation().Equals(NewTransform.GetRotation(), WorldParametersChangeTolerance))
+	{
+		return false;
+	}
+
+	const FVector OldScale = OldTransform.GetScale3D();
+	const FVector NewScale = NewTransform.GetScale3D();
+	if (OldScale.GetAbsMin() < UE_SMALL_NUMBER)
+	{
+		return OldScale.Equals(NewScale);
+	}
+	const FVector ScaleRatio = NewScale / OldScale;
+	return ScaleRatio.GetMin() > 0.0 &&
+		   ScaleRatio.GetMax() - ScaleRatio.GetMin() <= WorldParametersChangeTolerance * ScaleRatio.GetMax();
+}
+
+ELightVolumeInvalidation ClassifyWorldParametersChange(
+	const FRaymarchWorldParameters& OldWorldParameters, const FRaymarchWorldParameters& NewWorldParameters)
+{
+	const bool bSameClipping =
+		HaveSameLocalClipping(GetLocalClippingParameters(OldWorldParameters), GetLocalClippingParameters(NewWorldParameters));
+	const bool bSameLightDirections =
+		HaveSameLocalLightDirections(OldWorldParameters.VolumeTransform, NewWorldParameters.VolumeTransform);
+
+	if (bSameClipping)
+	{
+		return bSameLightDirections ? ELightVolumeInvalidation::None : ELightVolumeInvalidation::LightDirections;
+	}
+	return bSameLightDirections ? ELightVolumeInvalidation::Clipping : ELightVolumeInvalidation::Full;
+}
+
+FDirLightParameters GetLightParametersForTransform(
+	const FDirLightParameters& LightParameters, const FTransform& OldTransform, const FTransform& NewTransform)
+{
+	FDirLightParameters RetVal = LightParameters;
+	RetVal.LightDirection = NewTransform.TransformVector(OldTransform.InverseTransformVector(LightParameters.LightDirection));
+	RetVal.LightDirection.Normalize();
+	return RetVal;
+}
+
 float GetLightAlpha(FDirLightParameters LightParams, FMajorAxes MajorAxes, unsigned index)
 {
 	return LightParams.LightIntensity * MajorAxes.FaceWeight[index].second;
@@ -264,12 +358,362 @@ void GetLoopStartStopIndexes(
 	}
 }
 
-void TransitionBufferResources(
-	FRHICommandListImmediate& RHICmdList, FRHITexture* NewlyReadableTexture, FRHIUnorderedAccessView* NewlyWriteableUAV)
+FLightAxisConstants GetLightAxisConstants(const FDirLightParameters& LocalLightParams, const FMajorAxes& LocalMajorAxes,
+	const unsigned index, const FIntVector& TransposedDimensions)
+{
+	const FCubeFace Face = LocalMajorAxes.FaceWeight[index].first;
+	FVector UVWOffset;
+	float StepSize;
+	// The step is measured in the local space the light direction already is in, the world parameters don't change it. That's
+	// what lets FLightingRenderCache keep the constants while the volume moves.
+	GetStepSizeAndUVWOffset(
+		Face, -LocalLightParams.LightDirection, TransposedDimensions, FRaymarchWorldParameters(), StepSize, UVWOffset);
+
+	// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct,
+	// but consistent!)
+	const int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
+	UVWOffset.Normalize();
+	UVWOffset *= 1.0f / LowestVoxelCount;
+
+	FLightAxisConstants Constants;
+	Constants.PermutationMatrix = FMatrix44f(GetPermutationMatrix(LocalMajorAxes, index));
+	Constants.PrevPixelOffset = FVector2f(GetUVOffset(Face, -LocalLightParams.LightDirection, TransposedDimensions));
+	Constants.UVWOffset = FVector3f(UVWOffset);
+	Constants.StepSize = StepSize;
+	return Constants;
+}
+
+bool CanPropagateInSingleDispatch(const FIntVector& TransposedDimensions)
+{
+	return static_cast<int64>(TransposedDimensions.X) * TransposedDimensions.Y <= GPUSyncMaxSlicePixels;
+}
+
+EPixelFormat GetLightVolumePixelFormat(ELightVolumeFormat Format)
+{
+	switch (Format)
+	{
+		case ELightVolumeFormat::R16F:
+			return PF_R16F;
+		case ELightVolumeFormat::R32F:
+			return PF_R32_FLOAT;
+		default:
+			return PF_G8;
+	}
+}
+
+EPixelFormat GetBatchedLightBufferPixelFormat(ELightVolumeFormat Format)
 {
-	// 	RHICmdList.Transition(FRHITransitionInfo(NewlyReadableTexture, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
-	//
-	// 	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, NewlyReadableTexture);
-	// 	RHICmdList.TransitionResource(
-	// 		EResourceTransitionAccess::EWritable, EResourceTransitionPipeline::EComputeToCompute, NewlyWriteableUAV);
+	switch (Format)
+	{
+		case ELightVolumeFormat::R16F:
+			return PF_FloatRGBA;
+		case ELightVolumeFormat::R32F:
+			return PF_A32B32G32R32F;
+		default:
+			return PF_R8G8B8A8;
+	}
+}
+
+TArray<TArray<int32>> GroupLightsIntoBatches(TArrayView<const FDirLightParameters> Lights, const FTransform& VolumeTransform)
+{
+	TArray<TArray<int32>> Batches;
+	TArray<TPair<FCubeFace, FCubeFace>> BatchFaces;
+	for (int32 LightIndex = 0; LightIndex < Lights.Num(); LightIndex++)
+	{
+		if (Lights[LightIndex].LightDirection.IsZero())
+		{
+			continue;
+		}
+		FDirLightParameters LocalLightParams;
+		FMajorAxes LocalMajorAxes;
+		GetLocalLightParamsAndAxes(Lights[LightIndex], VolumeTransform, LocalLightParams, LocalMajorAxes);
+		const TPair<FCubeFace, FCubeFace> Faces(LocalMajorAxes.FaceWeight[0].first, LocalMajorAxes.FaceWeight[1].first);
+
+		int32 BatchIndex = INDEX_NONE;
+		for (int32 i = 0; i < Batches.Num(); i++)
+		{
+			if (BatchFaces[i] == Faces && Batches[i].Num() < MaxBatchedLights)
+			{
+				BatchIndex = i;
+				break;
+			}
+		}
+		if (BatchIndex == INDEX_NONE)
+		{
+			BatchIndex = Batches.AddDefaulted();
+			BatchFaces.Add(Faces);
+		}
+		Batches[BatchIndex].Add(LightIndex);
+	}
+	return Batches;
+}
+
+void FLightPropagationRange::ClipLoop(int& InOutStart, int& InOutStop, const int AxisDirection) const
+{
+	if (IsFull())
+	{
+		return;
+	}
+	const int32 TotalSteps = (InOutStop - InOutStart) * AxisDirection;
+	const int32 RangeSteps = FMath::Clamp(TotalSteps - FirstStep, 0, NumSteps);
+	InOutStart += FMath::Min(FirstStep, TotalSteps) * AxisDirection;
+	InOutStop = InOutStart + RangeSteps * AxisDirection;
+}
+
+int64 FClippingChangePlan::GetCost() const
+{
+	int64 Cost = 0;
+	for (int32 i = 0; i < AxisCount; i++)
+	{
+		const FClippingChangeAxisPlan& Axis = Axes[i];
+		Cost += static_cast<int64>(Axis.GetCleanSliceCount() + Axis.GetDirtySliceCount()) * Axis.SliceVoxels;
+	}
+	return Cost;
+}
+
+int64 FClippingChangePlan::GetFullCost() const
+{
+	int64 Cost = 0;
+	for (int32 i = 0; i < AxisCount; i++)
+	{
+		const FClippingChangeAxisPlan& Axis = Axes[i];
+		Cost += static_cast<int64>((Axis.Stop - Axis.Start) * Axis.AxisDirection) * Axis.SliceVoxels;
+	}
+	return Cost;
+}
+
+namespace
+{
+/// How the clipping plane affects the samples of one slice.
+enum class ESliceClipping : uint8
+{
+	/// All samples have a clipping weight of 1.
+	Unclipped,
+	/// All samples have a clipping weight of 0.
+	Clipped,
+	/// Anything in between.
+	Partial
+};
+
+/// The slices a light propagates through along one major axis.
+struct FSliceGeometry
+{
+	FCubeFace Face;
+	uint8 Axis;
+	FIntVector TransposedDimensions;
+	FIntVector LightVolumeDimensions;
+	FVector UVWOffset;
+	int Start, Stop, AxisDirection;
+
+	/// Loop index of the slice propagated Position-th.
+	int32 GetLoopIndex(int32 Position) const
+	{
+		return Start + Position * AxisDirection;
+	}
+
+	int32 GetPosition(int32 LoopIndex) const
+	{
+		return (LoopIndex - Start) * AxisDirection;
+	}
+
+	/// Equivalent of mul(int3(PixelLoc.x, PixelLoc.y, Loop), PermutationMatrix) in the shaders.
+	FIntVector GetVolumePosition(int32 X, int32 Y, int32 LoopIndex) const
+	{
+		switch (Axis)
+		{
+			case 0:
+				return FIntVector(LoopIndex, X, Y);
+			case 1:
+				return FIntVector(X, LoopIndex, Y);
+			default:
+				return FIntVector(X, Y, LoopIndex);
+		}
+	}
+};
+
+/// Fills the slice geometry of every major axis the light propagates along (same as the propagation shaders set up) and returns
+/// the number of axes.
+int32 GetSliceGeometries(const FDirLightParameters& LightParameters, const FRaymarchWorldParameters& WorldParameters,
+	const FIntVector& LightVolumeDimensions, FSliceGeometry OutGeometries[2])
+{
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
+	{
+		return 0;
+	}
+
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+
+	int32 AxisCount = 0;
+	for (unsigned i = 0; i < 2; i++)
+	{
+		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		{
+			break;
+		}
+		FSliceGeometry& Geometry = OutGeometries[AxisCount++];
+		Geometry.Face = LocalMajorAxes.FaceWeight[i].first;
+		Geometry.Axis = (uint8) Geometry.Face / 2;
+		Geometry.TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, LightVolumeDimensions, i);
+		Geometry.LightVolumeDimensions = LightVolumeDimensions;
+
+		float StepSize;
+		GetStepSizeAndUVWOffset(Geometry.Face, -LocalLightParams.LightDirection, Geometry.TransposedDimensions, WorldParameters,
+			StepSize, Geometry.UVWOffset);
+		const FIntVector& Dims = Geometry.TransposedDimensions;
+		Geometry.UVWOffset.Normalize();
+		Geometry.UVWOffset *= 1.0f / FMath::Min3(Dims.X, Dims.Y, Dims.Z);
+
+		GetLoopStartStopIndexes(Geometry.Start, Geometry.Stop, Geometry.AxisDirection, LocalMajorAxes, i, Dims.Z);
+	}
+	return AxisCount;
+}
+
+ESliceClipping ClassifySlice(const FSliceGeometry& Geometry, const FClippingPlaneParameters& Clipping, int32 LoopIndex)
+{
+	// The shaders weight samples by clamp(0.5 + Distance * |Direction * Resolution| / sqrt(3)), so samples at least this many
+	// voxels in front of (behind) the plane have a weight of 1 (0). Padded for float precision.
+	static constexpr double FullWeightVoxelDistance = 0.5 * UE_DOUBLE_SQRT_3 + 0.01;
+	const FVector Resolution(Geometry.LightVolumeDimensions);
+	const double VoxelScale = (Clipping.Direction * Resolution).Size();
+
+	// The distance is linear in the sample position, so its extremes over the slice are at the corners.
+	double MinDistance = MAX_dbl;
+	double MaxDistance = -MAX_dbl;
+	for (int32 Corner = 0; Corner < 4; Corner++)
+	{
+		const int32 X = (Corner & 1) ? Geometry.TransposedDimensions.X - 1 : 0;
+		const int32 Y = (Corner & 2) ? Geometry.TransposedDimensions.Y - 1 : 0;
+		const FVector SampleUVW = (FVector(Geometry.GetVolumePosition(X, Y, LoopIndex)) + 0.5) / Resolution + Geometry.UVWOffset;
+		const double Distance = FVector::DotProduct(SampleUVW - Clipping.Center, Clipping.Direction) * VoxelScale;
+		MinDistance = FMath::Min(MinDistance, Distance);
+		MaxDistance = FMath::Max(MaxDistance, Distance);
+	}
+
+	if (MinDistance >= FullWeightVoxelDistance)
+	{
+		return ESliceClipping::Unclipped;
+	}
+	if (MaxDistance <= -FullWeightVoxelDistance)
+	{
+		return ESliceClipping::Clipped;
+	}
+	return ESliceClipping::Partial;
+}
+
+/// Returns the position of the first slice the clipping plane touches - the first one that's partially clipped or clipped
+/// differently than the first one. The number of slices if there's none.
+int32 GetFirstTouchedPosition(const FSliceGeometry& Geometry, const FClippingPlaneParameters& Clipping)
+{
+	const ESliceClipping FirstClipping = ClassifySlice(Geometry, Clipping, Geometry.Start);
+	for (int32 Position = 0; Position < Geometry.TransposedDimensions.Z; Position++)
+	{
+		const ESliceClipping SliceClipping = ClassifySlice(Geometry, Clipping, Geometry.GetLoopIndex(Position));
+		if (SliceClipping == ESliceClipping::Partial || SliceClipping != FirstClipping)
+		{
+			return Position;
+		}
+	}
+	return Geometry.TransposedDimensions.Z;
+}
+
+/// Returns the position of the first slice whose samples might get a different clipping weight from the old and new plane.
+/// The number of slices if there's none.
+int32 GetFirstDirtyPosition(
+	const FSliceGeometry& Geometry, const FClippingPlaneParameters& OldClipping, const FClippingPlaneParameters& NewClipping)
+{
+	for (int32 Position = 0; Position < Geometry.TransposedDimensions.Z; Position++)
+	{
+		const int32 LoopIndex = Geometry.GetLoopIndex(Position);
+		const ESliceClipping OldSliceClipping = ClassifySlice(Geometry, OldClipping, LoopIndex);
+		if (OldSliceClipping == ESliceClipping::Partial || OldSliceClipping != ClassifySlice(Geometry, NewClipping, LoopIndex))
+		{
+			return Position;
+		}
+	}
+	return Geometry.TransposedDimensions.Z;
+}
+
+/// Position of the slice to capture a snapshot at, so that propagation can resume before the slice the plane touches first.
+int32 GetCapturePosition(const FSliceGeometry& Geometry, const FClippingPlaneParameters& Clipping)
+{
+	return GetFirstTouchedPosition(Geometry, Clipping) - LightSnapshotMarginSlices - 1;
+}
+}	 // namespace
+
+FLightPropagationSnapshots PlanSnapshotCapture(const FDirLightParameters& LightParameters,
+	const FRaymarchWorldParameters& WorldParameters, const FIntVector& LightVolumeDimensions)
+{
+	FLightPropagationSnapshots Snapshots;
+	FSliceGeometry Geometries[2];
+	const int32 AxisCount = GetSliceGeometries(LightParameters, WorldParameters, LightVolumeDimensions, Geometries);
+	const FClippingPlaneParameters Clipping = GetLocalClippingParameters(WorldParameters);
+
+	for (int32 i = 0; i < AxisCount; i++)
+	{
+		Snapshots.Axes[i].Face = Geometries[i].Face;
+		const int32 CapturePosition = GetCapturePosition(Geometries[i], Clipping);
+		if (CapturePosition >= 0)
+		{
+			Snapshots.Axes[i].Slice = Geometries[i].GetLoopIndex(CapturePosition);
+		}
+	}
+	return Snapshots;
+}
+
+FClippingChangePlan PlanClippingChange(const FDirLightParameters& LightParameters,
+	const FRaymarchWorldParameters& OldWorldParameters, const FRaymarchWorldParameters& NewWorldParameters,
+	const FIntVector& LightVolumeDimensions, const FLightPropagationSnapshots& Snapshots)
+{
+	FClippingChangePlan Plan;
+	FSliceGeometry Geometries[2];
+	Plan.AxisCount = GetSliceGeometries(LightParameters, NewWorldParameters, LightVolumeDimensions, Geometries);
+
+	const FClippingPlaneParameters OldClipping = GetLocalClippingParameters(OldWorldParameters);
+	const FClippingPlaneParameters NewClipping = GetLocalClippingParameters(NewWorldParameters);
+	const bool bSameClipping = HaveSameLocalClipping(OldClipping, NewClipping);
+
+	for (int32 i = 0; i < Plan.AxisCount; i++)
+	{
+		const FSliceGeometry& Geometry = Geometries[i];
+		FClippingChangeAxisPlan& AxisPlan = Plan.Axes[i];
+		AxisPlan.Start = Geometry.Start;
+		AxisPlan.Stop = Geometry.Stop;
+		AxisPlan.AxisDirection = Geometry.AxisDirection;
+		AxisPlan.SliceVoxels = static_cast<int64>(Geometry.TransposedDimensions.X) * Geometry.TransposedDimensions.Y;
+
+		const int32 FirstDirtyPosition =
+			bSameClipping ? Geometry.TransposedDimensions.Z : GetFirstDirtyPosition(Geometry, OldClipping, NewClipping);
+		AxisPlan.FirstDirtySlice = Geometry.GetLoopIndex(FirstDirtyPosition);
+
+		// A snapshot taken before the first dirty slice holds the same light with both planes.
+		const FLightPropagationSnapshot& OldSnapshot = Snapshots.Axes[i];
+		const bool bUseSnapshot = OldSnapshot.IsValid() && OldSnapshot.Face == Geometry.Face &&
+								  Geometry.GetPosition(OldSnapshot.Slice) < FirstDirtyPosition;
+		FLightPropagationSnapshot& NewSnapshot = Plan.NewSnapshots.Axes[i];
+		NewSnapshot = bUseSnapshot ? OldSnapshot : FLightPropagationSnapshot();
+		NewSnapshot.Face = Geometry.Face;
+
+		if (!AxisPlan.IsDirty())
+		{
+			AxisPlan.ResumeSlice = AxisPlan.Stop;
+			continue;
+		}
+
+		const int32 ResumePosition = bUseSnapshot ? Geometry.GetPosition(OldSnapshot.Slice) + 1 : 0;
+		AxisPlan.ResumeSlice = Geometry.GetLoopIndex(ResumePosition);
+		AxisPlan.ResumeBufferIndex = OldSnapshot.BufferIndex;
+
+		// Capture into the other buffer, the old snapshot is being read from.
+		const int32 CapturePosition = GetCapturePosition(Geometry, NewClipping);
+		if (CapturePosition >= ResumePosition)
+		{
+			AxisPlan.CaptureSlice = Geometry.GetLoopIndex(CapturePosition);
+			AxisPlan.CaptureBufferIndex = 1 - OldSnapshot.BufferIndex;
+			NewSnapshot.Slice = AxisPlan.CaptureSlice;
+			NewSnapshot.BufferIndex = AxisPlan.CaptureBufferIndex;
+		}
+	}
+	return Plan;
 }
@@ -7,7 +7,10 @@
 
 #include "DataDrivenShaderPlatformInfo.h"
 #include "Engine/TextureRenderTargetVolume.h"
+#include "RenderGraphUtils.h"
+#include "Rendering/LightingRenderCache.h"
 #include "Rendering/LightingShaderUtils.h"
+#include "Rendering/RaymarchAsyncCompute.h"
 #include "Runtime/RenderCore/Public/RenderUtils.h"
 #include "Util/UtilityShaders.h"
 
@@ -19,8 +22,17 @@
 
 IMPLEMENT_GLOBAL_SHADER(FAddDirLightShader, "/Raymarcher/Private/AddDirLightShader.usf", "MainComputeShader", SF_Compute);
 
+IMPLEMENT_GLOBAL_SHADER(
+	FChangeClippingShader, "/Raymarcher/Private/AddDirLightShader.usf", "ChangeClippingComputeShader", SF_Compute);
+
+IMPLEMENT_GLOBAL_SHADER(
+	FAddDirLightsBatchedShader, "/Raymarcher/Private/AddDirLightShader.usf", "BatchedComputeShader", SF_Compute);
+
 IMPLEMENT_GLOBAL_SHADER(FChangeDirLightShader, "/Raymarcher/Private/ChangeDirLightShader.usf", "MainComputeShader", SF_Compute);
 
+IMPLEMENT_GLOBAL_SHADER(
+	FUpsampleLightVolumeShader, "/Raymarcher/Private/UpsampleLightVolumeShader.usf", "MainComputeShader", SF_Compute);
+
 // For making statistics about GPU use - Adding Lights.
 DECLARE_FLOAT_COUNTER_STAT(TEXT("AddingLights"), STAT_GPU_AddingLights, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUAddingLights, TEXT("AddingLightsToVolume"));
@@ -29,11 +41,73 @@ DECLARE_GPU_STAT_NAMED(GPUAddingLights, TEXT("AddingLightsToVolume"));
 DECLARE_FLOAT_COUNTER_STAT(TEXT("ChangingLights"), STAT_GPU_ChangingLights, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUChangingLights, TEXT("ChangingLightsInVolume"));
 
+// For making statistics about GPU use - Upsampling coarse light volumes.
+DECLARE_GPU_STAT_NAMED(GPUUpsamplingLightVolumes, TEXT("UpsamplingLightVolumes"));
+
 // #TODO profile with different dimensions.
 #define NUM_THREADS_PER_GROUP_DIMENSION 16	  // This has to be the same as in the compute shader's spec [X, X, 1]
 
-void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
-	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters)
+#define UPSAMPLE_GROUP_SIZE 4	 // This has to be the same as in UpsampleLightVolumeShader.usf
+
+// Registers a read-write or snapshot buffer with the graph, which then takes care of transitioning it between being read, written
+// and copied.
+static FRDGTextureRef RegisterBuffer(FRDGBuilder& GraphBuilder, FRHITexture* Texture)
+{
+	return RegisterExternalTexture(GraphBuilder, Texture, TEXT("Illumination Buffer"));
+}
+
+// Pass parameters only hold raw sampler pointers, so the sampler has to live until the graph is executed.
+static FRHISamplerState* AllocSampler(FRDGBuilder& GraphBuilder, FSamplerStateRHIRef Sampler)
+{
+	return GraphBuilder.AllocObject<FSamplerStateRHIRef>(MoveTemp(Sampler))->GetReference();
+}
+
+FLightPropagationVolumeParameters GetLightPropagationVolumeParameters(FRDGBuilder& GraphBuilder,
+	const FBasicRaymarchRenderingResources& Resources, const FClippingPlaneParameters& LocalClippingParameters)
+{
+	// Set the zero color to fit the zero point of the windowing parameters (Center - Width/2)
+	// so that after sampling out of bounds, it gets changed to 0 on the Transfer Function in
+	// GetTransferFuncPosition() hlsl function.
+	const float ZeroTFValue = Resources.WindowingParameters.Center - 0.5 * Resources.WindowingParameters.Width;
+	const uint32 BorderColorInt = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0).ToFColor(false).ToPackedARGB();
+
+	FLightPropagationVolumeParameters Parameters;
+	Parameters.Volume = Resources.DataVolumeTextureRef->GetResource()->TextureRHI;
+	Parameters.VolumeSampler =
+		AllocSampler(GraphBuilder, FLightingRenderCache::Get().GetVolumeSampler(Resources.RenderCacheId, BorderColorInt));
+	Parameters.TransferFunc = Resources.TFTextureRef->GetResource()->TextureRHI;
+	Parameters.TransferFuncSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	Parameters.LocalClippingCenter = FVector3f(LocalClippingParameters.Center);
+	Parameters.LocalClippingDirection = FVector3f(LocalClippingParameters.Direction);
+	Parameters.WindowingParameters = FVector4f(Resources.WindowingParameters.ToLinearColor());
+	Parameters.ALightVolume = GraphBuilder.CreateUAV(
+		RegisterExternalTexture(GraphBuilder, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI, TEXT("Light Volume")));
+	return Parameters;
+}
+
+// Read-write buffers of one axis, registered with the graph. Only the buffers that exist get registered.
+struct FRDGAxisBuffers
+{
+	FRDGTextureRef Textures[4] = {};
+	FRDGTextureUAVRef UAVs[4] = {};
+
+	FRDGAxisBuffers(FRDGBuilder& GraphBuilder, const OneAxisReadWriteBufferResources& Buffers)
+	{
+		for (int32 i = 0; i < 4; i++)
+		{
+			if (Buffers.Buffers[i])
+			{
+				Textures[i] = RegisterBuffer(GraphBuilder, Buffers.Buffers[i]);
+				UAVs[i] = GraphBuilder.CreateUAV(Textures[i]);
+			}
+		}
+	}
+};
+
+void AddDirLightToSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationSnapshots* CaptureSnapshots /*= nullptr*/, FLightSnapshotBuffers* SnapshotBuffers /*= nullptr*/,
+	const FLightPropagationRange& Range /*= FLightPropagationRange()*/)
 {
 	check(IsInRenderingThread());
 
@@ -50,15 +124,21 @@ void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICm
 	// Calculate local Light parameters and corresponding axes.
 	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
 
-	// Transform clipping parameters into local space.
-	FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
-
 	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, AddDirLightToSingleLightVolume_RenderThread, TEXT("Adding Lights"));
-	SCOPED_GPU_STAT(RHICmdList, GPUAddingLights);
+	RDG_EVENT_SCOPE(GraphBuilder, "Adding Lights");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUAddingLights);
+
+	TShaderMapRef<FAddDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FRHITexture3D* LightVolumeTexture = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D();
+	FLightingRenderCache& Cache = FLightingRenderCache::Get();
+
+	// Everything but the loop index and the read/write buffers is the same for every slice of an axis.
+	FAddDirLightShader::FParameters AxisParameters;
+	// Transform clipping parameters into local space.
+	AxisParameters.VolumeParameters =
+		GetLightPropagationVolumeParameters(GraphBuilder, Resources, GetLocalClippingParameters(WorldParameters));
+	AxisParameters.bAdded = Added ? 1 : -1;
 
-	// TODO create structure with 2 sets of buffers so we don't have to look for them again in the
-	// actual shader loop! Clear buffers for the two axes we will be using.
 	for (unsigned i = 0; i < 2; i++)
 	{
 		// Break if the axis weight == 0
@@ -66,109 +146,329 @@ void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICm
 		{
 			break;
 		}
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
+		if (!Range.ContainsAxis(i))
+		{
+			continue;
+		}
 		OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, i, Resources);
+		const FRDGAxisBuffers AxisBuffers(GraphBuilder, Buffers);
+
+		// A range continuing the propagation along the axis keeps what the previous one left in the buffers.
+		if (Range.StartsAxis(i))
+		{
+			const float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, i);
+			AddClear2DTexturePass(GraphBuilder, AxisBuffers.UAVs[0], LightAlpha, GetRaymarchComputePassFlags());
+			AddClear2DTexturePass(GraphBuilder, AxisBuffers.UAVs[1], LightAlpha, GetRaymarchComputePassFlags());
+		}
+
+		// Get the X, Y and Z transposed into the current axis orientation.
+		FIntVector TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, LightVolumeTexture, i);
+
+		const FLightAxisConstants Constants =
+			Cache.GetAxisConstants(Resources.RenderCacheId, LocalLightParams, LocalMajorAxes, i, TransposedDimensions);
+		AxisParameters.VolumeParameters.PermutationMatrix = Constants.PermutationMatrix;
+		AxisParameters.StepSize = Constants.StepSize;
+		AxisParameters.PrevPixelOffset = Constants.PrevPixelOffset;
+		AxisParameters.UVWOffset = Constants.UVWOffset;
+		AxisParameters.ReadBufferSampler = AllocSampler(GraphBuilder,
+			Cache.GetBufferSampler(Resources.RenderCacheId, GetBorderColorIntSingle(LocalLightParams, LocalMajorAxes, i)));
+
+		const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
+			FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), NUM_THREADS_PER_GROUP_DIMENSION);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, TransposedDimensions.Z);
+		Range.ClipLoop(Start, Stop, AxisDirection);
 
-		float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, i);
+		const int CaptureSlice = (CaptureSnapshots && SnapshotBuffers) ? CaptureSnapshots->Axes[i].Slice : INDEX_NONE;
+		if (CaptureSlice != INDEX_NONE && Range.StartsAxis(i))
+		{
+			SnapshotBuffers->PrepareAxis(i, Buffers.Buffers[0]);
+		}
 
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[0], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), LightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[1], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), LightAlpha);
+		for (int j = Start; j != Stop; j += AxisDirection)
+		{
+			// Switch read and write buffers each row.
+			const int32 ReadIndex = j % 2;
+			FAddDirLightShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FAddDirLightShader::FParameters>();
+			*PassParameters = AxisParameters;
+			PassParameters->Loop = j;
+			PassParameters->ReadBuffer = AxisBuffers.Textures[ReadIndex];
+			PassParameters->WriteBuffer = AxisBuffers.UAVs[1 - ReadIndex];
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("AddDirLight Slice %d", j), GetRaymarchComputePassFlags(),
+				ComputeShader, PassParameters, GroupCount);
+
+			if (j == CaptureSlice)
+			{
+				AddCopyTexturePass(GraphBuilder, AxisBuffers.Textures[1 - ReadIndex],
+					RegisterBuffer(GraphBuilder, SnapshotBuffers->Buffers[i][CaptureSnapshots->Axes[i].BufferIndex]));
+			}
+		}
 	}
+}
 
-	// Find and set compute shader
-	TShaderMapRef<FAddDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
+void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationSnapshots* CaptureSnapshots /*= nullptr*/, FLightSnapshotBuffers* SnapshotBuffers /*= nullptr*/,
+	const FLightPropagationRange& Range /*= FLightPropagationRange()*/)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	AddDirLightToSingleLightVolume_RenderThread(
+		GraphBuilder, Resources, LightParameters, Added, WorldParameters, CaptureSnapshots, SnapshotBuffers, Range);
+	GraphBuilder.Execute();
+}
+
+// Propagates a batch of lights with the same major axes (see GroupLightsIntoBatches()) through the RGBA batch buffers.
+static void AddDirLightBatchToSingleLightVolume(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources& Resources,
+	const TArray<FDirLightParameters>& LightParameters, const TArray<int32>& Batch, const bool Added,
+	const FRaymarchWorldParameters& WorldParameters, const FLightPropagationRange& Range)
+{
+	const int32 NumLights = Batch.Num();
+	FDirLightParameters LocalLightParams[MaxBatchedLights];
+	FMajorAxes LocalMajorAxes[MaxBatchedLights];
+	for (int32 i = 0; i < NumLights; i++)
+	{
+		GetLocalLightParamsAndAxes(
+			LightParameters[Batch[i]], WorldParameters.VolumeTransform, LocalLightParams[i], LocalMajorAxes[i]);
+	}
+	// All lights share the faces, so the axes of the first one decide the buffers, dimensions and loop direction.
+	const FMajorAxes& BatchAxes = LocalMajorAxes[0];
+	FRHITexture3D* LightVolumeTexture = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D();
 
-	// Transition the resource to Compute-shader.
-	// Otherwise the renderer might touch our textures while we're writing to them.
-	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+	// For GPU profiling.
+	RDG_EVENT_SCOPE(GraphBuilder, "Adding Light Batch");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUAddingLights);
 
-	for (unsigned i = 0; i < 2; i++)
+	TShaderMapRef<FAddDirLightsBatchedShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FLightingRenderCache& Cache = FLightingRenderCache::Get();
+
+	FAddDirLightsBatchedShader::FParameters AxisParameters;
+	AxisParameters.VolumeParameters =
+		GetLightPropagationVolumeParameters(GraphBuilder, Resources, GetLocalClippingParameters(WorldParameters));
+	AxisParameters.bAdded = Added ? 1 : -1;
+	AxisParameters.NumBatchedLights = NumLights;
+
+	for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
 	{
-		// Break if the main axis weight == 1
-		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		FIntVector TransposedDimensions = GetTransposedDimensions(BatchAxes, LightVolumeTexture, AxisIndex);
+
+		// Per-light parameters. A light without weight along this axis propagates zero light, which never gets written.
+		FLinearColor LightAlphas(0.0, 0.0, 0.0, 0.0);
+		bool bAnyLightHasWeight = false;
+		for (int32 i = 0; i < NumLights; i++)
+		{
+			bAnyLightHasWeight |= LocalMajorAxes[i].FaceWeight[AxisIndex].second != 0;
+			LightAlphas.Component(i) = GetLightAlpha(LocalLightParams[i], LocalMajorAxes[i], AxisIndex);
+
+			const FLightAxisConstants Constants = Cache.GetAxisConstants(
+				Resources.RenderCacheId, LocalLightParams[i], LocalMajorAxes[i], AxisIndex, TransposedDimensions);
+			AxisParameters.BatchPrevPixelOffsets[i] =
+				FVector4f(Constants.PrevPixelOffset.X, Constants.PrevPixelOffset.Y, 0.0f, 0.0f);
+			AxisParameters.BatchUVWOffsets[i] = FVector4f(Constants.UVWOffset, Constants.StepSize);
+		}
+		// Break if the axis weight == 0 for all lights.
+		if (!bAnyLightHasWeight)
 		{
 			break;
 		}
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, i, Resources);
+		if (!Range.ContainsAxis(AxisIndex))
+		{
+			continue;
+		}
 
-		uint32 ColorInt = GetBorderColorIntSingle(LocalLightParams, LocalMajorAxes, i);
-		FSamplerStateRHIRef readBuffSampler = GetBufferSamplerRef(ColorInt);
+		const FRDGAxisBuffers AxisBuffers(GraphBuilder, GetBatchBuffers(BatchAxes, AxisIndex, Resources));
+		// A range continuing the propagation along the axis keeps what the previous one left in the buffers.
+		if (Range.StartsAxis(AxisIndex))
+		{
+			AddClearUAVPass(GraphBuilder, AxisBuffers.UAVs[0], LightAlphas, GetRaymarchComputePassFlags());
+			AddClearUAVPass(GraphBuilder, AxisBuffers.UAVs[1], LightAlphas, GetRaymarchComputePassFlags());
+		}
 
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
+		AxisParameters.VolumeParameters.PermutationMatrix = FMatrix44f(GetPermutationMatrix(BatchAxes, AxisIndex));
+		AxisParameters.ReadBufferSampler =
+			AllocSampler(GraphBuilder, Cache.GetBufferSampler(Resources.RenderCacheId, GetBorderColorIntBatched(LightAlphas)));
+
+		const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
+			FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), NUM_THREADS_PER_GROUP_DIMENSION);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(Start, Stop, AxisDirection, BatchAxes, AxisIndex, TransposedDimensions.Z);
+		Range.ClipLoop(Start, Stop, AxisDirection);
+
+		for (int j = Start; j != Stop; j += AxisDirection)
+		{
+			// Switch read and write buffers each row.
+			const int32 ReadIndex = j % 2;
+			FAddDirLightsBatchedShader::FParameters* PassParameters =
+				GraphBuilder.AllocParameters<FAddDirLightsBatchedShader::FParameters>();
+			*PassParameters = AxisParameters;
+			PassParameters->Loop = j;
+			PassParameters->BatchReadBuffer = AxisBuffers.Textures[ReadIndex];
+			PassParameters->BatchWriteBuffer = AxisBuffers.UAVs[1 - ReadIndex];
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("AddDirLightBatch Slice %d", j),
+				GetRaymarchComputePassFlags(), ComputeShader, PassParameters, GroupCount);
+		}
+	}
+}
 
-		FVector2D UVOffset =
-			GetUVOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions);
-		FMatrix PermutationMatrix = GetPermutationMatrix(LocalMajorAxes, i);
+void AddDirLightsToSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationRange& Range /*= FLightPropagationRange()*/)
+{
+	check(IsInRenderingThread());
 
-		FIntVector LightVolumeSize = FIntVector(Resources.LightVolumeRenderTarget->SizeX, Resources.LightVolumeRenderTarget->SizeY,
-			Resources.LightVolumeRenderTarget->SizeZ);
+	const bool bHasBatchBuffers = Resources.XYZBatchReadWriteBuffers[0].UAVs[0] && Resources.XYZBatchReadWriteBuffers[1].UAVs[0] &&
+								  Resources.XYZBatchReadWriteBuffers[2].UAVs[0];
+	const TArray<TArray<int32>> Batches = GroupLightsIntoBatches(LightParameters, WorldParameters.VolumeTransform);
+	// Lights propagated one after another would overwrite each other's buffers between ranges.
+	checkf(Range.IsFull() || (Batches.Num() <= 1 && (LightParameters.Num() <= 1 || bHasBatchBuffers)),
+		TEXT("Partial light propagation ranges need a single light or batch."));
 
-		FVector UVWOffset;
-		float StepSize;
-		GetStepSizeAndUVWOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions,
-			WorldParameters, StepSize, UVWOffset);
+	for (const TArray<int32>& Batch : Batches)
+	{
+		if (Batch.Num() > 1 && bHasBatchBuffers)
+		{
+			AddDirLightBatchToSingleLightVolume(GraphBuilder, Resources, LightParameters, Batch, Added, WorldParameters, Range);
+			continue;
+		}
+		for (const int32 LightIndex : Batch)
+		{
+			AddDirLightToSingleLightVolume_RenderThread(
+				GraphBuilder, Resources, LightParameters[LightIndex], Added, WorldParameters, nullptr, nullptr, Range);
+		}
+	}
+}
 
-		// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct,
-		// but consistent!)
-		int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
-		float LongestVoxelSide = 1.0f / LowestVoxelCount;
-		UVWOffset.Normalize();
-		UVWOffset *= LongestVoxelSide;
+void AddDirLightsToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationRange& Range /*= FLightPropagationRange()*/)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	AddDirLightsToSingleLightVolume_RenderThread(GraphBuilder, Resources, LightParameters, Added, WorldParameters, Range);
+	GraphBuilder.Execute();
+}
 
-		uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
-		uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
+void ChangeClippingInSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const FRaymarchWorldParameters OldWorldParameters,
+	const FRaymarchWorldParameters NewWorldParameters, const FClippingChangePlan& Plan, FLightSnapshotBuffers& SnapshotBuffers)
+{
+	check(IsInRenderingThread());
 
-		int Start, Stop, AxisDirection;
-		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, TransposedDimensions.Z);
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
+	{
+		return;
+	}
 
-		for (int j = Start; j != Stop; j += AxisDirection)
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, NewWorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+
+	const FClippingPlaneParameters RemovedLocalClippingParameters = GetLocalClippingParameters(OldWorldParameters);
+
+	// For GPU profiling.
+	RDG_EVENT_SCOPE(GraphBuilder, "Changing Light Clipping");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUChangingLights);
+
+	TShaderMapRef<FChangeClippingShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FRHITexture3D* LightVolumeTexture = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D();
+	FLightingRenderCache& Cache = FLightingRenderCache::Get();
+
+	FChangeClippingShader::FParameters AxisParameters;
+	FAddDirLightShader::FParameters& AddedParameters = AxisParameters.AddedLightParameters;
+	AddedParameters.VolumeParameters =
+		GetLightPropagationVolumeParameters(GraphBuilder, Resources, GetLocalClippingParameters(NewWorldParameters));
+	AxisParameters.RemovedLocalClippingCenter = FVector3f(RemovedLocalClippingParameters.Center);
+	AxisParameters.RemovedLocalClippingDirection = FVector3f(RemovedLocalClippingParameters.Direction);
+
+	for (int32 AxisIndex = 0; AxisIndex < Plan.AxisCount; AxisIndex++)
+	{
+		const FClippingChangeAxisPlan& AxisPlan = Plan.Axes[AxisIndex];
+		if (!AxisPlan.IsDirty())
 		{
-			// Set all compute shader parameters
-			// TODO find out why this has to be set for every invocation when it was fine to just SetLoop before UE 5.3
-			ComputeShader->SetRaymarchParameters(
-				RHICmdList, ShaderRHI, LocalClippingParameters, Resources.WindowingParameters.ToLinearColor());
-			ComputeShader->SetRaymarchResources(RHICmdList, ShaderRHI,
-				Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-				Resources.TFTextureRef->GetResource()->TextureRHI->GetTexture2D(), Resources.WindowingParameters);
-			ComputeShader->SetLightAdded(RHICmdList, ShaderRHI, Added);
-			ComputeShader->SetALightVolume(RHICmdList, ShaderRHI, Resources.LightVolumeUAVRef);
-			ComputeShader->SetUVOffset(RHICmdList, ShaderRHI, UVOffset);
-			ComputeShader->SetUVWOffset(RHICmdList, ShaderRHI, UVWOffset);
-			ComputeShader->SetPermutationMatrix(RHICmdList, ShaderRHI, PermutationMatrix);
-			ComputeShader->SetStepSize(RHICmdList, ShaderRHI, StepSize);
+			continue;
+		}
 
-			// Switch read and write buffers each row.
-			if (j % 2 == 0)
+		OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, AxisIndex, Resources);
+		const FRDGAxisBuffers AxisBuffers(GraphBuilder, Buffers);
+		FIntVector TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, LightVolumeTexture, AxisIndex);
+
+		// Start from the snapshot before the first dirty slice, or from the edge of the volume.
+		FRDGTextureRef ResumeBuffer = nullptr;
+		if (AxisPlan.ResumeSlice == AxisPlan.Start)
+		{
+			const float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, AxisIndex);
+			for (int32 i = 0; i < 4; i++)
 			{
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, j, Buffers.Buffers[0], readBuffSampler, Buffers.UAVs[1]);
+				AddClear2DTexturePass(GraphBuilder, AxisBuffers.UAVs[i], LightAlpha, GetRaymarchComputePassFlags());
 			}
-			else
+		}
+		else
+		{
+			ResumeBuffer = RegisterBuffer(GraphBuilder, SnapshotBuffers.Buffers[AxisIndex][AxisPlan.ResumeBufferIndex]);
+		}
+		if (AxisPlan.CaptureSlice != INDEX_NONE)
+		{
+			SnapshotBuffers.PrepareAxis(AxisIndex, Buffers.Buffers[0]);
+		}
+
+		const FLightAxisConstants Constants =
+			Cache.GetAxisConstants(Resources.RenderCacheId, LocalLightParams, LocalMajorAxes, AxisIndex, TransposedDimensions);
+		AddedParameters.VolumeParameters.PermutationMatrix = Constants.PermutationMatrix;
+		AddedParameters.StepSize = Constants.StepSize;
+		AddedParameters.PrevPixelOffset = Constants.PrevPixelOffset;
+		AddedParameters.UVWOffset = Constants.UVWOffset;
+		// Both lights use the same border color.
+		AddedParameters.ReadBufferSampler = AllocSampler(GraphBuilder,
+			Cache.GetBufferSampler(Resources.RenderCacheId, GetBorderColorIntSingle(LocalLightParams, LocalMajorAxes, AxisIndex)));
+
+		const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
+			FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), NUM_THREADS_PER_GROUP_DIMENSION);
+
+		for (int LoopIndex = AxisPlan.ResumeSlice; LoopIndex != AxisPlan.Stop; LoopIndex += AxisPlan.AxisDirection)
+		{
+			// Buffers 0/1 hold the light with the removed clipping, 2/3 with the added one. Both resume from the same snapshot.
+			const int32 ReadIndex = ((LoopIndex - AxisPlan.ResumeSlice) * AxisPlan.AxisDirection) % 2;
+			const int32 WriteIndex = 1 - ReadIndex;
+			const bool bResuming = LoopIndex == AxisPlan.ResumeSlice && ResumeBuffer;
+
+			FChangeClippingShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FChangeClippingShader::FParameters>();
+			*PassParameters = AxisParameters;
+			PassParameters->AddedLightParameters.Loop = LoopIndex;
+			PassParameters->bDirtySlice = (LoopIndex - AxisPlan.FirstDirtySlice) * AxisPlan.AxisDirection >= 0 ? 1 : 0;
+			PassParameters->RemovedReadBuffer = bResuming ? ResumeBuffer : AxisBuffers.Textures[ReadIndex];
+			PassParameters->RemovedWriteBuffer = AxisBuffers.UAVs[WriteIndex];
+			PassParameters->AddedLightParameters.ReadBuffer = bResuming ? ResumeBuffer : AxisBuffers.Textures[2 + ReadIndex];
+			PassParameters->AddedLightParameters.WriteBuffer = AxisBuffers.UAVs[2 + WriteIndex];
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("ChangeClipping Slice %d", LoopIndex),
+				GetRaymarchComputePassFlags(), ComputeShader, PassParameters, GroupCount);
+
+			if (LoopIndex == AxisPlan.CaptureSlice)
 			{
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, j, Buffers.Buffers[1], readBuffSampler, Buffers.UAVs[0]);
+				AddCopyTexturePass(GraphBuilder, AxisBuffers.Textures[2 + WriteIndex],
+					RegisterBuffer(GraphBuilder, SnapshotBuffers.Buffers[AxisIndex][AxisPlan.CaptureBufferIndex]));
 			}
-			RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
 		}
 	}
+}
 
-	// Unbind UAVs.
-	ComputeShader->UnbindResourcesLightPropagation(RHICmdList, ShaderRHI);
-
-	// Transition resources back to the renderer.
-	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+void ChangeClippingInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources Resources, const FDirLightParameters LightParameters,
+	const FRaymarchWorldParameters OldWorldParameters, const FRaymarchWorldParameters NewWorldParameters,
+	const FClippingChangePlan& Plan, FLightSnapshotBuffers& SnapshotBuffers)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	ChangeClippingInSingleLightVolume_RenderThread(
+		GraphBuilder, Resources, LightParameters, OldWorldParameters, NewWorldParameters, Plan, SnapshotBuffers);
+	GraphBuilder.Execute();
 }
 
-void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
-	FBasicRaymarchRenderingResources Resources, const FDirLightParameters RemovedLightParameters,
-	const FDirLightParameters AddedLightParameters, const FRaymarchWorldParameters WorldParameters)
+void ChangeDirLightInSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters RemovedLightParameters, const FDirLightParameters AddedLightParameters,
+	const FRaymarchWorldParameters WorldParameters)
 {
+	check(IsInRenderingThread());
+
 	// Can't have directional light without direction...
 	if (AddedLightParameters.LightDirection == FVector(0.0, 0.0, 0.0) ||
 		RemovedLightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
@@ -192,137 +492,116 @@ void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RH
 	if (RemovedLocalMajorAxes.FaceWeight[0].first != AddedLocalMajorAxes.FaceWeight[0].first ||
 		RemovedLocalMajorAxes.FaceWeight[1].first != AddedLocalMajorAxes.FaceWeight[1].first)
 	{
-		AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, RemovedLightParameters, false, WorldParameters);
-		AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, AddedLightParameters, true, WorldParameters);
+		AddDirLightToSingleLightVolume_RenderThread(GraphBuilder, Resources, RemovedLightParameters, false, WorldParameters);
+		AddDirLightToSingleLightVolume_RenderThread(GraphBuilder, Resources, AddedLightParameters, true, WorldParameters);
 		return;
 	}
 
-	FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
-
-	// Clear buffers for the two axes we will be using.
-	for (unsigned i = 0; i < 2; i++)
-	{
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			RemovedLocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(RemovedLocalMajorAxes, i, Resources);
-
-		float RemovedLightAlpha = GetLightAlpha(RemovedLocalLightParams, RemovedLocalMajorAxes, i);
-		float AddedLightAlpha = GetLightAlpha(AddedLocalLightParams, AddedLocalMajorAxes, i);
-
-		// Clear R/W buffers for Removed Light
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[0], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), RemovedLightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[1], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), RemovedLightAlpha);
-		// Clear R/W buffers for Added Light
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[2], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), AddedLightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[3], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), AddedLightAlpha);
-	}
-
 	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, ChangeDirLightInSingleLightVolume_RenderThread, TEXT("Changing Lights"));
-	SCOPED_GPU_STAT(RHICmdList, GPUChangingLights);
+	RDG_EVENT_SCOPE(GraphBuilder, "Changing Lights");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUChangingLights);
 
 	TShaderMapRef<FChangeDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
+	FRHITexture3D* LightVolumeTexture = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D();
+	FLightingRenderCache& Cache = FLightingRenderCache::Get();
 
-	// Don't need barriers on these - we only ever read/write to the same pixel from one thread ->
-	// no race conditions But we definitely need to transition the resource to Compute-shader
-	// accessible, otherwise the renderer might touch our textures while we're writing them.
-	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+	FChangeDirLightShader::FParameters AxisParameters;
+	AxisParameters.VolumeParameters =
+		GetLightPropagationVolumeParameters(GraphBuilder, Resources, GetLocalClippingParameters(WorldParameters));
 
 	for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
 	{
-		// Get Color ints for texture borders.
-		uint32 RemovedColorInt = GetBorderColorIntSingle(RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex);
-		uint32 AddedColorInt = GetBorderColorIntSingle(AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex);
-		// Get the sampler for read buffer to use border with the proper light color.
-		FSamplerStateRHIRef RemovedReadBuffSampler = GetBufferSamplerRef(RemovedColorInt);
-		FSamplerStateRHIRef AddedReadBuffSampler = GetBufferSamplerRef(AddedColorInt);
-
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(RemovedLocalMajorAxes, AxisIndex, Resources);
-		// TODO take these from buffers.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			RemovedLocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), AxisIndex);
-
-		FVector2D AddedPixOffset = GetUVOffset(
-			AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection, TransposedDimensions);
-		FVector2D RemovedPixOffset = GetUVOffset(
-			RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection, TransposedDimensions);
-
-		FVector2D AddedUVOffset = GetUVOffset(
-			AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection, TransposedDimensions);
-		FVector2D RemovedUVOffset = GetUVOffset(
-			RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection, TransposedDimensions);
-
-		FVector AddedUVWOffset, RemovedUVWOffset;
-		float AddedStepSize, RemovedStepSize;
-
-		GetStepSizeAndUVWOffset(AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection,
-			TransposedDimensions, WorldParameters, AddedStepSize, AddedUVWOffset);
-		GetStepSizeAndUVWOffset(RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection,
-			TransposedDimensions, WorldParameters, RemovedStepSize, RemovedUVWOffset);
-
-		// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct,
-		// but consistent!)
-		int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
-		float LongestVoxelSide = 1.0f / LowestVoxelCount;
-
-		AddedUVWOffset.Normalize();
-		AddedUVWOffset *= LongestVoxelSide;
-		RemovedUVWOffset.Normalize();
-		RemovedUVWOffset *= LongestVoxelSide;
-
-		FMatrix PermMatrix = GetPermutationMatrix(RemovedLocalMajorAxes, AxisIndex);
-
-		// Get group sizes for compute shader
-		uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
-		uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
+		const FRDGAxisBuffers AxisBuffers(GraphBuilder, GetBuffers(RemovedLocalMajorAxes, AxisIndex, Resources));
+		FIntVector TransposedDimensions = GetTransposedDimensions(RemovedLocalMajorAxes, LightVolumeTexture, AxisIndex);
+
+		// Clear R/W buffers for Removed Light (0/1) and for Added Light (2/3).
+		const float RemovedLightAlpha = GetLightAlpha(RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex);
+		const float AddedLightAlpha = GetLightAlpha(AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex);
+		for (int32 i = 0; i < 4; i++)
+		{
+			AddClear2DTexturePass(
+				GraphBuilder, AxisBuffers.UAVs[i], i < 2 ? RemovedLightAlpha : AddedLightAlpha, GetRaymarchComputePassFlags());
+		}
+
+		// Both lights share the major axes, so the permutation is the same for both.
+		const FLightAxisConstants AddedConstants = Cache.GetAxisConstants(
+			Resources.RenderCacheId, AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex, TransposedDimensions);
+		const FLightAxisConstants RemovedConstants = Cache.GetAxisConstants(
+			Resources.RenderCacheId, RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex, TransposedDimensions);
+		AxisParameters.VolumeParameters.PermutationMatrix = RemovedConstants.PermutationMatrix;
+		AxisParameters.StepSize = AddedConstants.StepSize;
+		AxisParameters.RemovedStepSize = RemovedConstants.StepSize;
+		AxisParameters.PrevPixelOffset = AddedConstants.PrevPixelOffset;
+		AxisParameters.RemovedPrevPixelOffset = RemovedConstants.PrevPixelOffset;
+		AxisParameters.UVWOffset = AddedConstants.UVWOffset;
+		AxisParameters.RemovedUVWOffset = RemovedConstants.UVWOffset;
+		// Get the samplers for read buffers to use border with the proper light color.
+		AxisParameters.ReadBufferSampler = AllocSampler(GraphBuilder, Cache.GetBufferSampler(Resources.RenderCacheId,
+			GetBorderColorIntSingle(AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex)));
+		AxisParameters.RemovedReadBufferSampler = AllocSampler(GraphBuilder, Cache.GetBufferSampler(Resources.RenderCacheId,
+			GetBorderColorIntSingle(RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex)));
+
+		const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
+			FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), NUM_THREADS_PER_GROUP_DIMENSION);
 
 		int Start, Stop, AxisDirection;
 		GetLoopStartStopIndexes(Start, Stop, AxisDirection, RemovedLocalMajorAxes, AxisIndex, TransposedDimensions.Z);
 
 		for (int LoopIndex = Start; LoopIndex != Stop; LoopIndex += AxisDirection)
-		{	 // Switch read and write buffers each cycle.
-			ComputeShader->SetRaymarchParameters(
-				RHICmdList, ShaderRHI, LocalClippingParameters, Resources.WindowingParameters.ToLinearColor());
-			ComputeShader->SetRaymarchResources(RHICmdList, ShaderRHI,
-				Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-				Resources.TFTextureRef->GetResource()->TextureRHI->GetTexture2D(), Resources.WindowingParameters);
-			ComputeShader->SetALightVolume(RHICmdList, ShaderRHI, Resources.LightVolumeUAVRef);
-			ComputeShader->SetStepSizes(RHICmdList, ShaderRHI, AddedStepSize, RemovedStepSize);
-			ComputeShader->SetPermutationMatrix(RHICmdList, ShaderRHI, PermMatrix);
-
-			ComputeShader->SetPixelOffsets(RHICmdList, ShaderRHI, AddedPixOffset, RemovedPixOffset);
-			ComputeShader->SetUVWOffsets(RHICmdList, ShaderRHI, AddedUVWOffset, RemovedUVWOffset);
-
-			if (LoopIndex % 2 == 0)
-			{
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[0], Buffers.UAVs[1]);
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[2], Buffers.UAVs[3]);
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, LoopIndex, Buffers.Buffers[0], RemovedReadBuffSampler,
-					Buffers.UAVs[1], Buffers.Buffers[2], AddedReadBuffSampler, Buffers.UAVs[3]);
-			}
-			else
-			{
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[1], Buffers.UAVs[0]);
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[3], Buffers.UAVs[2]);
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, LoopIndex, Buffers.Buffers[1], RemovedReadBuffSampler,
-					Buffers.UAVs[0], Buffers.Buffers[3], AddedReadBuffSampler, Buffers.UAVs[2]);
-			}
-			RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
+		{
+			// Switch read and write buffers each cycle.
+			const int32 ReadIndex = LoopIndex % 2;
+			FChangeDirLightShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FChangeDirLightShader::FParameters>();
+			*PassParameters = AxisParameters;
+			PassParameters->Loop = LoopIndex;
+			PassParameters->RemovedReadBuffer = AxisBuffers.Textures[ReadIndex];
+			PassParameters->RemovedWriteBuffer = AxisBuffers.UAVs[1 - ReadIndex];
+			PassParameters->ReadBuffer = AxisBuffers.Textures[2 + ReadIndex];
+			PassParameters->WriteBuffer = AxisBuffers.UAVs[3 - ReadIndex];
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("ChangeDirLight Slice %d", LoopIndex),
+				GetRaymarchComputePassFlags(), ComputeShader, PassParameters, GroupCount);
 		}
 	}
+}
+
+void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources Resources, const FDirLightParameters RemovedLightParameters,
+	const FDirLightParameters AddedLightParameters, const FRaymarchWorldParameters WorldParameters)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	ChangeDirLightInSingleLightVolume_RenderThread(
+		GraphBuilder, Resources, RemovedLightParameters, AddedLightParameters, WorldParameters);
+	GraphBuilder.Execute();
+}
+
+void AddUpsampledLightVolume_RenderThread(
+	FRDGBuilder& GraphBuilder, FRHITexture* LightVolume, FRHITexture* CoarseLightVolume, float Weight)
+{
+	check(IsInRenderingThread());
 
-	// Unbind Resources.
-	ComputeShader->UnbindResourcesChangeDirLight(RHICmdList, ShaderRHI);
+	// For GPU profiling.
+	RDG_EVENT_SCOPE(GraphBuilder, "Upsampling Light Volume");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUUpsamplingLightVolumes);
+
+	TShaderMapRef<FUpsampleLightVolumeShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FUpsampleLightVolumeShader::FParameters* PassParameters =
+		GraphBuilder.AllocParameters<FUpsampleLightVolumeShader::FParameters>();
+	PassParameters->ALightVolume = GraphBuilder.CreateUAV(RegisterExternalTexture(GraphBuilder, LightVolume, TEXT("Light Volume")));
+	PassParameters->CoarseLightVolume = RegisterExternalTexture(GraphBuilder, CoarseLightVolume, TEXT("Coarse Light Volume"));
+	PassParameters->CoarseLightVolumeSampler = TStaticSamplerState<SF_Trilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	PassParameters->Weight = Weight;
+
+	const FIntVector GroupCount = FIntVector::DivideAndRoundUp(LightVolume->GetSizeXYZ(), UPSAMPLE_GROUP_SIZE);
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("UpsampleLightVolume"), GetRaymarchComputePassFlags(),
+		ComputeShader, PassParameters, GroupCount);
+}
 
-	// Transition resources back to the renderer.
-	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+void AddUpsampledLightVolume_RenderThread(
+	FRHICommandListImmediate& RHICmdList, FRHITexture* LightVolume, FRHITexture* CoarseLightVolume, float Weight)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	AddUpsampledLightVolume_RenderThread(GraphBuilder, LightVolume, CoarseLightVolume, Weight);
+	GraphBuilder.Execute();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,221 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/OctreeCPU.h"
+
+#include "Async/ParallelFor.h"
+#include "Rendering/OctreeShaders.h"
+
+namespace
+{
+void InitMip(FOctreeMipCPU& Mip, const FIntVector& Dimensions)
+{
+	const int64 TexelCount = static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z;
+	Mip.Dimensions = Dimensions;
+	Mip.Max.SetNumUninitialized(TexelCount);
+	Mip.Min.SetNumUninitialized(TexelCount);
+}
+
+// Equivalent of MainComputeShader writing mip 0.
+void GenerateFirstMip(const FRaymarchCPUResources& Resources, FOctreeMipCPU& Mip, EParallelForFlags Flags)
+{
+	const FIntVector& DataDimensions = Resources.DataDimensions;
+	ParallelFor(
+		Mip.Dimensions.Z,
+		[&](int32 Z)
+		{
+			for (int32 Y = 0; Y < Mip.Dimensions.Y; Y++)
+			{
+				for (int32 X = 0; X < Mip.Dimensions.X; X++)
+				{
+					const int64 Index = Mip.GetIndex(X, Y, Z);
+					if (X < DataDimensions.X && Y < DataDimensions.Y && Z < DataDimensions.Z)
+					{
+						const int64 DataIndex = X + DataDimensions.X * (Y + static_cast<int64>(DataDimensions.Y) * Z);
+						const float Value = FMath::Clamp(Resources.DataVolume[DataIndex], 0.0f, 1.0f);
+						Mip.Max[Index] = Value;
+						Mip.Min[Index] = Value;
+					}
+					else
+					{
+						Mip.Max[Index] = 0.0f;
+						Mip.Min[Index] = 1.0f;
+					}
+				}
+			}
+		},
+		Flags);
+}
+
+// Equivalent of one level of the groupshared reduction (or of DownsampleComputeShader).
+void GenerateNextMip(const FOctreeMipCPU& Source, FOctreeMipCPU& Mip, EParallelForFlags Flags)
+{
+	ParallelFor(
+		Mip.Dimensions.Z,
+		[&](int32 Z)
+		{
+			for (int32 Y = 0; Y < Mip.Dimensions.Y; Y++)
+			{
+				for (int32 X = 0; X < Mip.Dimensions.X; X++)
+				{
+					float Max = 0.0f;
+					float Min = 1.0f;
+					for (int32 Child = 0; Child < 8; Child++)
+					{
+						const int64 SourceIndex =
+							Source.GetIndex(X * 2 + (Child & 1), Y * 2 + ((Child >> 1) & 1), Z * 2 + ((Child >> 2) & 1));
+						Max = FMath::Max(Max, Source.Max[SourceIndex]);
+						Min = FMath::Min(Min, Source.Min[SourceIndex]);
+					}
+					const int64 Index = Mip.GetIndex(X, Y, Z);
+					Mip.Max[Index] = Max;
+					Mip.Min[Index] = Min;
+				}
+			}
+		},
+		Flags);
+}
+}	 // namespace
+
+double FOctreeCPUStats::GetTexelsPerSecond() const
+{
+	return Seconds > 0.0 ? TexelsWritten / Seconds : 0.0;
+}
+
+FString FOctreeCPUStats::ToString() const
+{
+	return FString::Printf(TEXT("%.1f Mtexels/s, %d mips, %.1f ms total"), GetTexelsPerSecond() / 1.0e6, MipsGenerated,
+		Seconds * 1000.0);
+}
+
+bool GenerateOctreeForVolume_CPU(const FRaymarchCPUResources& Resources, int32 NumMips, TArray<FOctreeMipCPU>& OutMips,
+	bool bParallel /*= true*/, FOctreeCPUStats* OutStats /*= nullptr*/)
+{
+	const FIntVector& DataDimensions = Resources.DataDimensions;
+	const int64 VoxelCount = static_cast<int64>(DataDimensions.X) * DataDimensions.Y * DataDimensions.Z;
+	if (DataDimensions.GetMin() <= 0 || Resources.DataVolume.Num() != VoxelCount)
+	{
+		return false;
+	}
+	const FIntVector OctreeDimensions = GetOctreeDimensions(DataDimensions);
+	if (NumMips < 1 || NumMips > GetOctreeMipCount(OctreeDimensions))
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const EParallelForFlags Flags = bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+	FOctreeCPUStats Stats;
+
+	OutMips.SetNum(NumMips);
+	for (int32 Mip = 0; Mip < NumMips; Mip++)
+	{
+		InitMip(OutMips[Mip], GetOctreeMipDimensions(OctreeDimensions, Mip));
+		if (Mip == 0)
+		{
+			GenerateFirstMip(Resources, OutMips[Mip], Flags);
+		}
+		else
+		{
+			GenerateNextMip(OutMips[Mip - 1], OutMips[Mip], Flags);
+		}
+		Stats.TexelsWritten += OutMips[Mip].Max.Num();
+		Stats.MipsGenerated++;
+	}
+
+	if (OutStats)
+	{
+		Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+		*OutStats = Stats;
+	}
+	return true;
+}
+
+double FOctreeTraversalCPUStats::GetSampleFraction() const
+{
+	return FullSamples > 0 ? static_cast<double>(Samples) / FullSamples : 1.0;
+}
+
+FString FOctreeTraversalCPUStats::ToString() const
+{
+	return FString::Printf(TEXT("%lld rays, %lld of %lld samples (%.1f %%), %.1f node visits per ray"), Rays, Samples, FullSamples,
+		GetSampleFraction() * 100.0, Rays > 0 ? static_cast<double>(NodeVisits) / Rays : 0.0);
+}
+
+void TraverseOctree_CPU(const TArray<FOctreeMipCPU>& Mips, const FIntVector& DataDimensions, const FVector3f& Entry,
+	const FVector3f& Direction, float Thickness, float StepCount, const FVector2f& VisibleRange, FOctreeTraversalCPUStats& Stats,
+	TArray<int32>* OutSampledSteps /*= nullptr*/)
+{
+	// Same constants as in OctreeCommon.usf.
+	constexpr int32 LeafLevelLimit = 1;
+	constexpr int32 TopLevelLimit = 6;
+
+	const float FloatActualSteps = StepCount * Thickness;
+	const int32 MaxSteps = FMath::FloorToInt32(FloatActualSteps);
+	Stats.Rays++;
+	Stats.FullSamples += MaxSteps + (FMath::Frac(FloatActualSteps) > 0.0f ? 1 : 0);
+	Stats.Samples += FMath::Frac(FloatActualSteps) > 0.0f ? 1 : 0;
+	if (Mips.IsEmpty())
+	{
+		return;
+	}
+
+	const FVector3f VoxelSize(DataDimensions);
+	const FVector3f VoxelEntry = Entry * VoxelSize;
+	const FVector3f VoxelStep = Direction / StepCount * VoxelSize;
+	const int32 LeafLevel = FMath::Min(LeafLevelLimit, Mips.Num() - 1);
+	const int32 TopLevel = FMath::Min(TopLevelLimit, Mips.Num() - 1);
+	const FIntVector& OctreeSize = Mips[0].Dimensions;
+
+	const int32 MaxIterations = (MaxSteps + 1) * (TopLevel - LeafLevel + 1) + TopLevel;
+	int32 Level = TopLevel;
+	int32 Step = 1;
+	for (int32 Iteration = 0; Iteration < MaxIterations && Step <= MaxSteps; Iteration++)
+	{
+		const FVector3f VoxelPos = VoxelEntry + VoxelStep * Step;
+		const FIntVector Voxel(FMath::Clamp(FMath::FloorToInt32(VoxelPos.X), 0, OctreeSize.X - 1),
+			FMath::Clamp(FMath::FloorToInt32(VoxelPos.Y), 0, OctreeSize.Y - 1),
+			FMath::Clamp(FMath::FloorToInt32(VoxelPos.Z), 0, OctreeSize.Z - 1));
+		const FIntVector Node(Voxel.X >> Level, Voxel.Y >> Level, Voxel.Z >> Level);
+		const FOctreeMipCPU& Mip = Mips[Level];
+		const int64 NodeIndex = Mip.GetIndex(Node.X, Node.Y, Node.Z);
+		Stats.NodeVisits++;
+
+		// Equivalent of IsOctreeNodeEmpty, GetOctreeNodeSampleBounds and GetOctreeNodeExitStep.
+		if (Mip.Max[NodeIndex] < VisibleRange.X || Mip.Min[NodeIndex] > VisibleRange.Y)
+		{
+			const FVector3f NodeMin = FVector3f(Node.X << Level, Node.Y << Level, Node.Z << Level) + 0.5f;
+			const FVector3f NodeMax = FVector3f((Node.X + 1) << Level, (Node.Y + 1) << Level, (Node.Z + 1) << Level) - 0.5f;
+			if (VoxelPos.X >= NodeMin.X && VoxelPos.Y >= NodeMin.Y && VoxelPos.Z >= NodeMin.Z && VoxelPos.X <= NodeMax.X &&
+				VoxelPos.Y <= NodeMax.Y && VoxelPos.Z <= NodeMax.Z)
+			{
+				float ExitStep = 1e20f;
+				for (int32 Axis = 0; Axis < 3; Axis++)
+				{
+					if (FMath::Abs(VoxelStep[Axis]) > 1e-6f)
+					{
+						const float ExitPlane = VoxelStep[Axis] > 0.0f ? NodeMax[Axis] : NodeMin[Axis];
+						ExitStep = FMath::Min(ExitStep, (ExitPlane - VoxelEntry[Axis]) / VoxelStep[Axis]);
+					}
+				}
+				Step = FMath::Max(Step + 1, FMath::FloorToInt32(FMath::Min(ExitStep, static_cast<float>(MaxSteps))) + 1);
+				Level = FMath::Min(Level + 1, TopLevel);
+				continue;
+			}
+		}
+		if (Level > LeafLevel)
+		{
+			Level--;
+			continue;
+		}
+
+		if (OutSampledSteps)
+		{
+			OutSampledSteps->Add(Step);
+		}
+		Stats.Samples++;
+		Step++;
+	}
+}
@@ -6,6 +6,8 @@
 #include "Rendering/OctreeShaders.h"
 
 #include "Engine/TextureRenderTargetVolume.h"
+#include "RenderGraphUtils.h"
+#include "Rendering/RaymarchAsyncCompute.h"
 #include "Runtime/RenderCore/Public/RenderUtils.h"
 #include "Util/UtilityShaders.h"
 
@@ -16,41 +18,135 @@
 #define LOCTEXT_NAMESPACE "RaymarchPlugin"
 
 IMPLEMENT_GLOBAL_SHADER(FGenerateOctreeShader, "/Raymarcher/Private/GenerateOctreeShader.usf", "MainComputeShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(
+	FDownsampleOctreeShader, "/Raymarcher/Private/GenerateOctreeShader.usf", "DownsampleComputeShader", SF_Compute);
 
 // For making statistics about GPU use - Generating Octree.
 DECLARE_FLOAT_COUNTER_STAT(TEXT("GeneratingOctree"), STAT_GPU_GeneratingOctree, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUGeneratingOctree, TEXT("GeneratingOctree_"));
 
-// #TODO profile with different dimensions.
-#define OCTREE_NUM_THREADS_PER_GROUP_DIMENSION 1	// This has to be the same as in the compute shader's spec [X, X, X]
-#define LEAF_NODE_SIZE 8							// Provided to the shader as a uniform.
+FIntVector GetOctreeDimensions(const FIntVector& VolumeDimensions)
+{
+	return FIntVector(FMath::RoundUpToPowerOfTwo(VolumeDimensions.X), FMath::RoundUpToPowerOfTwo(VolumeDimensions.Y),
+		FMath::RoundUpToPowerOfTwo(VolumeDimensions.Z));
+}
+
+int32 GetOctreeMipCount(const FIntVector& OctreeDimensions)
+{
+	const int32 MinAxis = FMath::Max(OctreeDimensions.GetMin(), 1);
+	return FMath::Min<int32>(FMath::FloorLog2(MinAxis) + 1, MAX_TEXTURE_MIP_COUNT);
+}
+
+FIntVector GetOctreeMipDimensions(const FIntVector& OctreeDimensions, int32 Mip)
+{
+	return FIntVector(FMath::Max(OctreeDimensions.X >> Mip, 1), FMath::Max(OctreeDimensions.Y >> Mip, 1),
+		FMath::Max(OctreeDimensions.Z >> Mip, 1));
+}
+
+FVector2f GetOctreeVisibleRange(TArrayView<const FLinearColor> TransferFunction, const FWindowingParameters& WindowingParameters)
+{
+	const int32 SampleCount = TransferFunction.Num();
+	const int32 First = TransferFunction.IndexOfByPredicate([](const FLinearColor& Color) { return Color.A > 0.0f; });
+	if (First == INDEX_NONE || WindowingParameters.Width <= 0.0f)
+	{
+		return First == INDEX_NONE ? FVector2f(UE_BIG_NUMBER, -UE_BIG_NUMBER) : FVector2f(-UE_BIG_NUMBER, UE_BIG_NUMBER);
+	}
+	int32 Last = SampleCount - 1;
+	while (TransferFunction[Last].A <= 0.0f)
+	{
+		Last--;
+	}
+
+	// Visible positions in the TF - bilinear sampling blends in a visible sample up to a texel away from its center. The sampler
+	// clamps, so the edge samples extend to infinity, unless cut off by windowing.
+	float MinPosition = First == 0 ? -UE_BIG_NUMBER : (First - 0.5f) / SampleCount;
+	float MaxPosition = Last == SampleCount - 1 ? UE_BIG_NUMBER : (Last + 1.5f) / SampleCount;
+	if (WindowingParameters.LowCutoff)
+	{
+		MinPosition = FMath::Max(MinPosition, 0.0f);
+	}
+	if (WindowingParameters.HighCutoff)
+	{
+		MaxPosition = FMath::Min(MaxPosition, 1.0f);
+	}
+	if (MinPosition > MaxPosition)
+	{
+		return FVector2f(UE_BIG_NUMBER, -UE_BIG_NUMBER);
+	}
+
+	// Inverse of GetTransferFuncPosition() in WindowedSampling.usf.
+	const float Offset = WindowingParameters.Center - WindowingParameters.Width / 2.0f;
+	float MinValue = MinPosition <= -UE_BIG_NUMBER ? -UE_BIG_NUMBER : MinPosition * WindowingParameters.Width + Offset;
+	float MaxValue = MaxPosition >= UE_BIG_NUMBER ? UE_BIG_NUMBER : MaxPosition * WindowingParameters.Width + Offset;
+
+	// The octree clamps values to [0, 1] and quantizes them to 16 bits. Keep the range reachable by clamped values and widen it by
+	// a quantization step, so that no visible node gets skipped.
+	constexpr float QuantizationStep = 1.0f / 65535.0f;
+	MinValue = FMath::Min(MinValue, 1.0f) - QuantizationStep;
+	MaxValue = FMath::Max(MaxValue, 0.0f) + QuantizationStep;
+	return FVector2f(MinValue, MaxValue);
+}
 
 void GenerateOctreeForVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources)
 {
 	check(IsInRenderingThread());
-	constexpr int32 GroupSizePerDimension = OCTREE_NUM_THREADS_PER_GROUP_DIMENSION * LEAF_NODE_SIZE;
+
+	FRDGBuilder GraphBuilder(RHICmdList);
+	GenerateOctreeForVolume_RenderThread(GraphBuilder, Resources);
+	GraphBuilder.Execute();
+}
+
+void GenerateOctreeForVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources)
+{
+	check(IsInRenderingThread());
 
 	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, GenerateOctreeForVolume_RenderThread, TEXT("GeneratingOctree"));
-	SCOPED_GPU_STAT(RHICmdList, GPUGeneratingOctree);
-
-	TShaderMapRef<FGenerateOctreeShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
-	RHICmdList.Transition(FRHITransitionInfo(Resources.OctreeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
-
-	ComputeShader->SetGeneratingResources(RHICmdList, ShaderRHI,
-		Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-		Resources.OctreeVolumeRenderTarget->MippedTexture3DRTResource, LEAF_NODE_SIZE,
-		Resources.OctreeVolumeRenderTarget->GetNumMips());
-
-	const uint32 GroupSizeX = FMath::DivideAndRoundUp(Resources.OctreeVolumeRenderTarget->SizeX, GroupSizePerDimension);
-	const uint32 GroupSizeY = FMath::DivideAndRoundUp(Resources.OctreeVolumeRenderTarget->SizeY, GroupSizePerDimension);
-	const uint32 GroupSizeZ = FMath::DivideAndRoundUp(Resources.OctreeVolumeRenderTarget->SizeZ, GroupSizePerDimension);
-	RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, GroupSizeZ);
-
-	ComputeShader->UnbindResources(RHICmdList, ShaderRHI);
-	RHICmdList.Transition(FRHITransitionInfo(Resources.OctreeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+	RDG_EVENT_SCOPE(GraphBuilder, "GeneratingOctree");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUGeneratingOctree);
+
+	const FTexture3DComputeResource* ComputeResource = Resources.OctreeVolumeRenderTarget->MippedTexture3DRTResource;
+	FRDGTextureRef OctreeTexture = RegisterExternalTexture(GraphBuilder, ComputeResource->TextureRHI, TEXT("OctreeVolume"));
+	FRHITexture* VolumeTexture = Resources.DataVolumeTextureRef->GetResource()->TextureRHI;
+	const FIntVector OctreeSize(ComputeResource->SizeX, ComputeResource->SizeY, ComputeResource->SizeZ);
+	const int32 NumMips = ComputeResource->NumMips;
+
+	TShaderMapRef<FGenerateOctreeShader> GenerateShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	TShaderMapRef<FDownsampleOctreeShader> DownsampleShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+
+	// The graph transitions the last mip of every pass to be read by the next one.
+	for (int32 BaseMip = 0; BaseMip < NumMips; BaseMip += OCTREE_MIPS_PER_PASS)
+	{
+		const FIntVector OutputSize = GetOctreeMipDimensions(OctreeSize, BaseMip);
+		FGenerateOctreeShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FGenerateOctreeShader::FParameters>();
+
+		// Mip UAVs past the last mip of the octree are bound to the last mip, the shader doesn't write them.
+		const int32 PassMips = FMath::Min(OCTREE_MIPS_PER_PASS, NumMips - BaseMip);
+		FRDGTextureUAVRef* Outputs[OCTREE_MIPS_PER_PASS] = {&PassParameters->OctreeVolumeMip0, &PassParameters->OctreeVolumeMip1,
+			&PassParameters->OctreeVolumeMip2, &PassParameters->OctreeVolumeMip3};
+		for (int32 i = 0; i < OCTREE_MIPS_PER_PASS; i++)
+		{
+			*Outputs[i] =
+				i < PassMips ? GraphBuilder.CreateUAV(FRDGTextureUAVDesc(OctreeTexture, BaseMip + i)) : *Outputs[PassMips - 1];
+		}
+		PassParameters->OutputSize = OutputSize;
+		PassParameters->NumberOfMips = PassMips;
+
+		const FIntVector GroupCount = FIntVector::DivideAndRoundUp(OutputSize, OCTREE_GROUP_SIZE);
+		if (BaseMip == 0)
+		{
+			PassParameters->Volume = VolumeTexture;
+			PassParameters->VolumeSize = VolumeTexture->GetSizeXYZ();
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("GenerateOctree"), GetRaymarchComputePassFlags(),
+				GenerateShader, PassParameters, GroupCount);
+		}
+		else
+		{
+			PassParameters->SourceMip = GraphBuilder.CreateSRV(FRDGTextureSRVDesc::CreateForMipLevel(OctreeTexture, BaseMip - 1));
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("DownsampleOctree Mip %d", BaseMip),
+				GetRaymarchComputePassFlags(), DownsampleShader, PassParameters, GroupCount);
+		}
+	}
+	// The graph leaves the octree readable by the raymarching materials.
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,140 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/PreIntegratedTF.h"
+
+#include "Async/ParallelFor.h"
+
+namespace
+{
+// Color * extinction and extinction of a transfer function texel.
+FLinearColor GetExtinction(const FLinearColor& Color)
+{
+	const float Alpha = FMath::Clamp(Color.A, 0.0f, PRE_INTEGRATED_TF_MAX_ALPHA);
+	const float Extinction = -FMath::Loge(1.0f - Alpha);
+	return FLinearColor(Color.R * Extinction, Color.G * Extinction, Color.B * Extinction, Extinction);
+}
+
+// Integral of color * extinction and of extinction between two neighboring texels, with the opacity interpolated linearly like
+// bilinear sampling of the TF texture does. The extinction integral is exact (so the opacity of a segment matches a fine fixed step
+// raymarch), the color is taken as the average of the two texels.
+FLinearColor IntegrateTexelInterval(const FLinearColor& Color0, const FLinearColor& Color1)
+{
+	const double Transmittance0 = 1.0 - FMath::Clamp(Color0.A, 0.0f, PRE_INTEGRATED_TF_MAX_ALPHA);
+	const double Transmittance1 = 1.0 - FMath::Clamp(Color1.A, 0.0f, PRE_INTEGRATED_TF_MAX_ALPHA);
+	double Integral;
+	if (FMath::Abs(Transmittance0 - Transmittance1) < 1e-9)
+	{
+		Integral = -FMath::Loge(Transmittance0);
+	}
+	else
+	{
+		// Integral of -ln(T) over T from Transmittance1 to Transmittance0, divided by the length of that range.
+		Integral = (Transmittance1 * FMath::Loge(Transmittance1) - Transmittance1 - Transmittance0 * FMath::Loge(Transmittance0) +
+					   Transmittance0) /
+				   (Transmittance0 - Transmittance1);
+	}
+	const float Extinction = static_cast<float>(Integral);
+	const FLinearColor Color = (Color0 + Color1) * 0.5f;
+	return FLinearColor(Color.R * Extinction, Color.G * Extinction, Color.B * Extinction, Extinction);
+}
+}	 // namespace
+
+FLinearColor FPreIntegratedTransferFunction::Sample(float FrontPosition, float BackPosition) const
+{
+	const float X = FMath::Clamp(FrontPosition * Size - 0.5f, 0.0f, static_cast<float>(Size - 1));
+	const float Y = FMath::Clamp(BackPosition * Size - 0.5f, 0.0f, static_cast<float>(Size - 1));
+	const int32 X0 = FMath::FloorToInt32(X);
+	const int32 Y0 = FMath::FloorToInt32(Y);
+	const int32 X1 = FMath::Min(X0 + 1, Size - 1);
+	const int32 Y1 = FMath::Min(Y0 + 1, Size - 1);
+	const float WeightX = X - X0;
+	const float WeightY = Y - Y0;
+	return FMath::Lerp(FMath::Lerp(GetTexel(X0, Y0), GetTexel(X1, Y0), WeightX),
+		FMath::Lerp(GetTexel(X0, Y1), GetTexel(X1, Y1), WeightX), WeightY);
+}
+
+FPreIntegratedTransferFunction PreIntegrateTransferFunction(TArrayView<const FLinearColor> TransferFunction, bool bParallel)
+{
+	FPreIntegratedTransferFunction Table;
+	const int32 Size = TransferFunction.Num();
+	if (Size == 0)
+	{
+		return Table;
+	}
+
+	// Integrals from the first texel to every texel.
+	TArray<FLinearColor> Extinctions;
+	Extinctions.Reserve(Size);
+	for (const FLinearColor& Color : TransferFunction)
+	{
+		Extinctions.Add(GetExtinction(Color));
+	}
+	TArray<FLinearColor> Integrals;
+	Integrals.SetNumUninitialized(Size);
+	Integrals[0] = FLinearColor::Transparent;
+	for (int32 i = 1; i < Size; i++)
+	{
+		Integrals[i] = Integrals[i - 1] + IntegrateTexelInterval(TransferFunction[i - 1], TransferFunction[i]);
+	}
+
+	Table.Size = Size;
+	Table.Texels.SetNumUninitialized(Size * Size);
+	ParallelFor(
+		Size,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				Table.Texels[X + Size * Y] = X == Y ? Extinctions[X] : (Integrals[Y] - Integrals[X]) / static_cast<float>(Y - X);
+			}
+		},
+		bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+	return Table;
+}
+
+FLinearColor SampleWindowedPreIntegratedTransferFunction_CPU(const FPreIntegratedTransferFunction& Table, float FrontValue,
+	float BackValue, float StepSize, const FWindowingParameters& WindowingParameters)
+{
+	const float WindowLow = WindowingParameters.Center - WindowingParameters.Width / 2.0f;
+	const float FrontPos = (FrontValue - WindowLow) / WindowingParameters.Width;
+	const float BackPos = (BackValue - WindowLow) / WindowingParameters.Width;
+	const float Low = FMath::Min(FrontPos, BackPos);
+	const float High = FMath::Max(FrontPos, BackPos);
+
+	// The parts of the segment that windowing cuts off are transparent.
+	const float VisibleLow = WindowingParameters.LowCutoff ? FMath::Max(Low, 0.0f) : Low;
+	const float VisibleHigh = WindowingParameters.HighCutoff ? FMath::Min(High, 1.0f) : High;
+	if (VisibleLow > VisibleHigh)
+	{
+		return FLinearColor::Transparent;
+	}
+
+	FLinearColor Average;
+	const float Length = High - Low;
+	if (Length < 1e-5f)
+	{
+		const float Position = FMath::Clamp(VisibleLow, 0.0f, 1.0f);
+		Average = Table.Sample(Position, Position);
+	}
+	else
+	{
+		// Outside of [0, 1] the transfer function stays at its first and last texel.
+		const float Below = FMath::Max(FMath::Min(VisibleHigh, 0.0f) - VisibleLow, 0.0f);
+		const float Above = FMath::Max(VisibleHigh - FMath::Max(VisibleLow, 1.0f), 0.0f);
+		const float InsideLow = FMath::Clamp(VisibleLow, 0.0f, 1.0f);
+		const float InsideHigh = FMath::Clamp(VisibleHigh, 0.0f, 1.0f);
+		Average = (Table.Sample(0.0f, 0.0f) * Below + Table.Sample(InsideLow, InsideHigh) * (InsideHigh - InsideLow) +
+					  Table.Sample(1.0f, 1.0f) * Above) /
+				  Length;
+	}
+
+	if (Average.A <= 1e-6f)
+	{
+		return FLinearColor::Transparent;
+	}
+	return FLinearColor(
+		Average.R / Average.A, Average.G / Average.A, Average.B / Average.A, 1.0f - FMath::Exp(-Average.A * StepSize));
+}
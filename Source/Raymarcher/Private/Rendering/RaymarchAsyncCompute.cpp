@@ -0,0 +1,112 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/RaymarchAsyncCompute.h"
+
+#include "RenderGraphBuilder.h"
+#include "RenderGraphEvent.h"
+
+// For making statistics about GPU use - all raymarcher work on the async compute queue. The passes also count towards the stats of
+// what they do (e.g. AddingLightsToVolume), which are shared with the passes on the graphics pipe.
+DECLARE_GPU_STAT_NAMED(GPURaymarcherAsyncCompute, TEXT("RaymarcherAsyncCompute"));
+
+namespace
+{
+/// Render thread only.
+bool bRaymarchAsyncCompute = false;
+
+/// Game thread only.
+TSharedPtr<FRaymarchSceneViewExtension, ESPMode::ThreadSafe> SceneViewExtension;
+}	 // namespace
+
+ERDGPassFlags GetRaymarchComputePassFlags()
+{
+	check(IsInRenderingThread());
+	return bRaymarchAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute;
+}
+
+FRaymarchAsyncComputeScope::FRaymarchAsyncComputeScope() : bWasAsyncCompute(bRaymarchAsyncCompute)
+{
+	check(IsInRenderingThread());
+	bRaymarchAsyncCompute = true;
+}
+
+FRaymarchAsyncComputeScope::~FRaymarchAsyncComputeScope()
+{
+	bRaymarchAsyncCompute = bWasAsyncCompute;
+}
+
+FRaymarchSceneViewExtension::FRaymarchSceneViewExtension(const FAutoRegister& AutoRegister) : FSceneViewExtensionBase(AutoRegister)
+{
+}
+
+FRaymarchAsyncComputeSubmittedFlag FRaymarchSceneViewExtension::Enqueue(TUniqueFunction<void(FRDGBuilder&)>&& Work)
+{
+	check(IsInGameThread());
+	FRaymarchAsyncComputeSubmittedFlag SubmittedFlag = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+	ENQUEUE_RENDER_COMMAND(QueueRaymarchAsyncCompute)
+	([Extension = Get(), Work = MoveTemp(Work), SubmittedFlag](FRHICommandListImmediate& RHICmdList) mutable
+		{ Extension->Queue.Add({MoveTemp(Work), SubmittedFlag}); });
+	return SubmittedFlag;
+}
+
+void FRaymarchSceneViewExtension::Flush()
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(FlushRaymarchAsyncCompute)
+	([Extension = Get()](FRHICommandListImmediate& RHICmdList)
+		{
+			if (Extension->Queue.Num() == 0)
+			{
+				return;
+			}
+			FRDGBuilder GraphBuilder(RHICmdList);
+			Extension->AddQueuedWork(GraphBuilder);
+			GraphBuilder.Execute();
+		});
+}
+
+void FRaymarchSceneViewExtension::Shutdown()
+{
+	SceneViewExtension.Reset();
+}
+
+void FRaymarchSceneViewExtension::PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily)
+{
+	// Every view family rendered gets here - the first one takes all the work.
+	AddQueuedWork(GraphBuilder);
+}
+
+TSharedRef<FRaymarchSceneViewExtension, ESPMode::ThreadSafe> FRaymarchSceneViewExtension::Get()
+{
+	check(IsInGameThread());
+	if (!SceneViewExtension)
+	{
+		SceneViewExtension = FSceneViewExtensions::NewExtension<FRaymarchSceneViewExtension>();
+	}
+	return SceneViewExtension.ToSharedRef();
+}
+
+void FRaymarchSceneViewExtension::AddQueuedWork(FRDGBuilder& GraphBuilder)
+{
+	check(IsInRenderingThread());
+	if (Queue.Num() == 0)
+	{
+		return;
+	}
+
+	// For GPU profiling.
+	RDG_EVENT_SCOPE(GraphBuilder, "Raymarcher Async Compute");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPURaymarcherAsyncCompute);
+
+	FRaymarchAsyncComputeScope AsyncComputeScope;
+	for (FQueuedWork& QueuedWork : Queue)
+	{
+		QueuedWork.Work(GraphBuilder);
+		// Only the graph orders the work against what comes after it, see FRaymarchAsyncComputeSubmittedFlag.
+		QueuedWork.SubmittedFlag->AtomicSet(true);
+	}
+	Queue.Reset();
+}
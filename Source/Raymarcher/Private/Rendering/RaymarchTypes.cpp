@@ -4,3 +4,26 @@
 // (original raymarching code).
 
 #include "Rendering/RaymarchTypes.h"
+
+#include "RHICommandList.h"
+#include "Rendering/LightingRenderCache.h"
+
+void FLightSnapshotBuffers::PrepareAxis(int32 AxisIndex, const FTexture2DRHIRef& ReadWriteBuffer)
+{
+	check(IsInRenderingThread());
+	const FIntPoint Size(ReadWriteBuffer->GetSizeX(), ReadWriteBuffer->GetSizeY());
+	for (FTexture2DRHIRef& Buffer : Buffers[AxisIndex])
+	{
+		if (Buffer && Buffer->GetSizeXY() == Size && Buffer->GetFormat() == ReadWriteBuffer->GetFormat())
+		{
+			continue;
+		}
+		FRHITextureCreateDesc Desc =
+			FRHITextureCreateDesc::Create2D(TEXT("Illumination Snapshot"), Size.X, Size.Y, ReadWriteBuffer->GetFormat());
+		Desc.Flags |= TexCreate_ShaderResource;
+		Desc.NumMips = 1;
+		Desc.NumSamples = 1;
+		Buffer = RHICreateTexture(Desc);
+		INC_DWORD_STAT(STAT_RaymarcherLightingRHICreations);
+	}
+}
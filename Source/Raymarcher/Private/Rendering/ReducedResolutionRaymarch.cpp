@@ -0,0 +1,679 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "Rendering/ReducedResolutionRaymarch.h"
+
+#include "Async/ParallelFor.h"
+#include "PixelShaderUtils.h"
+#include "PostProcess/PostProcessMaterialInputs.h"
+#include "RenderGraphUtils.h"
+#include "SceneRenderTargetParameters.h"
+#include "SceneView.h"
+#include "ScreenPass.h"
+#include "SystemTextures.h"
+#include "TextureResource.h"
+
+IMPLEMENT_GLOBAL_SHADER(
+	FReducedResolutionRaymarchShader, "/Raymarcher/Private/ReducedResolutionRaymarch.usf", "LowResRaymarchCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(
+	FBilateralUpsampleShader, "/Raymarcher/Private/ReducedResolutionRaymarch.usf", "BilateralUpsamplePS", SF_Pixel);
+
+// For making statistics about GPU use - Raymarching volumes at reduced resolution and upsampling them.
+DECLARE_GPU_STAT_NAMED(GPUReducedResolutionRaymarch, TEXT("ReducedResolutionRaymarch"));
+
+namespace
+{
+/// Game thread only.
+TSharedPtr<FReducedResolutionRaymarchExtension, ESPMode::ThreadSafe> ReducedResolutionExtension;
+
+/// Frames a history can go unused before getting released.
+constexpr uint32 HistoryReleaseFrames = 60;
+
+/// Rows of the low resolution image marched by the CPU model, with the depth every ray ended at.
+struct FLowResImageCPU
+{
+	int32 Resolution = 0;
+	TArray<FLinearColor> Colors;
+	TArray<float> Depths;
+};
+
+/// Equivalent of LowResRaymarchCS in ReducedResolutionRaymarch.usf, without the jitter.
+void RaymarchLowRes_CPU(const FRaymarchCPUResources& Resources, const FRaymarchViewCPU& View, int32 Divisor,
+	FLowResImageCPU& OutImage, FRaymarchCPUStats& Stats)
+{
+	OutImage.Resolution = FMath::DivideAndRoundUp(View.Resolution, Divisor);
+	const int32 Resolution = OutImage.Resolution;
+	OutImage.Colors.Init(FLinearColor::Transparent, Resolution * Resolution);
+	OutImage.Depths.Init(0.0f, Resolution * Resolution);
+	const FVector3f Direction = View.ViewDirection.GetSafeNormal();
+	TArray<FRaymarchCPUStats> RowStats;
+	RowStats.SetNum(Resolution);
+	ParallelFor(Resolution,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Resolution; X++)
+			{
+				// The ray goes through the center of its block and ends at the scene depth of the pixel there.
+				const int32 LastPixel = View.Resolution - 1;
+				const FIntPoint DepthPixel(
+					FMath::Min(X * Divisor + Divisor / 2, LastPixel), FMath::Min(Y * Divisor + Divisor / 2, LastPixel));
+				FVector3f Origin;
+				float Entry, Exit;
+				View.GetRay((X + 0.5f) * Divisor, (Y + 0.5f) * Divisor, DepthPixel, Origin, Entry, Exit);
+				OutImage.Depths[X + Y * Resolution] = Exit;
+				if (Exit > Entry)
+				{
+					OutImage.Colors[X + Y * Resolution] = RaymarchFixedStep_CPU(
+						Resources, Origin + Direction * Entry, Direction, Exit - Entry, View.StepCount, RowStats[Y]);
+				}
+			}
+		});
+
+	for (const FRaymarchCPUStats& Row : RowStats)
+	{
+		Stats.Rays += Row.Rays;
+		Stats.Samples += Row.Samples;
+	}
+}
+
+/// Largest difference of a color channel or the opacity.
+float GetColorError(const FLinearColor& A, const FLinearColor& B)
+{
+	return FMath::Max(FMath::Max(FMath::Abs(A.R - B.R), FMath::Abs(A.G - B.G)),
+		FMath::Max(FMath::Abs(A.B - B.B), FMath::Abs(A.A - B.A)));
+}
+}	 // namespace
+
+int32 GetRaymarchResolutionDivisor(ERaymarchResolution Resolution)
+{
+	switch (Resolution)
+	{
+		case ERaymarchResolution::Half:
+			return 2;
+		case ERaymarchResolution::Quarter:
+			return 4;
+		default:
+			return 1;
+	}
+}
+
+float GetBilateralUpsampleWeight(
+	float BilinearWeight, float SampleDepth, float PixelDepth, const FBilateralUpsampleParameters& Parameters)
+{
+	const float Tolerance = FMath::Max(FMath::Max(SampleDepth, PixelDepth) * Parameters.DepthTolerance, 1e-6f);
+	return BilinearWeight * FMath::Exp(-FMath::Abs(SampleDepth - PixelDepth) / Tolerance);
+}
+
+bool UpsamplePixel(const FLinearColor (&Samples)[4], const float (&SampleDepths)[4], const float (&BilinearWeights)[4],
+	float PixelDepth, const FBilateralUpsampleParameters& Parameters, FLinearColor& OutColor)
+{
+	FLinearColor ColorSum = FLinearColor::Transparent;
+	float WeightSum = 0.0f;
+	float MinAlpha = 1.0f;
+	float MaxAlpha = 0.0f;
+	int32 Closest = 0;
+	for (int32 i = 0; i < 4; i++)
+	{
+		const float Weight = GetBilateralUpsampleWeight(BilinearWeights[i], SampleDepths[i], PixelDepth, Parameters);
+		ColorSum += Samples[i] * Weight;
+		WeightSum += Weight;
+		if (BilinearWeights[i] > 0.0f)
+		{
+			MinAlpha = FMath::Min(MinAlpha, Samples[i].A);
+			MaxAlpha = FMath::Max(MaxAlpha, Samples[i].A);
+		}
+		if (FMath::Abs(SampleDepths[i] - PixelDepth) < FMath::Abs(SampleDepths[Closest] - PixelDepth))
+		{
+			Closest = i;
+		}
+	}
+
+	OutColor = WeightSum > 1e-4f ? ColorSum / WeightSum : Samples[Closest];
+	return WeightSum < Parameters.EdgeWeightThreshold || MaxAlpha - MinAlpha > Parameters.EdgeAlphaThreshold;
+}
+
+void FRaymarchViewCPU::GetRay(
+	float X, float Y, const FIntPoint& DepthPixel, FVector3f& OutOrigin, float& OutEntry, float& OutExit) const
+{
+	const FVector3f Direction = ViewDirection.GetSafeNormal();
+	FVector3f AxisU, AxisV;
+	Direction.FindBestAxisVectors(AxisU, AxisV);
+
+	// The image covers the unit cube seen from any direction.
+	const float Extent = FMath::Sqrt(3.0f);
+	const FVector3f Center(0.5f);
+	OutOrigin = Center + AxisU * ((X / Resolution - 0.5f) * Extent) + AxisV * ((Y / Resolution - 0.5f) * Extent) -
+				Direction * Extent;
+
+	// Where the ray enters and leaves the unit cube.
+	float Enter = 0.0f;
+	float Exit = UE_BIG_NUMBER;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (FMath::Abs(Direction[Axis]) < 1e-6f)
+		{
+			Exit = (OutOrigin[Axis] < 0.0f || OutOrigin[Axis] > 1.0f) ? -1.0f : Exit;
+			continue;
+		}
+		float Near = -OutOrigin[Axis] / Direction[Axis];
+		float Far = (1.0f - OutOrigin[Axis]) / Direction[Axis];
+		if (Near > Far)
+		{
+			Swap(Near, Far);
+		}
+		Enter = FMath::Max(Enter, Near);
+		Exit = FMath::Min(Exit, Far);
+	}
+	if (Exit <= Enter)
+	{
+		OutEntry = 0.0f;
+		OutExit = 0.0f;
+		return;
+	}
+
+	OutEntry = Enter;
+	OutExit = SceneDepth.IsEmpty() ? Exit : FMath::Min(Exit, SceneDepth[DepthPixel.X + DepthPixel.Y * Resolution]);
+}
+
+FLinearColor RaymarchAmortized_CPU(const FRaymarchCPUResources& Resources, const FVector3f& Entry, const FVector3f& Direction,
+	float Thickness, float StepCount, int32 StepFrames, int32 StepFrame, FRaymarchCPUStats& Stats)
+{
+	StepFrames = FMath::Max(StepFrames, 1);
+
+	// Moving back by StepFrame / StepFrames of a step of this frame is StepFrame steps of the full step count.
+	const float Offset = (StepFrame % StepFrames) / StepCount;
+	return RaymarchFixedStep_CPU(
+		Resources, Entry - Direction * Offset, Direction, Thickness + Offset, StepCount / StepFrames, Stats);
+}
+
+void AccumulateTemporalSample(
+	FLinearColor& History, float& HistoryFrames, const FLinearColor& Sample, const FTemporalAccumulationParameters& Parameters)
+{
+	HistoryFrames = FMath::Min(HistoryFrames + 1.0f, static_cast<float>(FMath::Max(Parameters.MaxHistoryFrames, 1)));
+	History = FMath::Lerp(History, Sample, 1.0f / HistoryFrames);
+}
+
+FMatrix GetUVWToClipMatrix(
+	const FTransform& VolumeTransform, const FVector& PreViewTranslation, const FMatrix& TranslatedViewProjectionMatrix)
+{
+	return FTranslationMatrix(FVector(-0.5)) * VolumeTransform.ToMatrixWithScale() * FTranslationMatrix(PreViewTranslation) *
+		   TranslatedViewProjectionMatrix;
+}
+
+double FReducedResolutionComparisonCPU::GetSampleFraction() const
+{
+	return Full.Samples > 0 ? static_cast<double>(Reduced.Samples) / Full.Samples : 1.0;
+}
+
+FString FReducedResolutionComparisonCPU::ToString() const
+{
+	return FString::Printf(TEXT("%.1f %% of the samples (%lld of %lld edge pixels refined) in %.2f ms instead of %.2f ms, "
+								"mean error %.4f, max error %.4f"),
+		GetSampleFraction() * 100.0, RefinedPixels, EdgePixels, ReducedSeconds * 1000.0, FullSeconds * 1000.0, MeanError, MaxError);
+}
+
+FReducedResolutionComparisonCPU CompareReducedResolutionRaymarch_CPU(const FRaymarchCPUResources& Resources,
+	const FRaymarchViewCPU& View, ERaymarchResolution Resolution, const FBilateralUpsampleParameters& Parameters,
+	TArray<FLinearColor>* OutImage)
+{
+	FReducedResolutionComparisonCPU Comparison;
+	const int32 Size = View.Resolution;
+	const FVector3f Direction = View.ViewDirection.GetSafeNormal();
+	TArray<FRaymarchCPUStats> RowStats;
+	RowStats.SetNum(Size);
+
+	// Reference - every pixel raymarched.
+	double StartTime = FPlatformTime::Seconds();
+	TArray<FLinearColor> FullImage;
+	FullImage.Init(FLinearColor::Transparent, Size * Size);
+	ParallelFor(Size,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				FVector3f Origin;
+				float Entry, Exit;
+				View.GetRay(X + 0.5f, Y + 0.5f, FIntPoint(X, Y), Origin, Entry, Exit);
+				if (Exit > Entry)
+				{
+					FullImage[X + Y * Size] = RaymarchFixedStep_CPU(
+						Resources, Origin + Direction * Entry, Direction, Exit - Entry, View.StepCount, RowStats[Y]);
+				}
+			}
+		});
+	Comparison.FullSeconds = FPlatformTime::Seconds() - StartTime;
+	for (FRaymarchCPUStats& Row : RowStats)
+	{
+		Comparison.Full.Rays += Row.Rays;
+		Comparison.Full.Samples += Row.Samples;
+		Row = FRaymarchCPUStats();
+	}
+
+	// Equivalent of BilateralUpsamplePS in ReducedResolutionRaymarch.usf.
+	StartTime = FPlatformTime::Seconds();
+	const int32 Divisor = GetRaymarchResolutionDivisor(Resolution);
+	FLowResImageCPU LowRes;
+	RaymarchLowRes_CPU(Resources, View, Divisor, LowRes, Comparison.Reduced);
+	TArray<FLinearColor> Image;
+	Image.SetNumUninitialized(Size * Size);
+	TArray<int64> RowEdgePixels, RowRefinedPixels;
+	RowEdgePixels.SetNumZeroed(Size);
+	RowRefinedPixels.SetNumZeroed(Size);
+	ParallelFor(Size,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				FVector3f Origin;
+				float Entry, Exit;
+				View.GetRay(X + 0.5f, Y + 0.5f, FIntPoint(X, Y), Origin, Entry, Exit);
+
+				// The 4 low resolution samples closest to the pixel center.
+				const FVector2f LowResPos((X + 0.5f) / Divisor - 0.5f, (Y + 0.5f) / Divisor - 0.5f);
+				const FIntPoint Base(FMath::FloorToInt32(LowResPos.X), FMath::FloorToInt32(LowResPos.Y));
+				const FVector2f Frac = LowResPos - FVector2f(Base.X, Base.Y);
+				FLinearColor Samples[4];
+				float SampleDepths[4];
+				float BilinearWeights[4];
+				for (int32 i = 0; i < 4; i++)
+				{
+					const FIntPoint Offset(i & 1, i >> 1);
+					const int32 TapX = FMath::Clamp(Base.X + Offset.X, 0, LowRes.Resolution - 1);
+					const int32 TapY = FMath::Clamp(Base.Y + Offset.Y, 0, LowRes.Resolution - 1);
+					Samples[i] = LowRes.Colors[TapX + TapY * LowRes.Resolution];
+					SampleDepths[i] = LowRes.Depths[TapX + TapY * LowRes.Resolution];
+					BilinearWeights[i] = (Offset.X ? Frac.X : 1.0f - Frac.X) * (Offset.Y ? Frac.Y : 1.0f - Frac.Y);
+				}
+
+				FLinearColor& Color = Image[X + Y * Size];
+				if (UpsamplePixel(Samples, SampleDepths, BilinearWeights, Exit, Parameters, Color))
+				{
+					RowEdgePixels[Y]++;
+					if (Parameters.bRefineEdges)
+					{
+						RowRefinedPixels[Y]++;
+						Color = Exit > Entry ? RaymarchFixedStep_CPU(Resources, Origin + Direction * Entry, Direction, Exit - Entry,
+												   View.StepCount, RowStats[Y])
+											 : FLinearColor::Transparent;
+					}
+				}
+			}
+		});
+	Comparison.ReducedSeconds = FPlatformTime::Seconds() - StartTime;
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		Comparison.Reduced.Rays += RowStats[Y].Rays;
+		Comparison.Reduced.Samples += RowStats[Y].Samples;
+		Comparison.EdgePixels += RowEdgePixels[Y];
+		Comparison.RefinedPixels += RowRefinedPixels[Y];
+	}
+
+	double ErrorSum = 0.0;
+	for (int32 i = 0; i < Image.Num(); i++)
+	{
+		const float Error = GetColorError(Image[i], FullImage[i]);
+		ErrorSum += Error;
+		Comparison.MaxError = FMath::Max(Comparison.MaxError, static_cast<double>(Error));
+	}
+	Comparison.MeanError = Image.Num() > 0 ? ErrorSum / Image.Num() : 0.0;
+	if (OutImage)
+	{
+		*OutImage = MoveTemp(Image);
+	}
+	return Comparison;
+}
+
+double FTemporalAccumulationComparisonCPU::GetSampleFractionPerFrame() const
+{
+	return Full.Samples > 0 && Frames > 0 ? static_cast<double>(Accumulated.Samples) / Frames / Full.Samples : 1.0;
+}
+
+FString FTemporalAccumulationComparisonCPU::ToString() const
+{
+	return FString::Printf(TEXT("%d frames of %.1f %% of the samples, mean error %.4f after the first frame, %.4f accumulated "
+								"(max %.4f)"),
+		Frames, GetSampleFractionPerFrame() * 100.0, FirstFrameMeanError, MeanError, MaxError);
+}
+
+FTemporalAccumulationComparisonCPU CompareTemporalAccumulation_CPU(const FRaymarchCPUResources& Resources,
+	const FRaymarchViewCPU& View, const FTemporalAccumulationParameters& Parameters, int32 Frames)
+{
+	FTemporalAccumulationComparisonCPU Comparison;
+	Comparison.Frames = Frames;
+	const int32 Size = View.Resolution;
+	const FVector3f Direction = View.ViewDirection.GetSafeNormal();
+	TArray<FRaymarchCPUStats> RowStats;
+	RowStats.SetNum(Size);
+
+	// Reference - every step of every pixel.
+	TArray<FLinearColor> FullImage;
+	FullImage.Init(FLinearColor::Transparent, Size * Size);
+	ParallelFor(Size,
+		[&](int32 Y)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				FVector3f Origin;
+				float Entry, Exit;
+				View.GetRay(X + 0.5f, Y + 0.5f, FIntPoint(X, Y), Origin, Entry, Exit);
+				if (Exit > Entry)
+				{
+					FullImage[X + Y * Size] = RaymarchFixedStep_CPU(
+						Resources, Origin + Direction * Entry, Direction, Exit - Entry, View.StepCount, RowStats[Y]);
+				}
+			}
+		});
+	for (FRaymarchCPUStats& Row : RowStats)
+	{
+		Comparison.Full.Rays += Row.Rays;
+		Comparison.Full.Samples += Row.Samples;
+		Row = FRaymarchCPUStats();
+	}
+
+	// Equivalent of LowResRaymarchCS in ReducedResolutionRaymarch.usf with a static view, so the history reprojects onto itself.
+	TArray<FLinearColor> History;
+	History.Init(FLinearColor::Transparent, Size * Size);
+	TArray<float> HistoryFrames;
+	HistoryFrames.Init(0.0f, Size * Size);
+	for (int32 Frame = 0; Frame < Frames; Frame++)
+	{
+		ParallelFor(Size,
+			[&](int32 Y)
+			{
+				for (int32 X = 0; X < Size; X++)
+				{
+					FVector3f Origin;
+					float Entry, Exit;
+					View.GetRay(X + 0.5f, Y + 0.5f, FIntPoint(X, Y), Origin, Entry, Exit);
+					FLinearColor Sample = FLinearColor::Transparent;
+					if (Exit > Entry)
+					{
+						Sample = RaymarchAmortized_CPU(Resources, Origin + Direction * Entry, Direction, Exit - Entry,
+							View.StepCount, Parameters.StepFrames, Frame, RowStats[Y]);
+					}
+					AccumulateTemporalSample(History[X + Y * Size], HistoryFrames[X + Y * Size], Sample, Parameters);
+				}
+			});
+
+		if (Frame == 0)
+		{
+			double ErrorSum = 0.0;
+			for (int32 i = 0; i < History.Num(); i++)
+			{
+				ErrorSum += GetColorError(History[i], FullImage[i]);
+			}
+			Comparison.FirstFrameMeanError = History.Num() > 0 ? ErrorSum / History.Num() : 0.0;
+		}
+	}
+	for (const FRaymarchCPUStats& Row : RowStats)
+	{
+		Comparison.Accumulated.Rays += Row.Rays;
+		Comparison.Accumulated.Samples += Row.Samples;
+	}
+
+	double ErrorSum = 0.0;
+	for (int32 i = 0; i < History.Num(); i++)
+	{
+		const float Error = GetColorError(History[i], FullImage[i]);
+		ErrorSum += Error;
+		Comparison.MaxError = FMath::Max(Comparison.MaxError, static_cast<double>(Error));
+	}
+	Comparison.MeanError = History.Num() > 0 ? ErrorSum / History.Num() : 0.0;
+	return Comparison;
+}
+
+bool FReducedResolutionRaymarchState::IsHistoryCompatible(const FReducedResolutionRaymarchState& History) const
+{
+	// The volume transform is what the history gets reprojected with.
+	return bTemporalAccumulation && History.bTemporalAccumulation && Scene == History.Scene && DataVolume == History.DataVolume &&
+		   TransferFunction == History.TransferFunction && LightVolume == History.LightVolume &&
+		   HistoryVersion == History.HistoryVersion && LocalClippingParameters == History.LocalClippingParameters &&
+		   WindowingParameters.ToLinearColor() == History.WindowingParameters.ToLinearColor() && StepCount == History.StepCount &&
+		   Resolution == History.Resolution && TemporalParameters.StepFrames == History.TemporalParameters.StepFrames;
+}
+
+FReducedResolutionRaymarchExtension::FReducedResolutionRaymarchExtension(const FAutoRegister& AutoRegister)
+	: FSceneViewExtensionBase(AutoRegister)
+{
+}
+
+void FReducedResolutionRaymarchExtension::SetVolume(const void* Key, const FReducedResolutionRaymarchState& State,
+	UTexture* DataVolume, UTexture* TransferFunction, UTexture* LightVolume)
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(SetReducedResolutionVolume)
+	([Extension = Get(), Key, State, DataVolume, TransferFunction, LightVolume](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			if (!DataVolume->GetResource() || !TransferFunction->GetResource())
+			{
+				Extension->Volumes.Remove(Key);
+				return;
+			}
+			State.DataVolume = DataVolume->GetResource()->TextureRHI;
+			State.TransferFunction = TransferFunction->GetResource()->TextureRHI;
+			State.LightVolume = LightVolume && LightVolume->GetResource() ? LightVolume->GetResource()->TextureRHI : nullptr;
+			Extension->Volumes.Add(Key, MoveTemp(State));
+		});
+}
+
+void FReducedResolutionRaymarchExtension::RemoveVolume(const void* Key)
+{
+	check(IsInGameThread());
+	if (!ReducedResolutionExtension)
+	{
+		return;
+	}
+	ENQUEUE_RENDER_COMMAND(RemoveReducedResolutionVolume)
+	(
+		[Extension = Get(), Key](FRHICommandListImmediate& RHICmdList)
+		{
+			Extension->Volumes.Remove(Key);
+			for (auto It = Extension->Histories.CreateIterator(); It; ++It)
+			{
+				if (It.Key().Key == Key)
+				{
+					It.RemoveCurrent();
+				}
+			}
+		});
+}
+
+void FReducedResolutionRaymarchExtension::Shutdown()
+{
+	ReducedResolutionExtension.Reset();
+}
+
+void FReducedResolutionRaymarchExtension::SubscribeToPostProcessingPass(
+	EPostProcessingPass Pass, FAfterPassCallbackDelegateArray& InOutPassCallbacks, bool bIsPassEnabled)
+{
+	// Subscribing enables the pass even if motion blur is off, so only subscribe if there's anything to draw.
+	if (Pass == EPostProcessingPass::MotionBlur && Volumes.Num() > 0)
+	{
+		InOutPassCallbacks.Add(
+			FAfterPassCallbackDelegate::CreateRaw(this, &FReducedResolutionRaymarchExtension::DrawVolumes_RenderThread));
+	}
+}
+
+TSharedRef<FReducedResolutionRaymarchExtension, ESPMode::ThreadSafe> FReducedResolutionRaymarchExtension::Get()
+{
+	check(IsInGameThread());
+	if (!ReducedResolutionExtension)
+	{
+		ReducedResolutionExtension = FSceneViewExtensions::NewExtension<FReducedResolutionRaymarchExtension>();
+	}
+	return ReducedResolutionExtension.ToSharedRef();
+}
+
+/// Raymarches a volume at reduced resolution and composites it over SceneColor. If History is not null, the rays get accumulated
+/// with it and it gets replaced by the result.
+static void AddReducedResolutionRaymarchPasses(FRDGBuilder& GraphBuilder, const FSceneView& View,
+	const FReducedResolutionRaymarchState& State, FRDGTextureRef SceneDepth, const FScreenPassTexture& SceneColor,
+	FReducedResolutionRaymarchHistory* History)
+{
+	const int32 Divisor = GetRaymarchResolutionDivisor(State.Resolution);
+	const FClippingPlaneParameters& Clipping = State.LocalClippingParameters;
+	const FMatrix TranslatedWorldToUVW = FTranslationMatrix(-View.ViewMatrices.GetPreViewTranslation()) *
+										 State.VolumeTransform.ToInverseMatrixWithScale() * FTranslationMatrix(FVector(0.5));
+
+	FReducedResolutionRaymarchParameters RaymarchParameters;
+	RaymarchParameters.View = View.ViewUniformBuffer;
+	RaymarchParameters.Volume = State.DataVolume;
+	RaymarchParameters.VolumeSampler = TStaticSamplerState<SF_Trilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	RaymarchParameters.TransferFunc = State.TransferFunction;
+	RaymarchParameters.TransferFuncSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	// Unlit volumes still need a texture bound, it's never sampled.
+	RaymarchParameters.LightVolume = State.LightVolume ? State.LightVolume : State.DataVolume;
+	RaymarchParameters.LightVolumeSampler = TStaticSamplerState<SF_Trilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	RaymarchParameters.bLit = State.LightVolume ? 1 : 0;
+	RaymarchParameters.TranslatedWorldToUVW = FMatrix44f(TranslatedWorldToUVW);
+	RaymarchParameters.LocalClippingCenter = FVector3f(Clipping.Center);
+	RaymarchParameters.LocalClippingDirection = FVector3f(Clipping.Direction);
+	RaymarchParameters.WindowingParameters = FVector4f(State.WindowingParameters.ToLinearColor());
+	RaymarchParameters.StepCount = State.StepCount;
+	RaymarchParameters.SceneDepthTexture = SceneDepth;
+	RaymarchParameters.Divisor = Divisor;
+
+	// The low resolution targets cover the whole depth buffer, the shaders only touch the part covering the view rect.
+	const FIntPoint LowResExtent = FIntPoint::DivideAndRoundUp(SceneDepth->Desc.Extent, Divisor);
+	FRDGTextureRef LowResColor = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(LowResExtent, PF_FloatRGBA, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("Reduced Resolution Raymarch Color"));
+	FRDGTextureRef LowResDepth = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(LowResExtent, PF_G32R32F, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("Reduced Resolution Raymarch Depth"));
+
+	// The history only gets reprojected if it's been accumulated with the same state and in the same sized targets.
+	const bool bHistoryValid = History && History->Color && History->Depth && !View.bCameraCut &&
+							   History->Color->GetDesc().Extent == LowResExtent && State.IsHistoryCompatible(History->State);
+	if (History && !bHistoryValid)
+	{
+		History->FrameIndex = 0;
+	}
+	const FTemporalAccumulationParameters& Temporal = State.TemporalParameters;
+	const int32 StepFrames = History ? FMath::Max(Temporal.StepFrames, 1) : 1;
+
+	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(View.GetFeatureLevel());
+	TShaderMapRef<FReducedResolutionRaymarchShader> ComputeShader(ShaderMap);
+	FReducedResolutionRaymarchShader::FParameters* RaymarchPassParameters =
+		GraphBuilder.AllocParameters<FReducedResolutionRaymarchShader::FParameters>();
+	RaymarchPassParameters->RaymarchParameters = RaymarchParameters;
+	RaymarchPassParameters->StepFrames = StepFrames;
+	RaymarchPassParameters->StepFrame = History ? History->FrameIndex % StepFrames : 0;
+	RaymarchPassParameters->MaxHistoryFrames = History ? FMath::Max(Temporal.MaxHistoryFrames, 1) : 1;
+	RaymarchPassParameters->HistoryDepthTolerance = Temporal.DepthTolerance;
+	RaymarchPassParameters->bHistoryValid = bHistoryValid ? 1 : 0;
+	RaymarchPassParameters->HistorySampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	RaymarchPassParameters->HistoryExtent = FVector2f(LowResExtent);
+	if (bHistoryValid)
+	{
+		// Whatever moved the volume since the history got accumulated carried its contents along.
+		const FTransform& PrevVolumeTransform = History->State.VolumeTransform;
+		RaymarchPassParameters->HistoryColor = GraphBuilder.RegisterExternalTexture(History->Color);
+		RaymarchPassParameters->HistoryDepth = GraphBuilder.RegisterExternalTexture(History->Depth);
+		RaymarchPassParameters->UVWToPrevClip = FMatrix44f(
+			GetUVWToClipMatrix(PrevVolumeTransform, History->PreViewTranslation, History->TranslatedViewProjectionMatrix));
+		RaymarchPassParameters->PrevCameraUVW =
+			FVector3f(PrevVolumeTransform.InverseTransformPosition(History->ViewOrigin) + FVector(0.5));
+	}
+	else
+	{
+		// Never sampled.
+		RaymarchPassParameters->HistoryColor = GSystemTextures.GetBlackDummy(GraphBuilder);
+		RaymarchPassParameters->HistoryDepth = GSystemTextures.GetBlackDummy(GraphBuilder);
+		RaymarchPassParameters->UVWToPrevClip = FMatrix44f::Identity;
+		RaymarchPassParameters->PrevCameraUVW = FVector3f::ZeroVector;
+	}
+	RaymarchPassParameters->RWLowResColor = GraphBuilder.CreateUAV(LowResColor);
+	RaymarchPassParameters->RWLowResDepth = GraphBuilder.CreateUAV(LowResDepth);
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("LowResRaymarch %dx%d", LowResExtent.X, LowResExtent.Y),
+		ComputeShader, RaymarchPassParameters, FComputeShaderUtils::GetGroupCount(LowResExtent, REDUCED_RESOLUTION_GROUP_SIZE));
+
+	if (History)
+	{
+		GraphBuilder.QueueTextureExtraction(LowResColor, &History->Color);
+		GraphBuilder.QueueTextureExtraction(LowResDepth, &History->Depth);
+		History->State = State;
+		History->ViewOrigin = View.ViewMatrices.GetViewOrigin();
+		History->PreViewTranslation = View.ViewMatrices.GetPreViewTranslation();
+		History->TranslatedViewProjectionMatrix = View.ViewMatrices.GetTranslatedViewProjectionMatrix();
+		History->FrameIndex++;
+		History->LastUsedFrameNumber = GFrameNumberRenderThread;
+	}
+
+	TShaderMapRef<FBilateralUpsampleShader> PixelShader(ShaderMap);
+	FBilateralUpsampleShader::FParameters* UpsamplePassParameters =
+		GraphBuilder.AllocParameters<FBilateralUpsampleShader::FParameters>();
+	UpsamplePassParameters->RaymarchParameters = RaymarchParameters;
+	UpsamplePassParameters->LowResColor = LowResColor;
+	UpsamplePassParameters->LowResDepth = LowResDepth;
+	UpsamplePassParameters->UpsampleParameters = State.UpsampleParameters.ToVector();
+	UpsamplePassParameters->OutputRect = FVector4f(SceneColor.ViewRect.Min.X, SceneColor.ViewRect.Min.Y, SceneColor.ViewRect.Width(),
+		SceneColor.ViewRect.Height());
+	UpsamplePassParameters->RenderTargets[0] = FRenderTargetBinding(SceneColor.Texture, ERenderTargetLoadAction::ELoad);
+
+	// The volume color is premultiplied by its opacity.
+	FRHIBlendState* BlendState =
+		TStaticBlendState<CW_RGB, BO_Add, BF_One, BF_InverseSourceAlpha, BO_Add, BF_Zero, BF_One>::GetRHI();
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, ShaderMap, RDG_EVENT_NAME("BilateralUpsample"), PixelShader,
+		UpsamplePassParameters, SceneColor.ViewRect, BlendState);
+}
+
+FScreenPassTexture FReducedResolutionRaymarchExtension::DrawVolumes_RenderThread(
+	FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessMaterialInputs& Inputs)
+{
+	check(IsInRenderingThread());
+	FScreenPassTexture SceneColor =
+		FScreenPassTexture::CopyFromSlice(GraphBuilder, Inputs.GetInput(EPostProcessMaterialInput::SceneColor));
+	const TRDGUniformBufferRef<FSceneTextureUniformParameters> SceneTextures = Inputs.SceneTextures.SceneTextures;
+	// Views that stopped rendering never come back for their histories.
+	for (auto It = Histories.CreateIterator(); It; ++It)
+	{
+		if (GFrameNumberRenderThread - It.Value()->LastUsedFrameNumber > HistoryReleaseFrames)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	if (SceneColor.IsValid() && SceneTextures)
+	{
+		// For GPU profiling.
+		RDG_EVENT_SCOPE(GraphBuilder, "Reduced Resolution Raymarch");
+		RDG_GPU_STAT_SCOPE(GraphBuilder, GPUReducedResolutionRaymarch);
+
+		// Views without a state (e.g. scene captures) can't keep a history.
+		const uint32 ViewKey = View.GetViewKey();
+		for (const TPair<const void*, FReducedResolutionRaymarchState>& Volume : Volumes)
+		{
+			if (Volume.Value.Scene != View.Family->Scene)
+			{
+				continue;
+			}
+
+			FReducedResolutionRaymarchHistory* History = nullptr;
+			if (Volume.Value.bTemporalAccumulation && ViewKey != 0)
+			{
+				TUniquePtr<FReducedResolutionRaymarchHistory>& HistoryPtr = Histories.FindOrAdd({Volume.Key, ViewKey});
+				if (!HistoryPtr)
+				{
+					HistoryPtr = MakeUnique<FReducedResolutionRaymarchHistory>();
+				}
+				History = HistoryPtr.Get();
+			}
+			else
+			{
+				Histories.Remove({Volume.Key, ViewKey});
+			}
+			AddReducedResolutionRaymarchPasses(
+				GraphBuilder, View, Volume.Value, SceneTextures->GetContents()->SceneDepthTexture, SceneColor, History);
+		}
+	}
+
+	if (Inputs.OverrideOutput.IsValid())
+	{
+		AddDrawTexturePass(GraphBuilder, View, SceneColor, Inputs.OverrideOutput);
+		return Inputs.OverrideOutput;
+	}
+	return SceneColor;
+}
@@ -12,12 +12,15 @@
 #include "RHICommandList.h"
 #include "RHIDefinitions.h"
 #include "RHIStaticStates.h"
+#include "Rendering/LightingRenderCache.h"
 #include "Rendering/LightingShaders.h"
+#include "Rendering/LightingShadersExperimental.h"
 #include "Rendering/RaymarchTypes.h"
 #include "SceneInterface.h"
 #include "SceneUtils.h"
 #include "ShaderParameterUtils.h"
 #include "Rendering/OctreeShaders.h"
+#include "Rendering/PreIntegratedTF.h"
 #include "VolumeTextureToolkit/Public/TextureUtilities.h"
 
 #include <Engine/TextureRenderTargetVolume.h>
@@ -51,11 +54,10 @@ void URaymarchUtils::AddDirLightToSingleVolume(const FBasicRaymarchRenderingReso
 	if (bGPUSync)
 	{
 		// Call the actual rendering code on RenderThread.
-		// #todo fix GPUSync'd version of shader.
-		//ENQUEUE_RENDER_COMMAND(CaptureCommand)
-		//([=](FRHICommandListImmediate& RHICmdList) {
-		//	AddDirLightToSingleLightVolume_GPUSync_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
-		//});
+		ENQUEUE_RENDER_COMMAND(CaptureCommand)
+		([=](FRHICommandListImmediate& RHICmdList) {
+			AddDirLightToSingleLightVolume_GPUSync_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
+		});
 	}
 	else
 	{
@@ -67,6 +69,25 @@ void URaymarchUtils::AddDirLightToSingleVolume(const FBasicRaymarchRenderingReso
 	}
 }
 
+void URaymarchUtils::AddDirLightsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	bool& LightsAdded)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI)
+	{
+		LightsAdded = false;
+		return;
+	}
+	LightsAdded = true;
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddDirLightsToSingleLightVolume_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
+	});
+}
+
 void URaymarchUtils::ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResources& Resources,
 	const FDirLightParameters OldLightParameters, const FDirLightParameters NewLightParameters,
 	const FRaymarchWorldParameters WorldParameters, bool& LightAdded, bool bGpuSync)
@@ -91,6 +112,69 @@ void URaymarchUtils::ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResourc
 	});
 }
 
+void URaymarchUtils::AddDirLightWithSnapshotsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const FDirLightParameters& LightParameters, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationSnapshots& CaptureSnapshots, FLightSnapshotBuffersPtr SnapshotBuffers, bool& LightAdded)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI ||
+		!SnapshotBuffers)
+	{
+		LightAdded = false;
+		return;
+	}
+	LightAdded = true;
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddDirLightToSingleLightVolume_RenderThread(
+			RHICmdList, Resources, LightParameters, true, WorldParameters, &CaptureSnapshots, SnapshotBuffers.Get());
+	});
+}
+
+void URaymarchUtils::ChangeClippingInSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const FDirLightParameters& LightParameters, const FRaymarchWorldParameters OldWorldParameters,
+	const FRaymarchWorldParameters NewWorldParameters, const FClippingChangePlan& Plan, FLightSnapshotBuffersPtr SnapshotBuffers,
+	bool& LightAdded)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI ||
+		!SnapshotBuffers)
+	{
+		LightAdded = false;
+		return;
+	}
+	LightAdded = true;
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		ChangeClippingInSingleLightVolume_RenderThread(
+			RHICmdList, Resources, LightParameters, OldWorldParameters, NewWorldParameters, Plan, *SnapshotBuffers);
+	});
+}
+
+void URaymarchUtils::AddUpsampledLightVolume(const FBasicRaymarchRenderingResources& Resources,
+	UTextureRenderTargetVolume* CoarseLightVolume, float Weight, bool& bUpsampled)
+{
+	if (!Resources.LightVolumeRenderTarget || !Resources.LightVolumeRenderTarget->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource()->TextureRHI || !CoarseLightVolume || !CoarseLightVolume->GetResource() ||
+		!CoarseLightVolume->GetResource()->TextureRHI)
+	{
+		bUpsampled = false;
+		return;
+	}
+	bUpsampled = true;
+
+	FRHITexture* LightVolumeTexture = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI;
+	FRHITexture* CoarseLightVolumeTexture = CoarseLightVolume->GetResource()->TextureRHI;
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddUpsampledLightVolume_RenderThread(RHICmdList, LightVolumeTexture, CoarseLightVolumeTexture, Weight);
+	});
+}
+
 void URaymarchUtils::GenerateOctree(FBasicRaymarchRenderingResources& Resources)
 {
 	// Call the actual rendering code on RenderThread. We capture by value so that if
@@ -173,7 +257,47 @@ void URaymarchUtils::ColorCurveToTexture(UCurveLinearColor* Curve, UTexture2D*&
 	return;
 }
 
-void URaymarchUtils::CreateBufferTextures(FIntPoint Size, EPixelFormat PixelFormat, OneAxisReadWriteBufferResources& RWBuffers)
+TArray<FLinearColor> URaymarchUtils::SampleColorCurve(UCurveLinearColor* Curve)
+{
+	const int32 SampleCount = 256;
+	TArray<FLinearColor> Samples;
+	Samples.Reserve(SampleCount);
+	for (int32 i = 0; i < SampleCount; i++)
+	{
+		const float Position = i / (SampleCount - 1.0f);
+		// Same as MakeDefaultTFTexture without a curve.
+		Samples.Add(Curve ? Curve->GetLinearColorValue(Position) : FLinearColor(Position, Position, Position, 1.0f));
+	}
+	return Samples;
+}
+
+void URaymarchUtils::TransferFunctionToPreIntegratedTexture(
+	TArrayView<const FLinearColor> TransferFunction, UTexture2D*& OutTexture)
+{
+	const FPreIntegratedTransferFunction Table = PreIntegrateTransferFunction(TransferFunction);
+	if (Table.Size == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Warning: Pre-integrating an empty transfer function!"));
+		return;
+	}
+
+	// Float16, like the TF texture. Averaged extinctions stay below -ln(1 - PRE_INTEGRATED_TF_MAX_ALPHA), well within range.
+	TArray<FFloat16> Samples;
+	Samples.SetNumUninitialized(Table.Texels.Num() * 4);
+	for (int32 i = 0; i < Table.Texels.Num(); i++)
+	{
+		Samples[i * 4] = Table.Texels[i].R;
+		Samples[i * 4 + 1] = Table.Texels[i].G;
+		Samples[i * 4 + 2] = Table.Texels[i].B;
+		Samples[i * 4 + 3] = Table.Texels[i].A;
+	}
+
+	UVolumeTextureToolkit::Create2DTextureTransient(
+		OutTexture, PF_FloatRGBA, FIntPoint(Table.Size, Table.Size), reinterpret_cast<uint8*>(Samples.GetData()));
+}
+
+void URaymarchUtils::CreateBufferTextures(
+	FIntPoint Size, EPixelFormat PixelFormat, OneAxisReadWriteBufferResources& RWBuffers, int32 BufferCount /*= 4*/)
 {
 	if (Size.X == 0 || Size.Y == 0)
 	{
@@ -187,11 +311,12 @@ void URaymarchUtils::CreateBufferTextures(FIntPoint Size, EPixelFormat PixelForm
 	Desc.NumMips = 1;
 	Desc.NumSamples = 1;
 	
-	for (int i = 0; i < 4; i++)
+	for (int i = 0; i < FMath::Min(BufferCount, 4); i++)
 	{
 		RWBuffers.Buffers[i] =
 			RHICreateTexture(Desc);
 		RWBuffers.UAVs[i] = GetCmdList().CreateUnorderedAccessView(RWBuffers.Buffers[i]);
+		INC_DWORD_STAT_BY(STAT_RaymarcherLightingRHICreations, 2);
 	}
 }
 
@@ -9,6 +9,11 @@
 #include "Actor/RaymarchLight.h"
 #include "CoreMinimal.h"
 #include "Math/IntVector.h"
+#include "Rendering/LightPropagationScheduler.h"
+#include "Rendering/LightVolumeLOD.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "Rendering/RaymarchAsyncCompute.h"
+#include "Rendering/RaymarchMaterialParameters.h"
 #include "UObject/UnrealType.h"
 #include "VR/Grabbable.h"
 #include "VolumeAsset/VolumeAsset.h"
@@ -25,7 +30,33 @@ enum class ERaymarchMaterial : uint8
 {
 	Lit,
 	Intensity,
-	Octree
+	Octree,
+	/** Unlit (transfer function colors only) raymarch skipping empty space using the octree. Rendered by the octree material.*/
+	OctreeSkipping,
+	/** Maximum, minimum or average intensity projection, set by RaymarchProjection. Rendered by the octree material.*/
+	Projection
+};
+
+/** How the raymarching materials step through the volume. */
+UENUM(BlueprintType)
+enum class ERaymarchStepping : uint8
+{
+	/** Equal steps, RaymarchingSteps of them through the side of the cube.*/
+	Fixed,
+	/** Longer steps through empty and nearly transparent space, shorter ones near transfer function edges, set by
+		RaymarchQuality. Only the OctreeSkipping material steps adaptively, the others keep fixed steps.*/
+	Adaptive
+};
+
+/** Implementations of propagating a light through the light volume. */
+UENUM(BlueprintType)
+enum class ELightPropagationEngine : uint8
+{
+	/** A dispatch per slice of the light volume. Works for any volume.*/
+	PerSlice,
+	/** A single dispatch walking all slices of an axis, synchronized in the shader. Only for light volumes with slices of up to
+		4096 voxels (e.g. 64x64), the rest falls back to PerSlice. Saves the dispatch overhead of small volumes.*/
+	SingleDispatch
 };
 
 UCLASS()
@@ -43,6 +74,9 @@ public:
 
 	virtual void OnConstruction(const FTransform& Transform) override;
 
+	/** Maps properties saved by older versions of the plugin to the ones replacing them.*/
+	virtual void PostLoad() override;
+
 	/** Updates a single provided light affecting the LightVolume. */
 	void UpdateSingleLight(ARaymarchLight* UpdatedLight);
 
@@ -60,9 +94,10 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool SetVolumeAsset(UVolumeAsset* InVolumeAsset);
 
-	/** Use faster shader for light calculation. Leads to instability with more lights.*/
+	/** How lights propagated one by one get propagated through the light volume. Batched and time-sliced propagation always
+		use a dispatch per slice.*/
 	UPROPERTY(EditAnywhere)
-	bool bFastShader = true;
+	ELightPropagationEngine LightPropagationEngine = ELightPropagationEngine::PerSlice;
 
 	/// Map for storing previous ticks parameters per-light. Used to detect changes.
 	UPROPERTY(Transient)
@@ -85,6 +120,139 @@ protected:
 	UFUNCTION()
 	void ResetAllLights();
 
+	/** Updates the light volume after the world parameters changed, recomputing all lights only if both the local clipping and
+		light directions changed (or re-propagating just the affected slices isn't cheaper).**/
+	void UpdateLightsForWorldParametersChange();
+
+	/** Re-propagates every light from the first slice the clipping change affects. Returns false without changing anything if
+		that's not cheaper than recomputing all lights.**/
+	bool UpdateLightsForClippingChange();
+
+	/** Starts the time-sliced recompute of all lights, restarts it if the lights or world parameters changed since it started, or
+		propagates the next chunk of it. Displays the new light volume once it's complete.**/
+	void TickTimeSlicedLightPropagation();
+
+	/** Makes the light volume the completed time-sliced recompute rendered into the displayed one.**/
+	void FinishTimeSlicedLightPropagation();
+
+	/** Drops the time-sliced recompute in flight, if any. The displayed light volume stays as it is.**/
+	void CancelTimeSlicedLightPropagation();
+
+	/** Creates the light volume time-sliced recomputes render into, unless it already exists. Returns false on failure.**/
+	bool EnsurePendingLightVolume();
+
+	/** Returns the dimensions of the light volume.**/
+	FIntVector GetLightVolumeDimensions() const;
+
+	/** Adds changed lights to the light volumes of their levels of detail, or refines one light by a level if nothing changed for
+		LightVolumeRefinementIdleFrames. Recomputes all lights if requested or if the world parameters changed the lights.**/
+	void TickMultiResolutionLightVolume(bool bWorldParametersChanged);
+
+	/** Recomputes all lights, each at the level of detail picked for it.**/
+	void ResetAllLightsMultiResolution();
+
+	/** A light being removed from and/or added to a level of detail of the multi-resolution light volume.**/
+	struct FLightVolumeLODChange
+	{
+		ARaymarchLight* Light = nullptr;
+		bool bRemove = false;
+		FDirLightParameters RemovedParameters;
+		int32 RemovedLevel = 0;
+		bool bAdd = false;
+		FDirLightParameters AddedParameters;
+		int32 AddedLevel = 0;
+	};
+
+	/** Propagates the changes into the light volumes of their levels of detail. The coarse light volumes the changes touch get
+		taken out of the full resolution one before and upsampled into it again after, unless bUpsampled is false because they
+		haven't been upsampled into it yet. Returns false on failure.**/
+	bool ApplyLightVolumeLODChanges(TArrayView<const FLightVolumeLODChange> Changes, bool bUpsampled = true);
+
+	/** Level of detail a light being interacted with gets propagated at, picked by LightVolumeLODPolicy.**/
+	int32 SelectLightVolumeLODForLight(const ARaymarchLight* Light) const;
+
+	/** Light intensity divided by the brightest light's intensity.**/
+	float GetRelativeLightContribution(const ARaymarchLight* Light) const;
+
+	/** Resources propagating into the light volume of a level of detail - the raymarch resources with the light volume and
+		read-write buffers of the level. Level 0 is the full resolution light volume.**/
+	FBasicRaymarchRenderingResources GetLightVolumeLODResources(int32 Level) const;
+
+	/** Creates the light volume and read-write buffers of a coarse level of detail, unless they already exist. Returns false on
+		failure.**/
+	bool EnsureCoarseLightVolume(int32 Level);
+
+	/** Releases the light volumes and read-write buffers of all coarse levels of detail.**/
+	void FreeCoarseLightVolumes();
+
+	/** Async compute work in flight (see bAsyncCompute).**/
+	struct FAsyncComputeWork
+	{
+		/** Set once the work is part of a render graph (see FRaymarchAsyncComputeSubmittedFlag), null if nothing is in flight.**/
+		TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> SubmittedFlag;
+		/** Ticks the work has been queued for, without a scene being rendered.**/
+		int32 FramesWaited = 0;
+	};
+
+	/** Returns true once the work in flight is part of a render graph. Adds it to a graph of its own if no scene got rendered for
+		a few frames, so that the light volume and octree get updated even without a visible viewport.**/
+	bool PollAsyncCompute(FAsyncComputeWork& Work);
+
+	/** Recomputes all lights into the pending light volume on the async compute queue if the lights or world parameters changed,
+		and displays the pending light volume once its recompute is done.**/
+	void TickAsyncComputeLightVolume(bool bWorldParametersChanged);
+
+	/** Regenerates the octree into the pending octree on the async compute queue if requested, and displays the pending octree
+		once it's generated.**/
+	void TickAsyncComputeOctree();
+
+	/** Creates the octree async compute generates into, unless it already exists. Returns false on failure.**/
+	bool EnsurePendingOctree();
+
+	/** Drops the async compute work in flight, if any. Flushes the work that's queued but not rendered yet, so that it doesn't
+		outlive the textures it renders into.**/
+	void CancelAsyncCompute();
+
+	/** True if the selected material samples the light volume.**/
+	bool UsesLightVolume() const;
+
+	/** True if the selected material samples the octree. False for renderers whose material is missing, as the material
+		they fall back to doesn't.**/
+	bool UsesOctree() const;
+
+	/** True if the volume gets raymarched at reduced resolution or accumulated over frames instead of by the material of its
+		mesh. See RaymarchResolution and bTemporalAccumulation.**/
+	bool UsesReducedResolution() const;
+
+	/** Hands the current state of the volume to the reduced resolution renderer and hides the mesh, or stops rendering at reduced
+		resolution and shows the mesh again if it's not used anymore.**/
+	void UpdateReducedResolutionRaymarch();
+
+	/** Stops rendering at reduced resolution, if the volume is, and shows the mesh again.**/
+	void StopReducedResolutionRaymarch();
+
+	/** Updates the light volume if the lights, the world parameters or anything the light volume depends on changed.**/
+	void TickLightVolume(bool bWorldParametersChanged);
+
+	/** Range of data values visible with the current transfer function and windowing. See GetOctreeVisibleRange().**/
+	FVector2f GetCurrentOctreeVisibleRange() const;
+
+	/** Sets what the octree material renders. It's shared by the Octree, OctreeSkipping and Projection renderers.**/
+	void SetOctreeMaterialMode(EOctreeMaterialMode Mode);
+
+	/** Sets the intensity projection of the octree material from RaymarchProjection.**/
+	void SetMaterialProjectionMode();
+
+	/** Sets the step count and adaptive step parameters of the octree material from RaymarchQuality.**/
+	void SetMaterialAdaptiveStepParameters();
+
+	/** Binds the TF texture, or its pre-integrated table if bPreIntegratedTF is set, to the lit material.**/
+	void SetLitMaterialTransferFunction();
+
+	/** Creates the pre-integrated table texture of a transfer function curve (the default TF if null). Like the TF texture, it
+		can be bound once rendering commands have been flushed.**/
+	void CreatePreIntegratedTFTexture(UCurveLinearColor* Curve);
+
 public:
 #if WITH_EDITOR
 	/** Fired when curve gradient is updated.*/
@@ -119,6 +287,12 @@ public:
 	/** Called every frame */
 	virtual void Tick(float DeltaTime) override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Destroyed() override;
+
+	virtual void BeginDestroy() override;
+
 	/** The loaded Volume asset belonging to this volume*/
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	UVolumeAsset* VolumeAsset = nullptr;
@@ -182,21 +356,224 @@ public:
 	UPROPERTY(VisibleAnywhere)
 	FRaymarchWorldParameters WorldParameters;
 
+	/** World parameters the light volume was last propagated with. Compared to the current world parameters instead of last
+		tick's, so that changes too small to classify as a rotation can't accumulate. **/
+	UPROPERTY(Transient)
+	FRaymarchWorldParameters LightVolumeWorldParameters;
+
+	/** Number of volume or clipping plane moves that didn't need all lights to be recomputed. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 LightRecomputesAvoided = 0;
+
+	/** Number of lights changed in place because the volume rotated or got scaled non-uniformly. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 IncrementalLightUpdates = 0;
+
+	/** If true, moving the clipping plane only re-propagates lights from the first slice the move affects, resuming from
+		snapshots of the light captured a few slices before the plane. **/
+	UPROPERTY(EditAnywhere)
+	bool bDirtyRegionLightRecompute = true;
+
+	/** Number of lights re-propagated only from the first slice a clipping change affected. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 DirtyRegionLightUpdates = 0;
+
+	/** If true, resetting the lights propagates lights that share their major axes together, up to 4 in a single sweep through
+		RGBA buffers, instead of sweeping through the volume once per light. Lights with clipping snapshots to capture still get
+		propagated one by one. **/
+	UPROPERTY(EditAnywhere)
+	bool bBatchedLightPropagation = true;
+
+	/** If true, recomputing all lights gets spread over several frames instead of hitching the one it's requested in. Every frame
+		propagates as many slices as fit into LightPropagationBudgetMs of GPU time, into a second light volume - the old one stays
+		displayed until the new one is complete. Lights or world parameters changing meanwhile restart the recompute. Costs the
+		memory of a second light volume. **/
+	UPROPERTY(EditAnywhere)
+	bool bTimeSlicedLightPropagation = false;
+
+	/** GPU time a time-sliced light recompute may take per frame, in milliseconds. At least one slice is propagated every frame,
+		no matter how small the budget. **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.1", EditCondition = "bTimeSlicedLightPropagation"))
+	float LightPropagationBudgetMs = 2.0f;
+
+	/** Sweeps (a light or batch of lights along one of its major axes) the time-sliced recompute in flight has left. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 LightPropagationQueueDepth = 0;
+
+	/** Time from starting the last completed time-sliced recompute to displaying its light volume. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	float LightPropagationLatencyMs = 0.0f;
+
+	/** Frames from starting the last completed time-sliced recompute to displaying its light volume. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 LightPropagationLatencyFrames = 0;
+
+	/** GPU time per light volume voxel the time-sliced recompute plans with, measured with GPU timestamps. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	float LightPropagationNanosecondsPerVoxel = 0.0f;
+
+	/** Number of time-sliced recomputes restarted because something changed before they were complete. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 LightPropagationRestarts = 0;
+
+	/** Plans the time-sliced recompute in flight. **/
+	FLightPropagationScheduler LightPropagationScheduler;
+
+	/** Lights of the time-sliced recompute in flight, in the order their parameters were given to the scheduler. **/
+	TArray<ARaymarchLight*> ScheduledLights;
+
+	/** Light propagation snapshots of a single light and the buffers holding them. **/
+	struct FLightSnapshotState
+	{
+		FLightPropagationSnapshots Snapshots;
+		FLightSnapshotBuffersPtr Buffers;
+	};
+
+	/** Snapshots of every light, valid for the light parameters in LightParametersMap and LightVolumeWorldParameters. **/
+	TMap<ARaymarchLight*, FLightSnapshotState> LightSnapshots;
+
+	/** If true, lights propagate into light volumes of half or quarter resolution while they're being changed, picked per light
+		by LightVolumeLODPolicy, and get trilinearly upsampled into the full resolution light volume. Once nothing changed for
+		LightVolumeRefinementIdleFrames, lights get re-propagated one level finer every frame, until all are at full resolution.
+		Takes precedence over batched, time-sliced and dirty-region light recomputes. **/
+	UPROPERTY(EditAnywhere)
+	bool bMultiResolutionLightVolume = false;
+
+	/** How the level of detail of a light being changed gets picked. **/
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bMultiResolutionLightVolume"))
+	ELightVolumeLODPolicy LightVolumeLODPolicy = ELightVolumeLODPolicy::Contribution;
+
+	/** Lights with an intensity below this fraction of the brightest light's propagate at half resolution while being changed,
+		below its square at quarter resolution. **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", ClampMax = "1.0", EditCondition = "bMultiResolutionLightVolume"))
+	float LightVolumeLODContributionThreshold = 0.5f;
+
+	/** Camera distance, in multiples of the volume's bounding box diagonal, from which lights propagate at half resolution while
+		being changed. Twice as far, they propagate at quarter resolution. **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", EditCondition = "bMultiResolutionLightVolume"))
+	float LightVolumeLODCameraDistance = 2.0f;
+
+	/** Frames without any light or world parameters change before lights start getting refined to full resolution. **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0", EditCondition = "bMultiResolutionLightVolume"))
+	int32 LightVolumeRefinementIdleFrames = 10;
+
+	/** Number of lights propagated at half or quarter resolution. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 CoarseLightPropagations = 0;
+
+	/** Number of lights re-propagated one level finer while the scene was idle. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 LightVolumeRefinements = 0;
+
+	/** Light volumes and read-write buffers of the half and quarter resolution levels of detail, created once a light propagates
+		at that level. Only the light volume, buffers and render cache id are set. **/
+	UPROPERTY(Transient)
+	FBasicRaymarchRenderingResources CoarseLightVolumeResources[LightVolumeLODCount - 1];
+
+	/** Level of detail every light in LightParametersMap is propagated at, while the multi-resolution light volume is used. **/
+	TMap<ARaymarchLight*, int32> LightVolumeLODs;
+
+	/** Frames since a light or the world parameters last changed the multi-resolution light volume. **/
+	int32 LightVolumeIdleFrames = 0;
+
+	/** If true, light propagation and octree generation run on the async compute queue, overlapping with the base pass and
+		translucency of the next rendered frame. Lights get recomputed into a second light volume and the octree into a second
+		octree, while the materials keep reading the last completed ones - so any change shows up a frame late and both targets
+		are kept in memory. Every change of the lights recomputes all of them (batched, if bBatchedLightPropagation is set). Takes
+		precedence over time-sliced and dirty-region light updates, the multi-resolution light volume takes precedence over it. **/
+	UPROPERTY(EditAnywhere)
+	bool bAsyncCompute = false;
+
+	/** Number of light volume recomputes run on the async compute queue. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 AsyncComputeLightRecomputes = 0;
+
+	/** Number of times async compute work got added to a graph of its own, because no scene got rendered. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	int32 AsyncComputeFlushes = 0;
+
+	/** Light volume recompute on the async compute queue in flight. **/
+	FAsyncComputeWork AsyncComputeLightVolume;
+
+	/** Lights of the async compute recompute in flight, their parameters and the world parameters they're propagated with. **/
+	TArray<ARaymarchLight*> AsyncComputeLights;
+	TArray<FDirLightParameters> AsyncComputeLightParameters;
+	FRaymarchWorldParameters AsyncComputeWorldParameters;
+
+	/** Octree generation on the async compute queue in flight. **/
+	FAsyncComputeWork AsyncComputeOctree;
+
 	/** The number of steps to take when raymarching. This is multiplied by the volume thickness in texture space, so can be
 	 * multiplied by anything from 0 to sqrt(3), Raymarcher will only take exactly this many steps when the path through the cube is
 	 * equal to the lenght of it's side. **/
 	UPROPERTY(EditAnywhere)
 	float RaymarchingSteps = 150;
 
+	/** How the OctreeSkipping material steps through the volume, the other materials always take fixed steps. **/
+	UPROPERTY(EditAnywhere)
+	ERaymarchStepping RaymarchStepping = ERaymarchStepping::Fixed;
+
+	/** Quality/performance target of adaptive stepping, replaces RaymarchingSteps. 0 takes the fewest samples, 1 comes closest
+		to a fine fixed step raymarch. See GetAdaptiveStepParameters(). **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 0, ClampMax = 1, EditCondition = "RaymarchStepping==ERaymarchStepping::Adaptive"))
+	float RaymarchQuality = 0.5f;
+
+	/** If true, the Lit material classifies whole ray segments between samples with a pre-integrated transfer function instead
+		of classifying every sample alone. Sharp transfer functions then need far fewer RaymarchingSteps for the same image.
+		The table gets bound to the lit material in place of the TF texture. **/
+	UPROPERTY(EditAnywhere)
+	bool bPreIntegratedTF = false;
+
+	/** Intensity projection the Projection renderer shows. MIP and MinIP skip octree nodes that can't beat the maximum
+		(minimum) found so far, so they need the octree. **/
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "SelectRaymarchMaterial==ERaymarchMaterial::Projection"))
+	ERaymarchProjection RaymarchProjection = ERaymarchProjection::Maximum;
+
+	/** Screen resolution the volume gets raymarched at. Half and Quarter march one ray per 2x2 (4x4) pixels and upsample them
+		with a depth- and edge-aware filter, drawn after temporal anti-aliasing instead of by the material of the mesh. Only the
+		Lit and OctreeSkipping materials can be rendered at reduced resolution, always with fixed steps and per sample
+		classification - the others stay at full resolution. See ReducedResolutionRaymarch.h. **/
+	UPROPERTY(EditAnywhere)
+	ERaymarchResolution RaymarchResolution = ERaymarchResolution::Full;
+
+	/** If true, pixels at the silhouettes of the volume and of geometry in front of or inside it get raymarched at full
+		resolution instead of upsampled. **/
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "RaymarchResolution!=ERaymarchResolution::Full"))
+	bool bRefineRaymarchEdges = true;
+
+	/** If true, every frame only marches 1 / TemporalStepFrames of RaymarchingSteps and the rays get accumulated over frames,
+		reprojected with the motion of the camera and the volume. The accumulated image restarts whenever the transfer function,
+		windowing, lights or clipping change. Drawn like at reduced resolution (also at Full), with the same restrictions on the
+		materials. **/
+	UPROPERTY(EditAnywhere)
+	bool bTemporalAccumulation = false;
+
+	/** Frames the steps of a ray get spread over with temporal accumulation. **/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = 1, ClampMax = 16, EditCondition = "bTemporalAccumulation"))
+	int32 TemporalStepFrames = 4;
+
+	/** True while the volume is drawn at reduced resolution or accumulated over frames and its mesh is hidden. **/
+	UPROPERTY(VisibleAnywhere, Transient)
+	bool bDrawnAtReducedResolution = false;
+
+	/** Changes whenever the transfer function or the light volume get rewritten, which throws away the image accumulated with
+		temporal accumulation. **/
+	uint32 RaymarchHistoryVersion = 0;
+
 	/** Define mip level that octree raymarch material will render.**/
 	UPROPERTY(EditAnywhere,meta=(EditCondition="SelectRaymarchMaterial==ERaymarchMaterial::Octree", EditConditionHides))
 	uint32 OctreeVolumeMip = 0;
 
-	/** If true, the light volume texture will be created using R32F format instead of the standard G8. This allows
-		Illumination values greater than 1 (over-lighted) to be visible. Comes at the cost of 4x memory consumption and
-		noticeably (but not significantly, in the ballpark of 10%) slower illumination calculation and materials.	**/
+	/** Format of the light volume texture and the buffers used for propagating light. G8 clamps illumination to 1. R16F and
+		R32F allow illumination values greater than 1 (over-lighted) to be visible, at the cost of 2x (R16F) or 4x (R32F) memory
+		consumption and noticeably (but not significantly, in the ballpark of 10%) slower illumination calculation and materials.
+		R16F keeps about 3 significant digits, which is plenty for light, at half the memory of R32F.	**/
 	UPROPERTY(EditAnywhere)
-	bool bLightVolume32Bit = false;
+	ELightVolumeFormat LightVolumeFormat = ELightVolumeFormat::G8;
+
+	/** Replaced by LightVolumeFormat. Only kept to load levels saved with it, true becomes R32F in PostLoad().**/
+	UPROPERTY()
+	bool bLightVolume32Bit_DEPRECATED = false;
 
 	/** Switches to using a new Transfer function curve.**/
 	UFUNCTION(BlueprintCallable)
@@ -264,4 +641,24 @@ public:
 	/** Sets the maximum amount of steps to be taken when raymarching.**/
 	UFUNCTION(BlueprintCallable)
 	void SetRaymarchSteps(float InRaymarchingSteps);
+
+	/** Sets the quality/performance target of adaptive stepping.**/
+	UFUNCTION(BlueprintCallable)
+	void SetRaymarchQuality(float InRaymarchQuality);
+
+	/** Switches pre-integrated classification of the Lit material on or off.**/
+	UFUNCTION(BlueprintCallable)
+	void SetPreIntegratedTF(bool bInPreIntegratedTF);
+
+	/** Sets the intensity projection the Projection renderer shows.**/
+	UFUNCTION(BlueprintCallable)
+	void SetRaymarchProjection(ERaymarchProjection InRaymarchProjection);
+
+	/** Sets the screen resolution the volume gets raymarched at.**/
+	UFUNCTION(BlueprintCallable)
+	void SetRaymarchResolution(ERaymarchResolution InRaymarchResolution);
+
+	/** Turns accumulating the raymarched image over frames on or off.**/
+	UFUNCTION(BlueprintCallable)
+	void SetTemporalAccumulation(bool bInTemporalAccumulation);
 };
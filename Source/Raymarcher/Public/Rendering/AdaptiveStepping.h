@@ -0,0 +1,93 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Adaptive step size raymarching, done by PerformWindowedAdaptiveRaymarch in WindowedRaymarchMaterials.usf. Empty octree
+// nodes get skipped whole, elsewhere the step length grows where the transfer function opacity barely varies and shrinks back
+// to the shortest step near transfer function edges. Opacity is corrected for the length of every step, so the composite stays
+// consistent with a fixed step raymarch.
+// Also contains a CPU model of the adaptive and the fixed step raymarch, for measuring the image error and sample counts of
+// adaptive stepping without a GPU.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/OctreeCPU.h"
+
+/// Parameters of an adaptive step size raymarch.
+struct RAYMARCHER_API FAdaptiveStepParameters
+{
+	/// Steps per unit of UVW space at the shortest step length.
+	float StepCount = 150.0f;
+
+	/// Longest step through non-empty space, in shortest steps.
+	float MaxStepScale = 4.0f;
+
+	/// Variation of the transfer function opacity that still gets the shortest step. Less variation lengthens the step
+	/// proportionally.
+	float Tolerance = 0.05f;
+};
+
+/// Adaptive step parameters for a quality/performance target in [0, 1]. 0 takes the fewest samples, 1 comes closest to a fine
+/// fixed step raymarch.
+RAYMARCHER_API FAdaptiveStepParameters GetAdaptiveStepParameters(float Quality);
+
+/// Length of the next step through a non-empty octree node, in shortest steps. Equivalent of GetAdaptiveStepScale() in
+/// WindowedRaymarchMaterials.usf.
+/// @param NodeAlphas Transfer function opacity of the minimum, middle and maximum value of the octree node the sample is in.
+/// @param SampleAlpha Transfer function opacity of the sample.
+/// Both are taken before opacity correction. A transfer function peak between the node's taps goes unnoticed, unless the sample
+/// itself is on it.
+RAYMARCHER_API float GetAdaptiveStepScale(
+	const FVector3f& NodeAlphas, float SampleAlpha, const FAdaptiveStepParameters& Parameters);
+
+/// Counters of CPU raymarches.
+struct RAYMARCHER_API FRaymarchCPUStats
+{
+	int64 Rays = 0;
+
+	/// Samples of the data volume taken.
+	int64 Samples = 0;
+
+	/// Octree texels read.
+	int64 NodeVisits = 0;
+
+	double GetSamplesPerRay() const;
+};
+
+/// CPU model of the unlit fixed step raymarch (PerformWindowedOctreeSkippingRaymarch without skipping), without the jitter and
+/// clipping. Marches a ray from Entry (in UVW space) along the normalized Direction with Thickness * StepCount steps of
+/// 1 / StepCount. Returns the accumulated color (premultiplied by opacity) and opacity.
+RAYMARCHER_API FLinearColor RaymarchFixedStep_CPU(const FRaymarchCPUResources& Resources, const FVector3f& Entry,
+	const FVector3f& Direction, float Thickness, float StepCount, FRaymarchCPUStats& Stats);
+
+/// CPU model of PerformWindowedAdaptiveRaymarch in WindowedRaymarchMaterials.usf, without the jitter and clipping.
+/// Same as RaymarchFixedStep_CPU() with Parameters.StepCount if Parameters.MaxStepScale is 1.
+/// @param VisibleRange See GetOctreeVisibleRange().
+RAYMARCHER_API FLinearColor RaymarchAdaptiveStep_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips,
+	const FVector2f& VisibleRange, const FVector3f& Entry, const FVector3f& Direction, float Thickness,
+	const FAdaptiveStepParameters& Parameters, FRaymarchCPUStats& Stats);
+
+/// Image error and sample counts of an adaptive step raymarch against a fixed step one.
+struct RAYMARCHER_API FAdaptiveStepComparisonCPU
+{
+	FRaymarchCPUStats Fixed;
+	FRaymarchCPUStats Adaptive;
+
+	/// Mean and maximum over all pixels of the largest difference of a color channel or the opacity.
+	double MeanError = 0.0;
+	double MaxError = 0.0;
+
+	/// Fraction of the samples of the fixed step raymarch that the adaptive one takes.
+	double GetSampleFraction() const;
+
+	FString ToString() const;
+};
+
+/// Renders Resolution x Resolution orthographic pixels of the volume (the unit cube in UVW space) looking along ViewDirection, with
+/// fixed steps of 1 / FixedStepCount and with adaptive steps, and compares the two.
+RAYMARCHER_API FAdaptiveStepComparisonCPU CompareAdaptiveStepRaymarch_CPU(const FRaymarchCPUResources& Resources,
+	const TArray<FOctreeMipCPU>& Mips, const FVector2f& VisibleRange, const FVector3f& ViewDirection, int32 Resolution,
+	float FixedStepCount, const FAdaptiveStepParameters& Parameters);
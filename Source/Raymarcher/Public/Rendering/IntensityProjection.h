@@ -0,0 +1,58 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Maximum, minimum and average intensity projections (MIP, MinIP and AIP), done by PerformWindowedProjectionRaymarch in
+// WindowedRaymarchMaterials.usf. The projected data value is windowed into grayscale like the intensity material does.
+// MIP and MinIP traverse the octree and skip every node whose max (min) can't beat the maximum (minimum) found so far, so most of a
+// ray past the brightest (darkest) structure is crossed in a few coarse steps. They also stop as soon as the projection saturates
+// the window.
+// Also contains a CPU projector, used as a reference for the material and for benchmarking the skipping without a GPU.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/OctreeCPU.h"
+#include "Rendering/RaymarchTypes.h"
+
+/// Counters of CPU projections.
+struct RAYMARCHER_API FProjectionCPUStats
+{
+	int64 Rays = 0;
+
+	/// Samples of the data volume taken.
+	int64 Samples = 0;
+
+	/// Samples a projection without skipping or early termination would take along the same rays.
+	int64 FullSamples = 0;
+
+	/// Octree texels read.
+	int64 NodeVisits = 0;
+
+	/// Wall-clock duration of the projection in seconds.
+	double Seconds = 0.0;
+
+	/// Fraction of the samples of a projection without skipping that were taken.
+	double GetSampleFraction() const;
+
+	FString ToString() const;
+};
+
+/// CPU model of PerformWindowedProjectionRaymarch in WindowedRaymarchMaterials.usf, without the jitter and clipping. Marches a ray
+/// from Entry (in UVW space) along the normalized Direction with Thickness * StepCount steps of 1 / StepCount. MIP and MinIP skip
+/// octree nodes using Mips unless it's empty.
+/// @param OutValue The projected data value, before windowing. Once the projection saturates the window, the ray ends early, so
+/// a MIP (MinIP) value is then only known to be at or above (below) the window.
+/// @returns False if the ray takes no samples.
+RAYMARCHER_API bool ProjectRay_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips,
+	ERaymarchProjection Projection, const FVector3f& Entry, const FVector3f& Direction, float Thickness, float StepCount,
+	float& OutValue, FProjectionCPUStats& Stats);
+
+/// Renders Resolution x Resolution orthographic pixels of the volume (the unit cube in UVW space) looking along ViewDirection.
+/// OutImage holds the grayscale the projection material shows for every pixel, X-major, zero where the ray misses the volume.
+/// Rows are spread over the task graph workers.
+RAYMARCHER_API void RenderProjection_CPU(const FRaymarchCPUResources& Resources, const TArray<FOctreeMipCPU>& Mips,
+	ERaymarchProjection Projection, const FVector3f& ViewDirection, int32 Resolution, float StepCount, TArray<float>& OutImage,
+	FProjectionCPUStats& Stats);
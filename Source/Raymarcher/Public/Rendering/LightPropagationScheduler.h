@@ -0,0 +1,166 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Spreads recomputing a whole light volume over several frames. The propagation of every light (or batch of lights) is cut into
+// chunks of slices and every frame gets as many chunks as fit into a GPU time budget, estimated from timestamps of the chunks
+// already done. The owner renders the chunks into a second light volume and keeps displaying the old one until it's complete.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "RHICommandList.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "Rendering/RaymarchTypes.h"
+
+/// A light, or a batch of lights sharing their major axes, propagated by FLightPropagationScheduler.
+struct RAYMARCHER_API FScheduledLightPropagation
+{
+	TArray<FDirLightParameters> Lights;
+
+	/// Slices of the sweep along each of the major axes. 0 if none of the lights propagates along the axis.
+	int32 AxisSteps[2] = {0, 0};
+
+	/// Voxels in one slice along each of the major axes.
+	int64 SliceVoxels[2] = {0, 0};
+};
+
+/// Slices of one scheduled propagation to run in a frame.
+struct FLightPropagationChunk
+{
+	/// Index into FLightPropagationScheduler::GetPropagations().
+	int32 PropagationIndex = 0;
+
+	FLightPropagationRange Range;
+
+	/// Light volume voxels the chunk processes.
+	int64 Voxels = 0;
+};
+
+/// Timestamps around the chunks of a frame, read back without stalling once the GPU is done with them.
+/// Everything but the measurements queue is only touched on the render thread.
+class FLightPropagationGPUTimer
+{
+public:
+	void Begin(FRHICommandListImmediate& RHICmdList);
+
+	void End(FRHICommandListImmediate& RHICmdList, int64 Voxels);
+
+	/// Moves the timestamps the GPU is done with to Measurements.
+	void Poll();
+
+	/// Voxels and milliseconds of every measured frame, consumed by the game thread.
+	TQueue<TPair<int64, double>, EQueueMode::Spsc> Measurements;
+
+private:
+	struct FPendingQuery
+	{
+		FRenderQueryRHIRef Begin;
+		FRenderQueryRHIRef End;
+		int64 Voxels = 0;
+	};
+
+	TArray<FPendingQuery> PendingQueries;
+
+	FRenderQueryRHIRef CurrentBegin;
+};
+
+/// Plans and runs time-sliced light volume recomputes. Game thread only.
+class RAYMARCHER_API FLightPropagationScheduler
+{
+public:
+	FLightPropagationScheduler();
+
+	/// Starts propagating the lights into a cleared light volume of the given dimensions. Cancels the propagation in flight.
+	/// If bBatched, lights sharing their major axes get propagated together (see GroupLightsIntoBatches()), which needs batch
+	/// buffers in the resources the chunks get executed with.
+	void Start(TArrayView<const FDirLightParameters> InLights, const FRaymarchWorldParameters& InWorldParameters,
+		const FIntVector& LightVolumeDimensions, bool bBatched);
+
+	/// Drops the propagation in flight. Chunks already executed stay in the light volume they were rendered into.
+	void Cancel();
+
+	bool IsActive() const
+	{
+		return bActive;
+	}
+
+	/// True once every chunk of the propagation in flight has been planned.
+	bool IsComplete() const;
+
+	/// True if the propagation in flight doesn't result in the light volume for these lights and world parameters anymore.
+	bool IsOutdated(TArrayView<const FDirLightParameters> InLights, const FRaymarchWorldParameters& InWorldParameters) const;
+
+	/// Plans the chunks of the next frame - as many slices as the estimated GPU time per voxel lets fit into BudgetMs, but at
+	/// least one, so that the propagation finishes even with a tiny budget.
+	TArray<FLightPropagationChunk> PlanFrame(float BudgetMs);
+
+	/// Adds the chunks to the light volume in Resources on the render thread and measures how long the GPU takes for them.
+	void ExecuteChunks(const FBasicRaymarchRenderingResources& Resources, const TArray<FLightPropagationChunk>& Chunks);
+
+	/// Updates the estimated GPU time per voxel with a measurement.
+	void AddGPUTimeMeasurement(int64 Voxels, double Milliseconds);
+
+	/// Number of sweeps (one light or batch along one of its major axes) that haven't been completely planned yet.
+	int32 GetQueueDepth() const;
+
+	double GetNanosecondsPerVoxel() const
+	{
+		return NanosecondsPerVoxel;
+	}
+
+	/// Lights the propagation in flight was started with, including any without a direction.
+	const TArray<FDirLightParameters>& GetLights() const
+	{
+		return Lights;
+	}
+
+	const FRaymarchWorldParameters& GetWorldParameters() const
+	{
+		return WorldParameters;
+	}
+
+	const TArray<FScheduledLightPropagation>& GetPropagations() const
+	{
+		return Propagations;
+	}
+
+	/// Frames planned since the propagation in flight started.
+	int32 GetFramesPlanned() const
+	{
+		return FramesPlanned;
+	}
+
+	/// Wall-clock time since the propagation in flight started.
+	double GetSecondsSinceStart() const;
+
+	/// GPU time per voxel assumed before the first measurement comes back.
+	static constexpr double DefaultNanosecondsPerVoxel = 0.5;
+
+private:
+	/// Moves the position to the next sweep with slices left to plan.
+	void SkipFinishedSweeps();
+
+	TArray<FScheduledLightPropagation> Propagations;
+
+	/// Lights and world parameters the propagation in flight was started with.
+	TArray<FDirLightParameters> Lights;
+	FRaymarchWorldParameters WorldParameters;
+
+	/// Position of the next chunk to plan.
+	int32 CurrentPropagation = 0;
+	int32 CurrentAxis = 0;
+	int32 CurrentStep = 0;
+
+	bool bActive = false;
+
+	int32 FramesPlanned = 0;
+	double StartSeconds = 0.0;
+
+	double NanosecondsPerVoxel = DefaultNanosecondsPerVoxel;
+	bool bHasMeasurement = false;
+
+	TSharedRef<FLightPropagationGPUTimer, ESPMode::ThreadSafe> GPUTimer;
+};
@@ -0,0 +1,52 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Levels of detail of a multi-resolution light volume. Every light is propagated into the light volume of one level - full, half
+// or quarter resolution - and the coarse levels are trilinearly upsampled into the full resolution one, which gets sampled by the
+// materials. Lights being interacted with propagate at a level picked by their contribution or the camera distance, and get
+// refined to full resolution one level at a time once the scene is idle.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "LightVolumeLOD.generated.h"
+
+/// How the level of detail of a light being interacted with gets picked.
+UENUM(BlueprintType)
+enum class ELightVolumeLODPolicy : uint8
+{
+	/// Lights contributing little compared to the brightest light propagate at a lower resolution.
+	Contribution,
+	/// All lights propagate at a lower resolution when the camera is far away from the volume.
+	CameraDistance
+};
+
+/// Number of light volume levels of detail - full, half and quarter resolution.
+constexpr int32 LightVolumeLODCount = 3;
+
+/// Thresholds of ELightVolumeLODPolicy.
+struct RAYMARCHER_API FLightVolumeLODSettings
+{
+	/// Lights with an intensity below this fraction of the brightest light's propagate at half resolution, below its square at
+	/// quarter resolution.
+	float ContributionThreshold = 0.5f;
+
+	/// Camera distance, in multiples of the volume's bounding box diagonal, from which lights propagate at half resolution. Twice
+	/// as far, they propagate at quarter resolution.
+	float CameraDistanceThreshold = 2.0f;
+};
+
+/// Dimensions of the light volume of a level - the full resolution ones divided by 2^Level, rounded up.
+RAYMARCHER_API FIntVector GetLightVolumeLODDimensions(const FIntVector& FullDimensions, int32 Level);
+
+/// Level a light being interacted with gets propagated at. RelativeContribution is the light's intensity divided by the
+/// brightest light's, CameraDistance is in multiples of the volume's bounding box diagonal.
+RAYMARCHER_API int32 SelectLightVolumeLOD(ELightVolumeLODPolicy Policy, const FLightVolumeLODSettings& Settings,
+	float RelativeContribution, float CameraDistance);
+
+/// Picks the light to refine by one level next - one of the lights at the coarsest level, the one contributing the most of those.
+/// Returns INDEX_NONE if all lights are at full resolution.
+RAYMARCHER_API int32 PickLightVolumeLODRefinement(TArrayView<const int32> Levels, TArrayView<const float> Contributions);
@@ -0,0 +1,146 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// CPU implementation of the directional light propagation done by AddDirLightShader.usf and ChangeDirLightShader.usf.
+// Runs the same slice-by-slice ping-pong propagation with the rows of each slice spread over the task graph workers.
+// Used as a golden reference for the shaders and for benchmarking the algorithm without a GPU.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "Rendering/RaymarchTypes.h"
+
+/// CPU-side equivalent of the parts of FBasicRaymarchRenderingResources used by light propagation.
+struct RAYMARCHER_API FRaymarchCPUResources
+{
+	/// Dimensions of the data volume.
+	FIntVector DataDimensions = FIntVector(0, 0, 0);
+
+	/// Data volume values, X-major, exactly as the shaders would sample them (e.g. normalized to [0, 1] for G8/G16 volumes).
+	TArray64<float> DataVolume;
+
+	/// One row of the transfer function texture.
+	TArray<FLinearColor> TransferFunction;
+
+	FWindowingParameters WindowingParameters;
+
+	/// Dimensions of the light volume (can be smaller than the data volume, e.g. half resolution).
+	FIntVector LightVolumeDimensions = FIntVector(0, 0, 0);
+
+	/// The light volume, X-major. This is what propagation modifies.
+	TArray64<float> LightVolume;
+
+	/// Format the light volume and the light buffers are stored in on the GPU. Everything propagation stores gets rounded to it
+	/// (see QuantizeLightValue()), so that the quantization error of a format can be measured.
+	ELightVolumeFormat LightVolumeFormat = ELightVolumeFormat::R32F;
+
+	/// Sets up a zeroed light volume of the given dimensions.
+	void InitLightVolume(FIntVector Dimensions);
+};
+
+/// Rounds a light value to what a light volume or light buffer of the given format stores - clamped to [0, 1] and quantized to
+/// 1/255 for G8, rounded to the nearest 16-bit float for R16F and unchanged for R32F.
+RAYMARCHER_API float QuantizeLightValue(float Value, ELightVolumeFormat Format);
+
+/// Equivalent of SampleWindowedTransferFunction() in WindowedSampling.usf - the transfer function color of a data value, with the
+/// opacity corrected for StepSize (in Unreal units, 1 leaves it as it is in the transfer function).
+RAYMARCHER_API FLinearColor SampleWindowedTransferFunction_CPU(
+	const FRaymarchCPUResources& Resources, float DataValue, float StepSize);
+
+/// Equivalent of SampleWindowedVolumeStep() in WindowedSampling.usf. Samples the data volume trilinearly at UVW.
+RAYMARCHER_API FLinearColor SampleWindowedVolumeStep_CPU(
+	const FRaymarchCPUResources& Resources, const FVector& UVW, float StepSize);
+
+/// Trilinear sample of the data volume at UVW with clamped addressing, like the Clamp_WorldGroupSettings sampler of the intensity
+/// and projection materials.
+RAYMARCHER_API float SampleDataVolume_CPU(const FRaymarchCPUResources& Resources, const FVector& UVW);
+
+/// Timing of a CPU light propagation.
+struct RAYMARCHER_API FLightPropagationCPUStats
+{
+	/// Number of light volume voxels processed (a voxel is counted once per axis it gets propagated along).
+	int64 VoxelsProcessed = 0;
+
+	/// Number of slices propagated.
+	int32 SlicesProcessed = 0;
+
+	/// Wall-clock duration of the whole propagation in seconds.
+	double Seconds = 0.0;
+
+	/// Duration of the slowest slice in seconds.
+	double MaxSliceSeconds = 0.0;
+
+	double GetVoxelsPerSecond() const;
+
+	double GetAverageSliceSeconds() const;
+
+	/// Adds the counters of another propagation to these.
+	void Accumulate(const FLightPropagationCPUStats& Other);
+
+	FString ToString() const;
+};
+
+/// CPU equivalent of FLightSnapshotBuffers together with the slices captured in them.
+struct RAYMARCHER_API FLightSnapshotsCPU
+{
+	FLightPropagationSnapshots Snapshots;
+
+	/// Captured light buffers, per axis and buffer index.
+	TArray<float> Buffers[2][2];
+};
+
+/// CPU version of AddDirLightToSingleLightVolume_RenderThread. Adds (or removes, if Added is false) a directional light to the
+/// light volume in Resources. If Snapshots are provided, captures the slices in Snapshots->Snapshots.
+RAYMARCHER_API void AddDirLightToSingleLightVolume_CPU(FRaymarchCPUResources& Resources, const FDirLightParameters LightParameters,
+	const bool Added, const FRaymarchWorldParameters WorldParameters, FLightPropagationCPUStats* OutStats = nullptr,
+	FLightSnapshotsCPU* Snapshots = nullptr);
+
+/// What the CPU model of the single dispatch propagation found out about its barrier schedule.
+struct RAYMARCHER_API FGPUSyncScheduleCPUStats
+{
+	/// Axes propagated in a single dispatch.
+	int32 SingleDispatchAxes = 0;
+
+	/// Axes with slices too large for a single dispatch, which fell back to a dispatch per slice.
+	int32 PerSliceAxes = 0;
+
+	/// Group barriers executed by the single dispatch axes (one after clearing the buffer plus one per slice).
+	int32 Barriers = 0;
+
+	/// Group shared memory accesses racing with an access of another thread between the same two barriers.
+	int32 Hazards = 0;
+};
+
+/// CPU model of AddDirLightToSingleLightVolume_GPUSync_RenderThread. Runs the threads of the single thread group one after
+/// another between the group barriers of AddDirLightShader_GPUSync.usf, tracking their group shared memory accesses, so that
+/// the result can be compared to AddDirLightToSingleLightVolume_CPU() and the schedule checked for races.
+RAYMARCHER_API void AddDirLightToSingleLightVolume_GPUSync_CPU(FRaymarchCPUResources& Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	FGPUSyncScheduleCPUStats* OutStats = nullptr);
+
+/// CPU version of AddUpsampledLightVolume_RenderThread. Adds the light volume of CoarseResources, trilinearly upsampled and
+/// multiplied by Weight, to the light volume of Resources.
+RAYMARCHER_API void AddUpsampledLightVolume_CPU(
+	FRaymarchCPUResources& Resources, const FRaymarchCPUResources& CoarseResources, float Weight);
+
+/// CPU version of AddDirLightsToSingleLightVolume_RenderThread. Propagates lights sharing their major axes together in batches of
+/// up to MaxBatchedLights, summing them up before adding them to the light volume.
+RAYMARCHER_API void AddDirLightsToSingleLightVolume_CPU(FRaymarchCPUResources& Resources,
+	TArrayView<const FDirLightParameters> LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	FLightPropagationCPUStats* OutStats = nullptr);
+
+/// CPU version of ChangeClippingInSingleLightVolume_RenderThread. Resumes from and captures into Snapshots as the plan says, and
+/// updates Snapshots->Snapshots to Plan.NewSnapshots.
+RAYMARCHER_API void ChangeClippingInSingleLightVolume_CPU(FRaymarchCPUResources& Resources,
+	const FDirLightParameters LightParameters, const FRaymarchWorldParameters OldWorldParameters,
+	const FRaymarchWorldParameters NewWorldParameters, const FClippingChangePlan& Plan, FLightSnapshotsCPU& Snapshots,
+	FLightPropagationCPUStats* OutStats = nullptr);
+
+/// CPU version of ChangeDirLightInSingleLightVolume_RenderThread. Removes the old light and adds the new one in a single pass if
+/// both propagate along the same major axes, otherwise falls back to a separate removal and addition.
+RAYMARCHER_API void ChangeDirLightInSingleLightVolume_CPU(FRaymarchCPUResources& Resources,
+	const FDirLightParameters RemovedLightParameters, const FDirLightParameters AddedLightParameters,
+	const FRaymarchWorldParameters WorldParameters, FLightPropagationCPUStats* OutStats = nullptr);
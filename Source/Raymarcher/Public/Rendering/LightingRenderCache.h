@@ -0,0 +1,91 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Render thread cache of what the light propagation would otherwise re-create with every light it adds or changes - border
+// samplers of the data volume and the read-write buffers and the per-axis constants of every light. Entries are kept per set of
+// FBasicRaymarchRenderingResources and only dropped when the resources get freed or re-created.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("Raymarcher"), STATGROUP_Raymarcher, STATCAT_Advanced);
+
+/// RHI objects (samplers, textures, UAVs) created for light propagation in a frame.
+DECLARE_DWORD_COUNTER_STAT_EXTERN(
+	TEXT("Lighting RHI Object Creations"), STAT_RaymarcherLightingRHICreations, STATGROUP_Raymarcher, RAYMARCHER_API);
+
+class RAYMARCHER_API FLightingRenderCache
+{
+public:
+	/// The cache of the render thread. Only to be used on the render thread.
+	static FLightingRenderCache& Get();
+
+	/// Returns a new id to identify a freshly created set of FBasicRaymarchRenderingResources with. Never returns 0, which
+	/// resources not created by a raymarch volume keep and which doesn't get cached. Thread safe.
+	static uint32 AllocateResourcesId();
+
+	/// Bilinear sampler for the read-write buffers, returning BorderColorInt outside of them.
+	FSamplerStateRHIRef GetBufferSampler(uint32 ResourcesId, uint32 BorderColorInt);
+
+	/// Trilinear sampler for the data volume, returning BorderColorInt outside of it.
+	FSamplerStateRHIRef GetVolumeSampler(uint32 ResourcesId, uint32 BorderColorInt);
+
+	/// Returns GetLightAxisConstants() for the local light and axes.
+	FLightAxisConstants GetAxisConstants(uint32 ResourcesId, const FDirLightParameters& LocalLightParams,
+		const FMajorAxes& LocalMajorAxes, const unsigned AxisIndex, const FIntVector& TransposedDimensions);
+
+	/// Drops everything cached for the resources. To be called when they get freed.
+	void Invalidate(uint32 ResourcesId);
+
+	/// True if anything is cached for the resources.
+	bool IsCached(uint32 ResourcesId) const
+	{
+		return Entries.Contains(ResourcesId);
+	}
+
+	/// Samplers created since the cache was created, cached or not.
+	int32 GetNumCreatedSamplers() const
+	{
+		return NumCreatedSamplers;
+	}
+
+	/// Caches get reset when they grow past this, so that lights being moved around don't keep adding entries forever.
+	static constexpr int32 MaxEntriesPerCache = 256;
+
+private:
+	struct FAxisConstantsKey
+	{
+		FVector LightDirection;
+		FIntVector TransposedDimensions;
+		uint32 AxisIndex;
+
+		friend bool operator==(const FAxisConstantsKey& Lhs, const FAxisConstantsKey& Rhs)
+		{
+			return Lhs.LightDirection == Rhs.LightDirection && Lhs.TransposedDimensions == Rhs.TransposedDimensions &&
+				   Lhs.AxisIndex == Rhs.AxisIndex;
+		}
+
+		friend uint32 GetTypeHash(const FAxisConstantsKey& Key)
+		{
+			return HashCombine(HashCombine(GetTypeHash(Key.LightDirection), GetTypeHash(Key.TransposedDimensions)), Key.AxisIndex);
+		}
+	};
+
+	struct FResourcesEntry
+	{
+		TMap<FSamplerStateInitializerRHI, FSamplerStateRHIRef> Samplers;
+		TMap<FAxisConstantsKey, FLightAxisConstants> AxisConstants;
+	};
+
+	FSamplerStateRHIRef GetSampler(uint32 ResourcesId, const FSamplerStateInitializerRHI& Initializer);
+
+	TMap<uint32, FResourcesEntry> Entries;
+
+	int32 NumCreatedSamplers = 0;
+};
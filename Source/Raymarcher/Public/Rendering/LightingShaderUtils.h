@@ -57,6 +57,10 @@ struct FMajorAxes
 /// Returns the dimensions of the plane cutting through the volume when going along an axis at the given indes.
 FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FRHITexture3D* VolumeRef, const unsigned index);
 
+/// Same as above, for a volume that only exists on the CPU.
+RAYMARCHER_API FIntVector GetTransposedDimensions(
+	const FMajorAxes& Axes, const FIntVector& VolumeDimensions, const unsigned index);
+
 /// Returns +1 if going along the specified axis index means increasing the index.
 /// Returns -1 if going along the axis decreases the index.
 /// E.G. if we're going along +X axis, will return 1, going along -X will return -1.
@@ -66,6 +70,10 @@ int GetAxisDirection(const FMajorAxes& Axes, unsigned index);
 OneAxisReadWriteBufferResources& GetBuffers(
 	const FMajorAxes& Axes, const unsigned index, FBasicRaymarchRenderingResources& InParams);
 
+/// Returns the RGBA ReadWriteBuffer resource used for propagating a batch of lights along the axis index.
+OneAxisReadWriteBufferResources& GetBatchBuffers(
+	const FMajorAxes& Axes, const unsigned index, FBasicRaymarchRenderingResources& InParams);
+
 // Comparison function for a Face-weight pair, to sort in Descending order.
 static bool SortDescendingWeights(const std::pair<FCubeFace, float>& a, const std::pair<FCubeFace, float>& b);
 
@@ -79,20 +87,48 @@ void GetStepSizeAndUVWOffset(FCubeFace Axis, FVector LightPosition, FIntVector T
 	const FRaymarchWorldParameters WorldParameters, float& OutStepSize, FVector& OutUVWOffset);
 
 /// For the given light parameters and volume transform, returns the the Local Directional Lihgt parameters and Major Axes for illumination.
-void GetLocalLightParamsAndAxes(const FDirLightParameters& LightParameters, const FTransform& VolumeTransform,
+RAYMARCHER_API void GetLocalLightParamsAndAxes(const FDirLightParameters& LightParameters, const FTransform& VolumeTransform,
 	FDirLightParameters& OutLocalLightParameters, FMajorAxes& OutLocalMajorAxes);
 
 /// Creates a SamplerState RHI with "Border" handling of outside-of-UV reads.
 /// The color read from outside the buffer is specified by the BorderColorInt.
+/// Creates a new sampler on every call - the lighting passes get theirs from FLightingRenderCache instead.
 FSamplerStateRHIRef GetBufferSamplerRef(uint32 BorderColorInt);
 
 /// Returns the integer specifying the color needed for the border sampler.
 /// Used for sampling the light outside the edge of the Read buffer.
 uint32 GetBorderColorIntSingle(FDirLightParameters LightParams, FMajorAxes MajorAxes, unsigned index);
 
+/// Same as above for a batch of lights - every channel holds the light alpha of the light propagated in it.
+uint32 GetBorderColorIntBatched(const FLinearColor& LightAlphas);
+
 /// Returns clipping parameters from global world parameters.
 FClippingPlaneParameters GetLocalClippingParameters(const FRaymarchWorldParameters WorldParameters);
 
+/// How a change of the world parameters affects a light volume propagated with the old ones.
+/// Light propagation only depends on the world parameters through the local light directions and the local clipping plane.
+enum class ELightVolumeInvalidation : uint8
+{
+	/// Local light directions and clipping are unchanged (translation or uniform scale) - the light volume stays valid.
+	None,
+	/// Local light directions changed (rotation or non-uniform scale), clipping didn't - every light can be changed in place.
+	LightDirections,
+	/// Local clipping changed, light directions didn't - every light can be re-propagated from the first slice the clipping
+	/// change affects (see PlanClippingChange()).
+	Clipping,
+	/// Both changed - the light volume needs to be recomputed from scratch.
+	Full
+};
+
+/// Classifies the change from the world parameters a light volume was propagated with to new ones.
+RAYMARCHER_API ELightVolumeInvalidation ClassifyWorldParametersChange(
+	const FRaymarchWorldParameters& OldWorldParameters, const FRaymarchWorldParameters& NewWorldParameters);
+
+/// Returns light parameters that give the same local light direction under NewTransform as LightParameters give under
+/// OldTransform. Lets a light propagated with an old volume transform get removed by shaders using the new one.
+RAYMARCHER_API FDirLightParameters GetLightParametersForTransform(
+	const FDirLightParameters& LightParameters, const FTransform& OldTransform, const FTransform& NewTransform);
+
 // Returns the light's alpha at this major axis and weight (single channel)
 float GetLightAlpha(FDirLightParameters LightParams, FMajorAxes MajorAxes, unsigned index);
 
@@ -104,6 +140,199 @@ FMatrix GetPermutationMatrix(FMajorAxes MajorAxes, unsigned index);
 void GetLoopStartStopIndexes(
 	int& OutStart, int& OutStop, int& OutAxisDirection, const FMajorAxes& MajorAxes, const unsigned& index, const int zDimension);
 
-// Used for swapping read/write buffers - transitions one to Readable and other to Writable.
-void TransitionBufferResources(
-	FRHICommandListImmediate& RHICmdList, FRHITexture* NewlyReadableTexture, FRHIUnorderedAccessView* NewlyWriteableUAV);
+/// Constants of a light's propagation along one of its major axes, the same for every slice of the axis.
+struct FLightAxisConstants
+{
+	FMatrix44f PermutationMatrix = FMatrix44f::Identity;
+
+	/// UV offset to read the previous slice's buffer at.
+	FVector2f PrevPixelOffset = FVector2f::ZeroVector;
+
+	/// UVW offset towards the light, normalized to the length of the largest voxel side to get rid of artifacts. (Not correct,
+	/// but consistent!)
+	FVector3f UVWOffset = FVector3f::ZeroVector;
+
+	float StepSize = 0.0f;
+};
+
+/// Returns the propagation constants of a light along the index-th of its major axes. The light parameters and axes are local
+/// (see GetLocalLightParamsAndAxes()), TransposedDimensions are the light volume dimensions transposed to the axis.
+RAYMARCHER_API FLightAxisConstants GetLightAxisConstants(const FDirLightParameters& LocalLightParams,
+	const FMajorAxes& LocalMajorAxes, const unsigned index, const FIntVector& TransposedDimensions);
+
+/// Maximum number of lights propagated together - one per channel of the RGBA batch buffers.
+constexpr int32 MaxBatchedLights = 4;
+
+/// Threads of the single thread group that propagates a light through all slices in one dispatch (see
+/// AddDirLightShader_GPUSync.usf, GPUSYNC_NUM_THREADS has to be the same). Every thread handles every GPUSyncNumThreads-th
+/// pixel of a slice.
+constexpr int32 GPUSyncNumThreads = 1024;
+
+/// Largest slice the single dispatch propagation can handle - both of its ping-pong buffers have to fit into the 32 KB of group
+/// shared memory (GPUSYNC_MAX_SLICE_PIXELS in AddDirLightShader_GPUSync.usf has to be the same).
+constexpr int32 GPUSyncMaxSlicePixels = 4096;
+
+/// True if the slices of a light volume transposed to a propagation axis (see GetTransposedDimensions()) are small enough to be
+/// propagated in a single dispatch.
+RAYMARCHER_API bool CanPropagateInSingleDispatch(const FIntVector& TransposedDimensions);
+
+/// Pixel format of a light volume (and of its single light buffers) stored in the given format.
+RAYMARCHER_API EPixelFormat GetLightVolumePixelFormat(ELightVolumeFormat Format);
+
+/// Pixel format of the RGBA buffers propagating 4 batched lights at once, with the same precision as the light volume's.
+RAYMARCHER_API EPixelFormat GetBatchedLightBufferPixelFormat(ELightVolumeFormat Format);
+
+/// Splits lights into batches that can be propagated together in a single sweep. Lights in a batch have the same local major
+/// axes, so they go through the volume slice by slice along the same faces. Returns indexes into Lights, at most
+/// MaxBatchedLights per batch, in the order the lights come in. Lights without a direction are left out.
+RAYMARCHER_API TArray<TArray<int32>> GroupLightsIntoBatches(
+	TArrayView<const FDirLightParameters> Lights, const FTransform& VolumeTransform);
+
+/// Part of a light propagation - NumSteps slices from FirstStep on (counted in loop order, see GetLoopStartStopIndexes()) along
+/// one of the light's major axes. Used to spread a propagation over several frames. A range that doesn't start at the first step
+/// continues from the light buffers the previous range left behind, so the ranges of a light have to be propagated in order and
+/// nothing else may use the same buffers in between.
+struct FLightPropagationRange
+{
+	/// Major axis index (0 or 1) of the range. INDEX_NONE for the whole propagation along both axes.
+	int32 AxisIndex = INDEX_NONE;
+
+	int32 FirstStep = 0;
+
+	int32 NumSteps = MAX_int32;
+
+	bool IsFull() const
+	{
+		return AxisIndex == INDEX_NONE;
+	}
+
+	bool ContainsAxis(int32 Index) const
+	{
+		return IsFull() || AxisIndex == Index;
+	}
+
+	/// True if the light buffers of the axis have to be cleared before the range gets propagated.
+	bool StartsAxis(int32 Index) const
+	{
+		return ContainsAxis(Index) && FirstStep == 0;
+	}
+
+	/// Limits a loop as returned by GetLoopStartStopIndexes() to the steps of the range. The loop must be along an axis the
+	/// range contains.
+	RAYMARCHER_API void ClipLoop(int& InOutStart, int& InOutStop, const int AxisDirection) const;
+};
+
+/// Number of slices before the first one touched by the clipping plane that propagation snapshots get captured at. Lets the plane
+/// move this many slices towards the light and still resume from the snapshot.
+constexpr int32 LightSnapshotMarginSlices = 8;
+
+/// Identifies a light buffer captured after propagating one slice along one of a light's major axes. A later propagation of the
+/// same light can resume from the slice after it, as long as nothing changed up to and including the captured slice.
+struct FLightPropagationSnapshot
+{
+	/// Face the light was propagated along.
+	FCubeFace Face = FCubeFace::XPositive;
+
+	/// Loop index of the captured slice. INDEX_NONE if nothing is captured.
+	int32 Slice = INDEX_NONE;
+
+	/// Which of the two snapshot buffers of the axis holds the capture (see FLightSnapshotBuffers).
+	int32 BufferIndex = 0;
+
+	bool IsValid() const
+	{
+		return Slice != INDEX_NONE;
+	}
+};
+
+/// Snapshots of a single light along both of its major axes.
+struct FLightPropagationSnapshots
+{
+	FLightPropagationSnapshot Axes[2];
+
+	void Invalidate()
+	{
+		for (FLightPropagationSnapshot& Axis : Axes)
+		{
+			Axis.Slice = INDEX_NONE;
+		}
+	}
+};
+
+/// How to re-propagate a light along one major axis after the local clipping plane changed. Slices are loop indexes as
+/// returned by GetLoopStartStopIndexes().
+struct FClippingChangeAxisPlan
+{
+	int32 Start = 0;
+	int32 Stop = 0;
+	int32 AxisDirection = 1;
+
+	/// Voxels in one slice.
+	int64 SliceVoxels = 0;
+
+	/// First slice with samples clipped differently by the old and new plane - the light changes from it on. Stop if none.
+	int32 FirstDirtySlice = 0;
+
+	/// Slice the re-propagation starts at. Start, or the slice after the snapshot of the axis if that can be used.
+	int32 ResumeSlice = 0;
+
+	/// Snapshot buffer to resume from if ResumeSlice isn't Start.
+	int32 ResumeBufferIndex = 0;
+
+	/// Slice to capture a new snapshot at during the re-propagation. INDEX_NONE to not capture.
+	int32 CaptureSlice = INDEX_NONE;
+
+	/// Snapshot buffer the new snapshot gets captured into.
+	int32 CaptureBufferIndex = 0;
+
+	bool IsDirty() const
+	{
+		return FirstDirtySlice != Stop;
+	}
+
+	/// Slices before the first dirty one that only need to be propagated (once) to get to it.
+	int32 GetCleanSliceCount() const
+	{
+		return IsDirty() ? (FirstDirtySlice - ResumeSlice) * AxisDirection : 0;
+	}
+
+	/// Slices the light gets removed from and added to again.
+	int32 GetDirtySliceCount() const
+	{
+		return (Stop - FirstDirtySlice) * AxisDirection;
+	}
+};
+
+/// How to re-propagate a light after the clipping plane changed.
+struct FClippingChangePlan
+{
+	FClippingChangeAxisPlan Axes[2];
+
+	/// Number of major axes the light propagates along (1 if the second one has no weight).
+	int32 AxisCount = 0;
+
+	/// Snapshots of the light after the re-propagation.
+	FLightPropagationSnapshots NewSnapshots;
+
+	/// Data volume samples the re-propagation takes. Every slice from the resumed one on samples the volume once per voxel, dirty
+	/// slices share the sample between the old and the new light.
+	RAYMARCHER_API int64 GetCost() const;
+
+	/// Data volume samples adding the light to a cleared light volume takes.
+	RAYMARCHER_API int64 GetFullCost() const;
+};
+
+/// Returns the slices to capture snapshots at while propagating a light with the given world parameters.
+/// These are LightSnapshotMarginSlices before the first slice touched by the clipping plane.
+RAYMARCHER_API FLightPropagationSnapshots PlanSnapshotCapture(const FDirLightParameters& LightParameters,
+	const FRaymarchWorldParameters& WorldParameters, const FIntVector& LightVolumeDimensions);
+
+/// Plans re-propagating a light after the local clipping plane changed from the old world parameters to the new ones.
+/// The local light direction has to be the same with both (see ClassifyWorldParametersChange()).
+/// Per axis, finds the first slice whose samples either plane clips partially or the planes clip differently - every slice
+/// before it propagates exactly the same light, so only the slices from it on (the swept region and everything it shadows)
+/// need the old light removed and the new one added. Propagation resumes from the light's snapshot if there's one before that
+/// slice, otherwise the unchanged slices are propagated too, just without touching the light volume.
+RAYMARCHER_API FClippingChangePlan PlanClippingChange(const FDirLightParameters& LightParameters,
+	const FRaymarchWorldParameters& OldWorldParameters, const FRaymarchWorldParameters& NewWorldParameters,
+	const FIntVector& LightVolumeDimensions, const FLightPropagationSnapshots& Snapshots);
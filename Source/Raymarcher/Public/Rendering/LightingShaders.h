@@ -9,419 +9,239 @@
 #include "DataDrivenShaderPlatformInfo.h"
 #include "GlobalShader.h"
 #include "RHICommandList.h"
+#include "RenderGraphBuilder.h"
+#include "Rendering/LightingShaderUtils.h"
 #include "Rendering/RaymarchTypes.h"
-#include "ShaderParameterUtils.h"
-#include "ShaderParameters.h"
+#include "ShaderParameterStruct.h"
 #include "VolumeAsset/WindowingParameters.h"
 
+struct FClippingChangePlan;
+struct FLightPropagationSnapshots;
+
+// Every light propagation function comes in two versions - one adding its passes to a render graph, so that the graph can merge
+// the barriers between them and the passes of other work, and one building and executing a graph of its own.
+
+/// If SnapshotBuffers are provided, captures the slices in CaptureSnapshots into them while propagating.
+/// Only propagates the slices in Range (see FLightPropagationRange).
+void AddDirLightToSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationSnapshots* CaptureSnapshots = nullptr, FLightSnapshotBuffers* SnapshotBuffers = nullptr,
+	const FLightPropagationRange& Range = FLightPropagationRange());
+
 void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
-	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters);
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationSnapshots* CaptureSnapshots = nullptr, FLightSnapshotBuffers* SnapshotBuffers = nullptr,
+	const FLightPropagationRange& Range = FLightPropagationRange());
+
+/// Replaces a light propagated with the clipping plane of OldWorldParameters with the same light propagated with the clipping
+/// plane of NewWorldParameters. Only re-propagates the slices in the plan (see PlanClippingChange()), resuming from and capturing
+/// snapshots in SnapshotBuffers. LightParameters have to be the light's parameters for the new volume transform.
+void ChangeClippingInSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const FRaymarchWorldParameters OldWorldParameters,
+	const FRaymarchWorldParameters NewWorldParameters, const FClippingChangePlan& Plan, FLightSnapshotBuffers& SnapshotBuffers);
+
+void ChangeClippingInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources Resources, const FDirLightParameters LightParameters,
+	const FRaymarchWorldParameters OldWorldParameters, const FRaymarchWorldParameters NewWorldParameters,
+	const FClippingChangePlan& Plan, FLightSnapshotBuffers& SnapshotBuffers);
+
+/// Adds (or removes) multiple lights. Lights sharing their major axes are propagated up to MaxBatchedLights at a time in a single
+/// sweep through the RGBA batch buffers (see GroupLightsIntoBatches()). Batches of a single light and volumes without batch
+/// buffers fall back to AddDirLightToSingleLightVolume_RenderThread.
+/// A Range other than the full one can only continue the propagation of a single batch, so LightParameters have to be a single
+/// light or, if the volume has batch buffers, lights sharing their major axes.
+void AddDirLightsToSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationRange& Range = FLightPropagationRange());
+
+void AddDirLightsToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+	const FLightPropagationRange& Range = FLightPropagationRange());
+
+void ChangeDirLightInSingleLightVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters OldLightParameters, const FDirLightParameters NewLightParameters,
+	const FRaymarchWorldParameters WorldParameters);
 
 void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
 	FBasicRaymarchRenderingResources Resources, const FDirLightParameters OldLightParameters,
 	const FDirLightParameters NewLightParameters, const FRaymarchWorldParameters WorldParameters);
 
+/// Adds a light volume of a coarser level of detail (see LightVolumeLOD.h), trilinearly upsampled and multiplied by Weight, to
+/// LightVolume. A Weight of -1 takes back adding the same coarse volume with a Weight of 1.
+void AddUpsampledLightVolume_RenderThread(
+	FRDGBuilder& GraphBuilder, FRHITexture* LightVolume, FRHITexture* CoarseLightVolume, float Weight);
+
+void AddUpsampledLightVolume_RenderThread(
+	FRHICommandListImmediate& RHICmdList, FRHITexture* LightVolume, FRHITexture* CoarseLightVolume, float Weight);
+
+// Parameters shared by all light propagation shaders - the volume with its transfer function and clipping plane, and the light
+// volume being modified. Don't change between the slices of a propagation, except for the permutation matrix.
+BEGIN_SHADER_PARAMETER_STRUCT(FLightPropagationVolumeParameters, )
+// Volume texture + transfer function resource parameters
+SHADER_PARAMETER_TEXTURE(Texture3D, Volume)
+SHADER_PARAMETER_SAMPLER(SamplerState, VolumeSampler)
+SHADER_PARAMETER_TEXTURE(Texture2D, TransferFunc)
+SHADER_PARAMETER_SAMPLER(SamplerState, TransferFuncSampler)
+// Clipping uniforms
+SHADER_PARAMETER(FVector3f, LocalClippingCenter)
+SHADER_PARAMETER(FVector3f, LocalClippingDirection)
+// TF intensity Domain
+SHADER_PARAMETER(FVector4f, WindowingParameters)
+// Permutation matrix - used to get position in the volume from axis-aligned X,Y and loop index.
+SHADER_PARAMETER(FMatrix44f, PermutationMatrix)
+// Light volume to modify.
+SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float>, ALightVolume)
+END_SHADER_PARAMETER_STRUCT()
+
+/// Returns the parameters shared by all slices of a propagation. The permutation matrix is left to be set per axis.
+FLightPropagationVolumeParameters GetLightPropagationVolumeParameters(FRDGBuilder& GraphBuilder,
+	const FBasicRaymarchRenderingResources& Resources, const FClippingPlaneParameters& LocalClippingParameters);
+
 // A shader implementing adding or removing a single directional light.
 // (As opposed to changing [e.g. add and remove at the same time] a directional light)
 // Only adds the bAdded boolean for toggling adding/removing a light.
 class FAddDirLightShader : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FAddDirLightShader, Global, RAYMARCHER_API);
-
 public:
-	FAddDirLightShader() : FGlobalShader()
-	{
-	}
-
-	~FAddDirLightShader(){};
-
-	FAddDirLightShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
-	{
-		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
-		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
-
-		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
-		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
-
-		LocalClippingCenter.Bind(Initializer.ParameterMap, TEXT("LocalClippingCenter"), SPF_Mandatory);
-		LocalClippingDirection.Bind(Initializer.ParameterMap, TEXT("LocalClippingDirection"), SPF_Mandatory);
-
-		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
-		StepSize.Bind(Initializer.ParameterMap, TEXT("StepSize"), SPF_Mandatory);
-
-		PermutationMatrix.Bind(Initializer.ParameterMap, TEXT("PermutationMatrix"), SPF_Mandatory);
-		// Actual light volume
-		ALightVolume.Bind(Initializer.ParameterMap, TEXT("ALightVolume"), SPF_Mandatory);
-
-		// Offsets to get location to read from from previous layer.
-		PrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffset"), SPF_Mandatory);
-		UVWOffset.Bind(Initializer.ParameterMap, TEXT("UVWOffset"), SPF_Mandatory);
-
-		// Multiplier for adding or removing light.
-		bAdded.Bind(Initializer.ParameterMap, TEXT("bAdded"), SPF_Mandatory);
-		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Mandatory);
-		// Read buffer and sampler.
-		ReadBuffer.Bind(Initializer.ParameterMap, TEXT("ReadBuffer"), SPF_Mandatory);
-		ReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("ReadBufferSampler"), SPF_Mandatory);
-		// Write buffer.
-		WriteBuffer.Bind(Initializer.ParameterMap, TEXT("WriteBuffer"), SPF_Mandatory);
-	}
-
-	void SetLightAdded(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, bool bLightAdded)
-	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetShaderValue(RHICmdList, ShaderRHI, bAdded, bLightAdded ? 1 : -1);
-	}
-
-	void SetRaymarchResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture2DRHIRef pTransferFunc, FWindowingParameters WindowingParams)
-	{
-		// Set the zero color to fit the zero point of the windowing parameters (Center - Width/2)
-		// so that after sampling out of bounds, it gets changed to 0 on the Transfer Function in
-		// GetTransferFuncPosition() hlsl function.
-		float ZeroTFValue = WindowingParams.Center - 0.5 * WindowingParams.Width;
-
-		FLinearColor VolumeClearColor = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0);
-		const uint32 BorderColorInt = VolumeClearColor.ToFColor(false).ToPackedARGB();
-
-		// Create a static sampler reference and bind it together with the volume texture.
-		FSamplerStateRHIRef DataVolumeSamplerRef = RHICreateSamplerState(
-			FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
-
-		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSamplerRef, pVolume);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef, pTransferFunc);
-	}
-
-	// Sets the shader uniforms in the pipeline.
-	void SetRaymarchParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
-		FClippingPlaneParameters LocalClippingParams, FLinearColor pWindowingParameters)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingCenter, FVector3f(LocalClippingParams.Center));
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingDirection, FVector3f(LocalClippingParams.Direction));
-		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, pWindowingParameters);
-	}
-
-	// Sets the step-size. This is a crucial parameter, because when raymarching, we need to know how long our step was,
-	// so that we can calculate how large an effect the volume's density has.
-	void SetStepSize(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pStepSize)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pStepSize);
-	}
-
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
-	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
-
-	void SetALightVolume(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FUnorderedAccessViewRHIRef pALightVolume)
-	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, pALightVolume);
-	}
-
-	void SetPermutationMatrix(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FMatrix PermMatrix)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
-	}
-
-	void UnbindResourcesRaymarch(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
-	}
-
-	void UnbindResourcesLightPropagation(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		// Unbind volume buffer.
-		UnbindResourcesRaymarch(RHICmdList, ShaderRHI);
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, nullptr);
-	}
-
-	void SetUVOffset(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector2D PixelOffset)
-	{
-		auto fPixelOffset = FVector2f(PixelOffset);
-		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffset, fPixelOffset);
-	}
-
-	void SetUVWOffset(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector pUVWOffset)
-	{
-		auto fUVWOffset = FVector3f(pUVWOffset);
-		SetShaderValue(RHICmdList, ShaderRHI, UVWOffset, fUVWOffset);
-	}
+	DECLARE_EXPORTED_GLOBAL_SHADER(FAddDirLightShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FAddDirLightShader, FGlobalShader);
 
-protected:
-	// Volume texture + transfer function resource parameters
-	LAYOUT_FIELD(FShaderResourceParameter, Volume);
-	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
-	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
-	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
-	// Clipping uniforms
-	LAYOUT_FIELD(FShaderParameter, LocalClippingCenter);
-	LAYOUT_FIELD(FShaderParameter, LocalClippingDirection);
-	// TF intensity Domain
-	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FLightPropagationVolumeParameters, VolumeParameters)
 	// Step size taken each iteration
-	LAYOUT_FIELD(FShaderParameter, StepSize);
-	// Permutation matrix - used to get position in the volume from axis-aligned X,Y and loop index.
-	LAYOUT_FIELD(FShaderParameter, PermutationMatrix);
-	// Light volume to modify.
-	LAYOUT_FIELD(FShaderResourceParameter, ALightVolume);
+	SHADER_PARAMETER(float, StepSize)
 	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, PrevPixelOffset);
+	SHADER_PARAMETER(FVector2f, PrevPixelOffset)
 	// And the offset in the volume from the previous volume sample.
-	LAYOUT_FIELD(FShaderParameter, UVWOffset);
-	// Parameter for the added/removed multiplier.
-	LAYOUT_FIELD(FShaderParameter, bAdded);
+	SHADER_PARAMETER(FVector3f, UVWOffset)
+	// Multiplier for adding or removing light - 1 if we're adding it, -1 if removing it. (Not used when changing clipping.)
+	SHADER_PARAMETER(int32, bAdded)
 	// The current loop index of this shader run.
-	LAYOUT_FIELD(FShaderParameter, Loop);
+	SHADER_PARAMETER(int32, Loop)
 	// Read buffer texture and sampler.
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBufferSampler);
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, ReadBuffer)
+	SHADER_PARAMETER_SAMPLER(SamplerState, ReadBufferSampler)
 	// Write buffer UAV.
-	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffer);
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, WriteBuffer)
+	END_SHADER_PARAMETER_STRUCT()
 };
 
-// A shader implementing changing a light in one pass.
-// Works by subtracting the old light and adding the new one.
-// Notice the UE macro DECLARE_SHADER_TYPE, unlike the shaders above (which are abstract)
-// this one actually gets implemented.
-class FChangeDirLightShader : public FGlobalShader
+// A shader implementing changing the clipping plane a single light was propagated with.
+// Uses the second entry point of AddDirLightShader.usf, the read/write buffers of the included parameters hold the light with the
+// new plane.
+class FChangeClippingShader : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FChangeDirLightShader, Global, RAYMARCHER_API);
-
 public:
-	FChangeDirLightShader() : FGlobalShader()
-	{
-	}
-	~FChangeDirLightShader(){};
-
-	FChangeDirLightShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
-	{
-		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
-		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
-
-		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
-		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
-
-		LocalClippingCenter.Bind(Initializer.ParameterMap, TEXT("LocalClippingCenter"), SPF_Mandatory);
-		LocalClippingDirection.Bind(Initializer.ParameterMap, TEXT("LocalClippingDirection"), SPF_Mandatory);
-
-		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
-		StepSize.Bind(Initializer.ParameterMap, TEXT("StepSize"), SPF_Mandatory);
-
-		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Optional);
-		PermutationMatrix.Bind(Initializer.ParameterMap, TEXT("PermutationMatrix"), SPF_Mandatory);
-
-		// Read buffer and sampler.
-		ReadBuffer.Bind(Initializer.ParameterMap, TEXT("ReadBuffer"), SPF_Optional);
-		ReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("ReadBufferSampler"), SPF_Optional);
-		// Write buffer.
-		WriteBuffer.Bind(Initializer.ParameterMap, TEXT("WriteBuffer"), SPF_Optional);
-		// Actual light volume
-		ALightVolume.Bind(Initializer.ParameterMap, TEXT("ALightVolume"), SPF_Mandatory);
-
-		// Offsets to get location to read from from previous layer.
-		PrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffset"), SPF_Mandatory);
-		UVWOffset.Bind(Initializer.ParameterMap, TEXT("UVWOffset"), SPF_Mandatory);
-
-		// Volume texture + Transfer function uniforms
-		RemovedPrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("RemovedPrevPixelOffset"), SPF_Mandatory);
-		RemovedReadBuffer.Bind(Initializer.ParameterMap, TEXT("RemovedReadBuffer"), SPF_Mandatory);
-		RemovedReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("RemovedReadBufferSampler"), SPF_Mandatory);
-		RemovedWriteBuffer.Bind(Initializer.ParameterMap, TEXT("RemovedWriteBuffer"), SPF_Mandatory);
-		RemovedUVWOffset.Bind(Initializer.ParameterMap, TEXT("RemovedUVWOffset"), SPF_Mandatory);
-		RemovedStepSize.Bind(Initializer.ParameterMap, TEXT("RemovedStepSize"), SPF_Mandatory);
-	}
+	DECLARE_EXPORTED_GLOBAL_SHADER(FChangeClippingShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FChangeClippingShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FAddDirLightShader::FParameters, AddedLightParameters)
+	// Clipping plane the removed light was propagated with.
+	SHADER_PARAMETER(FVector3f, RemovedLocalClippingCenter)
+	SHADER_PARAMETER(FVector3f, RemovedLocalClippingDirection)
+	// Read buffer texture and write buffer UAV of the removed light. Read with the same sampler as the added light.
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, RemovedReadBuffer)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, RemovedWriteBuffer)
+	// Whether the current slice needs the removed light propagated.
+	SHADER_PARAMETER(int32, bDirtySlice)
+	END_SHADER_PARAMETER_STRUCT()
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
+};
 
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoopAdd(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
-	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
-
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pRemovedReadBuffer, const FSamplerStateRHIRef pRemovedReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pRemovedWriteBuffer, const FTexture2DRHIRef pAddedReadBuffer,
-		const FSamplerStateRHIRef pAddedReadBuffSampler, const FUnorderedAccessViewRHIRef pAddedWriteBuffer)
-	{
-		// Actually sets the shader uniforms in the pipeline.
-		SetLoopAdd(RHICmdList, ShaderRHI, loopIndex, pAddedReadBuffer, pAddedReadBuffSampler, pAddedWriteBuffer);
-		// Set read/write buffers for removed light.
-		SetUAVParameter(RHICmdList, ShaderRHI, RemovedWriteBuffer, pRemovedWriteBuffer);
-		SetTextureParameter(
-			RHICmdList, ShaderRHI, RemovedReadBuffer, RemovedReadBufferSampler, pRemovedReadBuffSampler, pRemovedReadBuffer);
-	}
-
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
-	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
-
-	void SetALightVolume(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FUnorderedAccessViewRHIRef pALightVolume)
-	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, pALightVolume);
-	}
-
-	void SetPermutationMatrix(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FMatrix PermMatrix)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
-	}
-
-	void SetPixelOffsets(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector2D AddedPixelOffset,
-		FVector2D RemovedPixelOffset)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffset, FVector2f(AddedPixelOffset));
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedPrevPixelOffset, FVector2f(RemovedPixelOffset));
-	}
+// A shader implementing adding or removing up to 4 directional lights sharing their major axes at once.
+// Uses the third entry point of AddDirLightShader.usf - light i is propagated in channel i of RGBA read/write buffers.
+class FAddDirLightsBatchedShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FAddDirLightsBatchedShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FAddDirLightsBatchedShader, FGlobalShader);
 
-	void SetUVWOffsets(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector pAddedUVWOffset, FVector pRemovedUVWOffset)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, UVWOffset, FVector3f(pAddedUVWOffset));
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedUVWOffset, FVector3f(pRemovedUVWOffset));
-	}
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FLightPropagationVolumeParameters, VolumeParameters)
+	// Multiplier for adding or removing the lights.
+	SHADER_PARAMETER(int32, bAdded)
+	// The current loop index of this shader run.
+	SHADER_PARAMETER(int32, Loop)
+	// RGBA read buffer texture and write buffer UAV. The sampler's border color holds the alpha of every light.
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, BatchReadBuffer)
+	SHADER_PARAMETER_SAMPLER(SamplerState, ReadBufferSampler)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, BatchWriteBuffer)
+	// Per-light offsets - PrevPixelOffset in XY of PrevPixelOffsets, UVWOffset and StepSize in XYZ and W of UVWOffsets.
+	SHADER_PARAMETER_ARRAY(FVector4f, BatchPrevPixelOffsets, [MaxBatchedLights])
+	SHADER_PARAMETER_ARRAY(FVector4f, BatchUVWOffsets, [MaxBatchedLights])
+	// Number of lights in the batch.
+	SHADER_PARAMETER(int32, NumBatchedLights)
+	END_SHADER_PARAMETER_STRUCT()
 
-	void SetStepSizes(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pAddedStepSize, float pRemovedStepSize)
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pAddedStepSize);
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedStepSize, pRemovedStepSize);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
+};
 
-	void UnbindResourcesRaymarch(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
-	}
+// A shader implementing changing a light in one pass.
+// Works by subtracting the old light and adding the new one.
+class FChangeDirLightShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FChangeDirLightShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FChangeDirLightShader, FGlobalShader);
 
-	void UnbindResourcesLightPropagation(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		// Unbind volume buffer.
-		UnbindResourcesRaymarch(RHICmdList, ShaderRHI);
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, nullptr);
-	}
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FLightPropagationVolumeParameters, VolumeParameters)
+	// The current loop index of this shader run.
+	SHADER_PARAMETER(int32, Loop)
 
-	void UnbindResourcesChangeDirLight(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		// Unbind parent and also our added parameters.
-		UnbindResourcesLightPropagation(RHICmdList, ShaderRHI);
-		SetUAVParameter(RHICmdList, ShaderRHI, RemovedWriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, RemovedReadBuffer, nullptr);
-	}
+	// Step size, offsets and buffers of the added light.
+	SHADER_PARAMETER(float, StepSize)
+	// Tells the shader the pixel offset for reading from the previous loop's buffer
+	SHADER_PARAMETER(FVector2f, PrevPixelOffset)
+	// And the offset in the volume from the previous volume sample.
+	SHADER_PARAMETER(FVector3f, UVWOffset)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, ReadBuffer)
+	SHADER_PARAMETER_SAMPLER(SamplerState, ReadBufferSampler)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, WriteBuffer)
+
+	// Same collection of parameters as for the added light, but these ones are the ones of the removed light.
+	// (Removed light step size is different than added one's)
+	SHADER_PARAMETER(float, RemovedStepSize)
+	SHADER_PARAMETER(FVector2f, RemovedPrevPixelOffset)
+	SHADER_PARAMETER(FVector3f, RemovedUVWOffset)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, RemovedReadBuffer)
+	SHADER_PARAMETER_SAMPLER(SamplerState, RemovedReadBufferSampler)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, RemovedWriteBuffer)
+	END_SHADER_PARAMETER_STRUCT()
 
-	void SetRaymarchResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture2DRHIRef pTransferFunc, FWindowingParameters WindowingParams)
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		// Set the zero color to fit the zero point of the windowing parameters (Center - Width/2)
-		// so that after sampling out of bounds, it gets changed to 0 on the Transfer Function in
-		// GetTransferFuncPosition() hlsl function.
-		float ZeroTFValue = WindowingParams.Center - 0.5 * WindowingParams.Width;
-
-		FLinearColor VolumeClearColor = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0);
-		const uint32 BorderColorInt = VolumeClearColor.ToFColor(false).ToPackedARGB();
-
-		// Create a static sampler reference and bind it together with the volume texture.
-		FSamplerStateRHIRef DataVolumeSamplerRef = RHICreateSamplerState(
-			FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
-
-		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSamplerRef, pVolume);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef, pTransferFunc);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
+};
 
-	// Sets the shader uniforms in the pipeline.
-	void SetRaymarchParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
-		FClippingPlaneParameters LocalClippingParams, FLinearColor pWindowingParameters)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingCenter, FVector3f(LocalClippingParams.Center));
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingDirection, FVector3f(LocalClippingParams.Direction));
-		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, pWindowingParameters);
-	}
+// A shader adding a trilinearly upsampled coarse light volume to a light volume.
+class FUpsampleLightVolumeShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FUpsampleLightVolumeShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FUpsampleLightVolumeShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	// Light volume to add to.
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float>, ALightVolume)
+	// Coarse light volume to upsample and its sampler.
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D<float>, CoarseLightVolume)
+	SHADER_PARAMETER_SAMPLER(SamplerState, CoarseLightVolumeSampler)
+	// Multiplier of the upsampled light - 1 if we're adding it, -1 if removing it.
+	SHADER_PARAMETER(float, Weight)
+	END_SHADER_PARAMETER_STRUCT()
 
-	// Sets the step-size. This is a crucial parameter, because when raymarching, we need to know how long our step was,
-	// so that we can calculate how large an effect the volume's density has.
-	void SetStepSize(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pStepSize)
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pStepSize);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
-
-protected:
-	// Volume texture + transfer function resource parameters
-	LAYOUT_FIELD(FShaderResourceParameter, Volume);
-	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
-	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
-	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
-	// Clipping uniforms
-	LAYOUT_FIELD(FShaderParameter, LocalClippingCenter);
-	LAYOUT_FIELD(FShaderParameter, LocalClippingDirection);
-	// TF intensity Domain
-	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
-	// Step size taken each iteration
-	LAYOUT_FIELD(FShaderParameter, StepSize);
-
-	// The current loop index of this shader run.
-	LAYOUT_FIELD(FShaderParameter, Loop);
-	// Permutation matrix - used to get position in the volume from axis-aligned X,Y and loop index.
-	LAYOUT_FIELD(FShaderParameter, PermutationMatrix);
-	// Read buffer texture and sampler.
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBufferSampler);
-	// Write buffer UAV.
-	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffer);
-	// Light volume to modify.
-	LAYOUT_FIELD(FShaderResourceParameter, ALightVolume);
-
-	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, PrevPixelOffset);
-	// And the offset in the volume from the previous volume sample.
-	LAYOUT_FIELD(FShaderParameter, UVWOffset);
-
-	// Same collection of parameters as for a "add dir light" shader, but these ones are the ones of
-	// the removed light.
-
-	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, RemovedPrevPixelOffset);
-
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedReadBufferSampler);
-	// Write buffer UAV.
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedWriteBuffer);
-	// Removed light step size (is different than added one's)
-	LAYOUT_FIELD(FShaderParameter, RemovedStepSize);
-	// Removed light UVW offset
-	LAYOUT_FIELD(FShaderParameter, RemovedUVWOffset);
-};
\ No newline at end of file
+};
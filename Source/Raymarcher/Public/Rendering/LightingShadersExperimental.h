@@ -3,66 +3,51 @@
 // Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
 // (original raymarching code).
 
-//#pragma once
-//
-//#include "LightingShaders.h"
-//
-//void AddDirLightToSingleLightVolume_GPUSync_RenderThread(FRHICommandListImmediate& RHICmdList,
-//	FBasicRaymarchRenderingResources Resources, const FDirLightParameters LightParameters, const bool Added,
-//	const FRaymarchWorldParameters WorldParameters);
-//
-//class FAddDirLightShader_GPUSyncCS : public FAddDirLightShader
-//{
-//	DECLARE_EXPORTED_SHADER_TYPE(FAddDirLightShader_GPUSyncCS, Global, RAYMARCHER_API);
-//
-//public:
-//	FAddDirLightShader_GPUSyncCS() : FAddDirLightShader()
-//	{
-//	}
-//
-//	FAddDirLightShader_GPUSyncCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
-//		: FAddDirLightShader(Initializer)
-//	{
-//		// Volume texture + Transfer function uniforms
-//		Start.Bind(Initializer.ParameterMap, TEXT("Start"), SPF_Mandatory);
-//		Stop.Bind(Initializer.ParameterMap, TEXT("Stop"), SPF_Mandatory);
-//		AxisDirection.Bind(Initializer.ParameterMap, TEXT("AxisDirection"), SPF_Mandatory);
-//		BufferBorderValue.Bind(Initializer.ParameterMap, TEXT("BufferBorderValue"), SPF_Mandatory);
-//		// !!!!!!!!!!!
-//		// When binding FRWShaderParameter, we must omit the "RW" from the name provided into the Bind function
-//		// Otherwise it gets bound as a SRV (no RW access)! See FRWShaderParameter::Init() in ShaderParameters.h !!!
-//		// !!!!!!!!!!!
-//		LightBuffer.Bind(Initializer.ParameterMap, TEXT("LightBuffer"));
-//	}
-//
-//	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
-//	{
-//		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
-//	}
-//
-//	void SetReadWriteBuffer(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FTexture2DRHIRef pTexture,
-//		FRHIUnorderedAccessView* pRWBuffer)
-//	{
-//		LightBuffer.SetTexture(RHICmdList, ShaderRHI, pTexture, pRWBuffer);
-//	}
-//
-//	void SetLoopParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int pStart, const int pStop,
-//		const int pAxisDirection)
-//	{
-//		SetShaderValue(RHICmdList, ShaderRHI, Start, pStart);
-//		SetShaderValue(RHICmdList, ShaderRHI, Stop, pStop);
-//		SetShaderValue(RHICmdList, ShaderRHI, AxisDirection, pAxisDirection);
-//	};
-//
-//	void SetOutsideLight(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float OutsideLightIntensity)
-//	{
-//		SetShaderValue(RHICmdList, ShaderRHI, BufferBorderValue, OutsideLightIntensity);
-//	};
-//
-//protected:
-//	LAYOUT_FIELD(FShaderParameter, Start);
-//	LAYOUT_FIELD(FShaderParameter, Stop);
-//	LAYOUT_FIELD(FShaderParameter, AxisDirection);
-//	LAYOUT_FIELD(FShaderParameter, BufferBorderValue);
-//	LAYOUT_FIELD(FRWShaderParameter, LightBuffer);
-//};
\ No newline at end of file
+// Light propagation through all slices of an axis in a single dispatch, synchronized by group barriers in the shader instead of
+// by the barriers between a dispatch per slice. Only works for light volumes with slices of up to GPUSyncMaxSlicePixels pixels.
+
+#pragma once
+
+#include "Rendering/LightingShaders.h"
+
+/// Same as AddDirLightToSingleLightVolume_RenderThread without snapshots and ranges, but propagates along every axis with small
+/// enough slices (see CanPropagateInSingleDispatch()) in a single dispatch. Falls back to a dispatch per slice along the others.
+void AddDirLightToSingleLightVolume_GPUSync_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters);
+
+void AddDirLightToSingleLightVolume_GPUSync_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources Resources, const FDirLightParameters LightParameters, const bool Added,
+	const FRaymarchWorldParameters WorldParameters);
+
+// A shader propagating a single directional light along one axis in a single thread group, which walks all slices.
+class FAddDirLightShader_GPUSyncCS : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FAddDirLightShader_GPUSyncCS, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FAddDirLightShader_GPUSyncCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FLightPropagationVolumeParameters, VolumeParameters)
+	// Step size taken each iteration
+	SHADER_PARAMETER(float, StepSize)
+	// Tells the shader the pixel offset for reading from the previous loop's buffer
+	SHADER_PARAMETER(FVector2f, PrevPixelOffset)
+	// And the offset in the volume from the previous volume sample.
+	SHADER_PARAMETER(FVector3f, UVWOffset)
+	// Multiplier for adding or removing light - 1 if we're adding it, -1 if removing it.
+	SHADER_PARAMETER(int32, bAdded)
+	// Light volume dimensions transposed to the propagation axis.
+	SHADER_PARAMETER(FIntPoint, SliceSize)
+	// Light outside of the buffers - the light alpha along the axis.
+	SHADER_PARAMETER(float, BufferBorderValue)
+	// Loop over the slices, as returned by GetLoopStartStopIndexes().
+	SHADER_PARAMETER(int32, Start)
+	SHADER_PARAMETER(int32, Stop)
+	SHADER_PARAMETER(int32, AxisDirection)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
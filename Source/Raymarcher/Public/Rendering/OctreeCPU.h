@@ -0,0 +1,79 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// CPU implementation of the min/max octree generated by GenerateOctreeShader.usf.
+// Produces exactly the values the shader writes (before quantization to OCTREE_PIXEL_FORMAT), with the slices of every mip spread
+// over the task graph workers. Used as a golden reference for the shader and for benchmarking without a GPU.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Rendering/LightingCPU.h"
+
+/// One mip of a CPU octree.
+struct RAYMARCHER_API FOctreeMipCPU
+{
+	FIntVector Dimensions = FIntVector(0, 0, 0);
+
+	/// Maximum and minimum of the voxels covered by each texel, X-major. Texels covering only the power-of-two padding around the
+	/// volume hold an empty range (max 0, min 1), like in the shader.
+	TArray64<float> Max;
+	TArray64<float> Min;
+
+	int64 GetIndex(int32 X, int32 Y, int32 Z) const
+	{
+		return X + static_cast<int64>(Dimensions.X) * (Y + static_cast<int64>(Dimensions.Y) * Z);
+	}
+};
+
+/// Timing of a CPU octree generation.
+struct RAYMARCHER_API FOctreeCPUStats
+{
+	/// Number of octree texels written over all mips.
+	int64 TexelsWritten = 0;
+
+	int32 MipsGenerated = 0;
+
+	/// Wall-clock duration of the whole generation in seconds.
+	double Seconds = 0.0;
+
+	double GetTexelsPerSecond() const;
+
+	FString ToString() const;
+};
+
+/// CPU version of GenerateOctreeForVolume_RenderThread. Generates NumMips mips of the octree of Resources.DataVolume, starting with
+/// a mip of GetOctreeDimensions(Resources.DataDimensions). Returns false if NumMips is not valid for those dimensions.
+/// @param bParallel If false, runs on the calling thread only (for benchmarking against the parallel version).
+RAYMARCHER_API bool GenerateOctreeForVolume_CPU(const FRaymarchCPUResources& Resources, int32 NumMips,
+	TArray<FOctreeMipCPU>& OutMips, bool bParallel = true, FOctreeCPUStats* OutStats = nullptr);
+
+/// Counters of CPU octree traversals.
+struct RAYMARCHER_API FOctreeTraversalCPUStats
+{
+	int64 Rays = 0;
+
+	/// Samples of the data volume taken by the traversal.
+	int64 Samples = 0;
+
+	/// Samples a raymarch without skipping would take along the same rays.
+	int64 FullSamples = 0;
+
+	/// Octree texels read.
+	int64 NodeVisits = 0;
+
+	/// Fraction of the samples of a raymarch without skipping that the traversal takes.
+	double GetSampleFraction() const;
+
+	FString ToString() const;
+};
+
+/// CPU model of the traversal done by PerformWindowedOctreeSkippingRaymarch in WindowedRaymarchMaterials.usf, without the
+/// jitter, clipping and early termination. Marches a ray from Entry (in UVW space) along the normalized Direction with
+/// Thickness * StepCount steps of 1 / StepCount. Adds the indices of the full steps that get sampled to OutSampledSteps.
+/// @param VisibleRange See GetOctreeVisibleRange().
+RAYMARCHER_API void TraverseOctree_CPU(const TArray<FOctreeMipCPU>& Mips, const FIntVector& DataDimensions, const FVector3f& Entry,
+	const FVector3f& Direction, float Thickness, float StepCount, const FVector2f& VisibleRange, FOctreeTraversalCPUStats& Stats,
+	TArray<int32>* OutSampledSteps = nullptr);
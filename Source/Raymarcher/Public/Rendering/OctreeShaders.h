@@ -8,74 +8,70 @@
 #include "CoreMinimal.h"
 #include "GlobalShader.h"
 #include "RHICommandList.h"
+#include "RenderGraphBuilder.h"
 #include "Rendering/RaymarchTypes.h"
-#include "ShaderParameterUtils.h"
-#include "ShaderParameters.h"
+#include "ShaderParameterStruct.h"
 
-void GenerateOctreeForVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources);
+// These have to be the same as in GenerateOctreeShader.usf
+#define OCTREE_GROUP_SIZE 8
+#define OCTREE_MIPS_PER_PASS 4
 
-// A shader that generates a TF-independent octree accelerator structure for a volume.
-class FGenerateOctreeShader : public FGlobalShader
-{
-	DECLARE_EXPORTED_SHADER_TYPE(FGenerateOctreeShader, Global, RAYMARCHER_API);
+/// Octree texels hold the maximum of the covered voxels in R and the minimum in G. Materials sampling .r keep seeing the maximum.
+#define OCTREE_PIXEL_FORMAT PF_G16R16
 
-public:
-	FGenerateOctreeShader() : FGlobalShader()
-	{
-	}
+/// Dimensions of the octree of a volume - every axis rounded up to a power of two.
+RAYMARCHER_API FIntVector GetOctreeDimensions(const FIntVector& VolumeDimensions);
 
-	~FGenerateOctreeShader(){};
+/// Number of mips of a full octree - mips get halved until the shortest axis is a single texel.
+RAYMARCHER_API int32 GetOctreeMipCount(const FIntVector& OctreeDimensions);
 
-	FGenerateOctreeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
-	{
-		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
-		OctreeVolume0.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip0"), SPF_Mandatory);
-		OctreeVolume1.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip1"), SPF_Mandatory);
-		OctreeVolume2.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip2"), SPF_Mandatory);
-		OctreeVolume3.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip3"), SPF_Mandatory);
-		MinMaxValues.Bind(Initializer.ParameterMap, TEXT("MinMaxValues"), SPF_Mandatory);
-		LeafNodeSize.Bind(Initializer.ParameterMap, TEXT("LeafNodeSize"), SPF_Mandatory);
-		NumberOfMips.Bind(Initializer.ParameterMap, TEXT("NumberOfMips"), SPF_Mandatory);
-	}
-		
-	void SetGeneratingResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture3DComputeResource* ComputeResource, int InLeafNodeSize, int InNumberOfMips)
-	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, pVolume);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume0, ComputeResource->UnorderedAccessViewRHIs[0]);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume1, ComputeResource->UnorderedAccessViewRHIs[1]);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume2, ComputeResource->UnorderedAccessViewRHIs[2]);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume3, ComputeResource->UnorderedAccessViewRHIs[3]);
-		SetShaderValue(RHICmdList, ShaderRHI, MinMaxValues, FVector2f(0.0, 1.0));
-		SetShaderValue(RHICmdList, ShaderRHI, LeafNodeSize, InLeafNodeSize);
-		SetShaderValue(RHICmdList, ShaderRHI, NumberOfMips, InNumberOfMips);
-	}
+/// Dimensions of a single mip of an octree.
+RAYMARCHER_API FIntVector GetOctreeMipDimensions(const FIntVector& OctreeDimensions, int32 Mip);
 
-	void UnbindResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume0, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume1, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume2, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume3, nullptr);
-	}
+/// Range of data values that can get a non-zero opacity with the given transfer function (its samples, as stored in the TF
+/// texture) and windowing parameters. Octree nodes with no values in this range are skipped by the octree skipping materials.
+/// Conservative with respect to bilinear TF sampling and the 16 bit quantization of the octree. Returns an empty range (X > Y)
+/// if nothing is visible.
+RAYMARCHER_API FVector2f GetOctreeVisibleRange(
+	TArrayView<const FLinearColor> TransferFunction, const FWindowingParameters& WindowingParameters);
 
-protected:
-	// Volume texture + transfer function resource parameters
-	LAYOUT_FIELD(FShaderResourceParameter, Volume);
+/// Generates all mips of Resources.OctreeVolumeRenderTarget from Resources.DataVolumeTextureRef. The first dispatch reads the
+/// volume and writes the first OCTREE_MIPS_PER_PASS mips, every following one reads the last mip written before it.
+void GenerateOctreeForVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources);
 
-	// OctreeVolume volume mips to modify.
-	LAYOUT_FIELD(FShaderResourceParameter, OctreeVolume0);
-	LAYOUT_FIELD(FShaderResourceParameter, OctreeVolume1);
-	LAYOUT_FIELD(FShaderResourceParameter, OctreeVolume2);
-	LAYOUT_FIELD(FShaderResourceParameter, OctreeVolume3);
+/// Same as above, adds the passes to a render graph.
+void GenerateOctreeForVolume_RenderThread(FRDGBuilder& GraphBuilder, FBasicRaymarchRenderingResources Resources);
 
-	// Parameter for min/max values allowed.
-	LAYOUT_FIELD(FShaderParameter, MinMaxValues);
-	
-	// Length of the size of the cube that creates a single leaf. (Each leaf node will have LeafNodeSize^3 voxels)
-	LAYOUT_FIELD(FShaderParameter, LeafNodeSize);
+// A shader that generates a TF-independent octree accelerator structure for a volume.
+// Generates the first OCTREE_MIPS_PER_PASS mips straight from the volume.
+class FGenerateOctreeShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FGenerateOctreeShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FGenerateOctreeShader, FGlobalShader);
 
-	// Number of mips to generate.
-	LAYOUT_FIELD(FShaderParameter, NumberOfMips)
-};
\ No newline at end of file
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	// OctreeVolume volume mips to modify.
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float2>, OctreeVolumeMip0)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float2>, OctreeVolumeMip1)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float2>, OctreeVolumeMip2)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float2>, OctreeVolumeMip3)
+	// Size of the first mip written by the pass.
+	SHADER_PARAMETER(FIntVector, OutputSize)
+	// Number of mips to generate in this pass.
+	SHADER_PARAMETER(int32, NumberOfMips)
+	// Volume texture and its size (first pass only).
+	SHADER_PARAMETER_TEXTURE(Texture3D, Volume)
+	SHADER_PARAMETER(FIntVector, VolumeSize)
+	// Single mip view of the mip preceding the first written one (following passes only).
+	SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D<float2>, SourceMip)
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+// Generates the following mips of the octree from the last mip generated before.
+class FDownsampleOctreeShader : public FGenerateOctreeShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FDownsampleOctreeShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FDownsampleOctreeShader, FGenerateOctreeShader);
+};
@@ -0,0 +1,50 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Pre-integrated classification. Instead of classifying every sample on its own, the pre-integrated raymarch materials look up the
+// transfer function integrated over the whole ray segment between two samples, assuming the data value changes linearly along it.
+// Sharp transfer function features that fall between two samples still contribute, so low step counts don't show slicing.
+// The lookup table is built on the CPU from the transfer function and sampled by SampleWindowedPreIntegratedTransferFunction() in
+// WindowedSampling.usf.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VolumeAsset/VolumeInfo.h"
+
+/// Opacity the pre-integration clamps the transfer function to, so that every sample has a finite extinction.
+#define PRE_INTEGRATED_TF_MAX_ALPHA 0.9999f
+
+/// Pre-integrated transfer function table. Texel (X, Y) holds the average of color * extinction (RGB) and of extinction (A) over
+/// the TF positions between texel X and texel Y of the transfer function, where extinction = -ln(1 - alpha). Texels are placed
+/// the same way as the ones of the TF texture, so the table is indexed by TF positions directly.
+struct RAYMARCHER_API FPreIntegratedTransferFunction
+{
+	/// Texels along each axis, the same as the transfer function.
+	int32 Size = 0;
+
+	/// Size x Size texels, X-major. Symmetric.
+	TArray<FLinearColor> Texels;
+
+	const FLinearColor& GetTexel(int32 X, int32 Y) const
+	{
+		return Texels[X + Size * Y];
+	}
+
+	/// Bilinear sample with clamped coordinates, like the table texture sampled with a clamping sampler.
+	FLinearColor Sample(float FrontPosition, float BackPosition) const;
+};
+
+/// Builds the pre-integrated table of a transfer function (one row of the TF texture). The integrals of the transfer function are
+/// accumulated once, after which every texel is the difference of two of them, so the table takes constant time per texel. Rows
+/// are spread over the task graph workers unless bParallel is false.
+RAYMARCHER_API FPreIntegratedTransferFunction PreIntegrateTransferFunction(
+	TArrayView<const FLinearColor> TransferFunction, bool bParallel = true);
+
+/// CPU equivalent of SampleWindowedPreIntegratedTransferFunction() in WindowedSampling.usf. Color and opacity of the ray segment
+/// between a sample of FrontValue and one of BackValue, with the opacity corrected for StepSize like
+/// SampleWindowedTransferFunction_CPU(). Values outside of the window are transparent where cutoffs are enabled.
+RAYMARCHER_API FLinearColor SampleWindowedPreIntegratedTransferFunction_CPU(const FPreIntegratedTransferFunction& Table,
+	float FrontValue, float BackValue, float StepSize, const FWindowingParameters& WindowingParameters);
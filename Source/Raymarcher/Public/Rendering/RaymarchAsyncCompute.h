@@ -0,0 +1,87 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Running light propagation and octree generation on the async compute queue. Instead of a graph of their own, the passes get added
+// to the scene renderer's render graph (by FRaymarchSceneViewExtension), flagged ERDGPassFlags::AsyncCompute, so that they overlap
+// with the base pass and translucency. The graph fences them against every other pass using the same textures. The raymarching
+// materials read their textures outside of the graph though, so the passes have to write into textures the materials don't
+// currently read (see ARaymarchVolume::bAsyncCompute).
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RenderGraphDefinitions.h"
+#include "SceneViewExtension.h"
+
+/// Flags the light propagation and octree compute passes get added with - ERDGPassFlags::AsyncCompute within a
+/// FRaymarchAsyncComputeScope, ERDGPassFlags::Compute otherwise. The graph runs async compute passes on the graphics pipe if the
+/// RHI doesn't support async compute. Render thread only.
+RAYMARCHER_API ERDGPassFlags GetRaymarchComputePassFlags();
+
+/// Makes the raymarcher compute passes added while it's alive run on the async compute queue. Render thread only.
+class RAYMARCHER_API FRaymarchAsyncComputeScope
+{
+public:
+	FRaymarchAsyncComputeScope();
+	~FRaymarchAsyncComputeScope();
+
+private:
+	bool bWasAsyncCompute;
+};
+
+/// Set on the render thread once the work it was returned for is added to a render graph. This is not a GPU fence - the work may
+/// not even have run on the GPU yet when the game thread sees it set. It doesn't have to have: the graph adding the work gets
+/// executed before any render command enqueued after the flag got set, and the graph joins its async compute passes back to the
+/// graphics pipe before it ends, when it transitions the textures they wrote to their final state. So anything the game thread
+/// sends to the render thread after seeing the flag (e.g. the materials switching to the written texture) reaches the GPU after
+/// the work is done.
+using FRaymarchAsyncComputeSubmittedFlag = TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe>;
+
+/// Adds the queued raymarcher work to the render graph of the next scene render, before any view gets rendered.
+class RAYMARCHER_API FRaymarchSceneViewExtension : public FSceneViewExtensionBase
+{
+public:
+	FRaymarchSceneViewExtension(const FAutoRegister& AutoRegister);
+
+	/// Queues Work to be added to the next scene render graph, with its compute passes on the async compute queue. Game thread only.
+	static FRaymarchAsyncComputeSubmittedFlag Enqueue(TUniqueFunction<void(FRDGBuilder&)>&& Work);
+
+	/// Adds the queued work to a graph of its own right away, for when no scene gets rendered (e.g. no viewport is visible). The
+	/// compute passes still run on the async compute queue, but only overlap with each other. Game thread only.
+	static void Flush();
+
+	/// Unregisters the extension. Called when the module shuts down.
+	static void Shutdown();
+
+	//~ Begin ISceneViewExtension interface
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override
+	{
+	}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+	virtual void PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override;
+	//~ End ISceneViewExtension interface
+
+private:
+	struct FQueuedWork
+	{
+		TUniqueFunction<void(FRDGBuilder&)> Work;
+		FRaymarchAsyncComputeSubmittedFlag SubmittedFlag;
+	};
+
+	/// Creates the extension on first use - scene view extensions can only be registered once the engine exists.
+	static TSharedRef<FRaymarchSceneViewExtension, ESPMode::ThreadSafe> Get();
+
+	/// Adds all queued work to the graph and sets its submitted flags. Render thread only.
+	void AddQueuedWork(FRDGBuilder& GraphBuilder);
+
+	/// Render thread only.
+	TArray<FQueuedWork> Queue;
+};
@@ -23,3 +23,33 @@ const static FName OctreeVolume = "OctreeVolume";
 const static FName OctreeMip = "OctreeMip";
 
 }	 // namespace RaymarchParams
+
+// Settings the shipped materials have no parameters for are passed as custom primitive data of the volume's mesh.
+// These are the float indices, keep in sync with RaymarchMaterialCommon.usf.
+namespace RaymarchPrimitiveData
+{
+// What the octree material renders, an EOctreeMaterialMode cast to float.
+constexpr int32 OctreeMaterialMode = 0;
+// Lowest and highest data value that can be visible (2 floats). See GetOctreeVisibleRange().
+constexpr int32 OctreeVisibleRange = 1;
+// Step count, longest step and opacity tolerance of adaptive stepping (3 floats). See FAdaptiveStepParameters.
+constexpr int32 AdaptiveStepParams = 3;
+// 1 if the lit material's TransferFunction is the pre-integrated table of the TF (see PreIntegratedTF.h), 0 otherwise.
+constexpr int32 PreIntegratedTF = 6;
+// Intensity projection of the octree material, an ERaymarchProjection cast to float.
+constexpr int32 ProjectionMode = 7;
+
+}	 // namespace RaymarchPrimitiveData
+
+// What the octree material (M_Octree_Raymarch) renders.
+enum class EOctreeMaterialMode : uint8
+{
+	// The octree mip selected by OctreeMip.
+	OctreeMip,
+	// Unlit raymarch skipping empty space using the octree.
+	Skipping,
+	// Unlit raymarch skipping empty space using the octree, with adaptive step size.
+	Adaptive,
+	// Intensity projection selected by the ProjectionMode primitive data.
+	Projection
+};
@@ -15,6 +15,44 @@
 
 class UTextureRenderTargetVolume;
 
+// Formats the light volume and the buffers used for propagating light into it can be stored in.
+UENUM(BlueprintType)
+enum class ELightVolumeFormat : uint8
+{
+	// 8-bit unsigned normalized, 1 byte per voxel. Light is clamped to [0, 1] and quantized to 1/255.
+	G8,
+	// 16-bit float, 2 bytes per voxel. Allows over-lit voxels (light above 1) at about 3 significant digits.
+	R16F,
+	// 32-bit float, 4 bytes per voxel. Allows over-lit voxels at full precision.
+	R32F
+};
+
+// Intensity projections the projection material can show. Same order as the PROJECTION_ defines in
+// WindowedRaymarchMaterials.usf.
+UENUM(BlueprintType)
+enum class ERaymarchProjection : uint8
+{
+	// Maximum intensity projection (MIP) - the highest data value along the ray.
+	Maximum,
+	// Minimum intensity projection (MinIP) - the lowest data value along the ray.
+	Minimum,
+	// Average intensity projection (AIP) - the mean data value along the ray, like an X-ray.
+	Average
+};
+
+// Screen resolutions the volume can be raymarched at. Reduced resolutions get upsampled to the screen (see
+// ReducedResolutionRaymarch.h).
+UENUM(BlueprintType)
+enum class ERaymarchResolution : uint8
+{
+	// Every pixel raymarched by the material of the volume's mesh.
+	Full,
+	// One ray per 2x2 pixels.
+	Half,
+	// One ray per 4x4 pixels.
+	Quarter
+};
+
 // USTRUCT for Directional light parameters.
 USTRUCT(BlueprintType)
 struct FDirLightParameters
@@ -28,13 +66,13 @@ struct FDirLightParameters
 	FDirLightParameters() : LightDirection(FVector(0, 0, 0)), LightIntensity(0){};
 
 	// Equal operator for convenient checking if a light changed.
-	inline bool operator==(const FDirLightParameters& rhs)
+	inline bool operator==(const FDirLightParameters& rhs) const
 	{
 		return (this->LightDirection == rhs.LightDirection) && (this->LightIntensity == rhs.LightIntensity);
 	}
 
 	// Inequality operator for convenient checking if a light changed.
-	inline bool operator!=(const FDirLightParameters& rhs)
+	inline bool operator!=(const FDirLightParameters& rhs) const
 	{
 		return !(*this == rhs);
 	}
@@ -80,6 +118,19 @@ struct OneAxisReadWriteBufferResources
 	FUnorderedAccessViewRHIRef UAVs[4];
 };
 
+// Light buffers captured while propagating a single light, so that a later propagation can resume from them instead of starting
+// at the edge of the volume (see FLightPropagationSnapshots). Two per major axis of the light, so that a new snapshot can be
+// captured while resuming from the old one.
+struct FLightSnapshotBuffers
+{
+	FTexture2DRHIRef Buffers[2][2];
+
+	/// (Re)creates the buffers of an axis if they don't match the given read-write buffer. Render thread only.
+	RAYMARCHER_API void PrepareAxis(int32 AxisIndex, const FTexture2DRHIRef& ReadWriteBuffer);
+};
+
+using FLightSnapshotBuffersPtr = TSharedPtr<FLightSnapshotBuffers, ESPMode::ThreadSafe>;
+
 /** A structure holding all resources related to a single raymarchable volume - its texture ref, the
    TF texture ref and TF Range parameters,
 	light volume texture ref, and read-write buffers used for propagating along all axes. */
@@ -100,14 +151,28 @@ struct FBasicRaymarchRenderingResources
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	UTexture2D* TFTextureRef = nullptr;
 
+	/// Pre-integrated table of the transfer function. Only created when a pre-integrated material exists.
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
+	UTexture2D* PreIntegratedTFTextureRef = nullptr;
+
 	/// Pointer to the illumination volume texture render target.
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	UTextureRenderTargetVolume* LightVolumeRenderTarget = nullptr;
 
+	/// Light volume a time-sliced or async compute recompute renders into while LightVolumeRenderTarget stays displayed. Swapped
+	/// with it once the recompute is done. Only created when lights get recomputed time-sliced or on the async compute queue.
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
+	UTextureRenderTargetVolume* PendingLightVolumeRenderTarget = nullptr;
+
 	/// Pointer to the illumination volume texture render target.
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	URenderTargetVolumeMipped* OctreeVolumeRenderTarget = nullptr;
 
+	/// Octree async compute generates into while OctreeVolumeRenderTarget stays displayed. Swapped with it once it's generated.
+	/// Only created when the octree gets generated on the async compute queue.
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
+	URenderTargetVolumeMipped* PendingOctreeVolumeRenderTarget = nullptr;
+
 	/// If true, Light Volume texture will be created with it's side scaled down by 1/2 (-> 1/8 total voxels!)
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
 	bool LightVolumeHalfResolution = false;
@@ -120,12 +185,26 @@ struct FBasicRaymarchRenderingResources
 
 	// Unordered access view to Octree accelerator structure.
 	FUnorderedAccessViewRHIRef OctreeUAVRef;
+
+	// Unordered access view to the pending Octree.
+	FUnorderedAccessViewRHIRef PendingOctreeUAVRef;
 	
 	// Unordered access view to the Light Volume. Used in our compute shaders as a RWTexture.
 	FUnorderedAccessViewRHIRef LightVolumeUAVRef;
+
+	// Unordered access view to the pending Light Volume.
+	FUnorderedAccessViewRHIRef PendingLightVolumeUAVRef;
 	
 	// Read-write buffers for all 3 major axes. Used in compute shaders.
 	OneAxisReadWriteBufferResources XYZReadWriteBuffers[3];
+
+	// RGBA read-write buffers for all 3 major axes, used for propagating up to 4 lights at once. Only the first 2 buffers of every
+	// axis exist - a batch doesn't need a second pair for changing lights.
+	OneAxisReadWriteBufferResources XYZBatchReadWriteBuffers[3];
+
+	// Identifies these resources in FLightingRenderCache. Assigned whenever the resources get created, 0 means nothing gets
+	// cached for them.
+	uint32 RenderCacheId = 0;
 };
 
 /** Structure containing the world parameters required for light propagation shaders - these include
@@ -0,0 +1,397 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Raymarching volumes at half or quarter screen resolution. Materials can't render at another resolution than the view, so a volume
+// raymarched at reduced resolution hides its mesh and gets drawn by FReducedResolutionRaymarchExtension instead, with global
+// shaders (see ReducedResolutionRaymarch.usf):
+// - A compute pass marches one ray per 2x2 (4x4) block of pixels into an offscreen target, along with the depth each ray ended at
+//   (the scene depth at the block center or the back of the volume).
+// - A full resolution pass upsamples the offscreen target bilaterally - every pixel weighs its 4 closest low resolution samples
+//   by their bilinear weight and by how well their depth matches its own - and composites the volume over the scene color.
+//   Pixels whose samples mostly end at other depths (silhouettes of geometry in front of or inside the volume) or differ a lot
+//   in opacity (silhouettes of the volume) are edge pixels and can get raymarched at full resolution instead.
+// With temporal accumulation, the compute pass also blends every ray with the history of earlier frames, reprojected with the
+// previous transform of the volume and the previous view, so that every frame only needs to march a fraction of the steps. The
+// history gets thrown away whenever anything but the volume transform and the view changes (see
+// FReducedResolutionRaymarchState::IsHistoryCompatible()), pixels of it that got disoccluded get rejected by their depth.
+// Accumulating also works at full resolution, in which case the upsample just composites.
+// Also contains a CPU model of the passes, used for measuring the image error and cost against full resolution raymarching
+// without a GPU.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "GlobalShader.h"
+#include "RenderGraphBuilder.h"
+#include "Rendering/AdaptiveStepping.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/RaymarchTypes.h"
+#include "RendererInterface.h"
+#include "SceneView.h"
+#include "SceneViewExtension.h"
+#include "ShaderParameterStruct.h"
+
+class FSceneInterface;
+class UTexture;
+struct FPostProcessMaterialInputs;
+struct FScreenPassTexture;
+
+// This has to be the same as in ReducedResolutionRaymarch.usf
+#define REDUCED_RESOLUTION_GROUP_SIZE 8
+
+/// Pixels along the side of the block of pixels a single ray gets marched for - 1, 2 or 4.
+RAYMARCHER_API int32 GetRaymarchResolutionDivisor(ERaymarchResolution Resolution);
+
+/// Parameters of the depth- and edge-aware upsample.
+struct RAYMARCHER_API FBilateralUpsampleParameters
+{
+	/// Depth difference between a pixel and a low resolution sample, relative to the larger of the two depths, that weighs the
+	/// sample down to 1/e of its bilinear weight.
+	float DepthTolerance = 0.05f;
+
+	/// Pixels whose low resolution samples keep less than this fraction of their bilinear weight are edge pixels.
+	float EdgeWeightThreshold = 0.5f;
+
+	/// Pixels whose low resolution samples differ by more than this in opacity are edge pixels.
+	float EdgeAlphaThreshold = 0.25f;
+
+	/// If true, edge pixels get raymarched at full resolution instead of upsampled.
+	bool bRefineEdges = true;
+
+	/// Packed for the UpsampleParameters shader parameter.
+	FVector4f ToVector() const
+	{
+		return FVector4f(DepthTolerance, EdgeWeightThreshold, EdgeAlphaThreshold, bRefineEdges ? 1.0f : 0.0f);
+	}
+};
+
+/// Parameters of accumulating the raymarched image over frames.
+struct RAYMARCHER_API FTemporalAccumulationParameters
+{
+	/// Frames the steps of a ray get spread over. Every frame marches 1 / StepFrames of the steps, offset by a fraction of a step
+	/// from the previous frame, so that StepFrames frames together take every step.
+	int32 StepFrames = 4;
+
+	/// Most frames the history holds - the current frame gets blended in with a weight of at least 1 / MaxHistoryFrames.
+	int32 MaxHistoryFrames = 16;
+
+	/// Depth difference between a ray and the history it reprojects to, relative to the larger of the two depths, above which
+	/// the history is disoccluded and gets rejected.
+	float DepthTolerance = 0.05f;
+};
+
+/// Weight of a low resolution sample ending at SampleDepth for a pixel ending at PixelDepth. Equivalent of GetBilateralWeight() in
+/// ReducedResolutionRaymarch.usf.
+RAYMARCHER_API float GetBilateralUpsampleWeight(
+	float BilinearWeight, float SampleDepth, float PixelDepth, const FBilateralUpsampleParameters& Parameters);
+
+/// Bilateral upsample of a pixel from its 4 closest low resolution samples. Equivalent of UpsamplePixel() in
+/// ReducedResolutionRaymarch.usf.
+/// @param Samples Premultiplied color and opacity of the samples.
+/// @param SampleDepths Depths the rays of the samples ended at.
+/// @param BilinearWeights Bilinear weights of the samples, summing up to 1.
+/// @param PixelDepth Depth the pixel's own ray ends at.
+/// @param OutColor The upsampled color. Falls back to the sample with the closest depth if none of the samples matches.
+/// @returns True if the pixel is an edge pixel.
+RAYMARCHER_API bool UpsamplePixel(const FLinearColor (&Samples)[4], const float (&SampleDepths)[4],
+	const float (&BilinearWeights)[4], float PixelDepth, const FBilateralUpsampleParameters& Parameters, FLinearColor& OutColor);
+
+/// CPU model of the amortized raymarch of ReducedResolutionRaymarch.usf, without the jitter - RaymarchFixedStep_CPU() with
+/// StepCount / StepFrames steps per unit, the entry moved back by StepFrame / StepFrames of a step.
+RAYMARCHER_API FLinearColor RaymarchAmortized_CPU(const FRaymarchCPUResources& Resources, const FVector3f& Entry,
+	const FVector3f& Direction, float Thickness, float StepCount, int32 StepFrames, int32 StepFrame, FRaymarchCPUStats& Stats);
+
+/// Blends a new sample into the history of a pixel that holds HistoryFrames frames. Equivalent of AccumulateHistory() in
+/// ReducedResolutionRaymarch.usf.
+RAYMARCHER_API void AccumulateTemporalSample(
+	FLinearColor& History, float& HistoryFrames, const FLinearColor& Sample, const FTemporalAccumulationParameters& Parameters);
+
+/// Matrix from the UVW space of a volume with the given transform to clip space of a view with the given pre-view translation
+/// and translated view projection matrix (see FViewMatrices). Used for reprojecting into the previous frame.
+RAYMARCHER_API FMatrix GetUVWToClipMatrix(
+	const FTransform& VolumeTransform, const FVector& PreViewTranslation, const FMatrix& TranslatedViewProjectionMatrix);
+
+/// Orthographic view of a volume (the unit cube in UVW space) with opaque geometry, for CPU raymarching.
+struct RAYMARCHER_API FRaymarchViewCPU
+{
+	/// Direction the view looks in, in UVW space.
+	FVector3f ViewDirection = FVector3f(0.0f, 0.0f, 1.0f);
+
+	/// Pixels along each side of the view, which covers the unit cube seen from any direction.
+	int32 Resolution = 256;
+
+	/// Steps per unit of UVW space.
+	float StepCount = 150.0f;
+
+	/// Distance from the image plane to the opaque geometry for every pixel, X-major, in UVW units. Empty if there's no geometry.
+	TArray<float> SceneDepth;
+
+	/// Sets up the ray of a pixel at continuous pixel coordinates (X, Y). Returns the ray's origin on the image plane, and the
+	/// distances along it at which it enters the volume and at which it stops - when leaving the volume or hitting the geometry
+	/// at DepthPixel. Exit is not above Entry if the ray misses the volume.
+	void GetRay(float X, float Y, const FIntPoint& DepthPixel, FVector3f& OutOrigin, float& OutEntry, float& OutExit) const;
+};
+
+/// Image error and cost of raymarching at reduced resolution against raymarching every pixel.
+struct RAYMARCHER_API FReducedResolutionComparisonCPU
+{
+	/// Raymarches of the full resolution image.
+	FRaymarchCPUStats Full;
+
+	/// Raymarches of the low resolution image and of the refined edge pixels.
+	FRaymarchCPUStats Reduced;
+
+	/// Number of edge pixels and how many of them got raymarched at full resolution.
+	int64 EdgePixels = 0;
+	int64 RefinedPixels = 0;
+
+	/// Wall-clock durations of rendering the full resolution image and of raymarching at reduced resolution and upsampling.
+	double FullSeconds = 0.0;
+	double ReducedSeconds = 0.0;
+
+	/// Mean and maximum over all pixels of the largest difference of a color channel or the opacity.
+	double MeanError = 0.0;
+	double MaxError = 0.0;
+
+	/// Fraction of the samples of the full resolution image that the reduced resolution one takes.
+	double GetSampleFraction() const;
+
+	FString ToString() const;
+};
+
+/// Image error and cost of accumulating amortized raymarches of a static view against raymarching every step every frame.
+struct RAYMARCHER_API FTemporalAccumulationComparisonCPU
+{
+	/// Raymarch of a single frame with every step.
+	FRaymarchCPUStats Full;
+
+	/// Raymarches of all accumulated frames.
+	FRaymarchCPUStats Accumulated;
+
+	int32 Frames = 0;
+
+	/// Mean and maximum error of the first frame on its own and of the image accumulated over all frames.
+	double FirstFrameMeanError = 0.0;
+	double MeanError = 0.0;
+	double MaxError = 0.0;
+
+	/// Fraction of the samples of a full frame that every accumulated frame takes.
+	double GetSampleFractionPerFrame() const;
+
+	FString ToString() const;
+};
+
+/// Renders the volume with every step and accumulates Frames amortized frames of it at full resolution, and compares the two.
+/// The view is static, so the history never gets reprojected or rejected.
+RAYMARCHER_API FTemporalAccumulationComparisonCPU CompareTemporalAccumulation_CPU(const FRaymarchCPUResources& Resources,
+	const FRaymarchViewCPU& View, const FTemporalAccumulationParameters& Parameters, int32 Frames);
+
+/// Renders the volume at full resolution (RaymarchFixedStep_CPU() for every pixel) and at reduced resolution with a bilateral
+/// upsample, and compares the two. Rows are spread over the task graph workers.
+/// @param OutImage If not null, receives the upsampled image (premultiplied color and opacity, X-major).
+RAYMARCHER_API FReducedResolutionComparisonCPU CompareReducedResolutionRaymarch_CPU(const FRaymarchCPUResources& Resources,
+	const FRaymarchViewCPU& View, ERaymarchResolution Resolution, const FBilateralUpsampleParameters& Parameters,
+	TArray<FLinearColor>* OutImage = nullptr);
+
+/// Everything the render thread needs to draw a volume at reduced resolution.
+struct RAYMARCHER_API FReducedResolutionRaymarchState
+{
+	/// Scene of the world the volume is in. Only views of this scene draw the volume.
+	FSceneInterface* Scene = nullptr;
+
+	/// Textures of the volume, taken from their resources by FReducedResolutionRaymarchExtension::SetVolume().
+	FTextureRHIRef DataVolume;
+	FTextureRHIRef TransferFunction;
+
+	/// Light volume multiplying the transfer function colors. Null for unlit materials.
+	FTextureRHIRef LightVolume;
+
+	/// Transform of the volume's unit cube mesh.
+	FTransform VolumeTransform;
+
+	/// Clipping plane in UVW space.
+	FClippingPlaneParameters LocalClippingParameters;
+
+	FWindowingParameters WindowingParameters;
+
+	/// Steps per unit of UVW space.
+	float StepCount = 150.0f;
+
+	ERaymarchResolution Resolution = ERaymarchResolution::Half;
+
+	FBilateralUpsampleParameters UpsampleParameters;
+
+	/// If true, rays get accumulated over frames, marching TemporalParameters.StepFrames times fewer steps every frame.
+	bool bTemporalAccumulation = false;
+
+	FTemporalAccumulationParameters TemporalParameters;
+
+	/// Changes whenever the transfer function or the light volume change without getting replaced by another texture.
+	uint32 HistoryVersion = 0;
+
+	/// True if a history accumulated with History can be reprojected into this state - only the volume transform differs.
+	bool IsHistoryCompatible(const FReducedResolutionRaymarchState& History) const;
+};
+
+/// Image of a volume accumulated over frames in a single view, with what it got accumulated with. Render thread only.
+struct FReducedResolutionRaymarchHistory
+{
+	/// Accumulated premultiplied color and opacity of every low resolution ray.
+	TRefCountPtr<IPooledRenderTarget> Color;
+
+	/// Depth every ray ended at and the number of frames accumulated in it.
+	TRefCountPtr<IPooledRenderTarget> Depth;
+
+	/// State of the volume and the view the history was last accumulated with.
+	FReducedResolutionRaymarchState State;
+	FVector ViewOrigin = FVector::ZeroVector;
+	FVector PreViewTranslation = FVector::ZeroVector;
+	FMatrix TranslatedViewProjectionMatrix = FMatrix::Identity;
+
+	/// Frames accumulated so far, picks the fraction of the steps the next frame marches.
+	uint32 FrameIndex = 0;
+
+	/// GFrameNumberRenderThread of the last time the history got used. Histories of views that stop rendering get released.
+	uint32 LastUsedFrameNumber = 0;
+};
+
+/// Draws the volumes raymarched at reduced resolution or accumulated over frames into every view of their scene, right after
+/// temporal anti-aliasing (in the place of motion blur), so that the rays don't get reprojected with the motion of the opaque
+/// geometry behind them. Volumes drawn this way are composited over all other translucency.
+class RAYMARCHER_API FReducedResolutionRaymarchExtension : public FSceneViewExtensionBase
+{
+public:
+	FReducedResolutionRaymarchExtension(const FAutoRegister& AutoRegister);
+
+	/// Starts drawing the volume identified by Key, or updates what gets drawn for it. The textures of State get taken from the
+	/// resources of the given textures on the render thread. LightVolume is null for unlit materials. Game thread only.
+	static void SetVolume(const void* Key, const FReducedResolutionRaymarchState& State, UTexture* DataVolume,
+		UTexture* TransferFunction, UTexture* LightVolume);
+
+	/// Stops drawing the volume identified by Key. Game thread only.
+	static void RemoveVolume(const void* Key);
+
+	/// Unregisters the extension. Called when the module shuts down.
+	static void Shutdown();
+
+	//~ Begin ISceneViewExtension interface
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override
+	{
+	}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+	virtual void SubscribeToPostProcessingPass(
+		EPostProcessingPass Pass, FAfterPassCallbackDelegateArray& InOutPassCallbacks, bool bIsPassEnabled) override;
+	//~ End ISceneViewExtension interface
+
+private:
+	/// Creates the extension on first use - scene view extensions can only be registered once the engine exists.
+	static TSharedRef<FReducedResolutionRaymarchExtension, ESPMode::ThreadSafe> Get();
+
+	/// Draws the volumes of the view's scene over the scene color. Render thread only.
+	FScreenPassTexture DrawVolumes_RenderThread(
+		FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessMaterialInputs& Inputs);
+
+	/// Render thread only.
+	TMap<const void*, FReducedResolutionRaymarchState> Volumes;
+
+	/// Histories of the volumes accumulated over frames, by volume and view key (see FSceneView::GetViewKey()). Kept on the heap,
+	/// textures get extracted into them when the graph executes. Render thread only.
+	TMap<TPair<const void*, uint32>, TUniquePtr<FReducedResolutionRaymarchHistory>> Histories;
+};
+
+// Parameters shared by the low resolution raymarch and the upsample, which raymarches edge pixels.
+BEGIN_SHADER_PARAMETER_STRUCT(FReducedResolutionRaymarchParameters, )
+SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+// Volume texture + transfer function resource parameters
+SHADER_PARAMETER_TEXTURE(Texture3D, Volume)
+SHADER_PARAMETER_SAMPLER(SamplerState, VolumeSampler)
+SHADER_PARAMETER_TEXTURE(Texture2D, TransferFunc)
+SHADER_PARAMETER_SAMPLER(SamplerState, TransferFuncSampler)
+// Light volume, only sampled if bLit is set.
+SHADER_PARAMETER_TEXTURE(Texture3D, LightVolume)
+SHADER_PARAMETER_SAMPLER(SamplerState, LightVolumeSampler)
+SHADER_PARAMETER(int32, bLit)
+// Transform from translated world space (see FViewMatrices::GetPreViewTranslation()) to the UVW space of the volume.
+SHADER_PARAMETER(FMatrix44f, TranslatedWorldToUVW)
+// Clipping uniforms
+SHADER_PARAMETER(FVector3f, LocalClippingCenter)
+SHADER_PARAMETER(FVector3f, LocalClippingDirection)
+// TF intensity Domain
+SHADER_PARAMETER(FVector4f, WindowingParameters)
+// Steps per unit of UVW space.
+SHADER_PARAMETER(float, StepCount)
+// Scene depth, at render resolution.
+SHADER_PARAMETER_RDG_TEXTURE(Texture2D, SceneDepthTexture)
+// Render resolution pixels along the side of the block marched by a single low resolution ray.
+SHADER_PARAMETER(int32, Divisor)
+END_SHADER_PARAMETER_STRUCT()
+
+// A shader marching one ray per block of Divisor x Divisor pixels.
+class FReducedResolutionRaymarchShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FReducedResolutionRaymarchShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FReducedResolutionRaymarchShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FReducedResolutionRaymarchParameters, RaymarchParameters)
+	// Every frame marches 1 / StepFrames of the steps, the StepFrame-th fraction of them. See FTemporalAccumulationParameters.
+	SHADER_PARAMETER(int32, StepFrames)
+	SHADER_PARAMETER(int32, StepFrame)
+	SHADER_PARAMETER(int32, MaxHistoryFrames)
+	SHADER_PARAMETER(float, HistoryDepthTolerance)
+	// History accumulated in earlier frames, only sampled if bHistoryValid is set.
+	SHADER_PARAMETER(int32, bHistoryValid)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, HistoryColor)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float2>, HistoryDepth)
+	SHADER_PARAMETER_SAMPLER(SamplerState, HistorySampler)
+	// Transform from the UVW space of the volume to the clip space of the previous frame, with the previous volume transform.
+	SHADER_PARAMETER(FMatrix44f, UVWToPrevClip)
+	// Previous camera position in UVW space of the previous volume transform.
+	SHADER_PARAMETER(FVector3f, PrevCameraUVW)
+	// Size of the history textures. The history is assumed to cover a view rect of the same size as the current one.
+	SHADER_PARAMETER(FVector2f, HistoryExtent)
+	// Premultiplied color and opacity of every ray (accumulated with the history), the depth it ended at and the number of frames
+	// accumulated in it.
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWLowResColor)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float2>, RWLowResDepth)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+// A shader upsampling the low resolution raymarch to the output resolution, drawn with premultiplied alpha blending over the
+// scene color.
+class FBilateralUpsampleShader : public FGlobalShader
+{
+public:
+	DECLARE_EXPORTED_GLOBAL_SHADER(FBilateralUpsampleShader, RAYMARCHER_API);
+	SHADER_USE_PARAMETER_STRUCT(FBilateralUpsampleShader, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_STRUCT_INCLUDE(FReducedResolutionRaymarchParameters, RaymarchParameters)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, LowResColor)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float2>, LowResDepth)
+	// See FBilateralUpsampleParameters::ToVector().
+	SHADER_PARAMETER(FVector4f, UpsampleParameters)
+	// Min and size of the output view rect, which differs from the render resolution one with upscaling.
+	SHADER_PARAMETER(FVector4f, OutputRect)
+	RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
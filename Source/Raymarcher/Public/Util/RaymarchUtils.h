@@ -11,6 +11,7 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "RHI.h"
 #include "RHIResources.h"
+#include "Rendering/LightingShaderUtils.h"
 #include "Rendering/LightingShaders.h"
 #include "Rendering/RaymarchTypes.h"
 #include "UObject/ObjectMacros.h"
@@ -28,18 +29,43 @@ public:
 	//
 	//
 
-	/** Adds a light to light volume. Also works for removing a light by setting bLightAdded to false.*/
+	/** Adds a light to light volume. Also works for removing a light by setting bLightAdded to false.
+	If bGPUSync, propagates along every axis with small enough slices in a single dispatch (see
+	AddDirLightToSingleLightVolume_GPUSync_RenderThread). */
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void AddDirLightToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
 		const FDirLightParameters& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
 		bool& LightAdded, bool bGPUSync = false);
 
+	/** Adds multiple lights to light volume, propagating lights that share their major axes together in a single sweep (up to 4
+	at a time). Also works for removing lights by setting Added to false. */
+	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
+	static RAYMARCHER_API void AddDirLightsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const TArray<FDirLightParameters>& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
+		bool& LightsAdded);
+
 	/** Changes a light in the light volume.	 */
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResources& Resources,
 		const FDirLightParameters OldLightParameters, const FDirLightParameters NewLightParameters,
 		const FRaymarchWorldParameters WorldParameters, bool& LightAdded, bool bGPUSync = false);
 
+	/** Adds a light to light volume, capturing the propagated light at the slices in CaptureSnapshots into SnapshotBuffers. */
+	static RAYMARCHER_API void AddDirLightWithSnapshotsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const FDirLightParameters& LightParameters, const FRaymarchWorldParameters WorldParameters,
+		const FLightPropagationSnapshots& CaptureSnapshots, FLightSnapshotBuffersPtr SnapshotBuffers, bool& LightAdded);
+
+	/** Changes the clipping plane a light in the light volume was propagated with, re-propagating only the slices in the plan. */
+	static RAYMARCHER_API void ChangeClippingInSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const FDirLightParameters& LightParameters, const FRaymarchWorldParameters OldWorldParameters,
+		const FRaymarchWorldParameters NewWorldParameters, const FClippingChangePlan& Plan, FLightSnapshotBuffersPtr SnapshotBuffers,
+		bool& LightAdded);
+
+	/** Adds a light volume of a coarser level of detail, trilinearly upsampled and multiplied by Weight, to the light volume in
+	Resources. A Weight of -1 takes back adding it with 1. */
+	static RAYMARCHER_API void AddUpsampledLightVolume(const FBasicRaymarchRenderingResources& Resources,
+		UTextureRenderTargetVolume* CoarseLightVolume, float Weight, bool& bUpsampled);
+
 	/** Generates an octree in the provided resources to accelerate raymarching through the volume.	 */
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void GenerateOctree(FBasicRaymarchRenderingResources& Resources);
@@ -63,6 +89,13 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void ColorCurveToTexture(UCurveLinearColor* Curve, UTexture2D*& OutTexture);
 
+	/** Samples a ColorCurve the same way as ColorCurveToTexture. A null Curve gives the default transfer function. */
+	static RAYMARCHER_API TArray<FLinearColor> SampleColorCurve(UCurveLinearColor* Curve);
+
+	/** Will create a 2D texture holding the pre-integrated table of a transfer function (see PreIntegratedTF.h). */
+	static RAYMARCHER_API void TransferFunctionToPreIntegratedTexture(
+		TArrayView<const FLinearColor> TransferFunction, UTexture2D*& OutTexture);
+
 	//
 	//
 	// Functions for creating parameter collections follow
@@ -87,8 +120,9 @@ public:
 	*/
 	static RAYMARCHER_API void TextureToLocalCoords(FVector TextureCoors, FVector& LocalCoords);
 
+	/** Creates the first BufferCount buffers (and their UAVs) of RWBuffers. */
 	static RAYMARCHER_API void CreateBufferTextures(
-		FIntPoint Size, EPixelFormat PixelFormat, OneAxisReadWriteBufferResources& RWBuffers);
+		FIntPoint Size, EPixelFormat PixelFormat, OneAxisReadWriteBufferResources& RWBuffers, int32 BufferCount = 4);
 
 	static RAYMARCHER_API void ReleaseOneAxisReadWriteBufferResources(OneAxisReadWriteBufferResources& Buffer);
 
@@ -231,6 +231,12 @@ void APerformanceTest1::RunTest(const TArray<FString>& Params)
 
 	OriginalOffsetVector = RotateAroundVolume->GetActorLocation() - GetWorld()->GetFirstPlayerController()->GetPawn()->GetActorLocation();
 
+	for (auto* ListenerVolume : ListenerVolumes)
+	{
+		ListenerVolume->SetRaymarchResolution(RaymarchResolution);
+		ListenerVolume->SetTemporalAccumulation(bTemporalAccumulation);
+	}
+
 	if (UWorld* World = GetWorld())
 	{
 		GEngine->Exec(World, TEXT("Trace.Start"));
@@ -0,0 +1,72 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the CPU model of adaptive step size raymarching against the fixed step raymarch.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/AdaptiveStepping.h"
+#include "Rendering/OctreeShaders.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdaptiveStepScaleTest, "TBRaymarcher.Raymarcher.AdaptiveStepping.StepScale",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAdaptiveStepScaleTest::RunTest(const FString& Parameters)
+{
+	const FAdaptiveStepParameters Low = GetAdaptiveStepParameters(0.0f);
+	const FAdaptiveStepParameters High = GetAdaptiveStepParameters(1.0f);
+	TestTrue(TEXT("Higher quality takes more steps"), High.StepCount > Low.StepCount);
+	TestTrue(TEXT("Higher quality takes shorter steps"), High.MaxStepScale < Low.MaxStepScale);
+	TestTrue(TEXT("Higher quality tolerates less variation"), High.Tolerance < Low.Tolerance);
+	TestEqual(TEXT("Quality is clamped"), GetAdaptiveStepParameters(2.0f).StepCount, High.StepCount);
+
+	const FAdaptiveStepParameters Default;
+	TestEqual(TEXT("Constant transparent node gets the longest step"),
+		GetAdaptiveStepScale(FVector3f(0.0f), 0.0f, Default), Default.MaxStepScale);
+	TestEqual(TEXT("TF edge gets the shortest step"), GetAdaptiveStepScale(FVector3f(0.0f, 0.5f, 1.0f), 0.0f, Default), 1.0f);
+	TestEqual(TEXT("Opaque sample gets the shortest step"), GetAdaptiveStepScale(FVector3f(0.5f), 0.5f, Default), 1.0f);
+	TestEqual(TEXT("Step scales with the variation"),
+		GetAdaptiveStepScale(FVector3f(0.0f, 0.01f, 0.02f), 0.0f, Default), Default.Tolerance / 0.02f, 1e-4f);
+
+	FAdaptiveStepParameters Fixed;
+	Fixed.MaxStepScale = 0.5f;
+	TestEqual(TEXT("Steps never get shorter than the shortest step"), GetAdaptiveStepScale(FVector3f(0.0f), 0.0f, Fixed), 1.0f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdaptiveSteppingRaymarchTest, "TBRaymarcher.Raymarcher.AdaptiveStepping.Raymarch",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAdaptiveSteppingRaymarchTest::RunTest(const FString& Parameters)
+{
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	const TArray<FOctreeMipCPU> Mips = RaymarchTestHelpers::MakeOctree(Resources);
+	const FVector2f VisibleRange = GetOctreeVisibleRange(Resources.TransferFunction, Resources.WindowingParameters);
+	const FVector3f ViewDirection = FVector3f(0.3f, -0.2f, 1.0f);
+
+	// Without longer steps, adaptive stepping only skips empty space and gives the fixed step image.
+	const FAdaptiveStepParameters Default = GetAdaptiveStepParameters(0.5f);
+	FAdaptiveStepParameters NoScaling = Default;
+	NoScaling.MaxStepScale = 1.0f;
+	const FAdaptiveStepComparisonCPU Exact =
+		CompareAdaptiveStepRaymarch_CPU(Resources, Mips, VisibleRange, ViewDirection, 32, NoScaling.StepCount, NoScaling);
+	TestTrue(TEXT("Some rays hit the ball"), Exact.Fixed.Rays > 0);
+	TestTrue(TEXT("Unscaled steps match fixed steps"), Exact.MaxError < 1e-5);
+	TestTrue(TEXT("Empty space is skipped"), Exact.GetSampleFraction() < 1.0);
+	AddInfo(FString::Printf(TEXT("Unscaled : %s"), *Exact.ToString()));
+
+	// Longer steps through the smooth parts of the ball take fewer samples for a small error.
+	const FAdaptiveStepComparisonCPU Scaled =
+		CompareAdaptiveStepRaymarch_CPU(Resources, Mips, VisibleRange, ViewDirection, 32, Default.StepCount, Default);
+	TestTrue(TEXT("Scaled steps take fewer samples than unscaled ones"), Scaled.Adaptive.Samples < Exact.Adaptive.Samples);
+	TestTrue(TEXT("Scaled steps stay close to fixed steps"), Scaled.MeanError < 0.02);
+	AddInfo(FString::Printf(TEXT("Default quality : %s"), *Scaled.ToString()));
+	return true;
+}
+
+#endif
@@ -0,0 +1,197 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the CPU intensity projector, with octree skipping against brute force projections.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/IntensityProjection.h"
+#include "Rendering/OctreeShaders.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// A cube volume with a constant background, a noisy ball and a few bright and dark specks.
+FRaymarchCPUResources MakeProjectionVolume(int32 Size, FRandomStream& Random)
+{
+	FRaymarchCPUResources Resources;
+	Resources.DataDimensions = FIntVector(Size);
+	Resources.DataVolume.SetNumUninitialized(static_cast<int64>(Size) * Size * Size);
+	const FVector BallCenter = FVector(0.55, 0.45, 0.5) * Size;
+	for (int32 Z = 0; Z < Size; Z++)
+	{
+		for (int32 Y = 0; Y < Size; Y++)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				const float Distance = FVector::Dist(FVector(X, Y, Z), BallCenter) / Size;
+				const float Ball = Distance < 0.3f ? 0.6f * (1.0f - Distance / 0.3f) + Random.FRandRange(0.0f, 0.05f) : 0.0f;
+				Resources.DataVolume[X + Size * (Y + static_cast<int64>(Size) * Z)] = 0.2f + Ball;
+			}
+		}
+	}
+	for (int32 i = 0; i < 20; i++)
+	{
+		const int64 Index = Random.RandHelper(static_cast<int32>(Resources.DataVolume.Num()));
+		Resources.DataVolume[Index] = i % 2 ? 0.95f : 0.05f;
+	}
+
+	// The window spans all values, so the projections never saturate it.
+	Resources.WindowingParameters.Center = 0.5f;
+	Resources.WindowingParameters.Width = 1.2f;
+	return Resources;
+}
+
+/// Largest difference between the pixels of two images.
+float GetMaxImageError(const TArray<float>& Image, const TArray<float>& Reference)
+{
+	float MaxError = 0.0f;
+	for (int32 i = 0; i < Image.Num(); i++)
+	{
+		MaxError = FMath::Max(MaxError, FMath::Abs(Image[i] - Reference[i]));
+	}
+	return MaxError;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FIntensityProjectionRayTest, "TBRaymarcher.Raymarcher.IntensityProjection.Ray",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FIntensityProjectionRayTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(11);
+	const FRaymarchCPUResources Resources = MakeProjectionVolume(32, Random);
+	const FVector3f Entry(0.0f, 0.3f, 0.6f);
+	const FVector3f Direction = FVector3f(1.0f, 0.4f, -0.2f).GetSafeNormal();
+	const float Thickness = 0.905f;
+	const float StepCount = 100.0f;
+
+	// Every sample the projections take.
+	const float FloatActualSteps = StepCount * Thickness;
+	float Max = -1.0f;
+	float Min = 2.0f;
+	double Sum = 0.0;
+	for (int32 Step = 1; Step <= FMath::FloorToInt32(FloatActualSteps); Step++)
+	{
+		const float Value = SampleDataVolume_CPU(Resources, FVector(Entry + Direction / StepCount * Step));
+		Max = FMath::Max(Max, Value);
+		Min = FMath::Min(Min, Value);
+		Sum += Value;
+	}
+	const float Last = SampleDataVolume_CPU(Resources, FVector(Entry + Direction / StepCount * FloatActualSteps));
+	Max = FMath::Max(Max, Last);
+	Min = FMath::Min(Min, Last);
+	const double Average = (Sum + Last * FMath::Frac(FloatActualSteps)) / FloatActualSteps;
+
+	FProjectionCPUStats Stats;
+	float Value;
+	const bool bHit =
+		ProjectRay_CPU(Resources, {}, ERaymarchProjection::Maximum, Entry, Direction, Thickness, StepCount, Value, Stats);
+	TestTrue(TEXT("MIP hits"), bHit);
+	TestEqual(TEXT("MIP is the highest sample"), Value, Max);
+	ProjectRay_CPU(Resources, {}, ERaymarchProjection::Minimum, Entry, Direction, Thickness, StepCount, Value, Stats);
+	TestEqual(TEXT("MinIP is the lowest sample"), Value, Min);
+	ProjectRay_CPU(Resources, {}, ERaymarchProjection::Average, Entry, Direction, Thickness, StepCount, Value, Stats);
+	TestEqual(TEXT("AIP is the step weighted mean"), Value, static_cast<float>(Average), 1e-5f);
+	TestEqual(TEXT("Without skipping every sample is taken"), Stats.GetSampleFraction(), 1.0);
+
+	FProjectionCPUStats MissStats;
+	const bool bMissHit =
+		ProjectRay_CPU(Resources, {}, ERaymarchProjection::Average, Entry, Direction, 0.0f, StepCount, Value, MissStats);
+	TestFalse(TEXT("Zero thickness ray misses"), bMissHit);
+
+	// A projection that saturates the window ends the ray.
+	FRaymarchCPUResources Narrow = Resources;
+	Narrow.WindowingParameters.Width = 0.1f;
+	FProjectionCPUStats NarrowStats;
+	ProjectRay_CPU(Narrow, {}, ERaymarchProjection::Maximum, Entry, Direction, Thickness, StepCount, Value, NarrowStats);
+	TestTrue(TEXT("Saturated MIP is at least the window top"), Value >= 0.55f);
+	TestTrue(TEXT("Saturated MIP ends early"), NarrowStats.Samples < NarrowStats.FullSamples);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FIntensityProjectionSkippingTest, "TBRaymarcher.Raymarcher.IntensityProjection.Skipping",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FIntensityProjectionSkippingTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(3);
+	const FRaymarchCPUResources Resources = MakeProjectionVolume(64, Random);
+	const TArray<FOctreeMipCPU> Mips = RaymarchTestHelpers::MakeOctree(Resources);
+	const FVector3f ViewDirection(0.3f, -0.2f, 1.0f);
+
+	// Skipping nodes that can't beat the current extreme gives exactly the brute force image.
+	for (const ERaymarchProjection Projection : {ERaymarchProjection::Maximum, ERaymarchProjection::Minimum})
+	{
+		const FString Name = StaticEnum<ERaymarchProjection>()->GetNameStringByValue(static_cast<int64>(Projection));
+		TArray<float> BruteForce, Skipping;
+		FProjectionCPUStats BruteForceStats, SkippingStats;
+		RenderProjection_CPU(Resources, {}, Projection, ViewDirection, 32, 128.0f, BruteForce, BruteForceStats);
+		RenderProjection_CPU(Resources, Mips, Projection, ViewDirection, 32, 128.0f, Skipping, SkippingStats);
+		TestTrue(Name + TEXT(" rays hit the volume"), SkippingStats.Rays > 0);
+		TestEqual(Name + TEXT(" skipping matches brute force"), GetMaxImageError(Skipping, BruteForce), 0.0f);
+		TestTrue(Name + TEXT(" skipping takes fewer samples"), SkippingStats.Samples < BruteForceStats.Samples);
+		AddInfo(FString::Printf(TEXT("%s : %s"), *Name, *SkippingStats.ToString()));
+	}
+
+	// AIP sees every sample, the octree doesn't change it.
+	TArray<float> Average, AverageWithOctree;
+	FProjectionCPUStats AverageStats;
+	RenderProjection_CPU(Resources, {}, ERaymarchProjection::Average, ViewDirection, 32, 128.0f, Average, AverageStats);
+	RenderProjection_CPU(Resources, Mips, ERaymarchProjection::Average, ViewDirection, 32, 128.0f, AverageWithOctree, AverageStats);
+	TestEqual(TEXT("AIP ignores the octree"), GetMaxImageError(AverageWithOctree, Average), 0.0f);
+	TestEqual(TEXT("AIP takes every sample"), AverageStats.GetSampleFraction(), 1.0);
+
+	// A constant volume projects to its value.
+	FRaymarchCPUResources Constant = Resources;
+	for (float& Voxel : Constant.DataVolume)
+	{
+		Voxel = 0.35f;
+	}
+	TArray<float> ConstantImage;
+	FProjectionCPUStats ConstantStats;
+	RenderProjection_CPU(Constant, {}, ERaymarchProjection::Average, ViewDirection, 16, 64.0f, ConstantImage, ConstantStats);
+	const float Expected = (0.35f - 0.5f + 0.6f) / 1.2f;
+	int32 Mismatches = 0;
+	for (const float Pixel : ConstantImage)
+	{
+		Mismatches += Pixel == 0.0f || FMath::IsNearlyEqual(Pixel, Expected, 1e-4f) ? 0 : 1;
+	}
+	TestEqual(TEXT("Constant volume averages to its value"), Mismatches, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FIntensityProjectionBenchmark, "TBRaymarcher.Raymarcher.IntensityProjection.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FIntensityProjectionBenchmark::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	for (const int32 Size : {128, 256})
+	{
+		const FRaymarchCPUResources Resources = MakeProjectionVolume(Size, Random);
+		const TArray<FOctreeMipCPU> Mips = RaymarchTestHelpers::MakeOctree(Resources);
+		const TArray<FOctreeMipCPU> NoMips;
+		for (const ERaymarchProjection Projection :
+			{ERaymarchProjection::Maximum, ERaymarchProjection::Minimum, ERaymarchProjection::Average})
+		{
+			const FString Name = StaticEnum<ERaymarchProjection>()->GetNameStringByValue(static_cast<int64>(Projection));
+			for (const bool bSkipping : {false, true})
+			{
+				TArray<float> Image;
+				FProjectionCPUStats Stats;
+				RenderProjection_CPU(
+					Resources, bSkipping ? Mips : NoMips, Projection, FVector3f(0.3f, -0.2f, 1.0f), 256, Size, Image, Stats);
+				AddInfo(FString::Printf(TEXT("%d^3 %s %s : %s"), Size, *Name, bSkipping ? TEXT("skipping") : TEXT("brute force"),
+					*Stats.ToString()));
+			}
+		}
+	}
+	return true;
+}
+
+#endif
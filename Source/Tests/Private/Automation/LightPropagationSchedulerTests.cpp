@@ -0,0 +1,163 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of planning time-sliced light propagation. Nothing here touches the GPU.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/LightPropagationScheduler.h"
+#include "Rendering/LightingShaderUtils.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+TArray<FDirLightParameters> MakeLights()
+{
+	// The first two share both major axes.
+	return {FDirLightParameters(FVector(0.1, 0.3, 1).GetSafeNormal(), 1.0f),
+		FDirLightParameters(FVector(0.2, 0.3, 1).GetSafeNormal(), 0.5f),
+		FDirLightParameters(FVector(1, 0.3, -0.2).GetSafeNormal(), 1.0f), FDirLightParameters(FVector(0, 0, 0), 1.0f)};
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationRangeTest, "TBRaymarcher.Raymarcher.LightPropagationScheduler.Range",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationRangeTest::RunTest(const FString& Parameters)
+{
+	auto Clip = [](const FLightPropagationRange& Range, int Start, int Stop, int AxisDirection)
+	{
+		Range.ClipLoop(Start, Stop, AxisDirection);
+		return FIntPoint(Start, Stop);
+	};
+
+	FLightPropagationRange Range;
+	TestTrue(TEXT("Full range keeps the loop"), Clip(Range, 9, -1, -1) == FIntPoint(9, -1));
+	TestTrue(TEXT("Full range starts every axis"), Range.StartsAxis(0) && Range.StartsAxis(1));
+
+	Range.AxisIndex = 1;
+	Range.FirstStep = 3;
+	Range.NumSteps = 4;
+	TestTrue(TEXT("Increasing loop"), Clip(Range, 0, 10, 1) == FIntPoint(3, 7));
+	TestTrue(TEXT("Decreasing loop"), Clip(Range, 9, -1, -1) == FIntPoint(6, 2));
+	TestFalse(TEXT("Range continuing an axis doesn't start it"), Range.StartsAxis(1));
+	TestFalse(TEXT("Range doesn't contain the other axis"), Range.ContainsAxis(0));
+
+	Range.NumSteps = 100;
+	TestTrue(TEXT("Range clipped to the end of the loop"), Clip(Range, 9, -1, -1) == FIntPoint(6, -1));
+	Range.FirstStep = 12;
+	const FIntPoint Empty = Clip(Range, 0, 10, 1);
+	TestEqual(TEXT("Range past the end of the loop is empty"), Empty.X, Empty.Y);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationSchedulerTest, "TBRaymarcher.Raymarcher.LightPropagationScheduler.Planning",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationSchedulerTest::RunTest(const FString& Parameters)
+{
+	const FIntVector Dimensions(64, 32, 16);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	const TArray<FDirLightParameters> Lights = MakeLights();
+
+	FLightPropagationScheduler Scheduler;
+	Scheduler.Start(Lights, WorldParameters, Dimensions, true);
+	const TArray<FScheduledLightPropagation>& Propagations = Scheduler.GetPropagations();
+	TestEqual(TEXT("Lights sharing axes are batched, lights without a direction skipped"), Propagations.Num(), 2);
+	if (Propagations.Num() != 2)
+	{
+		return false;
+	}
+	TestEqual(TEXT("Batch holds both lights"), Propagations[0].Lights.Num(), 2);
+	TestEqual(TEXT("Steps along Z"), Propagations[0].AxisSteps[0], Dimensions.Z);
+	TestEqual(TEXT("Slice voxels along Z"), Propagations[0].SliceVoxels[0], static_cast<int64>(Dimensions.X) * Dimensions.Y);
+	TestEqual(TEXT("Initial queue depth"), Scheduler.GetQueueDepth(), 4);
+
+	// Every sweep has to be covered by consecutive chunks, in order, and every frame has to stay in the budget.
+	const float BudgetMs = 0.005f;
+	const double BudgetVoxels = BudgetMs * 1.0e6 / Scheduler.GetNanosecondsPerVoxel();
+	int32 NextStep[2][2] = {{0, 0}, {0, 0}};
+	int32 LastPropagation = 0;
+	int32 LastQueueDepth = Scheduler.GetQueueDepth();
+	int32 Frames = 0;
+	bool bInOrder = true;
+	bool bInBudget = true;
+	while (!Scheduler.IsComplete() && Frames < 1000)
+	{
+		const TArray<FLightPropagationChunk> Chunks = Scheduler.PlanFrame(BudgetMs);
+		Frames++;
+		int64 FrameVoxels = 0;
+		for (const FLightPropagationChunk& Chunk : Chunks)
+		{
+			bInOrder &= Chunk.PropagationIndex >= LastPropagation;
+			bInOrder &= Chunk.Range.FirstStep == NextStep[Chunk.PropagationIndex][Chunk.Range.AxisIndex];
+			bInOrder &= Chunk.Range.AxisIndex == 0 || NextStep[Chunk.PropagationIndex][0] ==
+														  Propagations[Chunk.PropagationIndex].AxisSteps[0];
+			NextStep[Chunk.PropagationIndex][Chunk.Range.AxisIndex] += Chunk.Range.NumSteps;
+			LastPropagation = Chunk.PropagationIndex;
+			FrameVoxels += Chunk.Voxels;
+		}
+		bInBudget &= Chunks.Num() > 0 && (FrameVoxels <= BudgetVoxels || (Chunks.Num() == 1 && Chunks[0].Range.NumSteps == 1));
+		bInOrder &= Scheduler.GetQueueDepth() <= LastQueueDepth;
+		LastQueueDepth = Scheduler.GetQueueDepth();
+	}
+	TestTrue(TEXT("Propagation completes"), Scheduler.IsComplete());
+	TestTrue(TEXT("Chunks continue each other"), bInOrder);
+	TestTrue(TEXT("Frames stay in the budget"), bInBudget);
+	TestTrue(TEXT("Propagation is spread over frames"), Frames > 1);
+	TestEqual(TEXT("Frames planned"), Scheduler.GetFramesPlanned(), Frames);
+	TestEqual(TEXT("Nothing left in the queue"), Scheduler.GetQueueDepth(), 0);
+	for (int32 i = 0; i < Propagations.Num(); i++)
+	{
+		for (int32 AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+		{
+			TestEqual(TEXT("Every slice planned once"), NextStep[i][AxisIndex], Propagations[i].AxisSteps[AxisIndex]);
+		}
+	}
+
+	// A tiny budget still makes progress, one slice per frame.
+	Scheduler.Start(Lights, WorldParameters, Dimensions, false);
+	TestEqual(TEXT("Unbatched lights get a propagation each"), Scheduler.GetPropagations().Num(), 3);
+	const TArray<FLightPropagationChunk> TinyChunks = Scheduler.PlanFrame(0.0f);
+	TestTrue(TEXT("Tiny budget propagates a single slice"), TinyChunks.Num() == 1 && TinyChunks[0].Range.NumSteps == 1);
+	TestEqual(TEXT("Restart plans from the first frame"), Scheduler.GetFramesPlanned(), 1);
+
+	// Measurements replace the default estimate, then get smoothed.
+	Scheduler.AddGPUTimeMeasurement(1000000, 2.0);
+	TestEqual(TEXT("First measurement replaces the default"), Scheduler.GetNanosecondsPerVoxel(), 2.0, 1e-9);
+	Scheduler.AddGPUTimeMeasurement(1000000, 6.0);
+	TestEqual(TEXT("Later measurements are smoothed"), Scheduler.GetNanosecondsPerVoxel(), 3.0, 1e-9);
+	Scheduler.AddGPUTimeMeasurement(0, 1.0);
+	TestEqual(TEXT("Empty measurement is ignored"), Scheduler.GetNanosecondsPerVoxel(), 3.0, 1e-9);
+
+	// Changes the propagation doesn't survive.
+	TestFalse(TEXT("Same lights are up to date"), Scheduler.IsOutdated(Lights, WorldParameters));
+	FRaymarchWorldParameters Translated = WorldParameters;
+	Translated.VolumeTransform.SetTranslation(FVector(10, 20, 30));
+	TestFalse(TEXT("Translation keeps the propagation"), Scheduler.IsOutdated(Lights, Translated));
+	FRaymarchWorldParameters Rotated = WorldParameters;
+	Rotated.VolumeTransform.SetRotation(FQuat(FVector(0, 0, 1), 0.3));
+	TestTrue(TEXT("Rotation outdates the propagation"), Scheduler.IsOutdated(Lights, Rotated));
+	TArray<FDirLightParameters> ChangedLights = Lights;
+	ChangedLights[1].LightIntensity = 0.7f;
+	TestTrue(TEXT("Changed light outdates the propagation"), Scheduler.IsOutdated(ChangedLights, WorldParameters));
+	ChangedLights = Lights;
+	ChangedLights.Pop();
+	TestTrue(TEXT("Removed light outdates the propagation"), Scheduler.IsOutdated(ChangedLights, WorldParameters));
+
+	Scheduler.Cancel();
+	TestFalse(TEXT("Cancelled"), Scheduler.IsActive());
+	TestEqual(TEXT("Cancelled scheduler plans nothing"), Scheduler.PlanFrame(BudgetMs).Num(), 0);
+
+	// Nothing to propagate completes at once.
+	const TArray<FDirLightParameters> NoDirectionLights = {FDirLightParameters(FVector(0, 0, 0), 1.0f)};
+	Scheduler.Start(NoDirectionLights, WorldParameters, Dimensions, true);
+	TestTrue(TEXT("No lights complete at once"), Scheduler.IsActive() && Scheduler.IsComplete());
+	return true;
+}
+
+#endif
@@ -0,0 +1,110 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the multi-resolution light volume - picking levels of detail and upsampling coarse levels, using the CPU propagation.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/LightVolumeLOD.h"
+#include "Rendering/LightingCPU.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+double GetMean(const TArray64<float>& Values)
+{
+	double Sum = 0.0;
+	for (float Value : Values)
+	{
+		Sum += Value;
+	}
+	return Values.Num() > 0 ? Sum / Values.Num() : 0.0;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeLODSelectionTest, "TBRaymarcher.Raymarcher.LightVolumeLOD.Selection",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeLODSelectionTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("Full resolution"), GetLightVolumeLODDimensions(FIntVector(65, 64, 33), 0), FIntVector(65, 64, 33));
+	TestEqual(TEXT("Half resolution rounds up"), GetLightVolumeLODDimensions(FIntVector(65, 64, 33), 1), FIntVector(33, 32, 17));
+	TestEqual(TEXT("Quarter resolution rounds up"), GetLightVolumeLODDimensions(FIntVector(65, 64, 33), 2), FIntVector(17, 16, 9));
+
+	FLightVolumeLODSettings Settings;
+	Settings.ContributionThreshold = 0.5f;
+	Settings.CameraDistanceThreshold = 2.0f;
+	const ELightVolumeLODPolicy Contribution = ELightVolumeLODPolicy::Contribution;
+	TestEqual(TEXT("Brightest light is full resolution"), SelectLightVolumeLOD(Contribution, Settings, 1.0f, 10.0f), 0);
+	TestEqual(TEXT("Dimmer light is half resolution"), SelectLightVolumeLOD(Contribution, Settings, 0.4f, 0.0f), 1);
+	TestEqual(TEXT("Dim light is quarter resolution"), SelectLightVolumeLOD(Contribution, Settings, 0.1f, 0.0f), 2);
+
+	const ELightVolumeLODPolicy Distance = ELightVolumeLODPolicy::CameraDistance;
+	TestEqual(TEXT("Close camera is full resolution"), SelectLightVolumeLOD(Distance, Settings, 0.1f, 1.0f), 0);
+	TestEqual(TEXT("Farther camera is half resolution"), SelectLightVolumeLOD(Distance, Settings, 1.0f, 3.0f), 1);
+	TestEqual(TEXT("Far camera is quarter resolution"), SelectLightVolumeLOD(Distance, Settings, 1.0f, 5.0f), 2);
+
+	const TArray<int32> Levels = {0, 2, 1, 2};
+	const TArray<float> Contributions = {1.0f, 0.2f, 0.9f, 0.5f};
+	TestEqual(TEXT("Refines the most contributing light at the coarsest level first"),
+		PickLightVolumeLODRefinement(Levels, Contributions), 3);
+	const TArray<int32> FullLevels = {0, 0};
+	const TArray<float> FullContributions = {1.0f, 0.5f};
+	TestEqual(TEXT("Nothing to refine at full resolution"), PickLightVolumeLODRefinement(FullLevels, FullContributions),
+		static_cast<int32>(INDEX_NONE));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeLODRefinementTest, "TBRaymarcher.Raymarcher.LightVolumeLOD.Refinement",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeLODRefinementTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(5);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+	const FIntVector Dimensions(32, 28, 24);
+
+	// What ARaymarchVolume::ApplyLightVolumeLODChanges() does - propagate into a coarse level, upsample it into the full
+	// resolution light volume, then refine the light level by level.
+	FRaymarchCPUResources Full = RaymarchTestHelpers::MakeTestResources(Dimensions, Random);
+	FRaymarchCPUResources Levels[LightVolumeLODCount - 1] = {Full, Full};
+	for (int32 Level = 1; Level < LightVolumeLODCount; Level++)
+	{
+		Levels[Level - 1].InitLightVolume(GetLightVolumeLODDimensions(Dimensions, Level));
+	}
+	FRaymarchCPUResources Reference = Full;
+	AddDirLightToSingleLightVolume_CPU(Reference, Light, true, WorldParameters);
+
+	AddDirLightToSingleLightVolume_CPU(Levels[1], Light, true, WorldParameters);
+	AddUpsampledLightVolume_CPU(Full, Levels[1], 1.0f);
+	const double ReferenceMean = GetMean(Reference.LightVolume);
+	TestTrue(TEXT("Quarter resolution keeps the overall light"),
+		FMath::Abs(GetMean(Full.LightVolume) - ReferenceMean) < 0.2 * ReferenceMean);
+
+	// Quarter to half resolution.
+	AddUpsampledLightVolume_CPU(Full, Levels[1], -1.0f);
+	AddUpsampledLightVolume_CPU(Full, Levels[0], -1.0f);
+	AddDirLightToSingleLightVolume_CPU(Levels[1], Light, false, WorldParameters);
+	AddDirLightToSingleLightVolume_CPU(Levels[0], Light, true, WorldParameters);
+	AddUpsampledLightVolume_CPU(Full, Levels[1], 1.0f);
+	AddUpsampledLightVolume_CPU(Full, Levels[0], 1.0f);
+	TestTrue(TEXT("Half resolution keeps the overall light"),
+		FMath::Abs(GetMean(Full.LightVolume) - ReferenceMean) < 0.1 * ReferenceMean);
+
+	// Half to full resolution.
+	AddUpsampledLightVolume_CPU(Full, Levels[0], -1.0f);
+	AddDirLightToSingleLightVolume_CPU(Levels[0], Light, false, WorldParameters);
+	AddDirLightToSingleLightVolume_CPU(Full, Light, true, WorldParameters);
+	AddUpsampledLightVolume_CPU(Full, Levels[0], 1.0f);
+	TestTrue(TEXT("Refined light volume matches propagating at full resolution"),
+		RaymarchTestHelpers::GetMaxDifference(Full.LightVolume, Reference.LightVolume) < 1e-4f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,448 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests and a headless benchmark of the CPU directional light propagation.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/LightingShaderUtils.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUPropagationTest, "TBRaymarcher.Raymarcher.LightingCPU.Propagation",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUPropagationTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+	const FDirLightParameters MovedLight(FVector(0.35, 0.15, -1.0).GetSafeNormal(), 0.8f);
+
+	// Fully transparent volume - light along a single axis reaches every voxel unchanged.
+	{
+		FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+		for (FLinearColor& Color : Resources.TransferFunction)
+		{
+			Color.A = 0.0f;
+		}
+		AddDirLightToSingleLightVolume_CPU(Resources, FDirLightParameters(FVector(0, 0, -1), 0.8f), true, WorldParameters);
+		TArray64<float> Expected;
+		Expected.Init(0.8f, Resources.LightVolume.Num());
+		TestTrue(TEXT("Transparent volume is lit evenly"),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Expected) < 1e-6f);
+	}
+
+	// Adding and removing a light leaves an empty light volume.
+	{
+		FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+		const TArray64<float> Empty = Resources.LightVolume;
+		AddDirLightToSingleLightVolume_CPU(Resources, Light, true, WorldParameters);
+		TestTrue(TEXT("Adding a light lights the volume"),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Empty) > 0.1f);
+		AddDirLightToSingleLightVolume_CPU(Resources, Light, false, WorldParameters);
+		TestTrue(TEXT("Removing the light again empties the volume"),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Empty) < 1e-5f);
+	}
+
+	// Changing a light there and back restores the light volume. (Not compared to remove + add, because the change shader also
+	// samples outside of the volume, while the add shader doesn't.)
+	{
+		FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+		AddDirLightToSingleLightVolume_CPU(Resources, Light, true, WorldParameters);
+		const TArray64<float> Original = Resources.LightVolume;
+
+		ChangeDirLightInSingleLightVolume_CPU(Resources, Light, MovedLight, WorldParameters);
+		TestTrue(TEXT("Changing a light changes the volume"),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Original) > 1e-3f);
+		ChangeDirLightInSingleLightVolume_CPU(Resources, MovedLight, Light, WorldParameters);
+		TestTrue(TEXT("Changing it back restores the volume"),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Original) < 1e-5f);
+	}
+
+	// A clipping plane cutting away half of the volume lets more light through than no clipping at all.
+	{
+		FRaymarchCPUResources Unclipped = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+		FRaymarchCPUResources Clipped = Unclipped;
+		FRaymarchWorldParameters ClippedWorldParameters = WorldParameters;
+		ClippedWorldParameters.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0), FVector(0, 0, -1));
+
+		AddDirLightToSingleLightVolume_CPU(Unclipped, Light, true, WorldParameters);
+		AddDirLightToSingleLightVolume_CPU(Clipped, Light, true, ClippedWorldParameters);
+
+		double UnclippedSum = 0.0, ClippedSum = 0.0;
+		for (int64 i = 0; i < Unclipped.LightVolume.Num(); i++)
+		{
+			UnclippedSum += Unclipped.LightVolume[i];
+			ClippedSum += Clipped.LightVolume[i];
+		}
+		TestTrue(TEXT("Clipping plane lets more light through"), ClippedSum > UnclippedSum);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUTransformChangeTest, "TBRaymarcher.Raymarcher.LightingCPU.TransformChange",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUTransformChangeTest::RunTest(const FString& Parameters)
+{
+	// Without a clipping plane, like ARaymarchVolume does it.
+	FRaymarchWorldParameters Original;
+	Original.VolumeTransform = FTransform(FRotator(10, 20, 30), FVector(100, 200, 300), FVector(200, 200, 100));
+	Original.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 100000), FVector(0, 0, -1));
+
+	auto Classify = [&Original](const FTransform& Transform, const FClippingPlaneParameters& Clipping) {
+		FRaymarchWorldParameters Changed;
+		Changed.VolumeTransform = Transform;
+		Changed.ClippingPlaneParameters = Clipping;
+		return ClassifyWorldParametersChange(Original, Changed);
+	};
+	const FClippingPlaneParameters NoClipping = Original.ClippingPlaneParameters;
+	const FTransform& Transform = Original.VolumeTransform;
+
+	TestTrue(TEXT("Same parameters"), Classify(Transform, NoClipping) == ELightVolumeInvalidation::None);
+	TestTrue(TEXT("Translation"),
+		Classify(FTransform(Transform.GetRotation(), FVector(-50, 0, 10), Transform.GetScale3D()), NoClipping) ==
+			ELightVolumeInvalidation::None);
+	TestTrue(TEXT("Uniform scale"),
+		Classify(FTransform(Transform.GetRotation(), Transform.GetLocation(), Transform.GetScale3D() * 1.5), NoClipping) ==
+			ELightVolumeInvalidation::None);
+	TestTrue(TEXT("Rotation"),
+		Classify(FTransform(FRotator(10, 25, 30), Transform.GetLocation(), Transform.GetScale3D()), NoClipping) ==
+			ELightVolumeInvalidation::LightDirections);
+	TestTrue(TEXT("Non-uniform scale"),
+		Classify(FTransform(Transform.GetRotation(), Transform.GetLocation(), FVector(200, 100, 100)), NoClipping) ==
+			ELightVolumeInvalidation::LightDirections);
+	TestTrue(TEXT("Clipping plane moved into the volume"),
+		Classify(Transform, FClippingPlaneParameters(Transform.GetLocation(), FVector(0, 0, -1))) ==
+			ELightVolumeInvalidation::Clipping);
+	TestTrue(TEXT("Rotation and clipping plane moved into the volume"),
+		Classify(FTransform(FRotator(10, 25, 30), Transform.GetLocation(), Transform.GetScale3D()),
+			FClippingPlaneParameters(Transform.GetLocation(), FVector(0, 0, -1))) == ELightVolumeInvalidation::Full);
+
+	// A clipping plane cutting through the volume, moved along with it.
+	Original.ClippingPlaneParameters = FClippingPlaneParameters(Transform.GetLocation(), FVector(0, 0, 1));
+	const FVector Offset(30, -40, 50);
+	const FTransform Translated(Transform.GetRotation(), Transform.GetLocation() + Offset, Transform.GetScale3D());
+	TestTrue(TEXT("Volume and clipping plane translated together"),
+		Classify(Translated, FClippingPlaneParameters(Transform.GetLocation() + Offset, FVector(0, 0, 1))) ==
+			ELightVolumeInvalidation::None);
+	TestTrue(TEXT("Clipping plane moved within itself"),
+		Classify(Transform, FClippingPlaneParameters(Transform.GetLocation() + FVector(40, 40, 0), FVector(0, 0, 1))) ==
+			ELightVolumeInvalidation::None);
+	TestTrue(TEXT("Volume translated under the clipping plane"),
+		Classify(Translated, Original.ClippingPlaneParameters) == ELightVolumeInvalidation::Clipping);
+
+	// Rebasing a light keeps its local direction.
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+	const FTransform Rotated(FRotator(40, -30, 70), FVector(10, 0, 0), FVector(100, 300, 200));
+	const FDirLightParameters Rebased = GetLightParametersForTransform(Light, Transform, Rotated);
+	TestTrue(TEXT("Rebased light keeps its local direction"),
+		Rotated.InverseTransformVector(Rebased.LightDirection)
+			.GetSafeNormal()
+			.Equals(Transform.InverseTransformVector(Light.LightDirection).GetSafeNormal(), 1e-5));
+	TestEqual(TEXT("Rebased light keeps its intensity"), Rebased.LightIntensity, Light.LightIntensity);
+
+	// Changing a light in place after rotating the volume is the same as rotating the light the other way instead.
+	{
+		FRandomStream Random(7);
+		FRaymarchCPUResources VolumeRotated = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+		FRaymarchCPUResources LightRotated = VolumeRotated;
+		FRaymarchWorldParameters Unrotated = RaymarchTestHelpers::MakeWorldParameters();
+		Unrotated.ClippingPlaneParameters = NoClipping;
+		FRaymarchWorldParameters RotatedWorldParameters = Unrotated;
+		RotatedWorldParameters.VolumeTransform = FTransform(FRotator(0, 5, 3));
+		TestTrue(TEXT("Rotating the volume only changes light directions"),
+			ClassifyWorldParametersChange(Unrotated, RotatedWorldParameters) == ELightVolumeInvalidation::LightDirections);
+
+		AddDirLightToSingleLightVolume_CPU(VolumeRotated, Light, true, Unrotated);
+		ChangeDirLightInSingleLightVolume_CPU(VolumeRotated,
+			GetLightParametersForTransform(Light, Unrotated.VolumeTransform, RotatedWorldParameters.VolumeTransform), Light,
+			RotatedWorldParameters);
+
+		const FDirLightParameters InverseRotatedLight(
+			RotatedWorldParameters.VolumeTransform.InverseTransformVector(Light.LightDirection), Light.LightIntensity);
+		AddDirLightToSingleLightVolume_CPU(LightRotated, Light, true, Unrotated);
+		ChangeDirLightInSingleLightVolume_CPU(LightRotated, Light, InverseRotatedLight, Unrotated);
+
+		TestTrue(TEXT("Changing in place matches rotating the light"),
+			RaymarchTestHelpers::GetMaxDifference(VolumeRotated.LightVolume, LightRotated.LightVolume) < 1e-5f);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUClippingChangeTest, "TBRaymarcher.Raymarcher.LightingCPU.ClippingChange",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUClippingChangeTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	const FIntVector Dimensions(24, 20, 32);
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+
+	// Clipping planes cutting through the volume, each one further away from the light.
+	TArray<FRaymarchWorldParameters> Moves;
+	for (const double Z : {0.1, -0.05, -0.2})
+	{
+		FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+		WorldParameters.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, Z), FVector(0, 0, 1));
+		Moves.Add(WorldParameters);
+	}
+
+	FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(Dimensions, Random);
+	const FRaymarchCPUResources Empty = Resources;
+	FLightSnapshotsCPU Snapshots;
+	Snapshots.Snapshots = PlanSnapshotCapture(Light, Moves[0], Dimensions);
+	TestTrue(TEXT("Snapshot gets captured before the clipping plane"), Snapshots.Snapshots.Axes[0].IsValid());
+	AddDirLightToSingleLightVolume_CPU(Resources, Light, true, Moves[0], nullptr, &Snapshots);
+
+	for (int32 i = 1; i < Moves.Num(); i++)
+	{
+		const FClippingChangePlan Plan = PlanClippingChange(Light, Moves[i - 1], Moves[i], Dimensions, Snapshots.Snapshots);
+		TestTrue(FString::Printf(TEXT("Move %d resumes from the snapshot"), i), Plan.Axes[0].ResumeSlice != Plan.Axes[0].Start);
+		TestTrue(FString::Printf(TEXT("Move %d is cheaper than a full recompute"), i), Plan.GetCost() < Plan.GetFullCost());
+		ChangeClippingInSingleLightVolume_CPU(Resources, Light, Moves[i - 1], Moves[i], Plan, Snapshots);
+
+		FRaymarchCPUResources Expected = Empty;
+		AddDirLightToSingleLightVolume_CPU(Expected, Light, true, Moves[i]);
+		TestTrue(FString::Printf(TEXT("Move %d matches adding the light with the new clipping plane"), i),
+			RaymarchTestHelpers::GetMaxDifference(Resources.LightVolume, Expected.LightVolume) < 1e-5f);
+	}
+
+	const FClippingChangePlan Unchanged = PlanClippingChange(Light, Moves.Last(), Moves.Last(), Dimensions, Snapshots.Snapshots);
+	TestFalse(TEXT("Same clipping plane leaves the light clean"), Unchanged.Axes[0].IsDirty() || Unchanged.Axes[1].IsDirty());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUBatchedTest, "TBRaymarcher.Raymarcher.LightingCPU.Batched",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUBatchedTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	WorldParameters.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0.1), FVector(0.2, 0, 1).GetSafeNormal());
+
+	// Five lights sharing their major axes, one with a different second axis, one from the side and one without a direction.
+	const TArray<FDirLightParameters> Lights = {FDirLightParameters(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f),
+		FDirLightParameters(FVector(0.25, 0.1, -1.0).GetSafeNormal(), 0.5f),
+		FDirLightParameters(FVector(0.4, 0.3, -1.0).GetSafeNormal(), 1.0f),
+		FDirLightParameters(FVector(0.2, 0.05, -1.0).GetSafeNormal(), 0.3f),
+		FDirLightParameters(FVector(0.3, 0.25, -1.0).GetSafeNormal(), 0.6f),
+		FDirLightParameters(FVector(0.1, 0.4, -1.0).GetSafeNormal(), 0.7f),
+		FDirLightParameters(FVector(-1.0, 0.2, 0.3).GetSafeNormal(), 0.9f), FDirLightParameters(FVector(0, 0, 0), 1.0f)};
+
+	const TArray<TArray<int32>> Batches = GroupLightsIntoBatches(Lights, WorldParameters.VolumeTransform);
+	if (TestEqual(TEXT("Number of batches"), Batches.Num(), 4))
+	{
+		TestTrue(TEXT("First batch is full"), Batches[0] == TArray<int32>({0, 1, 2, 3}));
+		TestTrue(TEXT("Fifth light gets a batch of its own"), Batches[1] == TArray<int32>({4}));
+		TestTrue(TEXT("Different second axis gets a batch of its own"), Batches[2] == TArray<int32>({5}));
+		TestTrue(TEXT("Different first axis gets a batch of its own"), Batches[3] == TArray<int32>({6}));
+	}
+
+	FRaymarchCPUResources Batched = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+	FRaymarchCPUResources OneByOne = Batched;
+	const TArray64<float> Empty = Batched.LightVolume;
+	for (const FDirLightParameters& Light : Lights)
+	{
+		AddDirLightToSingleLightVolume_CPU(OneByOne, Light, true, WorldParameters);
+	}
+	AddDirLightsToSingleLightVolume_CPU(Batched, Lights, true, WorldParameters);
+	TestTrue(TEXT("Batched lights match adding them one by one"),
+		RaymarchTestHelpers::GetMaxDifference(Batched.LightVolume, OneByOne.LightVolume) < 1e-5f);
+
+	AddDirLightsToSingleLightVolume_CPU(Batched, Lights, false, WorldParameters);
+	TestTrue(TEXT("Removing the batched lights empties the volume"),
+		RaymarchTestHelpers::GetMaxDifference(Batched.LightVolume, Empty) < 1e-5f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUGPUSyncTest, "TBRaymarcher.Raymarcher.LightingCPU.GPUSync",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUGPUSyncTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(11);
+	FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	WorldParameters.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0.1), FVector(0.2, 0, 1).GetSafeNormal());
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+
+	FDirLightParameters LocalLight;
+	FMajorAxes LocalAxes;
+	GetLocalLightParamsAndAxes(Light, WorldParameters.VolumeTransform, LocalLight, LocalAxes);
+
+	// Slices larger than the thread group, so that every thread handles more than one pixel.
+	FRaymarchCPUResources SingleDispatch = RaymarchTestHelpers::MakeTestResources(FIntVector(40, 36, 24), Random);
+	FRaymarchCPUResources PerSlice = SingleDispatch;
+	const TArray64<float> Empty = SingleDispatch.LightVolume;
+
+	FGPUSyncScheduleCPUStats Stats;
+	AddDirLightToSingleLightVolume_GPUSync_CPU(SingleDispatch, Light, true, WorldParameters, &Stats);
+	AddDirLightToSingleLightVolume_CPU(PerSlice, Light, true, WorldParameters);
+	TestTrue(TEXT("Single dispatch matches the per-slice propagation"),
+		RaymarchTestHelpers::GetMaxDifference(SingleDispatch.LightVolume, PerSlice.LightVolume) < 1e-6f);
+	TestEqual(TEXT("Both axes propagate in a single dispatch"), Stats.SingleDispatchAxes, 2);
+	TestEqual(TEXT("No shared memory races"), Stats.Hazards, 0);
+
+	// One barrier after clearing the first read buffer and one after every slice.
+	int32 ExpectedBarriers = 0;
+	for (unsigned i = 0; i < 2; i++)
+	{
+		ExpectedBarriers += 1 + GetTransposedDimensions(LocalAxes, SingleDispatch.LightVolumeDimensions, i).Z;
+	}
+	TestEqual(TEXT("Barrier count"), Stats.Barriers, ExpectedBarriers);
+
+	AddDirLightToSingleLightVolume_GPUSync_CPU(SingleDispatch, Light, false, WorldParameters);
+	TestTrue(TEXT("Removing the light empties the volume"),
+		RaymarchTestHelpers::GetMaxDifference(SingleDispatch.LightVolume, Empty) < 1e-5f);
+
+	// The slices along Z don't fit into group shared memory, the ones along X do.
+	FRaymarchCPUResources Mixed = RaymarchTestHelpers::MakeTestResources(FIntVector(80, 72, 8), Random);
+	FRaymarchCPUResources MixedPerSlice = Mixed;
+	FGPUSyncScheduleCPUStats MixedStats;
+	AddDirLightToSingleLightVolume_GPUSync_CPU(Mixed, Light, true, WorldParameters, &MixedStats);
+	AddDirLightToSingleLightVolume_CPU(MixedPerSlice, Light, true, WorldParameters);
+	TestFalse(TEXT("Large slices can't propagate in a single dispatch"), CanPropagateInSingleDispatch(FIntVector(80, 72, 8)));
+	TestEqual(TEXT("Large slices fall back to a dispatch per slice"), MixedStats.PerSliceAxes, 1);
+	TestEqual(TEXT("Small slices still propagate in a single dispatch"), MixedStats.SingleDispatchAxes, 1);
+	TestTrue(TEXT("Fallback matches the per-slice propagation"),
+		RaymarchTestHelpers::GetMaxDifference(Mixed.LightVolume, MixedPerSlice.LightVolume) < 1e-6f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUQuantizationTest, "TBRaymarcher.Raymarcher.LightingCPU.Quantization",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingCPUQuantizationTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("G8 rounds to 1/255"), QuantizeLightValue(0.5f, ELightVolumeFormat::G8), 128.0f / 255.0f);
+	TestEqual(TEXT("G8 clamps over-lit voxels"), QuantizeLightValue(1.7f, ELightVolumeFormat::G8), 1.0f);
+	TestEqual(TEXT("G8 clamps negative values"), QuantizeLightValue(-0.2f, ELightVolumeFormat::G8), 0.0f);
+	TestTrue(TEXT("R16F keeps over-lit voxels"), FMath::Abs(QuantizeLightValue(1.7f, ELightVolumeFormat::R16F) - 1.7f) < 1e-3f);
+	TestEqual(TEXT("R32F is exact"), QuantizeLightValue(0.123456f, ELightVolumeFormat::R32F), 0.123456f);
+
+	// Two overlapping lights over-light the side of the volume they enter from.
+	FRandomStream Random(11);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	const FDirLightParameters Lights[2] = {FDirLightParameters(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f),
+		FDirLightParameters(FVector(-0.2, 0.1, -1.0).GetSafeNormal(), 0.8f)};
+
+	FRaymarchCPUResources Reference = RaymarchTestHelpers::MakeTestResources(FIntVector(24, 20, 16), Random);
+	FRaymarchCPUResources Half = Reference;
+	Half.LightVolumeFormat = ELightVolumeFormat::R16F;
+	FRaymarchCPUResources Byte = Reference;
+	Byte.LightVolumeFormat = ELightVolumeFormat::G8;
+	for (const FDirLightParameters& Light : Lights)
+	{
+		AddDirLightToSingleLightVolume_CPU(Reference, Light, true, WorldParameters);
+		AddDirLightToSingleLightVolume_CPU(Half, Light, true, WorldParameters);
+		AddDirLightToSingleLightVolume_CPU(Byte, Light, true, WorldParameters);
+	}
+
+	float MaxLight = 0.0f;
+	for (float Value : Half.LightVolume)
+	{
+		MaxLight = FMath::Max(MaxLight, Value);
+	}
+	TestTrue(TEXT("R16F light volume is over-lit"), MaxLight > 1.0f);
+	const float HalfError = RaymarchTestHelpers::GetMaxDifference(Half.LightVolume, Reference.LightVolume);
+	const float ByteError = RaymarchTestHelpers::GetMaxDifference(Byte.LightVolume, Reference.LightVolume);
+	AddInfo(FString::Printf(TEXT("Max quantization error - R16F: %f, G8: %f"), HalfError, ByteError));
+	TestTrue(TEXT("R16F light volume is close to R32F"), HalfError < 1e-2f);
+	TestTrue(TEXT("G8 light volume loses over-lit light"), ByteError > 0.1f);
+
+	// Removing a light takes back what adding it stored, up to rounding of the sum.
+	const TArray64<float> Original = Half.LightVolume;
+	AddDirLightToSingleLightVolume_CPU(Half, Lights[0], true, WorldParameters);
+	AddDirLightToSingleLightVolume_CPU(Half, Lights[0], false, WorldParameters);
+	TestTrue(TEXT("R16F adding and removing a light restores the volume"),
+		RaymarchTestHelpers::GetMaxDifference(Half.LightVolume, Original) < 1e-2f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUBatchedBenchmark, "TBRaymarcher.Raymarcher.LightingCPU.BatchedBenchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FLightingCPUBatchedBenchmark::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+
+	for (const int32 Size : {256, 512})
+	{
+		FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(FIntVector(Size), Random);
+		for (const int32 LightCount : {1, 4, 8})
+		{
+			// Lights from slightly different directions above the volume, all sharing their major axes.
+			TArray<FDirLightParameters> Lights;
+			for (int32 i = 0; i < LightCount; i++)
+			{
+				Lights.Add(FDirLightParameters(FVector(0.3 + 0.02 * i, 0.2 - 0.01 * i, -1.0).GetSafeNormal(), 0.8f / LightCount));
+			}
+
+			Resources.InitLightVolume(FIntVector(Size));
+			FLightPropagationCPUStats OneByOneStats;
+			for (const FDirLightParameters& Light : Lights)
+			{
+				AddDirLightToSingleLightVolume_CPU(Resources, Light, true, WorldParameters, &OneByOneStats);
+			}
+
+			Resources.InitLightVolume(FIntVector(Size));
+			FLightPropagationCPUStats BatchedStats;
+			AddDirLightsToSingleLightVolume_CPU(Resources, Lights, true, WorldParameters, &BatchedStats);
+
+			AddInfo(FString::Printf(TEXT("%d^3, %d lights : one by one %.1f ms (%d slices), batched %.1f ms (%d slices), %.2fx"),
+				Size, LightCount, OneByOneStats.Seconds * 1000.0, OneByOneStats.SlicesProcessed, BatchedStats.Seconds * 1000.0,
+				BatchedStats.SlicesProcessed, OneByOneStats.Seconds / BatchedStats.Seconds));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingCPUBenchmark, "TBRaymarcher.Raymarcher.LightingCPU.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FLightingCPUBenchmark::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(7);
+	const FRaymarchWorldParameters WorldParameters = RaymarchTestHelpers::MakeWorldParameters();
+	const FDirLightParameters Light(FVector(0.3, 0.2, -1.0).GetSafeNormal(), 0.8f);
+	const FDirLightParameters MovedLight(FVector(0.35, 0.15, -1.0).GetSafeNormal(), 0.8f);
+
+	for (const int32 Size : {128, 256})
+	{
+		FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeTestResources(FIntVector(Size), Random);
+
+		FLightPropagationCPUStats AddStats;
+		AddDirLightToSingleLightVolume_CPU(Resources, Light, true, WorldParameters, &AddStats);
+		AddInfo(FString::Printf(TEXT("%d^3 add : %s"), Size, *AddStats.ToString()));
+
+		FLightPropagationCPUStats ChangeStats;
+		ChangeDirLightInSingleLightVolume_CPU(Resources, Light, MovedLight, WorldParameters, &ChangeStats);
+		AddInfo(FString::Printf(TEXT("%d^3 change : %s"), Size, *ChangeStats.ToString()));
+
+		// Clipping plane moved by a few slices away from the light, compared to adding the light again above.
+		FRaymarchWorldParameters Clipped = WorldParameters, MovedClipped = WorldParameters;
+		Clipped.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0.1), FVector(0, 0, 1));
+		MovedClipped.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0.05), FVector(0, 0, 1));
+		Resources.InitLightVolume(FIntVector(Size));
+		FLightSnapshotsCPU Snapshots;
+		Snapshots.Snapshots = PlanSnapshotCapture(Light, Clipped, FIntVector(Size));
+		AddDirLightToSingleLightVolume_CPU(Resources, Light, true, Clipped, nullptr, &Snapshots);
+
+		const FClippingChangePlan Plan = PlanClippingChange(Light, Clipped, MovedClipped, FIntVector(Size), Snapshots.Snapshots);
+		FLightPropagationCPUStats ClippingStats;
+		ChangeClippingInSingleLightVolume_CPU(Resources, Light, Clipped, MovedClipped, Plan, Snapshots, &ClippingStats);
+		AddInfo(FString::Printf(TEXT("%d^3 clipping change (%.0f%% of full cost) : %s"), Size,
+			100.0 * Plan.GetCost() / Plan.GetFullCost(), *ClippingStats.ToString()));
+	}
+	return true;
+}
+
+#endif
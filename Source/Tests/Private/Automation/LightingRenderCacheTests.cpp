@@ -0,0 +1,92 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the render thread cache of lighting samplers and per-axis constants. Runs on the render thread, but doesn't dispatch
+// anything.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Rendering/LightingRenderCache.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "RenderingThread.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightingRenderCacheTest, "TBRaymarcher.Raymarcher.LightingRenderCache.Reuse",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightingRenderCacheTest::RunTest(const FString& Parameters)
+{
+	const FDirLightParameters Light(FVector(0.2, 0.3, 1).GetSafeNormal(), 1.0f);
+	FDirLightParameters LocalLight;
+	FMajorAxes LocalAxes;
+	GetLocalLightParamsAndAxes(Light, FTransform::Identity, LocalLight, LocalAxes);
+	const FIntVector TransposedDimensions = GetTransposedDimensions(LocalAxes, FIntVector(64, 32, 16), 0);
+	const FLightAxisConstants Expected = GetLightAxisConstants(LocalLight, LocalAxes, 0, TransposedDimensions);
+
+	// Samplers created by every step below.
+	int32 RepeatedSamplers = 0;
+	int32 OtherSamplers = 0;
+	int32 InvalidatedSamplers = 0;
+	int32 UncachedSamplers = 0;
+	bool bConstantsMatch = true;
+	bool bInvalidated = false;
+
+	ENQUEUE_RENDER_COMMAND(LightingRenderCacheTest)
+	(
+		[&](FRHICommandListImmediate& RHICmdList)
+		{
+			FLightingRenderCache& Cache = FLightingRenderCache::Get();
+			const uint32 ResourcesId = FLightingRenderCache::AllocateResourcesId();
+			const uint32 BorderColor = FColor(128, 0, 0, 0).ToPackedARGB();
+
+			int32 Created = Cache.GetNumCreatedSamplers();
+			auto CreatedSince = [&Cache, &Created]()
+			{
+				const int32 Count = Cache.GetNumCreatedSamplers() - Created;
+				Created = Cache.GetNumCreatedSamplers();
+				return Count;
+			};
+
+			Cache.GetBufferSampler(ResourcesId, BorderColor);
+			CreatedSince();
+			Cache.GetBufferSampler(ResourcesId, BorderColor);
+			RepeatedSamplers = CreatedSince();
+
+			Cache.GetVolumeSampler(ResourcesId, BorderColor);
+			Cache.GetBufferSampler(ResourcesId, FColor(64, 0, 0, 0).ToPackedARGB());
+			OtherSamplers = CreatedSince();
+
+			for (int32 i = 0; i < 2; i++)
+			{
+				const FLightAxisConstants Constants =
+					Cache.GetAxisConstants(ResourcesId, LocalLight, LocalAxes, 0, TransposedDimensions);
+				bConstantsMatch &= Constants.PermutationMatrix.Equals(Expected.PermutationMatrix) &&
+								   Constants.PrevPixelOffset.Equals(Expected.PrevPixelOffset) &&
+								   Constants.UVWOffset.Equals(Expected.UVWOffset) && Constants.StepSize == Expected.StepSize;
+			}
+
+			Cache.Invalidate(ResourcesId);
+			bInvalidated = !Cache.IsCached(ResourcesId);
+			Cache.GetBufferSampler(ResourcesId, BorderColor);
+			InvalidatedSamplers = CreatedSince();
+			Cache.Invalidate(ResourcesId);
+
+			Cache.GetBufferSampler(0, BorderColor);
+			Cache.GetBufferSampler(0, BorderColor);
+			UncachedSamplers = CreatedSince();
+		});
+	FlushRenderingCommands();
+
+	TestEqual(TEXT("Repeated sampler is reused"), RepeatedSamplers, 0);
+	TestEqual(TEXT("Different samplers get created"), OtherSamplers, 2);
+	TestTrue(TEXT("Cached axis constants match the computed ones"), bConstantsMatch);
+	TestTrue(TEXT("Invalidating drops the resources"), bInvalidated);
+	TestEqual(TEXT("Invalidated sampler gets created again"), InvalidatedSamplers, 1);
+	TestEqual(TEXT("Resources without an id don't get cached"), UncachedSamplers, 2);
+	return true;
+}
+
+#endif
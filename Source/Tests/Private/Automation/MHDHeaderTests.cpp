@@ -0,0 +1,165 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests and benchmarks of the single-pass MetaImage header parser and the batch header scan.
+
+#include "CoreMinimal.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/MHDHeader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+// A header as written by ITK/SimpleITK.
+const ANSICHAR* TypicalHeader = "ObjectType = Image\n"
+								"NDims = 3\n"
+								"BinaryData = True\n"
+								"BinaryDataByteOrderMSB = False\n"
+								"CompressedData = True\n"
+								"CompressedDataSize = 1234567\n"
+								"TransformMatrix = 1 0 0 0 1 0 0 0 1\n"
+								"Offset = -120.5 -98.25 -300\n"
+								"CenterOfRotation = 0 0 0\n"
+								"AnatomicalOrientation = RAI\n"
+								"ElementSpacing = 0.7 0.7 1.25\n"
+								"DimSize = 512 512 300\n"
+								"ElementType = MET_SHORT\n"
+								"ElementDataFile = volume.zraw\n";
+
+bool ParseString(const ANSICHAR* Text, FMHDHeader& OutHeader)
+{
+	return FMHDHeaderParser::Parse(Text, FCStringAnsi::Strlen(Text), OutHeader);
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMHDHeaderParsesKeyTableTest, "TBRaymarcher.VolumeTextureToolkit.MHDHeader.ParsesKeyTable",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMHDHeaderParsesKeyTableTest::RunTest(const FString& Parameters)
+{
+	FMHDHeader Header;
+	TestTrue(TEXT("Typical header parses"), ParseString(TypicalHeader, Header));
+	TestEqual(TEXT("Entry count"), Header.Entries.Num(), 14);
+	TestEqual(TEXT("NDims"), Header.NDims, 3);
+	TestEqual(TEXT("DimSize"), Header.DimSize, FIntVector(512, 512, 300));
+	TestEqual(TEXT("ElementSpacing"), Header.ElementSpacing, FVector(0.7, 0.7, 1.25));
+	TestEqual(TEXT("Offset"), Header.Offset, FVector(-120.5, -98.25, -300));
+	TestTrue(TEXT("TransformMatrix"), Header.TransformMatrix.Equals(FMatrix::Identity));
+	TestEqual(TEXT("AnatomicalOrientation"), Header.AnatomicalOrientation, FString(TEXT("RAI")));
+	TestTrue(TEXT("CompressedData"), Header.bCompressedData);
+	TestEqual(TEXT("CompressedDataSize"), Header.CompressedDataSize, static_cast<int64>(1234567));
+	TestEqual(TEXT("ElementDataFile"), Header.ElementDataFile, FString(TEXT("volume.zraw")));
+	TestEqual(TEXT("Generic key lookup"), Header.Find(TEXT("BinaryData")) ? *Header.Find(TEXT("BinaryData")) : FString(),
+		FString(TEXT("True")));
+
+	FVolumeInfo Info;
+	TestTrue(TEXT("Typical header converts"), Header.ToVolumeInfo(Info));
+	TestEqual(TEXT("Format"), static_cast<int32>(Info.OriginalFormat), static_cast<int32>(EVolumeVoxelFormat::SignedShort));
+	TestEqual(TEXT("Dimensions"), Info.Dimensions, FIntVector(512, 512, 300));
+	TestEqual(TEXT("WorldDimensions"), Info.WorldDimensions, FVector(512 * 0.7, 512 * 0.7, 300 * 1.25));
+	TestTrue(TEXT("Compressed"), Info.bIsCompressed);
+	TestEqual(TEXT("CompressedByteSize"), Info.CompressedByteSize, static_cast<int64>(1234567));
+	TestEqual(TEXT("DataFileName"), Info.DataFileName, FString(TEXT("volume.zraw")));
+
+	// Aliases, CRLF line endings, missing spaces around '=', ElementSize as spacing fallback, rotated transform and embedded data
+	// after the ElementDataFile line that must not be tokenized.
+	const ANSICHAR* UnusualHeader = "NDims=3\r\n"
+									"Comment = has = signs\r\n"
+									"Position = 1 2 3\r\n"
+									"Orientation = 0 1 0 -1 0 0 0 0 1\r\n"
+									"ElementSize = 2 2 3\r\n"
+									"DimSize = 4 4 4\r\n"
+									"ElementNumberOfChannels = 3\r\n"
+									"HeaderSize = -1\r\n"
+									"ElementType = MET_UCHAR\r\n"
+									"ElementDataFile = LOCAL\r\n"
+									"DimSize = 1 1 1\n";
+	TestTrue(TEXT("Unusual header parses"), ParseString(UnusualHeader, Header));
+	TestEqual(TEXT("Comment keeps everything after the first '='"), *Header.Find(TEXT("Comment")), FString(TEXT("has = signs")));
+	TestEqual(TEXT("Position is Offset"), Header.Offset, FVector(1, 2, 3));
+	TestEqual(TEXT("Orientation is TransformMatrix"), Header.TransformMatrix.M[1][0], -1.0);
+	TestEqual(TEXT("ElementSize spacing fallback"), Header.ElementSpacing, FVector(2, 2, 3));
+	TestEqual(TEXT("Stops after ElementDataFile"), Header.DimSize, FIntVector(4, 4, 4));
+	TestEqual(TEXT("HeaderByteLength"), Header.HeaderByteLength,
+		static_cast<int64>(FCStringAnsi::Strlen(UnusualHeader) - FCStringAnsi::Strlen("DimSize = 1 1 1\n")));
+	TestEqual(TEXT("ElementNumberOfChannels"), Header.ElementNumberOfChannels, 3);
+	TestEqual(TEXT("HeaderSize"), Header.HeaderSize, static_cast<int64>(-1));
+
+	AddExpectedError(TEXT("channels"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Multi-channel header is rejected"), Header.ToVolumeInfo(Info));
+
+	TestFalse(TEXT("Header without ElementType fails"), ParseString("DimSize = 1 2 3\nElementDataFile = a.raw\n", Header));
+	TestFalse(TEXT("Empty header fails"), ParseString("", Header));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMHDHeaderBenchmark, "TBRaymarcher.VolumeTextureToolkit.MHDHeader.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FMHDHeaderBenchmark::RunTest(const FString& Parameters)
+{
+	// Per-header parse cost, in memory.
+	{
+		constexpr int32 Iterations = 100000;
+		const int64 Length = FCStringAnsi::Strlen(TypicalHeader);
+		FMHDHeader Header;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			FMHDHeaderParser::Parse(TypicalHeader, Length, Header);
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		AddInfo(FString::Printf(TEXT("Parse : %.2f us per header"), Seconds * 1.0e6 / Iterations));
+	}
+
+	// Directory scan of 10k headers, serially and through the parallel batch scan.
+	{
+		constexpr int32 FileCount = 10000;
+		const FString Directory = FPaths::AutomationTransientDir() / TEXT("MHDHeaderBenchmark");
+		TArray<FString> FileNames;
+		for (int32 i = 0; i < FileCount; i++)
+		{
+			FileNames.Add(Directory / FString::Printf(TEXT("Volume%05d.mhd"), i));
+			if (!FFileHelper::SaveStringToFile(FString(TypicalHeader), *FileNames.Last()))
+			{
+				AddError(TEXT("Failed writing benchmark headers."));
+				IFileManager::Get().DeleteDirectory(*Directory, false, true);
+				return false;
+			}
+		}
+
+		double StartTime = FPlatformTime::Seconds();
+		int32 SerialParsed = 0;
+		for (const FString& FileName : FileNames)
+		{
+			FMHDHeader Header;
+			SerialParsed += FMHDHeaderParser::ParseFile(FileName, Header) ? 1 : 0;
+		}
+		const double SerialTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		const TArray<FMHDHeader> Headers = FMHDHeaderParser::ScanDirectory(Directory, false);
+		const double ParallelTime = FPlatformTime::Seconds() - StartTime;
+
+		int32 ParallelParsed = 0;
+		for (const FMHDHeader& Header : Headers)
+		{
+			ParallelParsed += Header.bParseWasSuccessful ? 1 : 0;
+		}
+		TestEqual(TEXT("Serially parsed headers"), SerialParsed, FileCount);
+		TestEqual(TEXT("Scanned headers"), ParallelParsed, FileCount);
+		AddInfo(FString::Printf(TEXT("Scan of %d files : serial %.1f ms, parallel %.1f ms (%.1fx)"), FileCount,
+			SerialTime * 1000.0, ParallelTime * 1000.0, SerialTime / ParallelTime));
+
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	}
+	return true;
+}
+
+#endif
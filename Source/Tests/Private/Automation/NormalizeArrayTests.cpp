@@ -0,0 +1,130 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests and benchmarks of the parallel UVolumeTextureToolkit::ConvertArrayToNormalizedArray against its serial reference.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "TextureUtilities.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// Fills an array with random values covering the whole range of T (or a sensible range for floats).
+template <typename T>
+void FillRandom(TArray64<T>& OutArray, int64 ElementCount, FRandomStream& Random)
+{
+	OutArray.SetNumUninitialized(ElementCount);
+	for (T& Value : OutArray)
+	{
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			Value = Random.FRandRange(-1024.0f, 3072.0f);
+		}
+		else
+		{
+			const uint32 Bits = Random.GetUnsignedInt();
+			FMemory::Memcpy(&Value, &Bits, sizeof(T));
+		}
+	}
+}
+
+template <typename InType, typename OutType>
+void CompareWithSerial(FAutomationTestBase& Test, const TCHAR* Name, const TArray64<InType>& Input)
+{
+	uint8* InputBytes = reinterpret_cast<uint8*>(const_cast<InType*>(Input.GetData()));
+	const uint64 ByteSize = Input.Num() * sizeof(InType);
+
+	float ParallelMin, ParallelMax, SerialMin, SerialMax;
+	const TUniquePtr<uint8[]> Parallel(
+		UVolumeTextureToolkit::ConvertArrayToNormalizedArray<InType, OutType>(InputBytes, ByteSize, ParallelMin, ParallelMax));
+	const TUniquePtr<uint8[]> Serial(
+		UVolumeTextureToolkit::ConvertArrayToNormalizedArraySerial<InType, OutType>(InputBytes, ByteSize, SerialMin, SerialMax));
+
+	Test.TestTrue(FString::Printf(TEXT("%s output matches serial output"), Name),
+		FMemory::Memcmp(Parallel.Get(), Serial.Get(), Input.Num() * sizeof(OutType)) == 0);
+	Test.TestEqual(FString::Printf(TEXT("%s min"), Name), ParallelMin, SerialMin);
+	Test.TestEqual(FString::Printf(TEXT("%s max"), Name), ParallelMax, SerialMax);
+}
+
+template <typename InType, typename OutType>
+void CompareWithSerial(FAutomationTestBase& Test, const TCHAR* Name, FRandomStream& Random)
+{
+	// Deliberately not a multiple of the chunk size, so that the last chunk is a partial one.
+	const int64 ElementCount = UVolumeTextureToolkit::ConversionChunkSize * 3 + 17;
+
+	TArray64<InType> Input;
+	FillRandom(Input, ElementCount, Random);
+	CompareWithSerial<InType, OutType>(Test, Name, Input);
+
+	// Constant volume.
+	const InType ConstantValue = Input[0];
+	Input.Init(ConstantValue, ElementCount);
+	CompareWithSerial<InType, OutType>(Test, *FString::Printf(TEXT("%s (constant)"), Name), Input);
+}
+
+template <typename InType, typename OutType>
+void Benchmark(FAutomationTestBase& Test, const TCHAR* Name, int64 ElementCount, FRandomStream& Random)
+{
+	TArray64<InType> Input;
+	FillRandom(Input, ElementCount, Random);
+	uint8* InputBytes = reinterpret_cast<uint8*>(Input.GetData());
+	const uint64 ByteSize = ElementCount * sizeof(InType);
+	const double GigaBytes = ByteSize / 1.0e9;
+
+	float Min, Max;
+	double StartTime = FPlatformTime::Seconds();
+	delete[] UVolumeTextureToolkit::ConvertArrayToNormalizedArraySerial<InType, OutType>(InputBytes, ByteSize, Min, Max);
+	const double SerialTime = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	delete[] UVolumeTextureToolkit::ConvertArrayToNormalizedArray<InType, OutType>(InputBytes, ByteSize, Min, Max);
+	const double ParallelTime = FPlatformTime::Seconds() - StartTime;
+
+	Test.AddInfo(FString::Printf(TEXT("%s : serial %.2f GB/s, parallel %.2f GB/s (%.1fx)"), Name, GigaBytes / SerialTime,
+		GigaBytes / ParallelTime, SerialTime / ParallelTime));
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNormalizeArrayMatchesSerialTest, "TBRaymarcher.VolumeTextureToolkit.NormalizeArray.MatchesSerial",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FNormalizeArrayMatchesSerialTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(1337);
+	CompareWithSerial<uint8, uint8>(*this, TEXT("UnsignedChar -> G8"), Random);
+	CompareWithSerial<int8, uint8>(*this, TEXT("SignedChar -> G8"), Random);
+	CompareWithSerial<uint16, uint16>(*this, TEXT("UnsignedShort -> G16"), Random);
+	CompareWithSerial<int16, uint16>(*this, TEXT("SignedShort -> G16"), Random);
+	CompareWithSerial<uint32, uint16>(*this, TEXT("UnsignedInt -> G16"), Random);
+	CompareWithSerial<int32, uint16>(*this, TEXT("SignedInt -> G16"), Random);
+	CompareWithSerial<float, uint16>(*this, TEXT("Float -> G16"), Random);
+	CompareWithSerial<uint16, uint8>(*this, TEXT("UnsignedShort -> G8"), Random);
+	CompareWithSerial<float, uint8>(*this, TEXT("Float -> G8"), Random);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNormalizeArrayBenchmark, "TBRaymarcher.VolumeTextureToolkit.NormalizeArray.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FNormalizeArrayBenchmark::RunTest(const FString& Parameters)
+{
+	// 256^3 voxels, a common CT volume size.
+	constexpr int64 ElementCount = 256 * 256 * 256;
+
+	FRandomStream Random(1337);
+	Benchmark<uint8, uint8>(*this, TEXT("UnsignedChar -> G8"), ElementCount, Random);
+	Benchmark<int8, uint8>(*this, TEXT("SignedChar -> G8"), ElementCount, Random);
+	Benchmark<uint16, uint16>(*this, TEXT("UnsignedShort -> G16"), ElementCount, Random);
+	Benchmark<int16, uint16>(*this, TEXT("SignedShort -> G16"), ElementCount, Random);
+	Benchmark<uint32, uint16>(*this, TEXT("UnsignedInt -> G16"), ElementCount, Random);
+	Benchmark<int32, uint16>(*this, TEXT("SignedInt -> G16"), ElementCount, Random);
+	Benchmark<float, uint16>(*this, TEXT("Float -> G16"), ElementCount, Random);
+	return true;
+}
+
+#endif
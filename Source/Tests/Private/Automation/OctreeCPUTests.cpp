@@ -0,0 +1,263 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests and a headless benchmark of the CPU min/max octree builder.
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformMemory.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Rendering/OctreeCPU.h"
+#include "Rendering/OctreeShaders.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// Random data volume, with values slightly outside of [0, 1] to exercise the clamping.
+FRaymarchCPUResources MakeTestVolume(FIntVector Dimensions, FRandomStream& Random)
+{
+	FRaymarchCPUResources Resources;
+	Resources.DataDimensions = Dimensions;
+	Resources.DataVolume.SetNumUninitialized(static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z);
+	for (float& Value : Resources.DataVolume)
+	{
+		Value = Random.FRandRange(-0.05f, 1.05f);
+	}
+	return Resources;
+}
+
+/// Number of texels of a mip that differ from the min/max of the voxels they cover, computed straight from the volume.
+int32 CountBruteForceMismatches(const FRaymarchCPUResources& Resources, const FOctreeMipCPU& Mip, int32 MipLevel)
+{
+	const int32 Footprint = 1 << MipLevel;
+	const FIntVector& DataDimensions = Resources.DataDimensions;
+	int32 Mismatches = 0;
+	for (int32 Z = 0; Z < Mip.Dimensions.Z; Z++)
+	{
+		for (int32 Y = 0; Y < Mip.Dimensions.Y; Y++)
+		{
+			for (int32 X = 0; X < Mip.Dimensions.X; X++)
+			{
+				float Max = 0.0f;
+				float Min = 1.0f;
+				for (int32 VZ = Z * Footprint; VZ < FMath::Min((Z + 1) * Footprint, DataDimensions.Z); VZ++)
+				{
+					for (int32 VY = Y * Footprint; VY < FMath::Min((Y + 1) * Footprint, DataDimensions.Y); VY++)
+					{
+						for (int32 VX = X * Footprint; VX < FMath::Min((X + 1) * Footprint, DataDimensions.X); VX++)
+						{
+							const float Value = FMath::Clamp(
+								Resources.DataVolume[VX + DataDimensions.X * (VY + static_cast<int64>(DataDimensions.Y) * VZ)],
+								0.0f, 1.0f);
+							Max = FMath::Max(Max, Value);
+							Min = FMath::Min(Min, Value);
+						}
+					}
+				}
+				const int64 Index = Mip.GetIndex(X, Y, Z);
+				Mismatches += (Mip.Max[Index] != Max || Mip.Min[Index] != Min) ? 1 : 0;
+			}
+		}
+	}
+	return Mismatches;
+}
+
+/// A 64^3 volume that is empty except for a small ball.
+FRaymarchCPUResources MakeSparseVolume()
+{
+	FRaymarchCPUResources Resources;
+	Resources.DataDimensions = FIntVector(64, 64, 64);
+	Resources.DataVolume.SetNumZeroed(64 * 64 * 64);
+	for (int32 Z = 0; Z < 64; Z++)
+	{
+		for (int32 Y = 0; Y < 64; Y++)
+		{
+			for (int32 X = 0; X < 64; X++)
+			{
+				if (FVector::Dist(FVector(X, Y, Z), FVector(40, 30, 32)) < 8.0)
+				{
+					Resources.DataVolume[X + 64 * (Y + 64 * Z)] = 0.8f;
+				}
+			}
+		}
+	}
+	return Resources;
+}
+
+/// Transfer function that is transparent for TF positions below Threshold and opaque above.
+TArray<FLinearColor> MakeThresholdTF(float Threshold)
+{
+	TArray<FLinearColor> TransferFunction;
+	for (int32 i = 0; i < 256; i++)
+	{
+		TransferFunction.Add(FLinearColor(1, 1, 1, i / 255.0f < Threshold ? 0.0f : 1.0f));
+	}
+	return TransferFunction;
+}
+
+/// True if trilinear sampling at a step of a ray can read a value in VisibleRange.
+bool CanSampleBeVisible(const FRaymarchCPUResources& Resources, const FVector3f& Entry, const FVector3f& Direction,
+	float StepCount, int32 Step, const FVector2f& VisibleRange)
+{
+	const FIntVector& Dimensions = Resources.DataDimensions;
+	const FVector3f VoxelPos = (Entry + Direction * (Step / StepCount)) * FVector3f(Dimensions) - 0.5f;
+	float Max = 0.0f;
+	float Min = 1.0f;
+	for (int32 Corner = 0; Corner < 8; Corner++)
+	{
+		const int32 X = FMath::Clamp(FMath::FloorToInt32(VoxelPos.X) + (Corner & 1), 0, Dimensions.X - 1);
+		const int32 Y = FMath::Clamp(FMath::FloorToInt32(VoxelPos.Y) + ((Corner >> 1) & 1), 0, Dimensions.Y - 1);
+		const int32 Z = FMath::Clamp(FMath::FloorToInt32(VoxelPos.Z) + ((Corner >> 2) & 1), 0, Dimensions.Z - 1);
+		const float Value = Resources.DataVolume[X + Dimensions.X * (Y + static_cast<int64>(Dimensions.Y) * Z)];
+		Max = FMath::Max(Max, Value);
+		Min = FMath::Min(Min, Value);
+	}
+	return Max >= VisibleRange.X && Min <= VisibleRange.Y;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOctreeCPUBuildTest, "TBRaymarcher.Raymarcher.OctreeCPU.Build",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOctreeCPUBuildTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("Octree dimensions"), GetOctreeDimensions(FIntVector(37, 20, 64)), FIntVector(64, 32, 64));
+	TestEqual(TEXT("Full mip chain"), GetOctreeMipCount(FIntVector(64, 32, 64)), 6);
+	TestEqual(TEXT("Mip dimensions"), GetOctreeMipDimensions(FIntVector(64, 32, 64), 5), FIntVector(2, 1, 2));
+
+	FRandomStream Random(5);
+	const FRaymarchCPUResources Resources = MakeTestVolume(FIntVector(37, 20, 64), Random);
+	const int32 NumMips = GetOctreeMipCount(GetOctreeDimensions(Resources.DataDimensions));
+
+	TArray<FOctreeMipCPU> Mips;
+	TestFalse(TEXT("Too many mips are rejected"), GenerateOctreeForVolume_CPU(Resources, NumMips + 1, Mips));
+	TestFalse(TEXT("Zero mips are rejected"), GenerateOctreeForVolume_CPU(Resources, 0, Mips));
+	if (!TestTrue(TEXT("Octree generates"), GenerateOctreeForVolume_CPU(Resources, NumMips, Mips)))
+	{
+		return false;
+	}
+	TestEqual(TEXT("Mip count"), Mips.Num(), NumMips);
+	TestEqual(TEXT("Last mip"), Mips.Last().Dimensions, FIntVector(2, 1, 2));
+
+	// Every mip matches the min/max of the voxels it covers, including the ones in the padding.
+	for (int32 Mip = 0; Mip < Mips.Num(); Mip++)
+	{
+		TestEqual(
+			FString::Printf(TEXT("Mip %d matches brute force"), Mip), CountBruteForceMismatches(Resources, Mips[Mip], Mip), 0);
+	}
+	const int64 PaddingIndex = Mips[0].GetIndex(40, 25, 0);
+	TestTrue(TEXT("Padding holds an empty range"), Mips[0].Max[PaddingIndex] == 0.0f && Mips[0].Min[PaddingIndex] == 1.0f);
+
+	// The serial build gives exactly the same octree.
+	TArray<FOctreeMipCPU> SerialMips;
+	GenerateOctreeForVolume_CPU(Resources, NumMips, SerialMips, false);
+	for (int32 Mip = 0; Mip < Mips.Num(); Mip++)
+	{
+		TestTrue(FString::Printf(TEXT("Serial mip %d matches"), Mip),
+			SerialMips[Mip].Max == Mips[Mip].Max && SerialMips[Mip].Min == Mips[Mip].Min);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOctreeCPUSkippingTest, "TBRaymarcher.Raymarcher.OctreeCPU.Skipping",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOctreeCPUSkippingTest::RunTest(const FString& Parameters)
+{
+	FWindowingParameters Window;
+	Window.Center = 0.5f;
+	Window.Width = 1.0f;
+
+	// Visible range of the windowing and transfer function.
+	const TArray<FLinearColor> TransferFunction = MakeThresholdTF(0.5f);
+	const FVector2f VisibleRange = GetOctreeVisibleRange(TransferFunction, Window);
+	TestTrue(TEXT("Transparent values are outside of the range"), VisibleRange.X > 0.49f && VisibleRange.X < 0.5f);
+	TestTrue(TEXT("Opaque top of the TF extends past the window"), VisibleRange.Y >= 1.0f);
+	const FVector2f EmptyRange = GetOctreeVisibleRange(MakeThresholdTF(2.0f), Window);
+	TestTrue(TEXT("Transparent TF has an empty range"), EmptyRange.X > EmptyRange.Y);
+	Window.LowCutoff = false;
+	TestTrue(TEXT("Opaque TF without low cutoff shows everything"), GetOctreeVisibleRange(MakeThresholdTF(0.0f), Window).X < 0.0f);
+	Window.LowCutoff = true;
+	Window.Center = 0.9f;
+	Window.Width = 0.2f;
+	TestTrue(TEXT("Low cutoff hides values below the window"), GetOctreeVisibleRange(MakeThresholdTF(0.0f), Window).X > 0.79f);
+
+	// Rays through a sparse volume.
+	const FRaymarchCPUResources Resources = MakeSparseVolume();
+	TArray<FOctreeMipCPU> Mips;
+	GenerateOctreeForVolume_CPU(Resources, GetOctreeMipCount(Resources.DataDimensions), Mips);
+
+	constexpr float StepCount = 150.0f;
+	FOctreeTraversalCPUStats Stats;
+	int32 MissedSamples = 0;
+	for (const FVector3f& Direction : {FVector3f(0, 0, 1), FVector3f(0.3f, -0.2f, 1.0f).GetSafeNormal()})
+	{
+		for (int32 Y = 0; Y < 16; Y++)
+		{
+			for (int32 X = 0; X < 16; X++)
+			{
+				const FVector3f Entry((X + 0.5f) / 16.0f, (Y + 0.5f) / 16.0f, 0.0f);
+				// Thickness until the ray leaves the unit cube.
+				float Thickness = 1.0f / Direction.Z;
+				for (int32 Axis = 0; Axis < 2; Axis++)
+				{
+					if (Direction[Axis] != 0.0f)
+					{
+						const float Exit = Direction[Axis] > 0.0f ? 1.0f - Entry[Axis] : Entry[Axis];
+						Thickness = FMath::Min(Thickness, Exit / FMath::Abs(Direction[Axis]));
+					}
+				}
+
+				TArray<int32> SampledSteps;
+				TraverseOctree_CPU(
+					Mips, Resources.DataDimensions, Entry, Direction, Thickness, StepCount, VisibleRange, Stats, &SampledSteps);
+				for (int32 Step = 1; Step <= FMath::FloorToInt32(Thickness * StepCount); Step++)
+				{
+					if (!SampledSteps.Contains(Step) &&
+						CanSampleBeVisible(Resources, Entry, Direction, StepCount, Step, VisibleRange))
+					{
+						MissedSamples++;
+					}
+				}
+			}
+		}
+	}
+	TestEqual(TEXT("No visible sample is skipped"), MissedSamples, 0);
+	TestTrue(TEXT("Most samples are skipped"), Stats.GetSampleFraction() < 0.25);
+	AddInfo(Stats.ToString());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOctreeCPUBenchmark, "TBRaymarcher.Raymarcher.OctreeCPU.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FOctreeCPUBenchmark::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(5);
+	for (const int32 Size : {512, 1024})
+	{
+		// Volume plus min and max of every mip - a bit over 3 floats per voxel.
+		const uint64 RequiredBytes = static_cast<uint64>(Size) * Size * Size * sizeof(float) * 7 / 2;
+		if (FPlatformMemory::GetStats().AvailablePhysical < RequiredBytes)
+		{
+			AddInfo(FString::Printf(TEXT("%d^3 : skipped, needs %llu MB of memory"), Size, RequiredBytes / (1024 * 1024)));
+			continue;
+		}
+
+		const FRaymarchCPUResources Resources = MakeTestVolume(FIntVector(Size), Random);
+		const int32 NumMips = GetOctreeMipCount(FIntVector(Size));
+		for (const bool bParallel : {false, true})
+		{
+			TArray<FOctreeMipCPU> Mips;
+			FOctreeCPUStats Stats;
+			GenerateOctreeForVolume_CPU(Resources, NumMips, Mips, bParallel, &Stats);
+			AddInfo(FString::Printf(TEXT("%d^3 %s : %s"), Size, bParallel ? TEXT("parallel") : TEXT("serial"), *Stats.ToString()));
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,142 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the pre-integrated transfer function table against per-sample classification.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/PreIntegratedTF.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// Transparent transfer function with a single half-opaque texel in the middle - the kind of sharp TF a fixed step raymarch needs
+/// many steps for.
+FRaymarchCPUResources MakeSpikeTFResources()
+{
+	FRaymarchCPUResources Resources;
+	for (int32 i = 0; i < 256; i++)
+	{
+		Resources.TransferFunction.Add(FLinearColor(i / 255.0f, 0.5f, 1.0f - i / 255.0f, i == 128 ? 0.5f : 0.0f));
+	}
+	Resources.WindowingParameters.Center = 0.5f;
+	Resources.WindowingParameters.Width = 1.0f;
+	return Resources;
+}
+
+/// Opacity of the segment between two data values, classified per sample with many tiny steps.
+float GetFineSteppedAlpha(const FRaymarchCPUResources& Resources, float FrontValue, float BackValue, float StepSize)
+{
+	constexpr int32 SubSteps = 4000;
+	float Transmittance = 1.0f;
+	for (int32 i = 0; i < SubSteps; i++)
+	{
+		const float Value = FMath::Lerp(FrontValue, BackValue, (i + 0.5f) / SubSteps);
+		Transmittance *= 1.0f - SampleWindowedTransferFunction_CPU(Resources, Value, StepSize / SubSteps).A;
+	}
+	return 1.0f - Transmittance;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPreIntegratedTFTableTest, "TBRaymarcher.Raymarcher.PreIntegratedTF.Table",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FPreIntegratedTFTableTest::RunTest(const FString& Parameters)
+{
+	TArray<FLinearColor> TransferFunction;
+	for (int32 i = 0; i < 256; i++)
+	{
+		TransferFunction.Add(FLinearColor(1.0f, i / 255.0f, 0.0f, FMath::Sin(i * 0.1f) * 0.5f + 0.5f));
+	}
+	const FPreIntegratedTransferFunction Table = PreIntegrateTransferFunction(TransferFunction);
+	TestEqual(TEXT("Table size"), Table.Size, 256);
+	TestEqual(TEXT("Texel count"), Table.Texels.Num(), 256 * 256);
+
+	int32 Asymmetric = 0;
+	for (int32 Y = 0; Y < Table.Size; Y++)
+	{
+		for (int32 X = 0; X < Y; X++)
+		{
+			Asymmetric += Table.GetTexel(X, Y).Equals(Table.GetTexel(Y, X), 1e-5f) ? 0 : 1;
+		}
+	}
+	TestEqual(TEXT("Table is symmetric"), Asymmetric, 0);
+	TestEqual(TEXT("Diagonal holds the extinction of the texel"), Table.GetTexel(40, 40).A,
+		-FMath::Loge(1.0f - TransferFunction[40].A), 1e-5f);
+
+	const FPreIntegratedTransferFunction SerialTable = PreIntegrateTransferFunction(TransferFunction, false);
+	TestTrue(TEXT("Serial build matches"), SerialTable.Texels == Table.Texels);
+
+	// A constant TF integrates to itself.
+	TArray<FLinearColor> ConstantTF;
+	ConstantTF.Init(FLinearColor(0.2f, 0.4f, 0.6f, 0.3f), 64);
+	const FPreIntegratedTransferFunction ConstantTable = PreIntegrateTransferFunction(ConstantTF);
+	const FLinearColor Expected = ConstantTable.GetTexel(0, 0);
+	int32 Mismatches = 0;
+	for (const FLinearColor& Texel : ConstantTable.Texels)
+	{
+		Mismatches += Texel.Equals(Expected, 1e-4f) ? 0 : 1;
+	}
+	TestEqual(TEXT("Constant TF gives a constant table"), Mismatches, 0);
+
+	TestEqual(TEXT("Empty TF gives an empty table"), PreIntegrateTransferFunction(TArray<FLinearColor>()).Size, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPreIntegratedTFSamplingTest, "TBRaymarcher.Raymarcher.PreIntegratedTF.Sampling",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FPreIntegratedTFSamplingTest::RunTest(const FString& Parameters)
+{
+	FRaymarchCPUResources Resources = MakeSpikeTFResources();
+	const FPreIntegratedTransferFunction Table = PreIntegrateTransferFunction(Resources.TransferFunction);
+	constexpr float StepSize = 10.0f;
+
+	// A segment of a single value is the same as classifying that value.
+	for (const float Value : {128.5f / 256.0f, 128.25f / 256.0f, 0.3f})
+	{
+		const FLinearColor PreIntegrated =
+			SampleWindowedPreIntegratedTransferFunction_CPU(Table, Value, Value, StepSize, Resources.WindowingParameters);
+		const FLinearColor PerSample = SampleWindowedTransferFunction_CPU(Resources, Value, StepSize);
+		TestEqual(FString::Printf(TEXT("Opacity of a point at %f"), Value), PreIntegrated.A, PerSample.A, 0.02f);
+	}
+
+	// Both ends of these segments are transparent, per-sample classification misses the spike between them.
+	for (const FVector2f& Segment : {FVector2f(0.2f, 0.8f), FVector2f(0.55f, 0.45f), FVector2f(0.49f, 0.52f)})
+	{
+		TestEqual(TEXT("Per-sample classification misses the spike"),
+			SampleWindowedTransferFunction_CPU(Resources, Segment.X, StepSize).A +
+				SampleWindowedTransferFunction_CPU(Resources, Segment.Y, StepSize).A,
+			0.0f);
+		const float PreIntegrated =
+			SampleWindowedPreIntegratedTransferFunction_CPU(Table, Segment.X, Segment.Y, StepSize, Resources.WindowingParameters).A;
+		const float Reference = GetFineSteppedAlpha(Resources, Segment.X, Segment.Y, StepSize);
+		TestTrue(FString::Printf(TEXT("Segment %s is visible"), *Segment.ToString()), PreIntegrated > 0.01f);
+		TestEqual(FString::Printf(TEXT("Segment %s matches fine steps"), *Segment.ToString()), PreIntegrated, Reference, 0.005f);
+	}
+
+	// Windowing cuts off the parts of a segment outside of the window.
+	TArray<FLinearColor> ConstantTF;
+	ConstantTF.Init(FLinearColor(1.0f, 1.0f, 1.0f, 0.3f), 256);
+	const FPreIntegratedTransferFunction ConstantTable = PreIntegrateTransferFunction(ConstantTF);
+	FWindowingParameters Window;
+	Window.Center = 0.5f;
+	Window.Width = 1.0f;
+	const float Extinction = -FMath::Loge(0.7f);
+	TestEqual(TEXT("Segment half in the window"),
+		SampleWindowedPreIntegratedTransferFunction_CPU(ConstantTable, -0.5f, 0.5f, StepSize, Window).A,
+		1.0f - FMath::Exp(-Extinction * 0.5f * StepSize), 1e-3f);
+	TestEqual(TEXT("Segment below the window"),
+		SampleWindowedPreIntegratedTransferFunction_CPU(ConstantTable, -0.5f, -0.1f, StepSize, Window).A, 0.0f);
+	Window.LowCutoff = false;
+	TestEqual(TEXT("Segment without low cutoff"),
+		SampleWindowedPreIntegratedTransferFunction_CPU(ConstantTable, -0.5f, 0.5f, StepSize, Window).A,
+		1.0f - FMath::Exp(-Extinction * StepSize), 1e-3f);
+	return true;
+}
+
+#endif
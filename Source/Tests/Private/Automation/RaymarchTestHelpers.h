@@ -0,0 +1,94 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Volumes and parameters shared by the automation tests of the CPU raymarching and lighting code.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Rendering/LightingCPU.h"
+#include "Rendering/OctreeCPU.h"
+#include "Rendering/OctreeShaders.h"
+
+namespace RaymarchTestHelpers
+{
+/// Random noise data volume with a mostly transparent ramp transfer function.
+inline FRaymarchCPUResources MakeTestResources(FIntVector Dimensions, FRandomStream& Random)
+{
+	FRaymarchCPUResources Resources;
+	Resources.DataDimensions = Dimensions;
+	Resources.DataVolume.SetNumUninitialized(static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z);
+	for (float& Value : Resources.DataVolume)
+	{
+		Value = Random.GetFraction();
+	}
+	for (int32 i = 0; i < 256; i++)
+	{
+		Resources.TransferFunction.Add(FLinearColor(1, 1, 1, i / 255.0f * 0.1f));
+	}
+	Resources.WindowingParameters.Center = 0.5f;
+	Resources.WindowingParameters.Width = 1.0f;
+	Resources.InitLightVolume(Dimensions);
+	return Resources;
+}
+
+/// Untransformed volume without a clipping plane.
+inline FRaymarchWorldParameters MakeWorldParameters()
+{
+	FRaymarchWorldParameters WorldParameters;
+	WorldParameters.VolumeTransform = FTransform::Identity;
+	WorldParameters.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0), FVector(0, 0, 0));
+	return WorldParameters;
+}
+
+inline float GetMaxDifference(const TArray64<float>& A, const TArray64<float>& B)
+{
+	float MaxDifference = 0.0f;
+	for (int64 i = 0; i < A.Num(); i++)
+	{
+		MaxDifference = FMath::Max(MaxDifference, FMath::Abs(A[i] - B[i]));
+	}
+	return MaxDifference;
+}
+
+/// A 64^3 volume that is empty except for a ball whose values fall off smoothly from its center.
+inline FRaymarchCPUResources MakeBallVolume()
+{
+	FRaymarchCPUResources Resources;
+	Resources.DataDimensions = FIntVector(64, 64, 64);
+	Resources.DataVolume.SetNumZeroed(64 * 64 * 64);
+	for (int32 Z = 0; Z < 64; Z++)
+	{
+		for (int32 Y = 0; Y < 64; Y++)
+		{
+			for (int32 X = 0; X < 64; X++)
+			{
+				const float Distance = FVector::Dist(FVector(X, Y, Z), FVector(36, 30, 32));
+				Resources.DataVolume[X + 64 * (Y + 64 * Z)] = FMath::Max(0.0f, 0.9f * (1.0f - Distance / 18.0f));
+			}
+		}
+	}
+
+	// Opacity ramps up from a value of 0.2, the color shifts from red to blue.
+	for (int32 i = 0; i < 256; i++)
+	{
+		const float Position = i / 255.0f;
+		Resources.TransferFunction.Add(
+			FLinearColor(1.0f - Position, 0.5f, Position, FMath::Clamp((Position - 0.2f) / 0.8f, 0.0f, 1.0f) * 0.3f));
+	}
+	Resources.WindowingParameters.Center = 0.5f;
+	Resources.WindowingParameters.Width = 1.0f;
+	return Resources;
+}
+
+/// Full octree of the volume.
+inline TArray<FOctreeMipCPU> MakeOctree(const FRaymarchCPUResources& Resources)
+{
+	TArray<FOctreeMipCPU> Mips;
+	GenerateOctreeForVolume_CPU(Resources, GetOctreeMipCount(GetOctreeDimensions(Resources.DataDimensions)), Mips);
+	return Mips;
+}
+}	 // namespace RaymarchTestHelpers
@@ -0,0 +1,153 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of the CPU model of reduced resolution raymarching against raymarching every pixel.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/ReducedResolutionRaymarch.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// A view along Z whose left part is covered by geometry cutting through the middle of the ball. The edge of the geometry is
+/// slanted, so that it doesn't line up with the low resolution blocks.
+FRaymarchViewCPU MakeOccludedView(int32 Resolution)
+{
+	FRaymarchViewCPU View;
+	View.Resolution = Resolution;
+	View.StepCount = 64.0f;
+	View.SceneDepth.Init(UE_BIG_NUMBER, Resolution * Resolution);
+	for (int32 Y = 0; Y < Resolution; Y++)
+	{
+		for (int32 X = 0; X < Resolution / 2 + Y / 4; X++)
+		{
+			// The volume starts at a depth of sqrt(3) - 0.5, the ball center is about half a unit behind that.
+			View.SceneDepth[X + Y * Resolution] = 1.75f;
+		}
+	}
+	return View;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FReducedResolutionUpsampleTest, "TBRaymarcher.Raymarcher.ReducedResolution.Upsample",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FReducedResolutionUpsampleTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("Full resolution divisor"), GetRaymarchResolutionDivisor(ERaymarchResolution::Full), 1);
+	TestEqual(TEXT("Half resolution divisor"), GetRaymarchResolutionDivisor(ERaymarchResolution::Half), 2);
+	TestEqual(TEXT("Quarter resolution divisor"), GetRaymarchResolutionDivisor(ERaymarchResolution::Quarter), 4);
+
+	const FBilateralUpsampleParameters Default;
+	TestEqual(TEXT("Matching depth keeps the bilinear weight"), GetBilateralUpsampleWeight(0.25f, 2.0f, 2.0f, Default), 0.25f);
+	TestTrue(TEXT("Depth difference lowers the weight"),
+		GetBilateralUpsampleWeight(0.25f, 2.0f, 1.0f, Default) < GetBilateralUpsampleWeight(0.25f, 2.0f, 1.95f, Default));
+
+	const FLinearColor Samples[4] = {FLinearColor(0.2f, 0.0f, 0.0f, 0.2f), FLinearColor(0.4f, 0.0f, 0.0f, 0.4f),
+		FLinearColor(0.2f, 0.0f, 0.0f, 0.2f), FLinearColor(0.4f, 0.0f, 0.0f, 0.4f)};
+	const float BilinearWeights[4] = {0.25f, 0.25f, 0.25f, 0.25f};
+	FLinearColor Color;
+
+	// All samples at the pixel's depth - a plain bilinear upsample.
+	const float SameDepths[4] = {2.0f, 2.0f, 2.0f, 2.0f};
+	TestFalse(TEXT("Matching samples are not an edge"), UpsamplePixel(Samples, SameDepths, BilinearWeights, 2.0f, Default, Color));
+	TestEqual(TEXT("Matching samples get interpolated bilinearly"), Color.A, 0.3f, 1e-5f);
+
+	// Samples ending in front of the pixel (on geometry it doesn't see) don't bleed into it.
+	const float SplitDepths[4] = {2.0f, 1.0f, 1.0f, 1.0f};
+	TestTrue(TEXT("Most of the weight at another depth is an edge"),
+		UpsamplePixel(Samples, SplitDepths, BilinearWeights, 2.0f, Default, Color));
+	TestEqual(TEXT("Samples at another depth are ignored"), Color.A, 0.2f, 1e-4f);
+
+	// None of the samples match, the closest one is taken.
+	const float FarDepths[4] = {3.0f, 1.0f, 4.0f, 5.0f};
+	UpsamplePixel(Samples, FarDepths, BilinearWeights, 0.5f, Default, Color);
+	TestEqual(TEXT("Without matching samples the closest one is taken"), Color.A, 0.4f);
+
+	// Silhouettes of the volume are edges even when the depths match.
+	const FLinearColor Silhouette[4] = {
+		FLinearColor::Transparent, FLinearColor(0.5f, 0.5f, 0.5f, 0.5f), FLinearColor::Transparent, FLinearColor::Transparent};
+	TestTrue(TEXT("Opacity difference is an edge"), UpsamplePixel(Silhouette, SameDepths, BilinearWeights, 2.0f, Default, Color));
+	const float CornerWeights[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+	TestFalse(TEXT("Samples without bilinear weight don't make an edge"),
+		UpsamplePixel(Silhouette, SameDepths, CornerWeights, 2.0f, Default, Color));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FReducedResolutionAccuracyTest, "TBRaymarcher.Raymarcher.ReducedResolution.Accuracy",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FReducedResolutionAccuracyTest::RunTest(const FString& Parameters)
+{
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	const FRaymarchViewCPU View = MakeOccludedView(64);
+
+	FBilateralUpsampleParameters Upsample;
+	const FReducedResolutionComparisonCPU Full =
+		CompareReducedResolutionRaymarch_CPU(Resources, View, ERaymarchResolution::Full, Upsample);
+	TestTrue(TEXT("Rays hit the ball"), Full.Full.Samples > 0);
+	TestEqual(TEXT("Full resolution matches raymarching every pixel"), Full.MaxError, 0.0);
+	TestEqual(TEXT("Full resolution has no edge pixels"), Full.EdgePixels, static_cast<int64>(0));
+
+	for (const ERaymarchResolution Resolution : {ERaymarchResolution::Half, ERaymarchResolution::Quarter})
+	{
+		const FString Name = StaticEnum<ERaymarchResolution>()->GetNameStringByValue(static_cast<int64>(Resolution));
+		const int32 Divisor = GetRaymarchResolutionDivisor(Resolution);
+
+		Upsample.bRefineEdges = false;
+		const FReducedResolutionComparisonCPU Bilateral =
+			CompareReducedResolutionRaymarch_CPU(Resources, View, Resolution, Upsample);
+		TestTrue(Name + TEXT(" takes a fraction of the samples"), Bilateral.GetSampleFraction() < 1.5 / (Divisor * Divisor));
+		TestTrue(Name + TEXT(" finds the edge of the geometry"), Bilateral.EdgePixels > 0);
+
+		// Ignoring the depths blends the volume behind the geometry into the pixels next to it.
+		FBilateralUpsampleParameters Bilinear = Upsample;
+		Bilinear.DepthTolerance = 1e6f;
+		const FReducedResolutionComparisonCPU Blurred = CompareReducedResolutionRaymarch_CPU(Resources, View, Resolution, Bilinear);
+		TestTrue(Name + TEXT(" depth awareness lowers the error"), Bilateral.MeanError < Blurred.MeanError);
+
+		Upsample.bRefineEdges = true;
+		const FReducedResolutionComparisonCPU Refined = CompareReducedResolutionRaymarch_CPU(Resources, View, Resolution, Upsample);
+		TestEqual(TEXT("Every edge pixel gets refined"), Refined.RefinedPixels, Refined.EdgePixels);
+		TestTrue(Name + TEXT(" refining edges lowers the error"), Refined.MeanError < Bilateral.MeanError);
+		TestTrue(Name + TEXT(" refining edges takes more samples"), Refined.Reduced.Samples > Bilateral.Reduced.Samples);
+		TestTrue(Name + TEXT(" still takes fewer samples"), Refined.GetSampleFraction() < 1.0);
+		AddInfo(FString::Printf(TEXT("%s : bilinear %.4f, bilateral %.4f, refined %s"), *Name, Blurred.MeanError,
+			Bilateral.MeanError, *Refined.ToString()));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FReducedResolutionBenchmark, "TBRaymarcher.Raymarcher.ReducedResolution.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FReducedResolutionBenchmark::RunTest(const FString& Parameters)
+{
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	for (const int32 Size : {256, 512})
+	{
+		FRaymarchViewCPU View = MakeOccludedView(Size);
+		View.StepCount = 150.0f;
+		for (const ERaymarchResolution Resolution : {ERaymarchResolution::Half, ERaymarchResolution::Quarter})
+		{
+			const FString Name = StaticEnum<ERaymarchResolution>()->GetNameStringByValue(static_cast<int64>(Resolution));
+			for (const bool bRefineEdges : {false, true})
+			{
+				FBilateralUpsampleParameters Upsample;
+				Upsample.bRefineEdges = bRefineEdges;
+				const FReducedResolutionComparisonCPU Comparison =
+					CompareReducedResolutionRaymarch_CPU(Resources, View, Resolution, Upsample);
+				AddInfo(FString::Printf(TEXT("%d^2 %s %s : %s"), Size, *Name, bRefineEdges ? TEXT("refined") : TEXT("upsampled"),
+					*Comparison.ToString()));
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,146 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests of temporal accumulation of amortized raymarches - history rejection, reprojection and the CPU model against
+// raymarching every step every frame.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "RaymarchTestHelpers.h"
+#include "Rendering/ReducedResolutionRaymarch.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTemporalAccumulationHistoryTest, "TBRaymarcher.Raymarcher.TemporalAccumulation.History",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTemporalAccumulationHistoryTest::RunTest(const FString& Parameters)
+{
+	FReducedResolutionRaymarchState History;
+	History.bTemporalAccumulation = true;
+	History.LocalClippingParameters = FClippingPlaneParameters(FVector(0.5), FVector(1, 0, 0));
+	TestTrue(TEXT("Same state keeps the history"), History.IsHistoryCompatible(History));
+
+	FReducedResolutionRaymarchState State = History;
+	State.VolumeTransform = FTransform(FRotator(10, 20, 30), FVector(100, 0, 0), FVector(2));
+	TestTrue(TEXT("Moving the volume reprojects the history"), State.IsHistoryCompatible(History));
+
+	State = History;
+	State.WindowingParameters.Center = 0.4f;
+	TestFalse(TEXT("Windowing change rejects the history"), State.IsHistoryCompatible(History));
+	State = History;
+	State.HistoryVersion++;
+	TestFalse(TEXT("Transfer function or light volume change rejects the history"), State.IsHistoryCompatible(History));
+	State = History;
+	State.LocalClippingParameters.Center.X = 0.6;
+	TestFalse(TEXT("Clipping change rejects the history"), State.IsHistoryCompatible(History));
+	State = History;
+	State.TemporalParameters.StepFrames = 2;
+	TestFalse(TEXT("Step frames change rejects the history"), State.IsHistoryCompatible(History));
+	State = History;
+	State.Resolution = ERaymarchResolution::Quarter;
+	TestFalse(TEXT("Resolution change rejects the history"), State.IsHistoryCompatible(History));
+	State = History;
+	State.bTemporalAccumulation = false;
+	TestFalse(TEXT("No history without accumulation"), State.IsHistoryCompatible(History));
+
+	// The history is the mean of the frames until it's full, then it keeps MaxHistoryFrames frames worth of weight.
+	FTemporalAccumulationParameters Temporal;
+	Temporal.MaxHistoryFrames = 4;
+	FLinearColor Color = FLinearColor::White;
+	float Frames = 0.0f;
+	AccumulateTemporalSample(Color, Frames, FLinearColor(0.2f, 0.2f, 0.2f, 0.2f), Temporal);
+	TestEqual(TEXT("First sample replaces the history"), Color.A, 0.2f);
+	AccumulateTemporalSample(Color, Frames, FLinearColor(0.4f, 0.4f, 0.4f, 0.4f), Temporal);
+	AccumulateTemporalSample(Color, Frames, FLinearColor(0.6f, 0.6f, 0.6f, 0.6f), Temporal);
+	TestEqual(TEXT("History is the mean of the frames"), Color.A, 0.4f, 1e-5f);
+	AccumulateTemporalSample(Color, Frames, FLinearColor(0.8f, 0.8f, 0.8f, 0.8f), Temporal);
+	AccumulateTemporalSample(Color, Frames, FLinearColor(1.0f, 1.0f, 1.0f, 1.0f), Temporal);
+	TestEqual(TEXT("Frames are capped"), Frames, 4.0f);
+	TestEqual(TEXT("Full history blends with the cap"), Color.A, 0.5f + 0.5f / 4.0f, 1e-5f);
+
+	// A point in UVW space lands where the world point of the previous volume transform projects to.
+	const FTransform VolumeTransform(FRotator(0, 90, 0), FVector(10, 20, 30), FVector(200));
+	const FVector PreViewTranslation(-5, 0, 100);
+	const FMatrix ViewProjection = FScaleMatrix(FVector(0.5, 0.25, 1.0)) * FTranslationMatrix(FVector(1, 2, 3));
+	const FMatrix UVWToClip = GetUVWToClipMatrix(VolumeTransform, PreViewTranslation, ViewProjection);
+	for (const FVector& UVW : {FVector(0.5), FVector(1.0, 0.5, 0.5), FVector(0.0, 0.25, 0.75)})
+	{
+		const FVector World = VolumeTransform.TransformPosition(UVW - FVector(0.5));
+		const FVector4 Expected = ViewProjection.TransformPosition(World + PreViewTranslation);
+		const FVector4 Clip = UVWToClip.TransformPosition(UVW);
+		TestTrue(FString::Printf(TEXT("UVW %s reprojects"), *UVW.ToString()), Clip.Equals(Expected, 1e-6));
+	}
+
+	// A single step frame is the fixed step raymarch.
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	const FVector3f Entry(0.0f, 0.45f, 0.5f);
+	const FVector3f Direction(1.0f, 0.0f, 0.0f);
+	FRaymarchCPUStats Stats;
+	const FLinearColor Fixed = RaymarchFixedStep_CPU(Resources, Entry, Direction, 1.0f, 100.0f, Stats);
+	const FLinearColor Amortized = RaymarchAmortized_CPU(Resources, Entry, Direction, 1.0f, 100.0f, 1, 3, Stats);
+	TestTrue(TEXT("Single step frame marches every step"), Amortized == Fixed);
+
+	// Away from the ball nothing ends the ray early - a quarter of the steps, plus the partial step of the offset.
+	FRaymarchCPUStats EmptyStats;
+	RaymarchAmortized_CPU(Resources, FVector3f(0.0f, 0.05f, 0.05f), Direction, 1.0f, 100.0f, 4, 1, EmptyStats);
+	TestEqual(TEXT("Amortized frame marches a fraction of the steps"), EmptyStats.Samples, static_cast<int64>(26));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTemporalAccumulationConvergenceTest, "TBRaymarcher.Raymarcher.TemporalAccumulation.Convergence",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTemporalAccumulationConvergenceTest::RunTest(const FString& Parameters)
+{
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	FRaymarchViewCPU View;
+	View.Resolution = 64;
+	View.StepCount = 64.0f;
+	View.ViewDirection = FVector3f(0.2f, -0.1f, 1.0f);
+
+	FTemporalAccumulationParameters Temporal;
+	Temporal.StepFrames = 1;
+	const FTemporalAccumulationComparisonCPU Single = CompareTemporalAccumulation_CPU(Resources, View, Temporal, 1);
+	TestTrue(TEXT("Rays hit the ball"), Single.Full.Samples > 0);
+	TestEqual(TEXT("A single step frame matches the full raymarch"), Single.MaxError, 0.0);
+
+	for (const int32 StepFrames : {2, 4})
+	{
+		Temporal.StepFrames = StepFrames;
+		const FTemporalAccumulationComparisonCPU Comparison =
+			CompareTemporalAccumulation_CPU(Resources, View, Temporal, StepFrames);
+		const FString Name = FString::Printf(TEXT("%d step frames"), StepFrames);
+		TestTrue(Name + TEXT(" march a fraction of the samples"), Comparison.GetSampleFractionPerFrame() < 1.5 / StepFrames);
+		TestTrue(Name + TEXT(" converge towards the full raymarch"), Comparison.MeanError < Comparison.FirstFrameMeanError);
+		AddInfo(FString::Printf(TEXT("%s : %s"), *Name, *Comparison.ToString()));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTemporalAccumulationBenchmark, "TBRaymarcher.Raymarcher.TemporalAccumulation.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FTemporalAccumulationBenchmark::RunTest(const FString& Parameters)
+{
+	const FRaymarchCPUResources Resources = RaymarchTestHelpers::MakeBallVolume();
+	FRaymarchViewCPU View;
+	View.Resolution = 256;
+	View.StepCount = 150.0f;
+	View.ViewDirection = FVector3f(0.2f, -0.1f, 1.0f);
+	for (const int32 StepFrames : {2, 4, 8})
+	{
+		for (const int32 Frames : {StepFrames, 16})
+		{
+			FTemporalAccumulationParameters Temporal;
+			Temporal.StepFrames = StepFrames;
+			const FTemporalAccumulationComparisonCPU Comparison = CompareTemporalAccumulation_CPU(Resources, View, Temporal, Frames);
+			AddInfo(FString::Printf(TEXT("%d step frames : %s"), StepFrames, *Comparison.ToString()));
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,195 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests and a benchmark of the on-disk converted volume cache.
+
+#include "CoreMinimal.h"
+#include "HAL/FileManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/VolumeCache.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+FString GetTestDirectory()
+{
+	return FPaths::AutomationTransientDir() / TEXT("VolumeCacheTest");
+}
+
+/// Writes a signed short source volume to disk and returns its info as a loader would parse it.
+FVolumeInfo MakeSourceVolume(const FString& FileName, FIntVector Dimensions, TArray64<uint8>& OutRawData)
+{
+	FVolumeInfo Info;
+	Info.DataFileName = FPaths::GetCleanFilename(FileName);
+	Info.Dimensions = Dimensions;
+	Info.OriginalFormat = EVolumeVoxelFormat::SignedShort;
+	Info.ActualFormat = EVolumeVoxelFormat::SignedShort;
+	Info.BytesPerVoxel = 2;
+	Info.bIsSigned = true;
+	Info.bParseWasSuccessful = true;
+
+	FRandomStream Random(11);
+	OutRawData.SetNumUninitialized(Info.GetByteSize());
+	for (uint8& Byte : OutRawData)
+	{
+		Byte = static_cast<uint8>(Random.RandHelper(256));
+	}
+	FFileHelper::SaveArrayToFile(OutRawData, *FileName);
+	return Info;
+}
+
+/// Converts a copy of the raw data the way the loaders do.
+TUniquePtr<uint8[]> Convert(const TArray64<uint8>& RawData, FVolumeInfo& InOutInfo, bool bNormalize, bool bConvertToFloat)
+{
+	TUniquePtr<uint8[]> Copy(new uint8[RawData.Num()]);
+	FMemory::Memcpy(Copy.Get(), RawData.GetData(), RawData.Num());
+	return IVolumeLoader::ConvertData(MoveTemp(Copy), InOutInfo, bNormalize, bConvertToFloat);
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeCacheRoundTripTest, "TBRaymarcher.VolumeTextureToolkit.VolumeCache.RoundTrip",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeCacheRoundTripTest::RunTest(const FString& Parameters)
+{
+	const FString Directory = GetTestDirectory();
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	const FString SourceFile = Directory / TEXT("Source") / TEXT("Volume.raw");
+
+	TArray64<uint8> RawData;
+	const FVolumeInfo SourceInfo = MakeSourceVolume(SourceFile, FIntVector(40, 30, 20), RawData);
+	const FVolumeCacheKey Key = FVolumeCacheKey::Make({SourceFile}, SourceInfo, true, false);
+	TestTrue(TEXT("Key is valid"), Key.IsValid());
+
+	FVolumeInfo ConvertedInfo = SourceInfo;
+	const TUniquePtr<uint8[]> Converted = Convert(RawData, ConvertedInfo, true, false);
+	const int64 PayloadByteSize = FVolumeCache::GetPayloadByteSize(ConvertedInfo);
+
+	FVolumeInfo CachedInfo;
+	TestNull(TEXT("Empty cache misses"), FVolumeCache::Load(Key, CachedInfo, Directory).Get());
+	TestTrue(TEXT("Stores"), FVolumeCache::Store(Key, ConvertedInfo, Converted.Get(), Directory, MAX_int64));
+
+	const TUniquePtr<uint8[]> Cached = FVolumeCache::Load(Key, CachedInfo, Directory);
+	if (TestNotNull(TEXT("Hits after storing"), Cached.Get()))
+	{
+		TestTrue(TEXT("Payload matches"), FMemory::Memcmp(Cached.Get(), Converted.Get(), PayloadByteSize) == 0);
+		TestEqual(TEXT("Actual format"), static_cast<int32>(CachedInfo.ActualFormat),
+			static_cast<int32>(ConvertedInfo.ActualFormat));
+		TestEqual(TEXT("Min"), CachedInfo.MinValue, ConvertedInfo.MinValue);
+		TestEqual(TEXT("Max"), CachedInfo.MaxValue, ConvertedInfo.MaxValue);
+		TestEqual(TEXT("Normalized"), CachedInfo.bIsNormalized, ConvertedInfo.bIsNormalized);
+		TestEqual(TEXT("Dimensions"), CachedInfo.Dimensions, ConvertedInfo.Dimensions);
+		TestEqual(TEXT("Bytes per voxel"), CachedInfo.BytesPerVoxel, ConvertedInfo.BytesPerVoxel);
+		TestEqual(TEXT("Data file name"), CachedInfo.DataFileName, ConvertedInfo.DataFileName);
+	}
+
+	// Anything the converted data depends on changes the key.
+	TestNotEqual(TEXT("Float conversion changes the key"), FVolumeCacheKey::Make({SourceFile}, SourceInfo, false, true).Hash,
+		Key.Hash);
+	TestNotEqual(TEXT("Loader settings change the key"),
+		FVolumeCacheKey::Make({SourceFile}, SourceInfo, true, false, TEXT("verify=1")).Hash, Key.Hash);
+	FVolumeInfo OtherInfo = SourceInfo;
+	OtherInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedShort;
+	TestNotEqual(TEXT("Source format changes the key"), FVolumeCacheKey::Make({SourceFile}, OtherInfo, true, false).Hash, Key.Hash);
+	TestFalse(TEXT("Missing source file makes the key invalid"),
+		FVolumeCacheKey::Make({Directory / TEXT("Missing.raw")}, SourceInfo, true, false).IsValid());
+
+	RawData.Add(0);
+	FFileHelper::SaveArrayToFile(RawData, *SourceFile);
+	const FVolumeCacheKey ModifiedKey = FVolumeCacheKey::Make({SourceFile}, SourceInfo, true, false);
+	TestNotEqual(TEXT("Modified source changes the key"), ModifiedKey.Hash, Key.Hash);
+	TestNull(TEXT("Modified source misses"), FVolumeCache::Load(ModifiedKey, CachedInfo, Directory).Get());
+
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeCacheEvictionTest, "TBRaymarcher.VolumeTextureToolkit.VolumeCache.Eviction",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeCacheEvictionTest::RunTest(const FString& Parameters)
+{
+	const FString Directory = GetTestDirectory();
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+	// Three volumes cached with a cap fitting only two of them.
+	TArray<FVolumeCacheKey> Keys;
+	TArray<FString> EntryFileNames;
+	int64 EntryByteSize = 0;
+	for (int32 i = 0; i < 3; i++)
+	{
+		const FString SourceFile = Directory / TEXT("Source") / FString::Printf(TEXT("Volume%d.raw"), i);
+		TArray64<uint8> RawData;
+		FVolumeInfo Info = MakeSourceVolume(SourceFile, FIntVector(32, 32, 32), RawData);
+		Keys.Add(FVolumeCacheKey::Make({SourceFile}, Info, false, true));
+		EntryFileNames.Add(FVolumeCache::GetEntryFileName(Keys.Last(), Directory));
+
+		const TUniquePtr<uint8[]> Converted = Convert(RawData, Info, false, true);
+		const int64 MaxByteSize = EntryByteSize > 0 ? EntryByteSize * 2 + EntryByteSize / 2 : MAX_int64;
+		TestTrue(FString::Printf(TEXT("Stores volume %d"), i),
+			FVolumeCache::Store(Keys.Last(), Info, Converted.Get(), Directory, MaxByteSize));
+		EntryByteSize = IFileManager::Get().FileSize(*EntryFileNames.Last());
+
+		if (i == 1)
+		{
+			// Make the first volume older than the second, then use it, which makes the second one least recently used.
+			IFileManager::Get().SetTimeStamp(*EntryFileNames[0], FDateTime::UtcNow() - FTimespan::FromHours(2));
+			IFileManager::Get().SetTimeStamp(*EntryFileNames[1], FDateTime::UtcNow() - FTimespan::FromHours(1));
+			FVolumeInfo CachedInfo;
+			TestNotNull(TEXT("First volume hits"), FVolumeCache::Load(Keys[0], CachedInfo, Directory).Get());
+		}
+	}
+
+	TestTrue(TEXT("Recently used entry is kept"), IFileManager::Get().FileExists(*EntryFileNames[0]));
+	TestFalse(TEXT("Least recently used entry is evicted"), IFileManager::Get().FileExists(*EntryFileNames[1]));
+	TestTrue(TEXT("New entry is kept"), IFileManager::Get().FileExists(*EntryFileNames[2]));
+
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeCacheBenchmark, "TBRaymarcher.VolumeTextureToolkit.VolumeCache.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FVolumeCacheBenchmark::RunTest(const FString& Parameters)
+{
+	const FString Directory = GetTestDirectory();
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	const FString SourceFile = Directory / TEXT("Source") / TEXT("Volume.raw");
+
+	// 512 x 512 x 512 signed shorts - 256 MB of source data, normalized to G16.
+	TArray64<uint8> RawData;
+	const FVolumeInfo SourceInfo = MakeSourceVolume(SourceFile, FIntVector(512), RawData);
+	const FVolumeCacheKey Key = FVolumeCacheKey::Make({SourceFile}, SourceInfo, true, false);
+
+	FVolumeInfo ConvertedInfo = SourceInfo;
+	double StartTime = FPlatformTime::Seconds();
+	const TUniquePtr<uint8[]> Converted = Convert(RawData, ConvertedInfo, true, false);
+	const double ConvertSeconds = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	FVolumeCache::Store(Key, ConvertedInfo, Converted.Get(), Directory, MAX_int64);
+	const double StoreSeconds = FPlatformTime::Seconds() - StartTime;
+
+	FVolumeInfo CachedInfo;
+	StartTime = FPlatformTime::Seconds();
+	const TUniquePtr<uint8[]> Cached = FVolumeCache::Load(Key, CachedInfo, Directory);
+	const double LoadSeconds = FPlatformTime::Seconds() - StartTime;
+	TestNotNull(TEXT("Benchmark volume hits"), Cached.Get());
+
+	const double PayloadMB = FVolumeCache::GetPayloadByteSize(ConvertedInfo) / (1024.0 * 1024.0);
+	AddInfo(FString::Printf(TEXT("%.0f MB : convert %.1f ms, store %.1f ms, load %.1f ms (%.1f MB/s)"), PayloadMB,
+		ConvertSeconds * 1000.0, StoreSeconds * 1000.0, LoadSeconds * 1000.0, PayloadMB / LoadSeconds));
+
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	return true;
+}
+
+#endif
@@ -0,0 +1,184 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// Tests that the slab-by-slab conversion of FVolumeStreamReader (from memory and from zlib-compressed files) matches
+// IVolumeLoader::ConvertData on the whole array.
+
+#include "CoreMinimal.h"
+#include "HAL/FileManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+#include "VolumeAsset/Loaders/VolumeStreamReader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+/// Slab source serving slabs straight out of an in-memory array.
+class FMemorySlabSource : public IVolumeSlabSource
+{
+public:
+	explicit FMemorySlabSource(const TArray64<uint8>& InData) : Data(InData)
+	{
+	}
+
+	virtual const uint8* ReadSlab(int64 Offset, int64 Size) override
+	{
+		return Offset + Size <= Data.Num() ? Data.GetData() + Offset : nullptr;
+	}
+
+	virtual bool IsMemoryMapped() const override
+	{
+		return false;
+	}
+
+private:
+	const TArray64<uint8>& Data;
+};
+
+// A slab size that is not a multiple of the slice size, so slabs get rounded to whole slices and the last slab is partial.
+constexpr int64 TestSlabByteSize = 7 * 67 * 45 + 13;
+
+FVolumeInfo MakeRandomVolume(EVolumeVoxelFormat Format, TArray64<uint8>& OutRawData)
+{
+	FVolumeInfo Info;
+	Info.Dimensions = FIntVector(67, 45, 33);
+	Info.OriginalFormat = Format;
+	Info.ActualFormat = Format;
+	Info.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(Format);
+	Info.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(Format);
+
+	FRandomStream Random(42);
+	OutRawData.SetNumUninitialized(Info.GetByteSize());
+	for (uint8& Byte : OutRawData)
+	{
+		Byte = static_cast<uint8>(Random.RandHelper(256));
+	}
+	if (Format == EVolumeVoxelFormat::Float)
+	{
+		// Random bytes would produce NaNs, use proper floats instead.
+		float* Floats = reinterpret_cast<float*>(OutRawData.GetData());
+		for (int64 i = 0; i < Info.GetTotalVoxels(); i++)
+		{
+			Floats[i] = Random.FRandRange(-1000.0f, 1000.0f);
+		}
+	}
+	return Info;
+}
+
+void CompareResults(FAutomationTestBase& Test, const FString& Name, const TArray64<uint8>& RawData, const FVolumeInfo& Info,
+	const FVolumeInfo& StreamedInfo, const uint8* Streamed, bool bNormalize, bool bConvertToFloat)
+{
+	if (!Test.TestNotNull(Name + TEXT(" streamed data"), Streamed))
+	{
+		return;
+	}
+
+	FVolumeInfo WholeInfo = Info;
+	TUniquePtr<uint8[]> WholeCopy(new uint8[RawData.Num()]);
+	FMemory::Memcpy(WholeCopy.Get(), RawData.GetData(), RawData.Num());
+	const TUniquePtr<uint8[]> Expected = IVolumeLoader::ConvertData(MoveTemp(WholeCopy), WholeInfo, bNormalize, bConvertToFloat);
+
+	const int64 OutByteSize = StreamedInfo.GetTotalVoxels() * FVolumeInfo::VoxelFormatByteSize(StreamedInfo.ActualFormat);
+	Test.TestEqual(
+		Name + TEXT(" actual format"), static_cast<int32>(StreamedInfo.ActualFormat), static_cast<int32>(WholeInfo.ActualFormat));
+	Test.TestEqual(Name + TEXT(" min"), StreamedInfo.MinValue, WholeInfo.MinValue);
+	Test.TestEqual(Name + TEXT(" max"), StreamedInfo.MaxValue, WholeInfo.MaxValue);
+	Test.TestTrue(Name + TEXT(" data"), FMemory::Memcmp(Streamed, Expected.Get(), OutByteSize) == 0);
+}
+
+FString GetCaseName(EVolumeVoxelFormat Format, bool bNormalize, bool bConvertToFloat)
+{
+	return FString::Printf(
+		TEXT("Format %d, normalize %d, float %d"), static_cast<int32>(Format), bNormalize ? 1 : 0, bConvertToFloat ? 1 : 0);
+}
+
+void CompareWithConvertData(FAutomationTestBase& Test, EVolumeVoxelFormat Format, bool bNormalize, bool bConvertToFloat)
+{
+	TArray64<uint8> RawData;
+	const FVolumeInfo Info = MakeRandomVolume(Format, RawData);
+
+	FVolumeInfo StreamedInfo = Info;
+	FMemorySlabSource Source(RawData);
+	FVolumeStreamStats Stats;
+	const TUniquePtr<uint8[]> Streamed =
+		FVolumeStreamReader::LoadAndConvert(Source, StreamedInfo, bNormalize, bConvertToFloat, Stats, TestSlabByteSize);
+
+	const FString Name = GetCaseName(Format, bNormalize, bConvertToFloat);
+	CompareResults(Test, Name, RawData, Info, StreamedInfo, Streamed.Get(), bNormalize, bConvertToFloat);
+	Test.TestEqual(Name + TEXT(" bytes written"), Stats.BytesWritten,
+		StreamedInfo.GetTotalVoxels() * FVolumeInfo::VoxelFormatByteSize(StreamedInfo.ActualFormat));
+}
+
+void CompareZLibWithConvertData(FAutomationTestBase& Test, EVolumeVoxelFormat Format, bool bNormalize, bool bConvertToFloat)
+{
+	TArray64<uint8> RawData;
+	FVolumeInfo Info = MakeRandomVolume(Format, RawData);
+
+	const int32 UncompressedSize = static_cast<int32>(RawData.Num());
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, UncompressedSize);
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (!Test.TestTrue(TEXT("Compressing test data"),
+			FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, RawData.GetData(), UncompressedSize)))
+	{
+		return;
+	}
+	Compressed.SetNum(CompressedSize);
+
+	const FString FileName = FPaths::AutomationTransientDir() / TEXT("VolumeStreamReaderTest.zraw");
+	if (!Test.TestTrue(TEXT("Writing test file"), FFileHelper::SaveArrayToFile(Compressed, *FileName)))
+	{
+		return;
+	}
+
+	Info.bIsCompressed = true;
+	Info.CompressedByteSize = CompressedSize;
+	FVolumeInfo StreamedInfo = Info;
+	const TUniquePtr<uint8[]> Streamed =
+		FVolumeStreamReader::LoadAndConvertZLibFile(FileName, StreamedInfo, bNormalize, bConvertToFloat, TestSlabByteSize);
+	IFileManager::Get().Delete(*FileName);
+
+	CompareResults(Test, TEXT("ZLib ") + GetCaseName(Format, bNormalize, bConvertToFloat), RawData, Info, StreamedInfo,
+		Streamed.Get(), bNormalize, bConvertToFloat);
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeStreamReaderMatchesConvertDataTest,
+	"TBRaymarcher.VolumeTextureToolkit.VolumeStreamReader.MatchesConvertData",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeStreamReaderMatchesConvertDataTest::RunTest(const FString& Parameters)
+{
+	for (const EVolumeVoxelFormat Format :
+		{EVolumeVoxelFormat::UnsignedChar, EVolumeVoxelFormat::SignedChar, EVolumeVoxelFormat::UnsignedShort,
+			EVolumeVoxelFormat::SignedShort, EVolumeVoxelFormat::UnsignedInt, EVolumeVoxelFormat::SignedInt,
+			EVolumeVoxelFormat::Float})
+	{
+		CompareWithConvertData(*this, Format, true, false);
+		CompareWithConvertData(*this, Format, false, true);
+		CompareWithConvertData(*this, Format, false, false);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeStreamReaderZLibMatchesConvertDataTest,
+	"TBRaymarcher.VolumeTextureToolkit.VolumeStreamReader.ZLibMatchesConvertData",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeStreamReaderZLibMatchesConvertDataTest::RunTest(const FString& Parameters)
+{
+	// Normalization inflates the file twice, float conversion once.
+	CompareZLibWithConvertData(*this, EVolumeVoxelFormat::SignedShort, true, false);
+	CompareZLibWithConvertData(*this, EVolumeVoxelFormat::UnsignedChar, false, true);
+	CompareZLibWithConvertData(*this, EVolumeVoxelFormat::Float, false, false);
+	return true;
+}
+
+#endif
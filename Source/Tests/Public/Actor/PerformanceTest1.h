@@ -54,6 +54,14 @@ class TESTS_API APerformanceTest1 : public AActor
 	UPROPERTY(EditAnywhere)
 	ARaymarchClipPlane* PlaneToRotate;
 
+	// Resolution the listener volumes get raymarched at during the test, so runs at every resolution can be compared.
+	UPROPERTY(EditAnywhere)
+	ERaymarchResolution RaymarchResolution = ERaymarchResolution::Full;
+
+	// If true, the listener volumes accumulate their rays over frames during the test.
+	UPROPERTY(EditAnywhere)
+	bool bTemporalAccumulation = false;
+
 	FVector OriginalOffsetVector{};
 
 	// List of all applied bookmarks in current test run.
@@ -5,6 +5,8 @@
 
 #include "Util/UtilityShaders.h"
 
+#include "RenderGraphUtils.h"
+
 #define CLEAR_NUM_THREADS_PER_GROUP_DIMENSION 16	  // This has to be the same as in the compute shader's spec [X, X, 1]
 
 IMPLEMENT_GLOBAL_SHADER(
@@ -17,59 +19,51 @@ IMPLEMENT_GLOBAL_SHADER(
 DECLARE_FLOAT_COUNTER_STAT(TEXT("ClearingVolumeTextures"), STAT_GPU_ClearingVolumeTextures, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUClearingVolumeTextures, TEXT("ClearingVolumeTextures"));
 
-
-// Shorthand
-FRHICommandListImmediate& GetCmdList()
-{
-	return FRHICommandListExecutor::GetImmediateCommandList();
-}
-
-void ClearVolumeTexture_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture3D* VolumeResourceRef, float ClearValues)
+void AddClearVolumeTexturePass(FRDGBuilder& GraphBuilder, FRDGTextureUAVRef VolumeUAV, float ClearValue, ERDGPassFlags PassFlags)
 {
 	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, ClearVolumeTexture_RenderThread, TEXT("Clearing volume texture"));
-	SCOPED_GPU_STAT(RHICmdList, GPUClearingVolumeTextures);
-
-	TShaderMapRef<FClearVolumeTextureShaderCS> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
+	RDG_EVENT_SCOPE(GraphBuilder, "Clearing volume texture");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, GPUClearingVolumeTextures);
 
-	// RHICmdList.TransitionResource(EResourceTransitionAccess::ERWNoBarrier,
-	// LightVolumeResource);
-	FUnorderedAccessViewRHIRef VolumeUAVRef = GetCmdList().CreateUnorderedAccessView(VolumeResourceRef);
+	const FRDGTextureDesc& Desc = VolumeUAV->Desc.Texture->Desc;
+	FClearVolumeTextureShaderCS::FParameters* PassParameters =
+		GraphBuilder.AllocParameters<FClearVolumeTextureShaderCS::FParameters>();
+	PassParameters->Volume = VolumeUAV;
+	PassParameters->ClearValue = ClearValue;
+	PassParameters->ZSize = Desc.Depth;
 
-	// Don't need barriers on these - we only ever read/write to the same pixel from one thread ->
-	// no race conditions But we definitely need to transition the resource to Compute-shader
-	// accessible, otherwise the renderer might touch our textures while we're writing them.
-	RHICmdList.Transition(FRHITransitionInfo(VolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
-
-	ComputeShader->SetParameters(RHICmdList, VolumeUAVRef, ClearValues, VolumeResourceRef->GetSizeZ());
+	// Every thread clears a whole column of voxels along Z.
+	TShaderMapRef<FClearVolumeTextureShaderCS> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("ClearVolumeTexture"), PassFlags, ComputeShader, PassParameters,
+		FIntVector(FMath::DivideAndRoundUp(Desc.Extent.X, CLEAR_NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(Desc.Extent.Y, CLEAR_NUM_THREADS_PER_GROUP_DIMENSION), 1));
+}
 
-	uint32 GroupSizeX = FMath::DivideAndRoundUp((int32) VolumeResourceRef->GetSizeX(), CLEAR_NUM_THREADS_PER_GROUP_DIMENSION);
-	uint32 GroupSizeY = FMath::DivideAndRoundUp((int32) VolumeResourceRef->GetSizeY(), CLEAR_NUM_THREADS_PER_GROUP_DIMENSION);
+void AddClear2DTexturePass(FRDGBuilder& GraphBuilder, FRDGTextureUAVRef TextureUAV, float Value, ERDGPassFlags PassFlags)
+{
+	const FIntPoint TextureSize = TextureUAV->Desc.Texture->Desc.Extent;
+	FClearFloatRWTextureCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FClearFloatRWTextureCS::FParameters>();
+	PassParameters->ClearTextureRW = TextureUAV;
+	PassParameters->ClearValue = Value;
+
+	TShaderMapRef<FClearFloatRWTextureCS> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Clear2DTexture"), PassFlags, ComputeShader, PassParameters,
+		FComputeShaderUtils::GetGroupCount(TextureSize, CLEAR_NUM_THREADS_PER_GROUP_DIMENSION));
+}
 
-	RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
-	ComputeShader->UnbindUAV(RHICmdList);
-	RHICmdList.Transition(FRHITransitionInfo(VolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+void ClearVolumeTexture_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture3D* VolumeResourceRef, float ClearValues)
+{
+	FRDGBuilder GraphBuilder(RHICmdList);
+	FRDGTextureRef Volume = RegisterExternalTexture(GraphBuilder, VolumeResourceRef, TEXT("ClearedVolumeTexture"));
+	AddClearVolumeTexturePass(GraphBuilder, GraphBuilder.CreateUAV(Volume), ClearValues);
+	GraphBuilder.Execute();
 }
 
 /// Clears a FloatTexture accesible as a UAV.
-void Clear2DTexture_RenderThread(
-	FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* TextureUAVRef, FIntPoint TextureSize, float Value)
+void Clear2DTexture_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* Texture, float Value)
 {
-	TShaderMapRef<FClearFloatRWTextureCS> ShaderRef(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ShaderRef.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
-
-	RHICmdList.Transition(FRHITransitionInfo(TextureUAVRef, ERHIAccess::Unknown, ERHIAccess::UAVCompute));
-
-	ShaderRef->SetParameters(RHICmdList, TextureUAVRef, Value);
-	uint32 GroupSizeX = FMath::DivideAndRoundUp(TextureSize.X, CLEAR_NUM_THREADS_PER_GROUP_DIMENSION);
-	uint32 GroupSizeY = FMath::DivideAndRoundUp(TextureSize.Y, CLEAR_NUM_THREADS_PER_GROUP_DIMENSION);
-
-	RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
-	//  DispatchComputeShader(RHICmdList, ShaderRef, GroupSizeX, GroupSizeY, 1);
-	ShaderRef->UnbindUAV(RHICmdList);
-
-	RHICmdList.Transition(FRHITransitionInfo(TextureUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
-}
\ No newline at end of file
+	FRDGBuilder GraphBuilder(RHICmdList);
+	FRDGTextureRef ClearedTexture = RegisterExternalTexture(GraphBuilder, Texture, TEXT("Cleared2DTexture"));
+	AddClear2DTexturePass(GraphBuilder, GraphBuilder.CreateUAV(ClearedTexture), Value);
+	GraphBuilder.Execute();
+}
@@ -2,6 +2,9 @@
 // Licensed under MIT license - See License.txt for details.
 #include "VolumeAsset/Loaders/DCMTKLoader.h"
 
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Misc/ScopeLock.h"
 #include "TextureUtilities.h"
 
 // DCMTK uses their own verify and check macros.
@@ -17,6 +20,7 @@
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmdata/dcpixel.h"
 
+#include <atomic>
 #include <vector>
 
 #pragma pop_macro("verify")
@@ -43,18 +47,6 @@ UDCMTKLoader* UDCMTKLoader::Get()
 	return NewObject<UDCMTKLoader>();
 }
 
-int GetSliceNumber(DcmDataset* SliceDataset)
-{
-	OFString SliceInstanceNumberOfString;
-	if (SliceDataset->findAndGetOFString(DCM_InstanceNumber, SliceInstanceNumberOfString).bad())
-	{
-		UE_LOG(LogDCMTK, Error, TEXT("Error getting Instance Number!"));
-		return -1;
-	}
-	const FString SliceInstanceNumberString = FString(UTF8_TO_TCHAR(SliceInstanceNumberOfString.c_str()));
-	return FCString::Atoi(*SliceInstanceNumberString);
-}
-
 void Dump(DcmDataset* Dataset)
 {
 	std::ostringstream out;
@@ -81,13 +73,246 @@ void UDCMTKLoader::DumpFileStructure(const FString& FileName)
 	Dump(Dataset);
 }
 
+/// Metadata of a single DICOM file, read without touching its pixel data.
+struct FDICOMFileEntry
+{
+	FString FilePath;
+	OFString SeriesInstanceUID;
+	int32 InstanceNumber = -1;
+	int32 NumberOfFrames = 1;
+
+	bool bHasImagePosition = false;
+	FVector ImagePositionPatient = FVector::ZeroVector;
+
+	bool bHasSliceLocation = false;
+	double SliceLocation = 0.0;
+
+	bool bHasSliceThickness = false;
+	double SliceThickness = 0.0;
+
+	bool bHasPixelSpacing = false;
+	OFString PixelSpacing;
+
+	// Pixel format. Zero means the tag was missing.
+	Uint16 Rows = 0;
+	Uint16 Columns = 0;
+	Uint16 BitsAllocated = 0;
+	Uint16 PixelRepresentation = 0;
+	Uint16 SamplesPerPixel = 0;
+	bool bHasPixelFormat = false;
+};
+
+/// Cheap fingerprint of the files in a folder, used to tell if a cached index went stale.
+struct FDICOMFolderSignature
+{
+	int32 NumFiles = 0;
+	int64 TotalSize = 0;
+	FDateTime NewestTimeStamp = FDateTime::MinValue();
+
+	bool operator==(const FDICOMFolderSignature& Other) const
+	{
+		return NumFiles == Other.NumFiles && TotalSize == Other.TotalSize && NewestTimeStamp == Other.NewestTimeStamp;
+	}
+};
+
+/// All readable DICOM files in a folder, sorted by instance number.
+struct FDICOMSeriesIndex
+{
+	FDICOMFolderSignature Signature;
+	TArray<FDICOMFileEntry> Entries;
+
+	const FDICOMFileEntry* FindEntry(const FString& FilePath) const
+	{
+		return Entries.FindByPredicate(
+			[&FilePath](const FDICOMFileEntry& Entry) { return FPaths::IsSamePath(Entry.FilePath, FilePath); });
+	}
+};
+
+using FDICOMSeriesIndexPtr = TSharedPtr<const FDICOMSeriesIndex, ESPMode::ThreadSafe>;
+
+// Indexes are cached per folder + extension, so header parsing and pixel loading of one import share a single metadata pass.
+static FCriticalSection SeriesIndexCacheLock;
+static TMap<FString, FDICOMSeriesIndexPtr> SeriesIndexCache;
+
+/// Reads the metadata of a single file. Parsing stops at the pixel data, so the (possibly huge and compressed) frames are never
+/// loaded here.
+bool ReadFileEntry(const FString& FilePath, FDICOMFileEntry& OutEntry)
+{
+	DcmFileFormat Format;
+	const OFCondition Result =
+		Format.loadFileUntilTag(TCHAR_TO_UTF8(*FilePath), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+	if (Result.bad())
+	{
+		return false;
+	}
+
+	DcmDataset* Dataset = Format.getDataset();
+	if (Dataset == nullptr)
+	{
+		return false;
+	}
+
+	OutEntry.FilePath = FilePath;
+	Dataset->findAndGetOFString(DCM_SeriesInstanceUID, OutEntry.SeriesInstanceUID);
+
+	OFString OfString;
+	if (Dataset->findAndGetOFString(DCM_InstanceNumber, OfString).good())
+	{
+		OutEntry.InstanceNumber = FCString::Atoi(*FString(UTF8_TO_TCHAR(OfString.c_str())));
+	}
+
+	if (Dataset->findAndGetOFString(DCM_NumberOfFrames, OfString).good())
+	{
+		OutEntry.NumberOfFrames = FCString::Atoi(*FString(UTF8_TO_TCHAR(OfString.c_str())));
+	}
+
+	double Position[3];
+	OutEntry.bHasImagePosition = Dataset->findAndGetFloat64(DCM_ImagePositionPatient, Position[0], 0).good() &&
+								 Dataset->findAndGetFloat64(DCM_ImagePositionPatient, Position[1], 1).good() &&
+								 Dataset->findAndGetFloat64(DCM_ImagePositionPatient, Position[2], 2).good();
+	if (OutEntry.bHasImagePosition)
+	{
+		OutEntry.ImagePositionPatient = FVector(Position[0], Position[1], Position[2]);
+	}
+
+	OutEntry.bHasSliceLocation = Dataset->findAndGetFloat64(DCM_SliceLocation, OutEntry.SliceLocation).good();
+	OutEntry.bHasSliceThickness = Dataset->findAndGetFloat64(DCM_SliceThickness, OutEntry.SliceThickness).good();
+	OutEntry.bHasPixelSpacing = Dataset->findAndGetOFString(DCM_PixelSpacing, OutEntry.PixelSpacing).good();
+
+	OutEntry.bHasPixelFormat = Dataset->findAndGetUint16(DCM_Rows, OutEntry.Rows).good() &&
+							   Dataset->findAndGetUint16(DCM_Columns, OutEntry.Columns).good() &&
+							   Dataset->findAndGetUint16(DCM_BitsAllocated, OutEntry.BitsAllocated).good() &&
+							   Dataset->findAndGetUint16(DCM_PixelRepresentation, OutEntry.PixelRepresentation).good() &&
+							   Dataset->findAndGetUint16(DCM_SamplesPerPixel, OutEntry.SamplesPerPixel).good();
+	return true;
+}
+
+FDICOMFolderSignature ComputeFolderSignature(const FString& FolderName, const TArray<FString>& FilesInDir)
+{
+	FDICOMFolderSignature Signature;
+	Signature.NumFiles = FilesInDir.Num();
+	for (const FString& File : FilesInDir)
+	{
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*(FolderName / File));
+		if (StatData.bIsValid)
+		{
+			Signature.TotalSize += StatData.FileSize;
+			Signature.NewestTimeStamp = FMath::Max(Signature.NewestTimeStamp, StatData.ModificationTime);
+		}
+	}
+	return Signature;
+}
+
+/// Returns the index of all DICOM files with the same extension as FilePath in its folder. The index is built with a single
+/// parallel metadata pass and cached until the folder contents change. KnownEntry (if provided) is reused instead of being read
+/// again.
+FDICOMSeriesIndexPtr GetSeriesIndex(const FString& FilePath, const FDICOMFileEntry* KnownEntry = nullptr)
+{
+	FString FolderName, FileNameDummy, Extension;
+	FPaths::Split(FilePath, FolderName, FileNameDummy, Extension);
+
+	const TArray<FString> FilesInDir = IVolumeLoader::GetFilesInFolder(FolderName, Extension);
+	const FDICOMFolderSignature Signature = ComputeFolderSignature(FolderName, FilesInDir);
+	const FString CacheKey = FPaths::ConvertRelativePathToFull(FolderName) / TEXT("*.") + Extension;
+
+	{
+		FScopeLock Lock(&SeriesIndexCacheLock);
+		if (const FDICOMSeriesIndexPtr* Cached = SeriesIndexCache.Find(CacheKey); Cached && (*Cached)->Signature == Signature)
+		{
+			return *Cached;
+		}
+	}
+
+	TSharedPtr<FDICOMSeriesIndex, ESPMode::ThreadSafe> Index = MakeShared<FDICOMSeriesIndex, ESPMode::ThreadSafe>();
+	Index->Signature = Signature;
+
+	TArray<FDICOMFileEntry> Entries;
+	Entries.SetNum(FilesInDir.Num());
+	ParallelFor(FilesInDir.Num(), [&](int32 FileIndex) {
+		const FString SliceFilePath = FolderName / FilesInDir[FileIndex];
+		if (KnownEntry && FPaths::IsSamePath(KnownEntry->FilePath, SliceFilePath))
+		{
+			Entries[FileIndex] = *KnownEntry;
+			Entries[FileIndex].FilePath = SliceFilePath;
+		}
+		else if (!ReadFileEntry(SliceFilePath, Entries[FileIndex]))
+		{
+			// Not a DICOM file (or unreadable), FilePath stays empty and the entry is dropped below.
+			Entries[FileIndex].FilePath.Empty();
+		}
+	});
+
+	Index->Entries.Reserve(Entries.Num());
+	for (FDICOMFileEntry& Entry : Entries)
+	{
+		if (!Entry.FilePath.IsEmpty())
+		{
+			Index->Entries.Add(MoveTemp(Entry));
+		}
+	}
+	Index->Entries.StableSort(
+		[](const FDICOMFileEntry& A, const FDICOMFileEntry& B) { return A.InstanceNumber < B.InstanceNumber; });
+
+	UE_LOG(LogDCMTK, Log, TEXT("Indexed %d DICOM files in %s."), Index->Entries.Num(), *FolderName);
+
+	FScopeLock Lock(&SeriesIndexCacheLock);
+	SeriesIndexCache.Add(CacheKey, Index);
+	return Index;
+}
+
+void UDCMTKLoader::ClearSeriesIndexCache()
+{
+	FScopeLock Lock(&SeriesIndexCacheLock);
+	SeriesIndexCache.Empty();
+}
+
+TArray<FString> UDCMTKLoader::GetCacheSourceFiles(const FString& FileName)
+{
+	FString FolderName, FileNameDummy, Extension;
+	FPaths::Split(FileName, FolderName, FileNameDummy, Extension);
+
+	TArray<FString> SourceFiles;
+	for (const FString& File : GetFilesInFolder(FolderName, Extension))
+	{
+		SourceFiles.Add(FolderName / File);
+	}
+	return SourceFiles;
+}
+
+FString UDCMTKLoader::GetCacheSettings() const
+{
+	return FString::Printf(TEXT("calculate=%d|verify=%d|ignoreirregular=%d"), bCalculateSliceThickness ? 1 : 0,
+		bVerifySliceThickness ? 1 : 0, bIgnoreIrregularThickness ? 1 : 0);
+}
+
+/// Gets the metadata of FilePath, preferably from an already cached folder index.
+bool GetFileEntry(const FString& FilePath, FDICOMFileEntry& OutEntry)
+{
+	{
+		FString FolderName, FileNameDummy, Extension;
+		FPaths::Split(FilePath, FolderName, FileNameDummy, Extension);
+		const FString CacheKey = FPaths::ConvertRelativePathToFull(FolderName) / TEXT("*.") + Extension;
+
+		FScopeLock Lock(&SeriesIndexCacheLock);
+		if (const FDICOMSeriesIndexPtr* Cached = SeriesIndexCache.Find(CacheKey))
+		{
+			if (const FDICOMFileEntry* Entry = (*Cached)->FindEntry(FilePath))
+			{
+				OutEntry = *Entry;
+				return true;
+			}
+		}
+	}
+	return ReadFileEntry(FilePath, OutEntry);
+}
+
 FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 {
 	FVolumeInfo Info;
 	Info.DataFileName = FileName;
 
-	DcmFileFormat Format;
-	if (Format.loadFile(TCHAR_TO_UTF8(*FileName)).bad())
+	FDICOMFileEntry Entry;
+	if (!GetFileEntry(FileName, Entry))
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
 		return Info;
@@ -95,57 +320,36 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 
 	// TODO - Sanity check that this DICOM is even a 2D/3D image
 
-	DcmDataset* Dataset = Format.getDataset();
-	OFString SeriesInstanceUIDOfString;
-	if (Dataset->findAndGetOFString(DCM_SeriesInstanceUID, SeriesInstanceUIDOfString).bad())
+	if (Entry.SeriesInstanceUID.empty())
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error getting Series Instance UID!"));
 		return Info;
 	}
 
-	uint32 NumberOfFrames = 1;
+	uint32 NumberOfFrames = Entry.NumberOfFrames;
 	{
-		OFString NumberOfFramesOfString;
-		if (Dataset->findAndGetOFString(DCM_NumberOfFrames, NumberOfFramesOfString).good())
-		{
-			NumberOfFrames = FCString::Atoi(*FString(UTF8_TO_TCHAR(NumberOfFramesOfString.c_str())));
-		}
-
 		if (NumberOfFrames == 1)
 		{
-			FString FolderName, FileNameDummy, Extension;
-			FPaths::Split(FileName, FolderName, FileNameDummy, Extension);
-			TArray<FString> FilesInDir = GetFilesInFolder(FolderName, Extension);
+			const FDICOMSeriesIndexPtr Index = GetSeriesIndex(FileName, &Entry);
 
 			NumberOfFrames = 0;
-			for (const FString& File : FilesInDir)
+			for (const FDICOMFileEntry& SliceEntry : Index->Entries)
 			{
-				DcmFileFormat SliceDataFormat;
-				if (SliceDataFormat.loadFile(TCHAR_TO_UTF8(*(FolderName / File))).bad())
+				if (SliceEntry.SeriesInstanceUID.empty() || SliceEntry.SeriesInstanceUID != Entry.SeriesInstanceUID)
 				{
+					// Series UID not matching -> different image than what we're loading.
 					continue;
 				}
 
-				DcmDataset* SliceDataSet = SliceDataFormat.getDataset();
-				OFString FileSeriesInstanceUIDOfString;
-				if (SliceDataSet->findAndGetOFString(DCM_SeriesInstanceUID, FileSeriesInstanceUIDOfString).bad())
+				++NumberOfFrames;
+				if (SliceEntry.InstanceNumber != -1)
 				{
-					// Series UID not matching -> different image than what we're loading.
-					continue;
+					Info.UpdateMinMaxSliceNumber(SliceEntry.InstanceNumber);
 				}
-
-				if (FileSeriesInstanceUIDOfString == SeriesInstanceUIDOfString)
+				else
 				{
-					++NumberOfFrames;
-					if (int SliceNumber = GetSliceNumber(SliceDataSet); SliceNumber != -1)
-					{
-						Info.UpdateMinMaxSliceNumber(SliceNumber);
-					}
-					else
-					{
-						UE_LOG(LogDCMTK, Error, TEXT("Failed getting slice numbers when reading DICOM folder headers"));
-						return Info;	
-					}
+					UE_LOG(LogDCMTK, Error, TEXT("Failed getting slice numbers when reading DICOM folder headers"));
+					return Info;
 				}
 			}
 		}
@@ -171,25 +375,23 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 		}
 	}
 
-	Uint16 Rows = 0, Columns = 0;
-	if (Dataset->findAndGetUint16(DCM_Rows, Rows).bad() || Dataset->findAndGetUint16(DCM_Columns, Columns).bad())
+	if (Entry.Rows == 0 || Entry.Columns == 0)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error getting Rows and Columns!"));
 		return Info;
 	}
-	Info.Dimensions = FIntVector(Columns, Rows, NumberOfFrames);
+	Info.Dimensions = FIntVector(Entry.Columns, Entry.Rows, NumberOfFrames);
 
 	double PixelSpacingX = DefaultPixelSpacingX, PixelSpacingY = DefaultPixelSpacingY;
 	if (!bSetPixelSpacingX || !bSetPixelSpacingY)
 	{
-		OFString OfPixelSpacingOfString;
-		if (Dataset->findAndGetOFString(DCM_PixelSpacing, OfPixelSpacingOfString).bad())
+		if (!Entry.bHasPixelSpacing)
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error getting Pixel Spacing!"));
 			return Info;
 		}
 
-		int ScanfResult = sscanf(OfPixelSpacingOfString.c_str(), "%lf\\%lf", &PixelSpacingX, &PixelSpacingY);
+		int ScanfResult = sscanf(Entry.PixelSpacing.c_str(), "%lf\\%lf", &PixelSpacingX, &PixelSpacingY);
 		if (ScanfResult == 0)
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error parsing Pixel Spacing!"));
@@ -204,24 +406,25 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 	double SliceThickness = DefaultSliceThickness;
 	if (bReadSliceThickness)
 	{
-		if (Dataset->findAndGetFloat64(DCM_SliceThickness, SliceThickness).bad())
+		if (!Entry.bHasSliceThickness)
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error getting Slice Thickness!"));
 			return Info;
 		}
+		SliceThickness = Entry.SliceThickness;
 	}
 
 	Info.Spacing = FVector(PixelSpacingX, PixelSpacingY, SliceThickness);
 	Info.WorldDimensions = Info.Spacing * FVector(Info.Dimensions);
 
-	Uint16 BitsAllocated = 0, PixelRepresentation = 0, SamplesPerPixel = 0;
-	if (Dataset->findAndGetUint16(DCM_BitsAllocated, BitsAllocated).bad() ||
-		Dataset->findAndGetUint16(DCM_PixelRepresentation, PixelRepresentation).bad() ||
-		Dataset->findAndGetUint16(DCM_SamplesPerPixel, SamplesPerPixel).bad())
+	if (!Entry.bHasPixelFormat)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error getting Pixel Data parameters!"));
 		return Info;
 	}
+	const Uint16 BitsAllocated = Entry.BitsAllocated;
+	const Uint16 PixelRepresentation = Entry.PixelRepresentation;
+	const Uint16 SamplesPerPixel = Entry.SamplesPerPixel;
 
 	Info.bIsSigned = PixelRepresentation == 1;
 	if (SamplesPerPixel == 1)
@@ -282,7 +485,8 @@ UVolumeAsset* UDCMTKLoader::CreateVolumeFromFile(FString FileName, bool bNormali
 	}
 
 	// Perform complete load and conversion of data.
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FileName, VolumeInfo, bNormalize, bConvertToFloat);
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertDataCached(
+		FileName, GetCacheSourceFiles(FileName), VolumeInfo, bNormalize, bConvertToFloat, GetCacheSettings());
 
 	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
 	const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
@@ -315,7 +519,8 @@ UVolumeAsset* UDCMTKLoader::CreatePersistentVolumeFromFile(
 	FString VolumeName;
 	GetValidPackageNameFromFolderName(FileName, VolumeName);
 
-	TUniquePtr<uint8[]> LoadedArray(LoadAndConvertData(FileName, VolumeInfo, bNormalize, false));
+	TUniquePtr<uint8[]> LoadedArray(LoadAndConvertDataCached(
+		FileName, GetCacheSourceFiles(FileName), VolumeInfo, bNormalize, false, GetCacheSettings()));
 	if (LoadedArray == nullptr)
 	{
 		return nullptr;
@@ -365,7 +570,8 @@ UVolumeAsset* UDCMTKLoader::CreateVolumeFromFileInExistingPackage(
 		return nullptr;
 	}
 
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FileName, VolumeInfo, bNormalize, bConvertToFloat);
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertDataCached(
+		FileName, GetCacheSourceFiles(FileName), VolumeInfo, bNormalize, bConvertToFloat, GetCacheSettings());
 	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
 
 	OutAsset->DataTexture =
@@ -431,72 +637,91 @@ void PrintDebugData(const Uint8* PixelData, unsigned long DataLength)
 	UE_LOG(LogTemp, Warning, TEXT("Debug data : %ls"), *DebugString);
 }
 
-TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FString& FilePath, const OFString& SeriesInstanceUIDOfString, FVolumeInfo& VolumeInfo,
-	bool bCalculateSliceThickness, bool bVerifySliceThickness, bool bIgnoreIrregularThickness)
+TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FDICOMSeriesIndex& Index, const OFString& SeriesInstanceUIDOfString,
+	FVolumeInfo& VolumeInfo, bool bCalculateSliceThickness, bool bVerifySliceThickness, bool bIgnoreIrregularThickness)
 {
-	const unsigned long FullDataSize = VolumeInfo.GetByteSize();
-	const unsigned long SliceByteSize = VolumeInfo.Dimensions.X * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
-
-	FString FolderName, FileNameDummy, Extension;
-	FPaths::Split(FilePath, FolderName, FileNameDummy, Extension);
+	const uint64 FullDataSize = VolumeInfo.GetByteSize();
+	const uint64 SliceByteSize = static_cast<uint64>(VolumeInfo.Dimensions.X) * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
 
 	TUniquePtr<uint8[]> FullData(new uint8[FullDataSize]);
 	memset(FullData.Get(), 0, FullDataSize);
 
+	// Resolve the destination slice of every file of the series up front, so the frames can be decoded independently.
+	TArray<const FDICOMFileEntry*> SliceEntries;
+	TArray<int32> SliceOffsets;
+	TBitArray<> ClaimedSlices(false, VolumeInfo.Dimensions.Z);
 	TArray<double> SliceLocations;
 	SliceLocations.Reserve(VolumeInfo.Dimensions.Z);
-	uint32 NumberOfFrames = 0;
-	const TArray<FString> FilesInDir = IVolumeLoader::GetFilesInFolder(FolderName, Extension);
-	for (const FString& SliceFileName : FilesInDir)
+	for (const FDICOMFileEntry& Entry : Index.Entries)
 	{
-		DcmFileFormat SliceFormat;
-		if (SliceFormat.loadFile(TCHAR_TO_UTF8(*(FolderName / SliceFileName))).bad())
+		if (Entry.SeriesInstanceUID.empty() || Entry.SeriesInstanceUID != SeriesInstanceUIDOfString)
 		{
 			continue;
 		}
 
-		DcmDataset* SliceDataset = SliceFormat.getDataset();
-		OFString SliceSeriesInstanceUIDOfString;
-		if (SliceDataset->findAndGetOFString(DCM_SeriesInstanceUID, SliceSeriesInstanceUIDOfString).bad())
-		{
-			continue;
-		}
-
-		if (SliceSeriesInstanceUIDOfString != SeriesInstanceUIDOfString)
-		{
-			continue;
-		}
-
-		const int SliceNumber = GetSliceNumber(SliceDataset);
 		// Slices can be numbered from 0 or 1 (or another, random number?), so always offset from the min slice number instead of 0 or 1.
-		const int SliceOffset = SliceNumber - VolumeInfo.minSliceNumber;
-		
+		const int SliceOffset = Entry.InstanceNumber - VolumeInfo.minSliceNumber;
+
 		if (bCalculateSliceThickness || bVerifySliceThickness)
 		{
-			double SliceLocation;
-			if (SliceDataset->findAndGetFloat64(DCM_SliceLocation, SliceLocation).bad())
+			// Fall back to the Z coordinate of the image position for files that omit the (optional) Slice Location.
+			if (!Entry.bHasSliceLocation && !Entry.bHasImagePosition)
 			{
 				UE_LOG(LogDCMTK, Error, TEXT("Error getting Slice Location!"));
 				return nullptr;
 			}
 
-			SliceLocations.Add(SliceLocation);
+			SliceLocations.Add(Entry.bHasSliceLocation ? Entry.SliceLocation : Entry.ImagePositionPatient.Z);
 		}
 
-		uint32 FragmentIndex = 1;
-		if ((SliceByteSize * (SliceOffset + 1)) > FullDataSize)
+		if (SliceOffset < 0 || (SliceByteSize * (SliceOffset + 1)) > FullDataSize)
 		{
 			UE_LOG(LogTemp, Warning,
 				TEXT("DICOM Loader error when attempting memcpy (SliceNumber * Data exceeds total array length), some data will be "
 					 "missing"));
+			continue;
+		}
+
+		if (ClaimedSlices[SliceOffset])
+		{
+			UE_LOG(LogDCMTK, Warning, TEXT("Multiple DICOM files share Instance Number %d, ignoring %s"), Entry.InstanceNumber,
+				*Entry.FilePath);
+			continue;
+		}
+
+		ClaimedSlices[SliceOffset] = true;
+		SliceEntries.Add(&Entry);
+		SliceOffsets.Add(SliceOffset);
+	}
+
+	// Every slice lands in its own part of FullData, so the files can be opened and decoded in parallel.
+	std::atomic<bool> bFailed = false;
+	ParallelFor(SliceEntries.Num(), [&](int32 i) {
+		if (bFailed)
+		{
+			return;
 		}
-		else if (LoadPixelData(SliceDataset, FullData.Get() + SliceByteSize * SliceOffset, SliceByteSize, 0, &FragmentIndex))
+
+		DcmFileFormat SliceFormat;
+		if (SliceFormat.loadFile(TCHAR_TO_UTF8(*SliceEntries[i]->FilePath)).bad())
+		{
+			UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM slice %s!"), *SliceEntries[i]->FilePath);
+			bFailed = true;
+			return;
+		}
+
+		uint32 FragmentIndex = 1;
+		uint8* SliceData = FullData.Get() + SliceByteSize * SliceOffsets[i];
+		if (LoadPixelData(SliceFormat.getDataset(), SliceData, SliceByteSize, 0, &FragmentIndex))
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error Loading Pixel data from file! JPEG2000 - compressed files require custom licensing."));
-			return nullptr;
+			bFailed = true;
 		}
+	});
 
-		++NumberOfFrames;
+	if (bFailed)
+	{
+		return nullptr;
 	}
 
 	if (bCalculateSliceThickness || bVerifySliceThickness)
@@ -545,37 +770,37 @@ TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FString& FilePath, const OF
 
 TUniquePtr<uint8[]> UDCMTKLoader::LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
 {
-	DcmFileFormat Format;
-	if (Format.loadFile(TCHAR_TO_UTF8(*FilePath)).bad())
+	FDICOMFileEntry Entry;
+	if (!GetFileEntry(FilePath, Entry))
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
 		return nullptr;
 	}
 
-	DcmDataset* Dataset = Format.getDataset();
-
-	int32 NumberOfFrames = 1;
-	OFString NumberOfFramesOfString;
-	if (Dataset->findAndGetOFString(DCM_NumberOfFrames, NumberOfFramesOfString).good())
-	{
-		NumberOfFrames = FCString::Atoi(*FString(UTF8_TO_TCHAR(NumberOfFramesOfString.c_str())));
-	}
-
 	TUniquePtr<uint8[]> Data;
-	if (NumberOfFrames > 1)
+	if (Entry.NumberOfFrames > 1)
 	{
-		Data = LoadMultiFrameDICOM(Dataset, NumberOfFrames, VolumeInfo);
+		// All frames live in this one file, so it has to be loaded whole.
+		DcmFileFormat Format;
+		if (Format.loadFile(TCHAR_TO_UTF8(*FilePath)).bad())
+		{
+			UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
+			return nullptr;
+		}
+
+		Data = LoadMultiFrameDICOM(Format.getDataset(), Entry.NumberOfFrames, VolumeInfo);
 	}
 	else
 	{
-		OFString SeriesInstanceUIDOfString;
-		if (Dataset->findAndGetOFString(DCM_SeriesInstanceUID, SeriesInstanceUIDOfString).bad())
+		if (Entry.SeriesInstanceUID.empty())
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error getting Series Instance UID!"));
 			return nullptr;
 		}
 
-		Data = LoadSingleFrameDICOMFolder(FilePath, SeriesInstanceUIDOfString, VolumeInfo, bCalculateSliceThickness,
+		// Usually a cache hit, the folder got indexed when parsing the header.
+		const FDICOMSeriesIndexPtr Index = GetSeriesIndex(FilePath, &Entry);
+		Data = LoadSingleFrameDICOMFolder(*Index, Entry.SeriesInstanceUID, VolumeInfo, bCalculateSliceThickness,
 			bVerifySliceThickness, bIgnoreIrregularThickness);
 	}
 
@@ -0,0 +1,470 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "VolumeAsset/Loaders/MHDHeader.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+namespace
+{
+/// MetaImage keys that get parsed into typed FMHDHeader fields. All other keys (Comment, ElementMin, Modality...) only end up in
+/// FMHDHeader::Entries.
+enum class EMHDKey : uint8
+{
+	ObjectType,
+	NDims,
+	DimSize,
+	ElementSpacing,
+	ElementSize,
+	Offset,
+	CenterOfRotation,
+	TransformMatrix,
+	AnatomicalOrientation,
+	ElementType,
+	ElementNumberOfChannels,
+	HeaderSize,
+	CompressedData,
+	CompressedDataSize,
+	BinaryDataByteOrderMSB,
+	ElementDataFile,
+	Other
+};
+
+struct FMHDKeyName
+{
+	FAnsiStringView Name;
+	EMHDKey Key;
+};
+
+// Aliases (Position/Origin, Rotation/Orientation, ElementByteOrderMSB) map to the same key as their canonical name.
+const FMHDKeyName KeyNames[] = {
+	{"ObjectType", EMHDKey::ObjectType},
+	{"NDims", EMHDKey::NDims},
+	{"DimSize", EMHDKey::DimSize},
+	{"ElementSpacing", EMHDKey::ElementSpacing},
+	{"ElementSize", EMHDKey::ElementSize},
+	{"Offset", EMHDKey::Offset},
+	{"Position", EMHDKey::Offset},
+	{"Origin", EMHDKey::Offset},
+	{"CenterOfRotation", EMHDKey::CenterOfRotation},
+	{"TransformMatrix", EMHDKey::TransformMatrix},
+	{"Rotation", EMHDKey::TransformMatrix},
+	{"Orientation", EMHDKey::TransformMatrix},
+	{"AnatomicalOrientation", EMHDKey::AnatomicalOrientation},
+	{"ElementType", EMHDKey::ElementType},
+	{"ElementNumberOfChannels", EMHDKey::ElementNumberOfChannels},
+	{"HeaderSize", EMHDKey::HeaderSize},
+	{"CompressedData", EMHDKey::CompressedData},
+	{"CompressedDataSize", EMHDKey::CompressedDataSize},
+	{"BinaryDataByteOrderMSB", EMHDKey::BinaryDataByteOrderMSB},
+	{"ElementByteOrderMSB", EMHDKey::BinaryDataByteOrderMSB},
+	{"ElementDataFile", EMHDKey::ElementDataFile},
+};
+
+EMHDKey FindKey(FAnsiStringView Name)
+{
+	for (const FMHDKeyName& KeyName : KeyNames)
+	{
+		if (KeyName.Name.Equals(Name, ESearchCase::CaseSensitive))
+		{
+			return KeyName.Key;
+		}
+	}
+	return EMHDKey::Other;
+}
+
+bool IsWhitespace(ANSICHAR Char)
+{
+	return Char == ' ' || Char == '\t' || Char == '\r' || Char == '\n';
+}
+
+FAnsiStringView Trim(const ANSICHAR* Begin, const ANSICHAR* End)
+{
+	while (Begin < End && IsWhitespace(*Begin))
+	{
+		++Begin;
+	}
+	while (End > Begin && IsWhitespace(*(End - 1)))
+	{
+		--End;
+	}
+	return FAnsiStringView(Begin, static_cast<int32>(End - Begin));
+}
+
+FString ToString(FAnsiStringView View)
+{
+	return FString(View.Len(), View.GetData());
+}
+
+/// Parses up to MaxCount whitespace-separated numbers from Value. Returns how many were parsed.
+int32 ParseNumbers(FAnsiStringView Value, double* OutValues, int32 MaxCount)
+{
+	int32 Count = 0;
+	int32 Index = 0;
+	while (Count < MaxCount)
+	{
+		while (Index < Value.Len() && IsWhitespace(Value[Index]))
+		{
+			Index++;
+		}
+		const int32 TokenStart = Index;
+		while (Index < Value.Len() && !IsWhitespace(Value[Index]))
+		{
+			Index++;
+		}
+		const int32 TokenLength = Index - TokenStart;
+		if (TokenLength == 0)
+		{
+			break;
+		}
+
+		// Values are not null-terminated inside the header, copy them out so that Atod doesn't run into the next value.
+		ANSICHAR Token[64];
+		const int32 CopyLength = FMath::Min(TokenLength, static_cast<int32>(UE_ARRAY_COUNT(Token)) - 1);
+		FMemory::Memcpy(Token, Value.GetData() + TokenStart, CopyLength);
+		Token[CopyLength] = '\0';
+		if (!FCharAnsi::IsDigit(Token[0]) && Token[0] != '-' && Token[0] != '+' && Token[0] != '.')
+		{
+			break;
+		}
+		OutValues[Count++] = FCStringAnsi::Atod(Token);
+	}
+	return Count;
+}
+
+bool ParseVector(FAnsiStringView Value, FVector& OutVector)
+{
+	double Values[3] = {0, 0, 0};
+	const int32 Count = ParseNumbers(Value, Values, 3);
+	OutVector = FVector(Values[0], Values[1], Values[2]);
+	return Count > 0;
+}
+
+int64 ParseInt(FAnsiStringView Value)
+{
+	double Number = 0;
+	ParseNumbers(Value, &Number, 1);
+	return static_cast<int64>(Number);
+}
+
+bool ParseBool(FAnsiStringView Value)
+{
+	return Value.Equals("True", ESearchCase::IgnoreCase) || Value.Equals("1");
+}
+
+bool ElementTypeToVoxelFormat(const FString& ElementType, EVolumeVoxelFormat& OutFormat)
+{
+	if (ElementType == TEXT("MET_UCHAR"))
+	{
+		OutFormat = EVolumeVoxelFormat::UnsignedChar;
+	}
+	else if (ElementType == TEXT("MET_CHAR"))
+	{
+		OutFormat = EVolumeVoxelFormat::SignedChar;
+	}
+	else if (ElementType == TEXT("MET_USHORT"))
+	{
+		OutFormat = EVolumeVoxelFormat::UnsignedShort;
+	}
+	else if (ElementType == TEXT("MET_SHORT"))
+	{
+		OutFormat = EVolumeVoxelFormat::SignedShort;
+	}
+	else if (ElementType == TEXT("MET_UINT"))
+	{
+		OutFormat = EVolumeVoxelFormat::UnsignedInt;
+	}
+	else if (ElementType == TEXT("MET_INT"))
+	{
+		OutFormat = EVolumeVoxelFormat::SignedInt;
+	}
+	else if (ElementType == TEXT("MET_FLOAT"))
+	{
+		OutFormat = EVolumeVoxelFormat::Float;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+}	 // namespace
+
+const FString* FMHDHeader::Find(const FString& Key) const
+{
+	for (const TPair<FString, FString>& Entry : Entries)
+	{
+		if (Entry.Key.Equals(Key, ESearchCase::CaseSensitive))
+		{
+			return &Entry.Value;
+		}
+	}
+	return nullptr;
+}
+
+bool FMHDHeader::ToVolumeInfo(FVolumeInfo& OutVolumeInfo) const
+{
+	OutVolumeInfo.bParseWasSuccessful = false;
+	if (!bParseWasSuccessful)
+	{
+		return false;
+	}
+
+	if (NDims != 2 && NDims != 3)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MHD header %s has %d dimensions, only 2D and 3D images are supported."), *FileName,
+			NDims);
+		return false;
+	}
+	if (ElementNumberOfChannels != 1)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MHD header %s has %d channels, only single-channel volumes are supported."), *FileName,
+			ElementNumberOfChannels);
+		return false;
+	}
+	if (ElementDataFile == TEXT("LOCAL") || ElementDataFile == TEXT("LIST") || ElementDataFile.Contains(TEXT("%")))
+	{
+		UE_LOG(LogVolumeLoader, Error,
+			TEXT("MHD header %s uses ElementDataFile = %s, only a single separate data file is supported."), *FileName,
+			*ElementDataFile);
+		return false;
+	}
+	if (HeaderSize != 0)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MHD header %s has HeaderSize = %lld, data files with a header are not supported."),
+			*FileName, HeaderSize);
+		return false;
+	}
+	if (bCompressedData && CompressedDataSize <= 0)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MHD header %s has compressed data, but no CompressedDataSize."), *FileName);
+		return false;
+	}
+	if (!ElementTypeToVoxelFormat(ElementType, OutVolumeInfo.OriginalFormat))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MHD header %s has unsupported ElementType %s."), *FileName, *ElementType);
+		return false;
+	}
+	if (bBinaryDataByteOrderMSB)
+	{
+		UE_LOG(LogVolumeLoader, Warning,
+			TEXT("MHD header %s has big-endian data, the volume will be loaded without byte swapping."), *FileName);
+	}
+
+	OutVolumeInfo.Dimensions = DimSize;
+	OutVolumeInfo.Spacing = ElementSpacing;
+	OutVolumeInfo.WorldDimensions = OutVolumeInfo.Spacing * FVector(OutVolumeInfo.Dimensions);
+	OutVolumeInfo.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(OutVolumeInfo.OriginalFormat);
+	OutVolumeInfo.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(OutVolumeInfo.OriginalFormat);
+	OutVolumeInfo.bIsCompressed = bCompressedData;
+	OutVolumeInfo.CompressedByteSize = CompressedDataSize;
+	OutVolumeInfo.DataFileName = ElementDataFile;
+	OutVolumeInfo.bParseWasSuccessful = true;
+	return true;
+}
+
+bool FMHDHeaderParser::Parse(const ANSICHAR* Text, int64 Length, FMHDHeader& OutHeader)
+{
+	const FString FileName = MoveTemp(OutHeader.FileName);
+	OutHeader = FMHDHeader();
+	OutHeader.FileName = FileName;
+
+	bool bHasSpacing = false;
+	int32 DimSizeCount = 0;
+	const ANSICHAR* const End = Text + Length;
+	const ANSICHAR* LineStart = Text;
+	while (LineStart < End)
+	{
+		const ANSICHAR* LineEnd = LineStart;
+		const ANSICHAR* Equals = nullptr;
+		while (LineEnd < End && *LineEnd != '\n')
+		{
+			if (!Equals && *LineEnd == '=')
+			{
+				Equals = LineEnd;
+			}
+			++LineEnd;
+		}
+		const ANSICHAR* const NextLine = LineEnd < End ? LineEnd + 1 : End;
+
+		if (!Equals)
+		{
+			LineStart = NextLine;
+			continue;
+		}
+		const FAnsiStringView Key = Trim(LineStart, Equals);
+		const FAnsiStringView Value = Trim(Equals + 1, LineEnd);
+		LineStart = NextLine;
+		if (Key.IsEmpty())
+		{
+			continue;
+		}
+		OutHeader.Entries.Emplace(ToString(Key), ToString(Value));
+
+		switch (FindKey(Key))
+		{
+			case EMHDKey::ObjectType:
+				OutHeader.ObjectType = ToString(Value);
+				break;
+			case EMHDKey::NDims:
+				OutHeader.NDims = static_cast<int32>(ParseInt(Value));
+				break;
+			case EMHDKey::DimSize:
+			{
+				double Values[3] = {0, 0, 1};
+				DimSizeCount = ParseNumbers(Value, Values, 3);
+				OutHeader.DimSize =
+					FIntVector(static_cast<int32>(Values[0]), static_cast<int32>(Values[1]), static_cast<int32>(Values[2]));
+				break;
+			}
+			case EMHDKey::ElementSpacing:
+				bHasSpacing = ParseVector(Value, OutHeader.ElementSpacing);
+				break;
+			case EMHDKey::ElementSize:
+				ParseVector(Value, OutHeader.ElementSize);
+				break;
+			case EMHDKey::Offset:
+				ParseVector(Value, OutHeader.Offset);
+				break;
+			case EMHDKey::CenterOfRotation:
+				ParseVector(Value, OutHeader.CenterOfRotation);
+				break;
+			case EMHDKey::TransformMatrix:
+			{
+				double Values[9];
+				if (ParseNumbers(Value, Values, 9) == 9)
+				{
+					for (int32 Row = 0; Row < 3; Row++)
+					{
+						for (int32 Column = 0; Column < 3; Column++)
+						{
+							OutHeader.TransformMatrix.M[Row][Column] = Values[Row * 3 + Column];
+						}
+					}
+				}
+				break;
+			}
+			case EMHDKey::AnatomicalOrientation:
+				OutHeader.AnatomicalOrientation = ToString(Value);
+				break;
+			case EMHDKey::ElementType:
+				OutHeader.ElementType = ToString(Value);
+				break;
+			case EMHDKey::ElementNumberOfChannels:
+				OutHeader.ElementNumberOfChannels = static_cast<int32>(ParseInt(Value));
+				break;
+			case EMHDKey::HeaderSize:
+				OutHeader.HeaderSize = ParseInt(Value);
+				break;
+			case EMHDKey::CompressedData:
+				OutHeader.bCompressedData = ParseBool(Value);
+				break;
+			case EMHDKey::CompressedDataSize:
+				// Older writers only emit the size, so its presence alone marks the data as compressed.
+				OutHeader.bCompressedData = true;
+				OutHeader.CompressedDataSize = ParseInt(Value);
+				break;
+			case EMHDKey::BinaryDataByteOrderMSB:
+				OutHeader.bBinaryDataByteOrderMSB = ParseBool(Value);
+				break;
+			case EMHDKey::ElementDataFile:
+				OutHeader.ElementDataFile = ToString(Value);
+				break;
+			case EMHDKey::Other:
+				break;
+		}
+
+		// ElementDataFile is always the last key, anything after it is (for LOCAL data) the volume itself.
+		if (!OutHeader.ElementDataFile.IsEmpty())
+		{
+			OutHeader.HeaderByteLength = NextLine - Text;
+			break;
+		}
+	}
+
+	if (OutHeader.NDims == 0)
+	{
+		OutHeader.NDims = DimSizeCount;
+	}
+	if (!bHasSpacing && !OutHeader.ElementSize.IsZero())
+	{
+		OutHeader.ElementSpacing = OutHeader.ElementSize;
+	}
+
+	OutHeader.bParseWasSuccessful = DimSizeCount > 0 && OutHeader.DimSize.X > 0 && OutHeader.DimSize.Y > 0 &&
+									OutHeader.DimSize.Z > 0 && !OutHeader.ElementType.IsEmpty() &&
+									!OutHeader.ElementDataFile.IsEmpty();
+	return OutHeader.bParseWasSuccessful;
+}
+
+bool FMHDHeaderParser::ParseFile(const FString& FileName, FMHDHeader& OutHeader)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// First, try to read FileName as absolute path, then as relative path.
+	TUniquePtr<IFileHandle> Handle(PlatformFile.OpenRead(*FileName));
+	if (!Handle)
+	{
+		const FString FullPath =
+			IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*FPaths::ProjectContentDir()) + FileName;
+		Handle.Reset(PlatformFile.OpenRead(*FullPath));
+	}
+
+	if (!Handle)
+	{
+		OutHeader = FMHDHeader();
+		OutHeader.FileName = FileName;
+		UE_LOG(LogVolumeLoader, Error, TEXT("Cannot read file path %s either as absolute or as relative path."), *FileName);
+		return false;
+	}
+
+	const int64 ReadSize = FMath::Min(Handle->Size(), MaxHeaderByteSize);
+	TArray<ANSICHAR> Text;
+	Text.SetNumUninitialized(static_cast<int32>(ReadSize));
+	if (!Handle->Read(reinterpret_cast<uint8*>(Text.GetData()), ReadSize))
+	{
+		OutHeader = FMHDHeader();
+		OutHeader.FileName = FileName;
+		UE_LOG(LogVolumeLoader, Error, TEXT("Failed reading MHD header %s."), *FileName);
+		return false;
+	}
+	OutHeader.FileName = FileName;
+	return Parse(Text.GetData(), ReadSize, OutHeader);
+}
+
+TArray<FMHDHeader> FMHDHeaderParser::ScanFiles(const TArray<FString>& FileNames)
+{
+	TArray<FMHDHeader> Headers;
+	Headers.SetNum(FileNames.Num());
+	// Headers are tiny, so this is dominated by file open latency, which overlaps nicely across threads.
+	ParallelFor(FileNames.Num(), [&](int32 Index) { ParseFile(FileNames[Index], Headers[Index]); });
+	return Headers;
+}
+
+TArray<FMHDHeader> FMHDHeaderParser::ScanDirectory(const FString& Directory, bool bRecursive /*= true*/)
+{
+	TArray<FString> FileNames;
+	for (const TCHAR* Extension : {TEXT("*.mhd"), TEXT("*.mha")})
+	{
+		if (bRecursive)
+		{
+			IFileManager::Get().FindFilesRecursive(FileNames, *Directory, Extension, true, false, false);
+		}
+		else
+		{
+			TArray<FString> LocalNames;
+			IFileManager::Get().FindFiles(LocalNames, *(Directory / Extension), true, false);
+			for (const FString& LocalName : LocalNames)
+			{
+				FileNames.Add(Directory / LocalName);
+			}
+		}
+	}
+	return ScanFiles(FileNames);
+}
@@ -6,8 +6,7 @@
 #include "VolumeAsset/Loaders/MHDLoader.h"
 
 #include "TextureUtilities.h"
-#include "sstream"
-#include "string"
+#include "VolumeAsset/Loaders/MHDHeader.h"
 
 UMHDLoader* UMHDLoader::Get()
 {
@@ -17,167 +16,13 @@ UMHDLoader* UMHDLoader::Get()
 
 FVolumeInfo UMHDLoader::ParseVolumeInfoFromHeader(FString FileName)
 {
-	// #TODO UE probably has a nicer string parser than istringstream...
-	// And the way I'm doing this is the ugliest you could imagine.
-	// But hey, this is probably literally the first C++ code I ever wrote in Unreal, so I'm keeping it this way, so
-	// I can look at it and shed a tear of remembering the sweet, sweet days of yesteryear.
-
-	FString FileString = IVolumeLoader::ReadFileAsString(FileName);
-
 	FVolumeInfo OutVolumeInfo;
-	OutVolumeInfo.bParseWasSuccessful = false;
-
-	// #TODO stop being sentimental and use FConsole::Parse()
+	FMHDHeader Header;
+	if (FMHDHeaderParser::ParseFile(FileName, Header))
 	{
-		std::string MyStdString(TCHAR_TO_UTF8(*FileString));
-		std::istringstream inStream = std::istringstream(MyStdString);
-
-		std::string ReadWord;
-
-		// Skip until we get to Dimensions.
-		while (inStream.good() && ReadWord != "DimSize")
-		{
-			inStream >> ReadWord;
-		}
-		// Should be at the "=" after DimSize now.
-		if (inStream.good())
-		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-			// Read the three values;
-			inStream >> OutVolumeInfo.Dimensions.X;
-			inStream >> OutVolumeInfo.Dimensions.Y;
-			inStream >> OutVolumeInfo.Dimensions.Z;
-		}
-		else
-		{
-			return OutVolumeInfo;
-		}
-
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to spacing.
-		while (inStream.good() && ReadWord != "ElementSpacing" && ReadWord != "ElementSize")
-		{
-			inStream >> ReadWord;
-		}
-		// Should be at the "=" after ElementSpacing/ElementSize now.
-		if (inStream.good())
-		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-			// Read the three values;
-			inStream >> OutVolumeInfo.Spacing.X;
-			inStream >> OutVolumeInfo.Spacing.Y;
-			inStream >> OutVolumeInfo.Spacing.Z;
-
-			OutVolumeInfo.WorldDimensions = OutVolumeInfo.Spacing * FVector(OutVolumeInfo.Dimensions);
-		}
-		else
-		{
-			return OutVolumeInfo;
-		}
-
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "ElementType")
-		{
-			inStream >> ReadWord;
-		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
-		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-
-			inStream >> ReadWord;
-			if (ReadWord == "MET_UCHAR")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedChar;
-			}
-			else if (ReadWord == "MET_CHAR")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedChar;
-			}
-
-			else if (ReadWord == "MET_USHORT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedShort;
-			}
-			else if (ReadWord == "MET_SHORT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedShort;
-			}
-			else if (ReadWord == "MET_UINT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedInt;
-			}
-			else if (ReadWord == "MET_INT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedInt;
-			}
-			else if (ReadWord == "MET_FLOAT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::Float;
-			}
-			else
-			{
-				return OutVolumeInfo;
-			}
-		}
-		else
-		{
-			return OutVolumeInfo;
-		}
-
-		OutVolumeInfo.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(OutVolumeInfo.OriginalFormat);
-		OutVolumeInfo.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(OutVolumeInfo.OriginalFormat);
-
-		// Check for compressed data size tag.
-
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "CompressedDataSize")
-		{
-			inStream >> ReadWord;
-		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
-		{
-			OutVolumeInfo.bIsCompressed = true;
-
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-
-			inStream >> OutVolumeInfo.CompressedByteSize;
-		}
-
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "ElementDataFile")
-		{
-			inStream >> ReadWord;
-		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
-		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-
-			inStream >> ReadWord;
-		}
-		else
-		{
-			return OutVolumeInfo;
-		}
-		OutVolumeInfo.DataFileName = FString(ReadWord.c_str());
-		OutVolumeInfo.bParseWasSuccessful = true;
-		// Return with constructor that sets success to true.
-		return OutVolumeInfo;
+		Header.ToVolumeInfo(OutVolumeInfo);
 	}
+	return OutVolumeInfo;
 }
 
 UVolumeAsset* UMHDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
@@ -199,7 +44,8 @@ UVolumeAsset* UMHDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize
 	}
 
 	// Perform complete load and conversion of data.
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertDataCached(
+		FilePath, {FilePath + "/" + VolumeInfo.DataFileName}, VolumeInfo, bNormalize, bConvertToFloat);
 
 	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
 	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
@@ -239,7 +85,8 @@ UVolumeAsset* UMHDLoader::CreatePersistentVolumeFromFile(
 		return nullptr;
 	}
 
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, false);
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertDataCached(
+		FilePath, {FilePath + "/" + VolumeInfo.DataFileName}, VolumeInfo, bNormalize, false);
 	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
 
 	// Create the persistent volume texture.
@@ -280,7 +127,8 @@ UVolumeAsset* UMHDLoader::CreateVolumeFromFileInExistingPackage(
 	}
 
 	// Perform complete load and conversion of data.
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertDataCached(
+		FilePath, {FilePath + "/" + VolumeInfo.DataFileName}, VolumeInfo, bNormalize, bConvertToFloat);
 
 	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
 	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
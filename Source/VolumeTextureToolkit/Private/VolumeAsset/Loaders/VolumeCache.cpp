@@ -0,0 +1,293 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "VolumeAsset/Loaders/VolumeCache.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+static TAutoConsoleVariable<bool> CVarVolumeCache(TEXT("VolumeTextureToolkit.VolumeCache"), true,
+	TEXT("If true, converted volume data is cached in Saved/VolumeCache and reused while the source files and conversion "
+		 "settings stay the same."));
+
+static TAutoConsoleVariable<int32> CVarVolumeCacheMaxSizeMB(TEXT("VolumeTextureToolkit.VolumeCacheMaxSizeMB"), 8192,
+	TEXT("Size cap of the converted volume cache in MB. Least recently used entries get evicted when it's exceeded."));
+
+namespace
+{
+const TCHAR* EntryExtension = TEXT("vcache");
+
+/// Bytes at the start of every entry - magic, version, payload offset and payload size.
+constexpr int64 EntryPrefixByteSize = 2 * sizeof(uint32) + 2 * sizeof(int64);
+
+/// Serializes all of the volume info, including the members that aren't UPROPERTYs.
+void SerializeVolumeInfo(FArchive& Ar, FVolumeInfo& Info)
+{
+	FVolumeInfo::StaticStruct()->SerializeBin(Ar, &Info);
+	Ar << Info.bParseWasSuccessful << Info.bIsCompressed << Info.CompressedByteSize << Info.bIsSigned;
+	uint64 BytesPerVoxel = Info.BytesPerVoxel;
+	Ar << BytesPerVoxel;
+	Info.BytesPerVoxel = BytesPerVoxel;
+	Ar << Info.minSliceNumber << Info.maxSliceNumber;
+}
+
+/// Reads Size bytes in blocks of FVolumeCache::BlockByteSize.
+bool ReadBlocks(IFileHandle& Handle, uint8* Destination, int64 Size)
+{
+	for (int64 Offset = 0; Offset < Size; Offset += FVolumeCache::BlockByteSize)
+	{
+		if (!Handle.Read(Destination + Offset, FMath::Min(FVolumeCache::BlockByteSize, Size - Offset)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool WriteBlocks(IFileHandle& Handle, const uint8* Source, int64 Size)
+{
+	for (int64 Offset = 0; Offset < Size; Offset += FVolumeCache::BlockByteSize)
+	{
+		if (!Handle.Write(Source + Offset, FMath::Min(FVolumeCache::BlockByteSize, Size - Offset)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}	 // namespace
+
+FVolumeCacheKey FVolumeCacheKey::Make(const TArray<FString>& SourceFiles, const FVolumeInfo& SourceInfo, bool bNormalize,
+	bool bConvertToFloat, const FString& LoaderSettings)
+{
+	FVolumeCacheKey Key;
+	Key.Description = FString::Printf(TEXT("version=%u|normalize=%d|float=%d|settings=%s"), FVolumeCache::Version,
+		bNormalize ? 1 : 0, bConvertToFloat ? 1 : 0, *LoaderSettings);
+
+	for (const FString& SourceFile : SourceFiles)
+	{
+		const FFileStatData Stat = IFileManager::Get().GetStatData(*SourceFile);
+		if (!Stat.bIsValid || Stat.bIsDirectory)
+		{
+			return FVolumeCacheKey();
+		}
+		Key.Description += FString::Printf(TEXT("|%s|%lld|%lld"), *FPaths::ConvertRelativePathToFull(SourceFile), Stat.FileSize,
+			Stat.ModificationTime.GetTicks());
+	}
+
+	TArray<uint8> InfoBytes;
+	FMemoryWriter Writer(InfoBytes);
+	FVolumeInfo InfoCopy = SourceInfo;
+	SerializeVolumeInfo(Writer, InfoCopy);
+	Key.Description += TEXT("|info=") + BytesToHex(InfoBytes.GetData(), InfoBytes.Num());
+
+	FSHA1 Sha;
+	Sha.UpdateWithString(*Key.Description, Key.Description.Len());
+	Sha.Final();
+	FSHAHash Hash;
+	Sha.GetHash(Hash.Hash);
+	Key.Hash = Hash.ToString();
+	return Key;
+}
+
+bool FVolumeCacheKey::IsValid() const
+{
+	return !Hash.IsEmpty();
+}
+
+bool FVolumeCache::IsEnabled()
+{
+	return CVarVolumeCache.GetValueOnAnyThread();
+}
+
+FString FVolumeCache::GetDefaultDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("VolumeCache");
+}
+
+int64 FVolumeCache::GetDefaultMaxByteSize()
+{
+	return static_cast<int64>(CVarVolumeCacheMaxSizeMB.GetValueOnAnyThread()) * 1024 * 1024;
+}
+
+int64 FVolumeCache::GetPayloadByteSize(const FVolumeInfo& ConvertedInfo)
+{
+	// Not BytesPerVoxel, as float conversion doesn't update that.
+	return ConvertedInfo.GetTotalVoxels() * FVolumeInfo::VoxelFormatByteSize(ConvertedInfo.ActualFormat);
+}
+
+FString FVolumeCache::GetEntryFileName(const FVolumeCacheKey& Key, const FString& Directory)
+{
+	return Directory / Key.Hash + TEXT(".") + EntryExtension;
+}
+
+TUniquePtr<uint8[]> FVolumeCache::Load(const FVolumeCacheKey& Key, FVolumeInfo& OutInfo, const FString& Directory)
+{
+	if (!Key.IsValid())
+	{
+		return nullptr;
+	}
+	const FString FileName = GetEntryFileName(Key, Directory);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> Handle(PlatformFile.OpenRead(*FileName));
+	if (!Handle)
+	{
+		return nullptr;
+	}
+
+	// Fixed-size prefix first, it says how large the rest of the header is.
+	TArray<uint8> Header;
+	Header.SetNumUninitialized(EntryPrefixByteSize);
+	if (!Handle->Read(Header.GetData(), EntryPrefixByteSize))
+	{
+		return nullptr;
+	}
+	uint32 EntryMagic = 0, EntryVersion = 0;
+	int64 PayloadOffset = 0, PayloadByteSize = 0;
+	{
+		FMemoryReader Reader(Header);
+		Reader << EntryMagic << EntryVersion << PayloadOffset << PayloadByteSize;
+	}
+	if (EntryMagic != Magic || EntryVersion != Version || PayloadOffset < EntryPrefixByteSize ||
+		PayloadOffset + PayloadByteSize != Handle->Size())
+	{
+		UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring invalid volume cache entry %s."), *FileName);
+		return nullptr;
+	}
+
+	Header.SetNumUninitialized(PayloadOffset - EntryPrefixByteSize);
+	if (!Handle->Read(Header.GetData(), Header.Num()))
+	{
+		return nullptr;
+	}
+	FString Description;
+	FVolumeInfo Info;
+	{
+		FMemoryReader Reader(Header);
+		Reader << Description;
+		SerializeVolumeInfo(Reader, Info);
+		if (Reader.IsError())
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring invalid volume cache entry %s."), *FileName);
+			return nullptr;
+		}
+	}
+	// Hash collision or an entry from before a format change.
+	if (Description != Key.Description || PayloadByteSize != GetPayloadByteSize(Info))
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<uint8[]> Data(new uint8[PayloadByteSize]);
+	if (!ReadBlocks(*Handle, Data.Get(), PayloadByteSize))
+	{
+		UE_LOG(LogVolumeLoader, Warning, TEXT("Failed reading volume cache entry %s."), *FileName);
+		return nullptr;
+	}
+	Handle.Reset();
+
+	// The modification time doubles as the last use time for eviction.
+	PlatformFile.SetTimeStamp(*FileName, FDateTime::UtcNow());
+	OutInfo = Info;
+	return Data;
+}
+
+bool FVolumeCache::Store(
+	const FVolumeCacheKey& Key, const FVolumeInfo& ConvertedInfo, const uint8* Data, const FString& Directory, int64 MaxByteSize)
+{
+	const int64 PayloadByteSize = GetPayloadByteSize(ConvertedInfo);
+	if (!Key.IsValid() || !Data || PayloadByteSize > MaxByteSize)
+	{
+		return false;
+	}
+
+	TArray<uint8> Header;
+	FMemoryWriter Writer(Header);
+	uint32 EntryMagic = Magic, EntryVersion = Version;
+	int64 PayloadOffset = 0, EntryPayloadByteSize = PayloadByteSize;
+	Writer << EntryMagic << EntryVersion << PayloadOffset << EntryPayloadByteSize;
+	FString Description = Key.Description;
+	Writer << Description;
+	FVolumeInfo Info = ConvertedInfo;
+	SerializeVolumeInfo(Writer, Info);
+
+	// Pad the header, so that the payload starts aligned, then patch the offset into the prefix.
+	PayloadOffset = Align(Header.Num(), PayloadAlignment);
+	Header.SetNumZeroed(PayloadOffset);
+	Writer.Seek(sizeof(uint32) * 2);
+	Writer << PayloadOffset;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*Directory);
+	const FString FileName = GetEntryFileName(Key, Directory);
+	const FString TempFileName = FileName + TEXT(".tmp");
+	{
+		TUniquePtr<IFileHandle> Handle(PlatformFile.OpenWrite(*TempFileName));
+		if (!Handle || !Handle->Write(Header.GetData(), Header.Num()) || !WriteBlocks(*Handle, Data, PayloadByteSize))
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Failed writing volume cache entry %s."), *TempFileName);
+			Handle.Reset();
+			PlatformFile.DeleteFile(*TempFileName);
+			return false;
+		}
+	}
+
+	// Written under a temporary name and moved in place, so that a partially written entry never gets loaded.
+	PlatformFile.DeleteFile(*FileName);
+	if (!PlatformFile.MoveFile(*FileName, *TempFileName))
+	{
+		PlatformFile.DeleteFile(*TempFileName);
+		return false;
+	}
+
+	Trim(Directory, MaxByteSize);
+	return true;
+}
+
+void FVolumeCache::Trim(const FString& Directory, int64 MaxByteSize)
+{
+	struct FEntry
+	{
+		FString FileName;
+		FDateTime LastUsed;
+		int64 ByteSize;
+	};
+	TArray<FEntry> Entries;
+	int64 TotalByteSize = 0;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.IterateDirectoryStat(*Directory, [&](const TCHAR* FileName, const FFileStatData& Stat) {
+		if (!Stat.bIsDirectory && FPaths::GetExtension(FileName) == EntryExtension)
+		{
+			Entries.Add({FileName, Stat.ModificationTime, Stat.FileSize});
+			TotalByteSize += Stat.FileSize;
+		}
+		return true;
+	});
+	if (TotalByteSize <= MaxByteSize)
+	{
+		return;
+	}
+
+	Entries.Sort([](const FEntry& A, const FEntry& B) { return A.LastUsed < B.LastUsed; });
+	for (const FEntry& Entry : Entries)
+	{
+		if (TotalByteSize <= MaxByteSize)
+		{
+			break;
+		}
+		if (PlatformFile.DeleteFile(*Entry.FileName))
+		{
+			TotalByteSize -= Entry.ByteSize;
+			UE_LOG(LogVolumeLoader, Log, TEXT("Evicted volume cache entry %s."), *Entry.FileName);
+		}
+	}
+}
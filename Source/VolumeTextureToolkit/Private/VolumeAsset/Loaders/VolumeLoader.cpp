@@ -6,13 +6,20 @@
 #include "VolumeAsset/Loaders/VolumeLoader.h"
 
 #include "HAL/FileManagerGeneric.h"
+#include "HAL/IConsoleManager.h"
 #include "Logging/LogMacros.h"
 #include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
 #include "TextureUtilities.h"
+#include "VolumeAsset/Loaders/VolumeCache.h"
+#include "VolumeAsset/Loaders/VolumeStreamReader.h"
 
 DEFINE_LOG_CATEGORY(LogVolumeLoader)
 
+static TAutoConsoleVariable<bool> CVarStreamRawVolumes(TEXT("VolumeTextureToolkit.StreamRawVolumes"), true,
+	TEXT("If true, raw volumes are converted slab by slab instead of being read into memory whole first. Uncompressed files get "
+		 "memory-mapped, zlib-compressed ones get inflated in a pipeline overlapping with the conversion."));
+
 TUniquePtr<uint8[]> IVolumeLoader::LoadRawDataFileFromInfo(const FString& FilePath, const FVolumeInfo& Info)
 {
 	if (Info.bIsCompressed)
@@ -88,12 +95,45 @@ void IVolumeLoader::GetValidPackageNameFromFolderName(const FString& FullPath, F
 TUniquePtr<uint8[]> IVolumeLoader::LoadAndConvertData(
 	FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
 {
+	if (CVarStreamRawVolumes.GetValueOnAnyThread())
+	{
+		const FString DataFilePath = FilePath + "/" + VolumeInfo.DataFileName;
+		return VolumeInfo.bIsCompressed
+				   ? FVolumeStreamReader::LoadAndConvertZLibFile(DataFilePath, VolumeInfo, bNormalize, bConvertToFloat)
+				   : FVolumeStreamReader::LoadAndConvertRawFile(DataFilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	}
+
 	// Load raw data.
 	TUniquePtr<uint8[]> LoadedArray = LoadRawDataFileFromInfo(FilePath, VolumeInfo);
 	LoadedArray = ConvertData(MoveTemp(LoadedArray), VolumeInfo, bNormalize, bConvertToFloat);
 	return LoadedArray;
 }
 
+TUniquePtr<uint8[]> IVolumeLoader::LoadAndConvertDataCached(FString FilePath, const TArray<FString>& SourceFiles,
+	FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat, const FString& LoaderSettings)
+{
+	if (!FVolumeCache::IsEnabled())
+	{
+		return LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	}
+
+	const FVolumeCacheKey Key = FVolumeCacheKey::Make(SourceFiles, VolumeInfo, bNormalize, bConvertToFloat, LoaderSettings);
+	FVolumeInfo CachedInfo;
+	if (TUniquePtr<uint8[]> CachedData = FVolumeCache::Load(Key, CachedInfo))
+	{
+		UE_LOG(LogVolumeLoader, Log, TEXT("Loaded converted volume %s from the volume cache."), *VolumeInfo.DataFileName);
+		VolumeInfo = CachedInfo;
+		return CachedData;
+	}
+
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	if (LoadedArray)
+	{
+		FVolumeCache::Store(Key, VolumeInfo, LoadedArray.Get());
+	}
+	return LoadedArray;
+}
+
 TUniquePtr<uint8[]> IVolumeLoader::ConvertData(TUniquePtr<uint8[]>&& LoadedArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
 {
 	VolumeInfo.bIsNormalized = bNormalize;
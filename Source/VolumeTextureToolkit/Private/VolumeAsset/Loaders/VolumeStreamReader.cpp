@@ -0,0 +1,553 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#include "VolumeAsset/Loaders/VolumeStreamReader.h"
+
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "TextureUtilities.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+FCriticalSection FVolumeStreamReader::LastStatsMutex;
+FVolumeStreamStats FVolumeStreamReader::LastStats;
+
+double FVolumeStreamStats::GetThroughputMBPerSecond() const
+{
+	return Seconds > 0.0 ? (BytesRead / (1024.0 * 1024.0)) / Seconds : 0.0;
+}
+
+uint64 FVolumeStreamStats::GetPeakResidentGrowth() const
+{
+	return PeakUsedPhysical > StartUsedPhysical ? PeakUsedPhysical - StartUsedPhysical : 0;
+}
+
+void FVolumeStreamStats::SampleResidentMemory()
+{
+	PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+}
+
+FString FVolumeStreamStats::ToString() const
+{
+	return FString::Printf(TEXT("Read %.1f MB, wrote %.1f MB in %.3f s (%.1f MB/s, %s). Peak resident memory growth %.1f MB."),
+		BytesRead / (1024.0 * 1024.0), BytesWritten / (1024.0 * 1024.0), Seconds, GetThroughputMBPerSecond(),
+		bMemoryMapped ? TEXT("memory-mapped") : TEXT("buffered"), GetPeakResidentGrowth() / (1024.0 * 1024.0));
+}
+
+/// Slab source reading from a memory-mapped file. Only the current slab is mapped, so pages of finished slabs can be dropped.
+class FMappedFileSlabSource : public IVolumeSlabSource
+{
+public:
+	explicit FMappedFileSlabSource(IMappedFileHandle* InHandle) : Handle(InHandle)
+	{
+	}
+
+	virtual const uint8* ReadSlab(int64 Offset, int64 Size) override
+	{
+		// Unmap the previous slab before mapping the next one.
+		Region.Reset();
+		Region.Reset(Handle->MapRegion(Offset, Size, true));
+		return Region ? Region->GetMappedPtr() : nullptr;
+	}
+
+	virtual bool IsMemoryMapped() const override
+	{
+		return true;
+	}
+
+private:
+	TUniquePtr<IMappedFileHandle> Handle;
+	TUniquePtr<IMappedFileRegion> Region;
+};
+
+/// Slab source reading through a regular file handle into a single slab-sized buffer. Used where memory-mapping isn't available.
+class FBufferedFileSlabSource : public IVolumeSlabSource
+{
+public:
+	explicit FBufferedFileSlabSource(IFileHandle* InHandle) : Handle(InHandle)
+	{
+	}
+
+	virtual const uint8* ReadSlab(int64 Offset, int64 Size) override
+	{
+		Buffer.SetNumUninitialized(Size, EAllowShrinking::No);
+		if (!Handle->Seek(Offset) || !Handle->Read(Buffer.GetData(), Size))
+		{
+			return nullptr;
+		}
+		return Buffer.GetData();
+	}
+
+	virtual bool IsMemoryMapped() const override
+	{
+		return false;
+	}
+
+private:
+	TUniquePtr<IFileHandle> Handle;
+	TArray64<uint8> Buffer;
+};
+
+/// Slab source inflating a zlib stream. The compressed file is read in fixed windows and the next slab is inflated on a pool
+/// thread while the caller converts the current one, so disk reads, decompression and conversion overlap.
+class FZLibSlabSource : public IVolumeSlabSource
+{
+public:
+	/// Size of a single read from the compressed file.
+	static constexpr int64 ReadWindowSize = 4 * 1024 * 1024;
+
+	FZLibSlabSource(IFileHandle* InHandle, int64 InCompressedSize, int64 InUncompressedSize)
+		: Handle(InHandle), CompressedSize(InCompressedSize), UncompressedSize(InUncompressedSize)
+	{
+		FMemory::Memzero(Stream);
+		bStreamInitialized = inflateInit(&Stream) == Z_OK;
+	}
+
+	virtual ~FZLibSlabSource() override
+	{
+		WaitForPrefetch();
+		if (bStreamInitialized)
+		{
+			inflateEnd(&Stream);
+		}
+	}
+
+	virtual const uint8* ReadSlab(int64 Offset, int64 Size) override
+	{
+		if (!bStreamInitialized)
+		{
+			return nullptr;
+		}
+
+		if (Offset == 0)
+		{
+			WaitForPrefetch();
+		}
+
+		if (Offset == 0 && InflatedOffset != 0)
+		{
+			// A new pass over the data - start inflating from the beginning again.
+			Stream.avail_in = 0;
+			if (inflateReset(&Stream) != Z_OK || !Handle->Seek(0))
+			{
+				return nullptr;
+			}
+			CompressedRead = 0;
+			InflatedOffset = 0;
+		}
+
+		if (Prefetch.IsValid() && PrefetchOffset == Offset && PrefetchSize == Size)
+		{
+			// The slab got inflated in the background while the previous one was being converted.
+			if (!WaitForPrefetch())
+			{
+				return nullptr;
+			}
+			Swap(CurrentBuffer, PrefetchBuffer);
+		}
+		else
+		{
+			WaitForPrefetch();
+			if (Offset != InflatedOffset)
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("Compressed volumes can only be read sequentially."));
+				return nullptr;
+			}
+			CurrentBuffer.SetNumUninitialized(Size, EAllowShrinking::No);
+			if (!Inflate(CurrentBuffer.GetData(), Size))
+			{
+				return nullptr;
+			}
+		}
+
+		// Assume the next slab has the same size (all but the last one do) and start inflating it right away.
+		const int64 NextOffset = Offset + Size;
+		if (NextOffset < UncompressedSize)
+		{
+			PrefetchOffset = NextOffset;
+			PrefetchSize = FMath::Min(Size, UncompressedSize - NextOffset);
+			PrefetchBuffer.SetNumUninitialized(PrefetchSize, EAllowShrinking::No);
+			Prefetch = Async(EAsyncExecution::ThreadPool, [this]() { return Inflate(PrefetchBuffer.GetData(), PrefetchSize); });
+		}
+
+		return CurrentBuffer.GetData();
+	}
+
+	virtual bool IsMemoryMapped() const override
+	{
+		return false;
+	}
+
+private:
+	/// Waits for the background inflate (if any) and returns its result.
+	bool WaitForPrefetch()
+	{
+		if (!Prefetch.IsValid())
+		{
+			return true;
+		}
+		const bool bResult = Prefetch.Get();
+		Prefetch.Reset();
+		return bResult;
+	}
+
+	/// Inflates the next Size bytes of the stream into Destination, reading more compressed data as needed.
+	bool Inflate(uint8* Destination, int64 Size)
+	{
+		int64 Remaining = Size;
+		while (Remaining > 0)
+		{
+			if (Stream.avail_in == 0)
+			{
+				const int64 WindowSize = FMath::Min(ReadWindowSize, CompressedSize - CompressedRead);
+				if (WindowSize <= 0)
+				{
+					UE_LOG(LogVolumeLoader, Error, TEXT("Compressed data ended before the whole volume got inflated."));
+					return false;
+				}
+				InputWindow.SetNumUninitialized(WindowSize, EAllowShrinking::No);
+				if (!Handle->Read(InputWindow.GetData(), WindowSize))
+				{
+					UE_LOG(LogVolumeLoader, Error, TEXT("Failed reading compressed volume data."));
+					return false;
+				}
+				CompressedRead += WindowSize;
+				Stream.next_in = InputWindow.GetData();
+				Stream.avail_in = static_cast<uInt>(WindowSize);
+			}
+
+			// avail_out is only 32 bit, feed huge slabs in pieces.
+			const uInt OutChunk = static_cast<uInt>(FMath::Min<int64>(Remaining, MAX_int32));
+			Stream.next_out = Destination + (Size - Remaining);
+			Stream.avail_out = OutChunk;
+
+			const int Result = inflate(&Stream, Z_NO_FLUSH);
+			Remaining -= OutChunk - Stream.avail_out;
+			if (Result == Z_STREAM_END && Remaining > 0)
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("Compressed stream ended before the whole volume got inflated."));
+				return false;
+			}
+			if (Result != Z_OK && Result != Z_STREAM_END && Result != Z_BUF_ERROR)
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("zlib inflate failed with error %d."), Result);
+				return false;
+			}
+		}
+
+		InflatedOffset += Size;
+		return true;
+	}
+
+	TUniquePtr<IFileHandle> Handle;
+	const int64 CompressedSize;
+	const int64 UncompressedSize;
+
+	z_stream Stream;
+	bool bStreamInitialized = false;
+	int64 CompressedRead = 0;
+	int64 InflatedOffset = 0;
+
+	TArray64<uint8> InputWindow;
+	TArray64<uint8> CurrentBuffer;
+	TArray64<uint8> PrefetchBuffer;
+
+	TFuture<bool> Prefetch;
+	int64 PrefetchOffset = 0;
+	int64 PrefetchSize = 0;
+};
+
+namespace
+{
+/// Calls Callback for every slab of voxels of BytesPerVoxel bytes each. Slabs are made of whole slices, so they never split a
+/// voxel.
+template <typename CallbackType>
+bool ForEachSlab(IVolumeSlabSource& Source, const FVolumeInfo& VolumeInfo, int64 BytesPerVoxel, int64 SlabByteSize,
+	FVolumeStreamStats& Stats, CallbackType&& Callback)
+{
+	const int64 VoxelCount = VolumeInfo.GetTotalVoxels();
+	const int64 SliceVoxels = static_cast<int64>(VolumeInfo.Dimensions.X) * VolumeInfo.Dimensions.Y;
+	const int64 SliceBytes = FMath::Max<int64>(1, SliceVoxels * BytesPerVoxel);
+	const int64 SlabVoxels = FMath::Max<int64>(1, SlabByteSize / SliceBytes) * SliceVoxels;
+
+	for (int64 Start = 0; Start < VoxelCount; Start += SlabVoxels)
+	{
+		const int64 Count = FMath::Min(SlabVoxels, VoxelCount - Start);
+		const uint8* Slab = Source.ReadSlab(Start * BytesPerVoxel, Count * BytesPerVoxel);
+		if (!Slab)
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("Failed reading volume data at offset %lld."), Start * BytesPerVoxel);
+			return false;
+		}
+
+		Callback(Slab, Start, Count);
+		Stats.BytesRead += Count * BytesPerVoxel;
+		Stats.SampleResidentMemory();
+	}
+	return true;
+}
+
+template <typename InType, typename OutType>
+TUniquePtr<uint8[]> StreamNormalize(
+	IVolumeSlabSource& Source, FVolumeInfo& VolumeInfo, int64 SlabByteSize, FVolumeStreamStats& Stats)
+{
+	// First pass finds the min and max, second pass normalizes.
+	InType InMin = std::numeric_limits<InType>::max();
+	InType InMax = std::numeric_limits<InType>::lowest();
+	const int64 InBytesPerVoxel = sizeof(InType);
+	if (!ForEachSlab(Source, VolumeInfo, InBytesPerVoxel, SlabByteSize, Stats, [&](const uint8* Slab, int64 Start, int64 Count) {
+			UVolumeTextureToolkit::FindMinMaxParallel(reinterpret_cast<const InType*>(Slab), Count, InMin, InMax);
+		}))
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<uint8[]> OutArray(new uint8[VolumeInfo.GetTotalVoxels() * sizeof(OutType)]);
+	OutType* OutCastArray = reinterpret_cast<OutType*>(OutArray.Get());
+	if (!ForEachSlab(Source, VolumeInfo, InBytesPerVoxel, SlabByteSize, Stats, [&](const uint8* Slab, int64 Start, int64 Count) {
+			UVolumeTextureToolkit::NormalizeArrayParallel(
+				reinterpret_cast<const InType*>(Slab), OutCastArray + Start, Count, InMin, InMax);
+		}))
+	{
+		return nullptr;
+	}
+
+	VolumeInfo.MinValue = (float) InMin;
+	VolumeInfo.MaxValue = (float) InMax;
+	Stats.BytesWritten = VolumeInfo.GetTotalVoxels() * sizeof(OutType);
+	return OutArray;
+}
+
+template <typename InType>
+TUniquePtr<uint8[]> StreamConvertToFloat(
+	IVolumeSlabSource& Source, FVolumeInfo& VolumeInfo, int64 SlabByteSize, FVolumeStreamStats& Stats)
+{
+	TUniquePtr<uint8[]> OutArray(new uint8[VolumeInfo.GetTotalVoxels() * sizeof(float)]);
+	float* OutCastArray = reinterpret_cast<float*>(OutArray.Get());
+	const int64 InBytesPerVoxel = sizeof(InType);
+	if (!ForEachSlab(Source, VolumeInfo, InBytesPerVoxel, SlabByteSize, Stats, [&](const uint8* Slab, int64 Start, int64 Count) {
+			UVolumeTextureToolkit::ConvertToFloatParallel(reinterpret_cast<const InType*>(Slab), OutCastArray + Start, Count);
+		}))
+	{
+		return nullptr;
+	}
+
+	Stats.BytesWritten = VolumeInfo.GetTotalVoxels() * sizeof(float);
+	return OutArray;
+}
+
+TUniquePtr<uint8[]> StreamCopy(
+	IVolumeSlabSource& Source, FVolumeInfo& VolumeInfo, int64 SlabByteSize, FVolumeStreamStats& Stats)
+{
+	TUniquePtr<uint8[]> OutArray(new uint8[VolumeInfo.GetByteSize()]);
+	const int64 BytesPerVoxel = VolumeInfo.BytesPerVoxel;
+	if (!ForEachSlab(Source, VolumeInfo, BytesPerVoxel, SlabByteSize, Stats, [&](const uint8* Slab, int64 Start, int64 Count) {
+			FMemory::Memcpy(OutArray.Get() + Start * BytesPerVoxel, Slab, Count * BytesPerVoxel);
+		}))
+	{
+		return nullptr;
+	}
+
+	Stats.BytesWritten = VolumeInfo.GetByteSize();
+	return OutArray;
+}
+
+
+// Returns FileName if it exists as an absolute path, otherwise FileName relative to the content directory.
+FString ResolveVolumeFilePath(const FString& FileName)
+{
+	return FPlatformFileManager::Get().GetPlatformFile().FileExists(*FileName) ? FileName : FPaths::ProjectContentDir() + FileName;
+}
+}	 // namespace
+
+TUniquePtr<uint8[]> FVolumeStreamReader::LoadAndConvertRawFile(
+	const FString& FileName, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString FullPath = ResolveVolumeFilePath(FileName);
+
+	const int64 FileSize = PlatformFile.FileSize(*FullPath);
+	if (FileSize < 0)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw file could not be opened."));
+		return nullptr;
+	}
+	else if (FileSize < VolumeInfo.GetByteSize())
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw file is smaller than expected, cannot read volume."));
+		return nullptr;
+	}
+	else if (FileSize > VolumeInfo.GetByteSize())
+	{
+		UE_LOG(LogVolumeLoader, Warning,
+			TEXT("Raw File is larger than expected,	check your dimensions and pixel format. (nonfatal, but the texture will "
+				 "probably be screwed up)"));
+	}
+
+	TUniquePtr<IVolumeSlabSource> Source;
+	if (IMappedFileHandle* MappedHandle = PlatformFile.OpenMapped(*FullPath))
+	{
+		Source = MakeUnique<FMappedFileSlabSource>(MappedHandle);
+	}
+	else if (IFileHandle* FileHandle = PlatformFile.OpenRead(*FullPath))
+	{
+		Source = MakeUnique<FBufferedFileSlabSource>(FileHandle);
+	}
+	else
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw file could not be opened."));
+		return nullptr;
+	}
+
+	FVolumeStreamStats Stats;
+	TUniquePtr<uint8[]> Data = LoadAndConvert(*Source, VolumeInfo, bNormalize, bConvertToFloat, Stats);
+	UE_LOG(LogVolumeLoader, Log, TEXT("Streamed %s : %s"), *FullPath, *Stats.ToString());
+	return Data;
+}
+
+TUniquePtr<uint8[]> FVolumeStreamReader::LoadAndConvertZLibFile(const FString& FileName, FVolumeInfo& VolumeInfo, bool bNormalize,
+	bool bConvertToFloat, int64 SlabByteSize /*= DefaultSlabByteSize*/)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString FullPath = ResolveVolumeFilePath(FileName);
+
+	const int64 FileSize = PlatformFile.FileSize(*FullPath);
+	if (FileSize < 0)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw compressed file could not be opened."));
+		return nullptr;
+	}
+	else if (FileSize < VolumeInfo.CompressedByteSize)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw compressed file is smaller than expected, cannot read volume."));
+		return nullptr;
+	}
+	else if (FileSize > VolumeInfo.CompressedByteSize)
+	{
+		UE_LOG(LogVolumeLoader, Warning,
+			TEXT("Raw compressed file is larger than expected, check your dimensions and pixel format. (nonfatal, but the texture "
+				 "will probably be screwed up)"));
+	}
+
+	IFileHandle* FileHandle = PlatformFile.OpenRead(*FullPath);
+	if (!FileHandle)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Raw compressed file could not be opened."));
+		return nullptr;
+	}
+
+	FZLibSlabSource Source(FileHandle, VolumeInfo.CompressedByteSize, VolumeInfo.GetByteSize());
+	FVolumeStreamStats Stats;
+	TUniquePtr<uint8[]> Data = LoadAndConvert(Source, VolumeInfo, bNormalize, bConvertToFloat, Stats, SlabByteSize);
+	UE_LOG(LogVolumeLoader, Log, TEXT("Streamed %s : %s"), *FullPath, *Stats.ToString());
+	return Data;
+}
+
+TUniquePtr<uint8[]> FVolumeStreamReader::LoadAndConvert(IVolumeSlabSource& Source, FVolumeInfo& VolumeInfo, bool bNormalize,
+	bool bConvertToFloat, FVolumeStreamStats& OutStats, int64 SlabByteSize /*= DefaultSlabByteSize*/)
+{
+	OutStats = FVolumeStreamStats();
+	OutStats.bMemoryMapped = Source.IsMemoryMapped();
+	OutStats.StartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	OutStats.PeakUsedPhysical = OutStats.StartUsedPhysical;
+	const double StartTime = FPlatformTime::Seconds();
+
+	TUniquePtr<uint8[]> Data;
+	VolumeInfo.bIsNormalized = bNormalize;
+	if (bNormalize)
+	{
+		// Same format mapping as UVolumeTextureToolkit::NormalizeArrayByFormat - normalize and cap at G16.
+		switch (VolumeInfo.OriginalFormat)
+		{
+			case EVolumeVoxelFormat::UnsignedChar:
+				Data = StreamNormalize<uint8, uint8>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedChar:
+				Data = StreamNormalize<int8, uint8>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::UnsignedShort:
+				Data = StreamNormalize<uint16, uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedShort:
+				Data = StreamNormalize<int16, uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::UnsignedInt:
+				Data = StreamNormalize<uint32, uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedInt:
+				Data = StreamNormalize<int32, uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::Float:
+				Data = StreamNormalize<float, uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			default:
+				ensure(false);
+				return nullptr;
+		}
+
+		if (VolumeInfo.BytesPerVoxel > 1)
+		{
+			VolumeInfo.BytesPerVoxel = 2;
+			VolumeInfo.ActualFormat = EVolumeVoxelFormat::UnsignedShort;
+		}
+		else
+		{
+			VolumeInfo.ActualFormat = EVolumeVoxelFormat::UnsignedChar;
+		}
+	}
+	else if (bConvertToFloat && VolumeInfo.OriginalFormat != EVolumeVoxelFormat::Float)
+	{
+		switch (VolumeInfo.OriginalFormat)
+		{
+			case EVolumeVoxelFormat::UnsignedChar:
+				Data = StreamConvertToFloat<uint8>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedChar:
+				Data = StreamConvertToFloat<int8>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::UnsignedShort:
+				Data = StreamConvertToFloat<uint16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedShort:
+				Data = StreamConvertToFloat<int16>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::UnsignedInt:
+				Data = StreamConvertToFloat<uint32>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			case EVolumeVoxelFormat::SignedInt:
+				Data = StreamConvertToFloat<int32>(Source, VolumeInfo, SlabByteSize, OutStats);
+				break;
+			default:
+				ensure(false);
+				return nullptr;
+		}
+		VolumeInfo.ActualFormat = EVolumeVoxelFormat::Float;
+	}
+	else
+	{
+		Data = StreamCopy(Source, VolumeInfo, SlabByteSize, OutStats);
+		VolumeInfo.ActualFormat = VolumeInfo.OriginalFormat;
+	}
+
+	OutStats.Seconds = FPlatformTime::Seconds() - StartTime;
+	OutStats.SampleResidentMemory();
+	{
+		FScopeLock Lock(&LastStatsMutex);
+		LastStats = OutStats;
+	}
+	return Data;
+}
+
+FVolumeStreamStats FVolumeStreamReader::GetLastStats()
+{
+	FScopeLock Lock(&LastStatsMutex);
+	return LastStats;
+}
@@ -7,12 +7,12 @@
 
 int64 FVolumeInfo::GetByteSize() const
 {
-	return Dimensions.X * Dimensions.Y * Dimensions.Z * BytesPerVoxel;
+	return static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z * BytesPerVoxel;
 }
 
 int64 FVolumeInfo::GetTotalVoxels() const
 {
-	return Dimensions.X * Dimensions.Y * Dimensions.Z;
+	return static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z;
 }
 
 float FVolumeInfo::NormalizeValue(float InValue)
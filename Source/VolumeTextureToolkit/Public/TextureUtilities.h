@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "Async/ParallelFor.h"
 #include "CoreMinimal.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Engine/VolumeTexture.h"
@@ -98,19 +99,131 @@ public:
 	static void LoadRawIntoVolumeTextureAsset(FString RawFileName, UVolumeTexture* inTexture, FIntVector Dimensions,
 		uint32 BytexPerVoxel, EPixelFormat OutPixelFormat, bool Persistent);
 
+	/// Number of voxels a single task processes in the parallel conversion functions.
+	static constexpr int64 ConversionChunkSize = 64 * 1024;
+
+	/** Extends InOutMin and InOutMax by the values found in InArray. Runs as a ParallelFor over chunks of ConversionChunkSize
+		voxels, whose results get merged at the end. Can be called repeatedly on consecutive slabs of a volume.*/
+	template <typename InType>
+	static void FindMinMaxParallel(const InType* InArray, int64 ElementCount, InType& InOutMin, InType& InOutMax)
+	{
+		const int32 NumChunks = static_cast<int32>(FMath::DivideAndRoundUp<int64>(ElementCount, ConversionChunkSize));
+
+		// Every chunk finds its own min and max, these get merged once all chunks are done.
+		TArray<InType> ChunkMins, ChunkMaxs;
+		ChunkMins.SetNumUninitialized(NumChunks);
+		ChunkMaxs.SetNumUninitialized(NumChunks);
+		ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+			const int64 Start = ChunkIndex * ConversionChunkSize;
+			const int64 End = FMath::Min(Start + ConversionChunkSize, ElementCount);
+
+			InType ChunkMin = std::numeric_limits<InType>::max();
+			InType ChunkMax = std::numeric_limits<InType>::lowest();
+			for (int64 i = Start; i < End; i++)
+			{
+				ChunkMin = FMath::Min(ChunkMin, InArray[i]);
+				ChunkMax = FMath::Max(ChunkMax, InArray[i]);
+			}
+			ChunkMins[ChunkIndex] = ChunkMin;
+			ChunkMaxs[ChunkIndex] = ChunkMax;
+		});
+
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+		{
+			InOutMin = FMath::Min(InOutMin, ChunkMins[ChunkIndex]);
+			InOutMax = FMath::Max(InOutMax, ChunkMaxs[ChunkIndex]);
+		}
+	}
+
+	/** Normalizes InArray from the [InMin, InMax] range to the full range of OutType and writes it into OutArray. Runs as a
+		ParallelFor over chunks of ConversionChunkSize voxels. Can be called repeatedly on consecutive slabs of a volume.*/
+	template <typename InType, typename OutType>
+	static void NormalizeArrayParallel(const InType* InArray, OutType* OutArray, int64 ElementCount, InType InMin, InType InMax)
+	{
+		const int32 NumChunks = static_cast<int32>(FMath::DivideAndRoundUp<int64>(ElementCount, ConversionChunkSize));
+
+		// Same arithmetic as the serial version, just hoisted out of the loop, so that the results match bit for bit.
+		const float InMinFloat = static_cast<float>(InMin);
+		const float InRange = static_cast<float>(InMax) - InMinFloat;
+		const float OutMinFloat = static_cast<float>(std::numeric_limits<OutType>::min());
+		const float OutRange = static_cast<float>(std::numeric_limits<OutType>::max() - std::numeric_limits<OutType>::min());
+
+		ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+			const int64 Start = ChunkIndex * ConversionChunkSize;
+			const int64 Count = FMath::Min(ConversionChunkSize, ElementCount - Start);
+
+			// Constant volumes would divide by zero, map them all to the minimum.
+			if (InRange == 0.0f)
+			{
+				FMemory::Memzero(OutArray + Start, Count * sizeof(OutType));
+				return;
+			}
+
+			// Plain loop over restricted pointers without branches, so that the compiler vectorizes it.
+			const InType* RESTRICT Source = InArray + Start;
+			OutType* RESTRICT Destination = OutArray + Start;
+			for (int64 i = 0; i < Count; i++)
+			{
+				const float Normalized = (static_cast<float>(Source[i]) - InMinFloat) / InRange;
+				Destination[i] = static_cast<OutType>(OutMinFloat + (Normalized * OutRange));
+			}
+		});
+	}
+
+	/** Converts InArray to floats and writes them into OutArray. Runs as a ParallelFor over chunks of ConversionChunkSize voxels.*/
+	template <typename InType>
+	static void ConvertToFloatParallel(const InType* InArray, float* OutArray, int64 ElementCount)
+	{
+		const int32 NumChunks = static_cast<int32>(FMath::DivideAndRoundUp<int64>(ElementCount, ConversionChunkSize));
+		ParallelFor(NumChunks, [&](int32 ChunkIndex) {
+			const int64 Start = ChunkIndex * ConversionChunkSize;
+			const int64 Count = FMath::Min(ConversionChunkSize, ElementCount - Start);
+
+			const InType* RESTRICT Source = InArray + Start;
+			float* RESTRICT Destination = OutArray + Start;
+			for (int64 i = 0; i < Count; i++)
+			{
+				Destination[i] = static_cast<float>(Source[i]);
+			}
+		});
+	}
+
 	/** Converts an array to an array normalized on the range of the OutType, based on the minimum and maximum values
-		found in the InArray, when cast to the type InType.*/
+		found in the InArray, when cast to the type InType.
+		The min/max reduction and the normalization both run in parallel, see FindMinMaxParallel and NormalizeArrayParallel. The
+		output is identical to ConvertArrayToNormalizedArraySerial.*/
+	template <typename InType, typename OutType>
+	static uint8* ConvertArrayToNormalizedArray(uint8* InArray, uint64 ByteSize, float& OutOriginalMin, float& OutOriginalMax)
+	{
+		const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+		const int64 ElementCount = ByteSize / sizeof(InType);
+
+		InType InMin = std::numeric_limits<InType>::max();
+		InType InMax = std::numeric_limits<InType>::lowest();
+		FindMinMaxParallel(InCastArray, ElementCount, InMin, InMax);
+
+		OutType* OutArray = new OutType[ElementCount];
+		NormalizeArrayParallel(InCastArray, OutArray, ElementCount, InMin, InMax);
+
+		// Output the original min and max.
+		OutOriginalMin = (float) InMin;
+		OutOriginalMax = (float) InMax;
+
+		return reinterpret_cast<uint8*>(OutArray);
+	}
+
+	/** Single-threaded version of ConvertArrayToNormalizedArray. Kept as a reference for testing the parallel one.*/
 	template <typename InType, typename OutType>
-	static uint8* ConvertArrayToNormalizedArray(
-		uint8* InArray, unsigned long ByteSize, float& OutOriginalMin, float& OutOriginalMax)
+	static uint8* ConvertArrayToNormalizedArraySerial(
+		uint8* InArray, uint64 ByteSize, float& OutOriginalMin, float& OutOriginalMax)
 	{
 		InType* InCastArray = reinterpret_cast<InType*>(InArray);
-		const unsigned long ElementCount = ByteSize / sizeof(InType);
+		const int64 ElementCount = ByteSize / sizeof(InType);
 
 		InType InMin = std::numeric_limits<InType>::max();
-		InType InMax = std::numeric_limits<InType>::min();
+		InType InMax = std::numeric_limits<InType>::lowest();
 
-		for (unsigned long i = 0; i < ElementCount; i++)
+		for (int64 i = 0; i < ElementCount; i++)
 		{
 			if (InCastArray[i] < InMin)
 			{
@@ -134,9 +247,14 @@ public:
 		OutType OutMin = std::numeric_limits<OutType>::min();
 		OutType OutMax = std::numeric_limits<OutType>::max();
 
-		// #TODO this could use a ParallelFor
-		for (unsigned long i = 0; i < ElementCount; i++)
+		for (int64 i = 0; i < ElementCount; i++)
 		{
+			// Constant volumes would divide by zero, map them all to the minimum.
+			if (((float) InMax - InMin) == 0.0f)
+			{
+				OutArray[i] = OutMin;
+				continue;
+			}
 			float Normalized = ((float) InCastArray[i] - InMin) / ((float) InMax - InMin);
 			OutArray[i] = OutMin + (Normalized * (OutMax - OutMin));
 		}
@@ -11,109 +11,58 @@
 #include "Engine/VolumeTexture.h"
 #include "Engine/World.h"
 #include "GlobalShader.h"
+#include "RenderGraphBuilder.h"
 #include "SceneUtils.h"
 #include "Shader.h"
-#include "ShaderParameterUtils.h"
-#include "ShaderParameters.h"
+#include "ShaderParameterStruct.h"
 
 void VOLUMETEXTURETOOLKIT_API ClearVolumeTexture_RenderThread(
 	FRHICommandListImmediate& RHICmdList, FRHITexture3D* ALightVolumeResource, float ClearValue);
 
-void VOLUMETEXTURETOOLKIT_API Clear2DTexture_RenderThread(
-	FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* TextureRW, FIntPoint TextureSize, float Value);
-// void ClearVolumeTexture_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* ALightVolumeResource, float
-// ClearValue);
+void VOLUMETEXTURETOOLKIT_API Clear2DTexture_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* Texture, float Value);
+
+/// Adds a pass setting every voxel of the volume the UAV views to ClearValue.
+void VOLUMETEXTURETOOLKIT_API AddClearVolumeTexturePass(FRDGBuilder& GraphBuilder, FRDGTextureUAVRef VolumeUAV, float ClearValue,
+	ERDGPassFlags PassFlags = ERDGPassFlags::Compute);
+
+/// Adds a pass setting every texel of the single-channel 2D float texture the UAV views to Value.
+void VOLUMETEXTURETOOLKIT_API AddClear2DTexturePass(FRDGBuilder& GraphBuilder, FRDGTextureUAVRef TextureUAV, float Value,
+	ERDGPassFlags PassFlags = ERDGPassFlags::Compute);
 
 // Compute shader for clearing a single-channel 2D float RW texture
 class FClearFloatRWTextureCS : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FClearFloatRWTextureCS, Global, VOLUMETEXTURETOOLKIT_API);
-
 public:
-	FClearFloatRWTextureCS() : FGlobalShader()
-	{
-	}
-	FClearFloatRWTextureCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
-	{
-		ClearValue.Bind(Initializer.ParameterMap, TEXT("ClearValue"), SPF_Mandatory);
-		ClearTexture2DRW.Bind(Initializer.ParameterMap, TEXT("ClearTextureRW"), SPF_Mandatory);
-	}
+	DECLARE_EXPORTED_GLOBAL_SHADER(FClearFloatRWTextureCS, VOLUMETEXTURETOOLKIT_API);
+	SHADER_USE_PARAMETER_STRUCT(FClearFloatRWTextureCS, FGlobalShader);
 
-	void SetParameters(FRHICommandList& RHICmdList, FRHIUnorderedAccessView* TextureRW, float Value)
-	{
-		SetUAVParameter(RHICmdList, RHICmdList.GetBoundComputeShader(), ClearTexture2DRW, TextureRW);
-		SetShaderValue(RHICmdList, RHICmdList.GetBoundComputeShader(), ClearValue, Value);
-	}
-
-	void UnbindUAV(FRHICommandList& RHICmdList)
-	{
-		SetUAVParameter(RHICmdList, RHICmdList.GetBoundComputeShader(), ClearTexture2DRW, nullptr);
-	}
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, ClearTextureRW)
+	SHADER_PARAMETER(float, ClearValue)
+	END_SHADER_PARAMETER_STRUCT()
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
-
-	const FShaderParameter& GetClearColorParameter()
-	{
-		return ClearValue;
-	}
-
-	const FShaderResourceParameter& GetClearTextureRWParameter()
-	{
-		return ClearTexture2DRW;
-	}
-
-protected:
-	LAYOUT_FIELD(FShaderResourceParameter, ClearTexture2DRW);
-	LAYOUT_FIELD(FShaderParameter, ClearValue);
 };
 
 // Compute Shader used for fast clearing of RW volume textures.
 class FClearVolumeTextureShaderCS : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FClearVolumeTextureShaderCS, Global, VOLUMETEXTURETOOLKIT_API);
-
 public:
-	FClearVolumeTextureShaderCS() : FGlobalShader()
-	{
-	}
+	DECLARE_EXPORTED_GLOBAL_SHADER(FClearVolumeTextureShaderCS, VOLUMETEXTURETOOLKIT_API);
+	SHADER_USE_PARAMETER_STRUCT(FClearVolumeTextureShaderCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+	// Float values to be set to the alpha volume.
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float>, Volume)
+	SHADER_PARAMETER(float, ClearValue)
+	SHADER_PARAMETER(int32, ZSize)
+	END_SHADER_PARAMETER_STRUCT()
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
-
-	static void ModifyCompilationEnvironment(
-		const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
-	{
-		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
-	}
-
-	FClearVolumeTextureShaderCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
-	{
-		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
-		ClearValue.Bind(Initializer.ParameterMap, TEXT("ClearValue"), SPF_Mandatory);
-		ZSize.Bind(Initializer.ParameterMap, TEXT("ZSize"), SPF_Mandatory);
-	}
-
-	void SetParameters(FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* VolumeRef, float clearColor, int ZSizeParam)
-	{
-		FRHIComputeShader* ShaderRHI = RHICmdList.GetBoundComputeShader();
-		SetUAVParameter(RHICmdList, ShaderRHI, Volume, VolumeRef);
-		SetShaderValue(RHICmdList, ShaderRHI, ClearValue, clearColor);
-		SetShaderValue(RHICmdList, ShaderRHI, ZSize, ZSizeParam);
-	}
-
-	void UnbindUAV(FRHICommandList& RHICmdList)
-	{
-		SetUAVParameter(RHICmdList, RHICmdList.GetBoundComputeShader(), Volume, nullptr);
-	}
-	
-protected:
-	// Float values to be set to the alpha volume.
-	LAYOUT_FIELD(FShaderResourceParameter, Volume);
-	LAYOUT_FIELD(FShaderParameter, ClearValue);
-	LAYOUT_FIELD(FShaderParameter, ZSize);
 };
@@ -63,4 +63,14 @@ public:
 	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat) override;
 
 	static void DumpFileStructure(const FString& FileName);
+
+	/// Drops all cached DICOM folder indexes. Folders are re-indexed on the next load.
+	static void ClearSeriesIndexCache();
+
+private:
+	/// All files of the series FileName belongs to (files with the same extension in its folder). Used as the volume cache key.
+	static TArray<FString> GetCacheSourceFiles(const FString& FileName);
+
+	/// The loader settings that change the loaded data (as opposed to just the parsed volume info).
+	FString GetCacheSettings() const;
 };
@@ -0,0 +1,96 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VolumeAsset/VolumeInfo.h"
+
+/// Contents of a MetaImage (.mhd/.mha) header. See https://itk.org/Wiki/ITK/MetaIO/Documentation for the meaning of the keys.
+/// All "Key = Value" lines are kept in Entries, the keys the loaders care about are also parsed into the typed fields below.
+struct VOLUMETEXTURETOOLKIT_API FMHDHeader
+{
+	/// File the header was read from. Empty when parsed from memory.
+	FString FileName;
+
+	/// True if the header could be tokenized and contained all keys needed to describe a volume.
+	bool bParseWasSuccessful = false;
+
+	/// Every key/value pair of the header in file order, with surrounding whitespace trimmed.
+	TArray<TPair<FString, FString>> Entries;
+
+	FString ObjectType;
+
+	/// Number of dimensions. Inferred from DimSize if the NDims key is missing.
+	int32 NDims = 0;
+
+	FIntVector DimSize = FIntVector(0, 0, 0);
+
+	/// Distance between voxel centers in mm. Falls back to ElementSize and then to 1 if missing.
+	FVector ElementSpacing = FVector(1, 1, 1);
+
+	/// Physical size of a voxel in mm (can differ from the spacing for gapped acquisitions).
+	FVector ElementSize = FVector(0, 0, 0);
+
+	/// World position of the first voxel (also written as Position or Origin).
+	FVector Offset = FVector(0, 0, 0);
+
+	FVector CenterOfRotation = FVector(0, 0, 0);
+
+	/// Direction cosines, stored row by row (also written as Rotation or Orientation).
+	FMatrix TransformMatrix = FMatrix::Identity;
+
+	FString AnatomicalOrientation;
+
+	FString ElementType;
+
+	int32 ElementNumberOfChannels = 1;
+
+	/// Bytes to skip at the start of the data file. -1 means the data sits at the end of the file.
+	int64 HeaderSize = 0;
+
+	bool bCompressedData = false;
+
+	int64 CompressedDataSize = 0;
+
+	/// True for big-endian data (also written as ElementByteOrderMSB).
+	bool bBinaryDataByteOrderMSB = false;
+
+	/// Data file name relative to the header, or "LOCAL" if the data directly follows the header.
+	FString ElementDataFile;
+
+	/// Number of bytes taken by the header text, up to and including the ElementDataFile line.
+	int64 HeaderByteLength = 0;
+
+	/// Returns the raw value of Key or nullptr if the header doesn't contain it.
+	const FString* Find(const FString& Key) const;
+
+	/// Fills a FVolumeInfo from the header. Returns false (and logs why) if the header describes something the volume loaders
+	/// cannot read, e.g. multi-channel or embedded data.
+	bool ToVolumeInfo(FVolumeInfo& OutVolumeInfo) const;
+};
+
+/// Single-pass MetaImage header tokenizer. Every line is split into key and value once and known keys are converted to the
+/// typed fields of FMHDHeader on the fly, so the cost is linear in the header length regardless of how many keys are used.
+class VOLUMETEXTURETOOLKIT_API FMHDHeaderParser
+{
+public:
+	/// Headers longer than this are not MetaImage headers (or are .mha files without an ElementDataFile line).
+	static constexpr int64 MaxHeaderByteSize = 64 * 1024;
+
+	/// Parses header text. Stops after the ElementDataFile line, as anything after it is embedded volume data.
+	static bool Parse(const ANSICHAR* Text, int64 Length, FMHDHeader& OutHeader);
+
+	/// Reads and parses the header of FileName. FileName is tried as an absolute path first, then relative to the content
+	/// directory. Only the first MaxHeaderByteSize bytes are read, so this is cheap even for .mha files with embedded data.
+	static bool ParseFile(const FString& FileName, FMHDHeader& OutHeader);
+
+	/// Parses the headers of all FileNames in parallel. The result has one entry per file name, in the same order.
+	static TArray<FMHDHeader> ScanFiles(const TArray<FString>& FileNames);
+
+	/// Finds all .mhd and .mha files in Directory and parses their headers in parallel. Meant for browsing large datasets without
+	/// loading any volume data.
+	static TArray<FMHDHeader> ScanDirectory(const FString& Directory, bool bRecursive = true);
+};
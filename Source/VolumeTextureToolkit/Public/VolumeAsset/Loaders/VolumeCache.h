@@ -0,0 +1,73 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+// On-disk cache of converted volume data. Converting a volume (normalizing or converting to float) is a lot slower than
+// reading the result back, so the converted voxels are stored in Saved/VolumeCache and reused until any of the source files or
+// the conversion settings change. Entries over the size cap get evicted, least recently used first.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VolumeAsset/VolumeInfo.h"
+
+/// Identifies one converted volume - the source files (with their sizes and timestamps), the volume info they were parsed into
+/// and the conversion settings.
+struct VOLUMETEXTURETOOLKIT_API FVolumeCacheKey
+{
+	/// Canonical description of everything the converted data depends on. Stored in the entry and compared on load.
+	FString Description;
+
+	/// Hash of the description, used as the entry file name.
+	FString Hash;
+
+	/// Builds a key. Returns an invalid key if any of the source files can't be found.
+	/// @param SourceFiles All files the volume data gets read from.
+	/// @param SourceInfo Volume info as parsed from the header, before loading and converting the data.
+	/// @param LoaderSettings Any loader-specific settings that affect the loaded data.
+	static FVolumeCacheKey Make(const TArray<FString>& SourceFiles, const FVolumeInfo& SourceInfo, bool bNormalize,
+		bool bConvertToFloat, const FString& LoaderSettings = FString());
+
+	bool IsValid() const;
+};
+
+/// Stores and loads converted volume data.
+/// An entry is a small header (magic, version, key description and the serialized resulting FVolumeInfo) followed by the
+/// voxels exactly as CreateVolumeTextureTransient takes them, starting at a PayloadAlignment boundary. Loading is a single
+/// sequential read into the output array in blocks of BlockByteSize.
+class VOLUMETEXTURETOOLKIT_API FVolumeCache
+{
+public:
+	static constexpr uint32 Magic = 0x43564254;	   // "TBVC"
+	static constexpr uint32 Version = 1;
+	static constexpr int64 PayloadAlignment = 4096;
+	static constexpr int64 BlockByteSize = 16 * 1024 * 1024;
+
+	/// True if the loaders should use the cache (VolumeTextureToolkit.VolumeCache).
+	static bool IsEnabled();
+
+	/// Directory holding the cache entries.
+	static FString GetDefaultDirectory();
+
+	/// Size cap of the cache in bytes (VolumeTextureToolkit.VolumeCacheMaxSizeMB).
+	static int64 GetDefaultMaxByteSize();
+
+	/// Bytes of converted voxel data of a volume after conversion.
+	static int64 GetPayloadByteSize(const FVolumeInfo& ConvertedInfo);
+
+	/// Loads the entry for Key. On a hit, OutInfo is set to the volume info the data had after conversion and the entry is
+	/// marked as most recently used. Returns nullptr on a miss.
+	static TUniquePtr<uint8[]> Load(
+		const FVolumeCacheKey& Key, FVolumeInfo& OutInfo, const FString& Directory = GetDefaultDirectory());
+
+	/// Stores converted data for Key and evicts old entries if the cache got over MaxByteSize.
+	static bool Store(const FVolumeCacheKey& Key, const FVolumeInfo& ConvertedInfo, const uint8* Data,
+		const FString& Directory = GetDefaultDirectory(), int64 MaxByteSize = GetDefaultMaxByteSize());
+
+	/// Deletes least recently used entries until the total size of the cache is at most MaxByteSize.
+	static void Trim(const FString& Directory, int64 MaxByteSize);
+
+	/// Full path of the entry file for a key.
+	static FString GetEntryFileName(const FVolumeCacheKey& Key, const FString& Directory);
+};
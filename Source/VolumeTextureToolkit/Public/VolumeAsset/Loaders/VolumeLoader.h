@@ -65,6 +65,11 @@ public:
 	// Loads the raw data specified in the VolumeInfo and converts it so that it's useable with our raymarching materials.
 	// This means either converting it to U8 or U16 and normalizing or a conversion to Float.
 	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	// Same as LoadAndConvertData, but reuses converted data from the volume cache (see VolumeCache.h) if there is any and stores it
+	// there otherwise. SourceFiles are all files the data gets read from, LoaderSettings any loader settings affecting the result.
+	TUniquePtr<uint8[]> LoadAndConvertDataCached(FString FilePath, const TArray<FString>& SourceFiles, FVolumeInfo& VolumeInfo,
+		bool bNormalize, bool bConvertToFloat, const FString& LoaderSettings = FString());
 	
 	// Converts raw data read from a Volume file so that it's useable by our materials.
 	// if bNormalize is true, the data gets normalized to 0.0 to 1.0 range and gets saved as a G8 or G16 texture later in the process.
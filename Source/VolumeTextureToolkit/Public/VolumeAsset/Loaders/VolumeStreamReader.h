@@ -0,0 +1,87 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+// Special credits go to : Temaran (compute shader tutorial), TheHugeManatee (original concept, supervision) and Ryan Brucks
+// (original raymarching code).
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VolumeAsset/VolumeInfo.h"
+
+/// Counters gathered during a streamed volume load. Used to verify the memory savings and throughput on large volumes.
+struct VOLUMETEXTURETOOLKIT_API FVolumeStreamStats
+{
+	/// Bytes of source data consumed (counted once per pass over the data).
+	int64 BytesRead = 0;
+
+	/// Bytes of converted data produced.
+	int64 BytesWritten = 0;
+
+	/// Wall-clock duration of the whole load in seconds.
+	double Seconds = 0.0;
+
+	/// Resident memory of the process when the load started.
+	uint64 StartUsedPhysical = 0;
+
+	/// Highest resident memory of the process sampled between slabs during the load.
+	uint64 PeakUsedPhysical = 0;
+
+	/// True if the source got memory-mapped, false if it was read through a regular file handle.
+	bool bMemoryMapped = false;
+
+	/// Source data throughput in MB/s.
+	double GetThroughputMBPerSecond() const;
+
+	/// How much the resident memory grew during the load at its peak.
+	uint64 GetPeakResidentGrowth() const;
+
+	/// Samples the current resident memory and updates the peak.
+	void SampleResidentMemory();
+
+	FString ToString() const;
+};
+
+/// Provides consecutive slabs of raw volume data. Within one pass, offsets only ever grow. A new pass starts at offset 0.
+class VOLUMETEXTURETOOLKIT_API IVolumeSlabSource
+{
+public:
+	virtual ~IVolumeSlabSource() = default;
+
+	/// Returns a pointer to Size bytes of data starting at Offset or nullptr on failure. The pointer is valid until the next call.
+	virtual const uint8* ReadSlab(int64 Offset, int64 Size) = 0;
+
+	/// True if the data is read directly from a memory-mapped file.
+	virtual bool IsMemoryMapped() const = 0;
+};
+
+/// Loads raw volume data slab by slab (a slab being a run of whole Z slices) and converts each slab straight into the output
+/// array. Unlike LoadRawFileIntoArray + ConvertData, a full-size copy of the unconverted data never exists.
+class VOLUMETEXTURETOOLKIT_API FVolumeStreamReader
+{
+public:
+	/// Default target size of a single slab in bytes of source data.
+	static constexpr int64 DefaultSlabByteSize = 64 * 1024 * 1024;
+
+	/// Loads and converts an uncompressed raw file, memory-mapping it where the platform supports it. FileName is tried as an
+	/// absolute path first, then relative to the content directory. Updates VolumeInfo the same way IVolumeLoader::ConvertData
+	/// does.
+	static TUniquePtr<uint8[]> LoadAndConvertRawFile(
+		const FString& FileName, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	/// Loads and converts a zlib-compressed raw file of VolumeInfo.CompressedByteSize bytes. The compressed data is read in fixed
+	/// windows and inflated one slab ahead on a pool thread, while the previous slab gets converted on the worker threads.
+	/// Normalizing needs two passes over the data, so the file gets inflated twice in that case.
+	static TUniquePtr<uint8[]> LoadAndConvertZLibFile(const FString& FileName, FVolumeInfo& VolumeInfo, bool bNormalize,
+		bool bConvertToFloat, int64 SlabByteSize = DefaultSlabByteSize);
+
+	/// Converts all data provided by Source, slab by slab. Used by LoadAndConvertRawFile, but works with any slab source.
+	static TUniquePtr<uint8[]> LoadAndConvert(IVolumeSlabSource& Source, FVolumeInfo& VolumeInfo, bool bNormalize,
+		bool bConvertToFloat, FVolumeStreamStats& OutStats, int64 SlabByteSize = DefaultSlabByteSize);
+
+	/// Returns the stats of the last finished streamed load.
+	static FVolumeStreamStats GetLastStats();
+
+private:
+	static FCriticalSection LastStatsMutex;
+	static FVolumeStreamStats LastStats;
+};
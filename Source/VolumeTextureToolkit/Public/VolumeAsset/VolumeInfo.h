@@ -104,7 +104,7 @@ public:
 
 	bool bIsCompressed = false;
 
-	int32 CompressedByteSize = 0;
+	int64 CompressedByteSize = 0;
 
 	// Returns the number of bytes needed to store this Volume.
 	int64 GetByteSize() const;